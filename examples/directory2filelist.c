@@ -80,6 +80,8 @@ int usage(const char *pgm, int defaultMJD)
 	printf("    MKIV1_4-128-2-1\n");
 	printf("    Mark5B-512-16-2\n\n");
 	printf("  [<refMJD>]  changes the reference MJD (default is %d)\n\n", defaultMJD);
+	printf("Set MARK5ACCESS_CACHE to a file (or to \"sidecar\" for one per directory)\n");
+	printf("to keep the times found, so unchanged files need not be read again.\n\n");
 
 	return 0;
 }
@@ -139,6 +141,22 @@ int verify(const char *filename, const char *formatname, int refMJD)
 	int mjd, sec;
         double ns, startmjd, stopmjd = 0.0, eofmjd = 0.0;
 	int64_t validoffset = 0;
+	char cachekey[256], cached[256];
+
+	// times found for this same file before, if caching is on
+	snprintf(cachekey, sizeof(cachekey), "%s/%s/%d", program, formatname, refMJD);
+	if(mark5_cache_get(filename, cachekey, cached, sizeof(cached)) == 0 &&
+		sscanf(cached, "%lf %lf %d", &startmjd, &stopmjd, &corrupt) == 3)
+	{
+		if(corrupt)
+		{
+			fprintf(stderr, "Warning: found corrupt data frames in file %s\n", filename);
+		}
+
+		fprintf(stdout, "%s %lf %lf\n", filename, startmjd, stopmjd);
+
+		return 0;
+	}
 
 	// open with seeking to first valid-looking frame pair
 	ms = openmk5(filename, formatname, &validoffset);
@@ -280,6 +298,12 @@ int verify(const char *filename, const char *formatname, int refMJD)
 
 	fprintf(stdout, "%s %lf %lf\n", filename, startmjd, stopmjd);
 
+	if(!die)
+	{
+		snprintf(cached, sizeof(cached), "%.17g %.17g %d", startmjd, stopmjd, corrupt);
+		mark5_cache_put(filename, cachekey, cached);
+	}
+
 	return 0;
 }
 
@@ -320,7 +344,7 @@ int main(int argc, char **argv)
 	{
 		while ( (ep = readdir (dp)) && !die )
 		{
-			if ((strcmp(ep->d_name, ".") != 0) && (strcmp(ep->d_name, "..") != 0))
+			if ((strcmp(ep->d_name, ".") != 0) && (strcmp(ep->d_name, "..") != 0) && (strcmp(ep->d_name, MARK5_CACHE_SIDECAR) != 0))
 			{
 				int p;
 
@@ -0,0 +1,711 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "../mark5access/mark5_stream.h"
+
+const char program[] = "m5bench";
+const char author[]  = "mark5access developers";
+const char version[] = "0.1";
+const char verdate[] = "20200601";
+
+/* one of each format family, at typical rates */
+static const char *defaultformats[] =
+{
+	"VLBA1_2-256-8-2",
+	"VLBA1_1-512-32-2",
+	"VLBA1_4-512-16-1",
+	"VLBN1_1-512-32-2",
+	"MKIV1_2-256-8-2",
+	"MKIV1_1-1024-32-2",
+	"Mark5B-2048-16-2",
+	"Mark5B-1024-8-1",
+	"KVN5B-2048-16-2",
+	"D2K-1024-16-2",
+	"VDIF_8000-2048-16-2",
+	"VDIF_8000-1024-1-2",
+	"VDIF_8000-4096-4-8",
+	"VDIFL_8000-2048-16-2",
+	"VDIFC_8000-2048-8-2",
+	"VDIFC_8000-4096-1-8",
+	"CODIFC_5000-51200m27-8-1",
+	0
+};
+
+enum benchop
+{
+	OP_DECODE = 0,
+	OP_COMPLEX_DECODE,
+	OP_COUNT,
+	OP_UNPACK,
+	NUM_OP
+};
+
+static const char *opnames[NUM_OP] = { "decode", "complex_decode", "count", "mark5_unpack" };
+
+struct bench
+{
+	const char *formatname;
+	struct mark5_stream *ms;
+	int headers;		/* 1 if the frames carry (generated) headers */
+	unsigned char *buffer;	/* the cold region; the warm one is its start */
+	long long nbytes;	/* in the cold region */
+	int stride;		/* bytes per frame in the buffer */
+	int chunkframes;	/* frames decoded per call, filling the warm region */
+	int chunksamples;	/* samples per channel per call */
+	int nchunk;		/* calls to cover the cold region */
+	float **data;
+	mark5_float_complex **cdata;
+	unsigned int highstates[256];
+};
+
+static void usage(const char *pgm)
+{
+	printf("\n");
+
+	printf("%s ver. %s   %s  %s\n\n", program, version, author, verdate);
+	printf("A decoder throughput benchmark.  Frames are synthesized for each format,\n"
+		"with headers from the format's own generator where it has one, and the\n"
+		"decoders are timed on data in cache (warm) and streamed from memory (cold).\n\n");
+	printf("Usage : %s [options] [<dataformat> ...]\n\n", pgm);
+	printf("  <dataformat> should be of the form: <FORMAT>-<Mbps>-<nchan>-<nbit>, e.g.:\n");
+	printf("    VLBA1_2-256-8-2\n");
+	printf("    MKIV1_4-128-2-1\n");
+	printf("    Mark5B-512-16-2\n");
+	printf("    VDIF_1000-64-1-2 (here 1000 is payload size in bytes)\n");
+	printf("  if none are given, one of each format family is benchmarked\n\n");
+	printf("The following options are supported\n\n");
+	printf("    --version     Print version information and quit\n");
+	printf("    --json        Write the results as JSON rather than a table\n");
+	printf("    --warm=<kB>   Input decoded per call, and so held in cache (default 128)\n");
+	printf("    --cold=<MB>   Input streamed for the cold cache timing (default 128)\n");
+	printf("    --time=<s>    CPU time spent on each timing (default 0.25)\n");
+	printf("    --simd=<set>  Limit the vector decoders: auto, avx512, avx2, sse4.1 or scalar\n");
+	printf("    --read=<file> Instead, time reading and decoding <file>, of the one <dataformat>\n");
+	printf("                  given, through file streams and a memory stream\n");
+	printf("    --buffers=<MB>[,<MB>...]  File stream buffer sizes for --read (default 1,16,256)\n");
+	printf("    --help        This list\n\n");
+	printf("Rates are per cpu second of the (single) decoding thread, so per core;\n"
+		"samples are counted over all channels, bytes include frame headers.\n"
+		"With --read, rates are per second of wall clock time instead; for the disk\n"
+		"to be measured the file should not be in the page cache.\n\n");
+}
+
+static double cputime(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+
+	return t.tv_sec + 1.0e-9*t.tv_nsec;
+}
+
+static double walltime(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + 1.0e-9*t.tv_nsec;
+}
+
+static int simdlevel(const char *name)
+{
+	if(strcasecmp(name, "auto") == 0)
+	{
+		return MK5_SIMD_AUTO;
+	}
+	if(strcasecmp(name, "scalar") == 0 || strcasecmp(name, "none") == 0)
+	{
+		return MK5_SIMD_SCALAR;
+	}
+	if(strcasecmp(name, "sse4.1") == 0 || strcasecmp(name, "sse41") == 0)
+	{
+		return MK5_SIMD_SSE41;
+	}
+	if(strcasecmp(name, "avx2") == 0)
+	{
+		return MK5_SIMD_AVX2;
+	}
+	if(strcasecmp(name, "avx512") == 0 || strcasecmp(name, "avx512bw") == 0)
+	{
+		return MK5_SIMD_AVX512BW;
+	}
+	if(strcasecmp(name, "neon") == 0)
+	{
+		return MK5_SIMD_NEON;
+	}
+
+	return -2;
+}
+
+static const char *simdname(int level)
+{
+	switch(level)
+	{
+	case MK5_SIMD_SCALAR:
+		return "scalar";
+	case MK5_SIMD_SSE41:
+		return "sse4.1";
+	case MK5_SIMD_AVX2:
+		return "avx2";
+	case MK5_SIMD_AVX512BW:
+		return "avx512bw";
+	case MK5_SIMD_NEON:
+		return "neon";
+	default:
+		return "unknown";
+	}
+}
+
+/* deterministic noise, so that all runs decode the same data */
+static void fillrandom(unsigned char *buffer, long long n)
+{
+	uint64_t x = 0x2545F4914F6CDD1DULL;
+	long long i;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		memcpy(buffer + i, &x, 8);
+	}
+	for(; i < n; ++i)
+	{
+		buffer[i] = i;
+	}
+}
+
+static void delete_bench(struct bench *B)
+{
+	int c;
+
+	if(B->ms)
+	{
+		for(c = 0; c < B->ms->nchan; ++c)
+		{
+			if(B->data)
+			{
+				free(B->data[c]);
+			}
+			if(B->cdata)
+			{
+				free(B->cdata[c]);
+			}
+		}
+		delete_mark5_stream(B->ms);
+	}
+	free(B->data);
+	free(B->cdata);
+	free(B->buffer);
+	memset(B, 0, sizeof(struct bench));
+}
+
+/* one call's worth of work, on chunk k of the buffer */
+static int runop(struct bench *B, enum benchop op, int k)
+{
+	struct mark5_stream *ms = B->ms;
+	const unsigned char *chunk = B->buffer + (long long)k*B->chunkframes*B->stride;
+
+	switch(op)
+	{
+	case OP_DECODE:
+		mark5_unpack(ms, chunk, B->data, 0);
+		return mark5_stream_decode(ms, B->chunksamples, B->data);
+	case OP_COMPLEX_DECODE:
+		mark5_unpack_complex(ms, chunk, B->cdata, 0);
+		return mark5_stream_decode_complex(ms, B->chunksamples, B->cdata);
+	case OP_COUNT:
+		mark5_unpack(ms, chunk, B->data, 0);
+		return mark5_stream_count_high_states(ms, B->chunksamples, B->highstates);
+	case OP_UNPACK:
+		if(ms->iscomplex)
+		{
+			return mark5_unpack_complex(ms, chunk, B->cdata, B->chunksamples);
+		}
+		return mark5_unpack(ms, chunk, B->data, B->chunksamples);
+	default:
+		return -1;
+	}
+}
+
+/* makes the stream and its frames; returns 0 on success */
+static int new_bench(struct bench *B, const char *formatname, int warmbytes, long long coldbytes)
+{
+	struct mark5_stream *ms;
+	int c, r, headers;
+
+	/* try with generated headers first, else on bare payloads */
+	for(headers = 1; headers >= 0; --headers)
+	{
+		memset(B, 0, sizeof(struct bench));
+		B->formatname = formatname;
+		B->headers = headers;
+
+		ms = new_mark5_stream(new_mark5_stream_unpacker(!headers), new_mark5_format_generic_from_string(formatname));
+		if(!ms)
+		{
+			return -1;
+		}
+		if(headers && !ms->genheaders)
+		{
+			delete_mark5_stream(ms);
+
+			continue;
+		}
+		B->ms = ms;
+
+		B->stride = B->headers ? ms->framebytes : ms->databytes;
+		B->chunkframes = (warmbytes + B->stride - 1)/B->stride;
+		B->chunkframes += (ms->framegranularity - B->chunkframes % ms->framegranularity) % ms->framegranularity;
+		B->chunksamples = B->chunkframes*ms->framesamples;
+		B->nchunk = coldbytes/((long long)B->chunkframes*B->stride);
+		if(B->nchunk < 2)
+		{
+			B->nchunk = 2;
+		}
+		B->nbytes = (long long)B->nchunk*B->chunkframes*B->stride;
+
+		/* one more frame: some decoders look a little past the end */
+		B->buffer = (unsigned char *)malloc(B->nbytes + B->stride);
+		if(!B->buffer)
+		{
+			delete_bench(B);
+
+			return -1;
+		}
+		fillrandom(B->buffer, B->nbytes + B->stride);
+		if(B->headers)
+		{
+			ms->genheaders(ms, B->nbytes/B->stride + 1, B->buffer);
+		}
+
+		if(ms->iscomplex)
+		{
+			B->cdata = (mark5_float_complex **)malloc(ms->nchan*sizeof(mark5_float_complex *));
+			for(c = 0; c < ms->nchan; ++c)
+			{
+				/* staggered, so that the channels do not alias in cache */
+				B->cdata[c] = (mark5_float_complex *)malloc((B->chunksamples + 16*c + 16)*sizeof(mark5_float_complex));
+			}
+		}
+		else
+		{
+			B->data = (float **)malloc(ms->nchan*sizeof(float *));
+			for(c = 0; c < ms->nchan; ++c)
+			{
+				B->data[c] = (float *)malloc((B->chunksamples + 16*c + 16)*sizeof(float));
+			}
+		}
+
+		/* the generated headers must pass validation, else all would be blanked */
+		r = runop(B, OP_UNPACK, 1);
+		if(r >= B->chunksamples*0.99)
+		{
+			return 0;
+		}
+		delete_bench(B);
+	}
+
+	return -1;
+}
+
+/* best rate over three timings of at least mintime each; returns calls per second */
+static double timeop(struct bench *B, enum benchop op, int cold, double mintime)
+{
+	double t0, t, best = 0.0;
+	long long calls;
+	int trial, k;
+
+	/* once through, for page faults and lazy initialization */
+	for(k = 0; k < (cold ? B->nchunk : 1); ++k)
+	{
+		runop(B, op, k);
+	}
+
+	for(trial = 0; trial < 3; ++trial)
+	{
+		calls = 0;
+		k = 0;
+		t0 = cputime();
+		do
+		{
+			if(runop(B, op, cold ? k : 0) < 0)
+			{
+				return -1.0;
+			}
+			++calls;
+			if(++k >= B->nchunk)
+			{
+				k = 0;
+			}
+			t = cputime() - t0;
+		} while(t < mintime || (cold && k != 0));
+		if(calls/t > best)
+		{
+			best = calls/t;
+		}
+	}
+
+	return best;
+}
+
+static int opapplies(const struct mark5_stream *ms, enum benchop op)
+{
+	switch(op)
+	{
+	case OP_DECODE:
+		return !ms->iscomplex && ms->decode != 0;
+	case OP_COMPLEX_DECODE:
+		return ms->iscomplex && ms->complex_decode != 0;
+	case OP_COUNT:
+		return !ms->iscomplex && ms->count != 0 && ms->nbit == 2 && ms->nchan <= 256;
+	case OP_UNPACK:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* decodes all of a stream, which it deletes; returns bytes per second of wall clock, or -1 */
+static double readstream(struct mark5_stream *ms, int warmbytes, long long *nbytes)
+{
+	float **data;
+	double t0, t;
+	int c, nsamp;
+
+	if(!ms)
+	{
+		return -1.0;
+	}
+
+	/* about warmbytes per call, in whole frames */
+	nsamp = (warmbytes/ms->framebytes + 1)*ms->framesamples;
+	data = (float **)malloc(ms->nchan*sizeof(float *));
+	for(c = 0; c < ms->nchan; ++c)
+	{
+		data[c] = (float *)malloc(2*nsamp*sizeof(float));
+	}
+
+	t0 = walltime();
+	while(mark5_stream_decode(ms, nsamp, data) >= 0)
+	{
+	}
+	t = walltime() - t0;
+	*nbytes = (ms->framenum + 1)*ms->framebytes;
+
+	for(c = 0; c < ms->nchan; ++c)
+	{
+		free(data[c]);
+	}
+	free(data);
+	delete_mark5_stream(ms);
+
+	return t > 0.0 ? *nbytes/t : -1.0;
+}
+
+static void printread(int json, int *first, const char *filename, const char *formatname, const char *stream, long long buffersize, long long nbytes, double rate)
+{
+	if(json)
+	{
+		printf("%s\n    { \"file\": \"%s\", \"format\": \"%s\", \"stream\": \"%s\", \"buffer_bytes\": %lld, ", *first ? "" : ",", filename, formatname, stream, buffersize);
+		if(rate < 0.0)
+		{
+			printf("\"error\": \"cannot make stream\" }");
+		}
+		else
+		{
+			printf("\"bytes\": %lld, \"bytes_per_s\": %.0f }", nbytes, rate);
+		}
+		*first = 0;
+	}
+	else if(rate < 0.0)
+	{
+		printf("  %-26s %-8s %12lld cannot make stream\n", formatname, stream, buffersize);
+	}
+	else
+	{
+		printf("  %-26s %-8s %12lld %14lld %10.1f\n", formatname, stream, buffersize, nbytes, rate/1.0e6);
+	}
+	fflush(stdout);
+}
+
+/* file and memory streams over the same file, with buffers of the given sizes; returns 0 on success */
+static int benchread(const char *filename, const char *formatname, const char *buffers, int warmbytes, int json)
+{
+	struct mark5_stream_generic *s;
+	struct stat fileStatus;
+	unsigned char *buffer;
+	const char *b;
+	long long buffersize, nbytes = 0;
+	double rate;
+	int first = 1;
+	FILE *in;
+
+	if(stat(filename, &fileStatus) < 0)
+	{
+		fprintf(stderr, "Error: cannot stat %s\n", filename);
+
+		return -1;
+	}
+
+	if(json)
+	{
+		printf("{\n  \"program\": \"%s\",\n  \"version\": \"%s\",\n  \"results\": [", program, version);
+	}
+	else
+	{
+		printf("# %s, %lld bytes; rates per second of wall clock\n", filename, (long long)fileStatus.st_size);
+		printf("# %-26s %-8s %12s %14s %10s\n", "format", "stream", "buffer", "bytes", "MB/s");
+	}
+
+	for(b = buffers; b; b = strchr(b, ','))
+	{
+		if(*b == ',')
+		{
+			++b;
+		}
+		buffersize = (long long)(atof(b)*1048576.0);
+		s = new_mark5_stream_file(filename, 0);
+		if(s && mark5_stream_file_set_buffersize(s, buffersize) < 0)
+		{
+			delete_mark5_stream_generic(s);
+			s = 0;
+		}
+		rate = s ? readstream(new_mark5_stream_absorb(s, new_mark5_format_generic_from_string(formatname)), warmbytes, &nbytes) : -1.0;
+		printread(json, &first, filename, formatname, "file", buffersize, nbytes, rate);
+	}
+
+	/* the whole file in one window */
+	buffer = (unsigned char *)malloc(fileStatus.st_size);
+	in = fopen(filename, "r");
+	if(buffer && in && fread(buffer, 1, fileStatus.st_size, in) == (size_t)fileStatus.st_size)
+	{
+		rate = readstream(new_mark5_stream_absorb(new_mark5_stream_memory(buffer, fileStatus.st_size), new_mark5_format_generic_from_string(formatname)), warmbytes, &nbytes);
+	}
+	else
+	{
+		rate = -1.0;
+	}
+	printread(json, &first, filename, formatname, "memory", fileStatus.st_size, nbytes, rate);
+	if(in)
+	{
+		fclose(in);
+	}
+	free(buffer);
+
+	if(json)
+	{
+		printf("\n  ]\n}\n");
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char **formats = defaultformats;
+	const char *readfile = 0;
+	const char *buffers = "1,16,256";
+	struct bench B;
+	double mintime = 0.25, rate, msps, bps;
+	long long coldbytes = 128LL<<20;
+	int warmbytes = 128<<10;
+	int json = 0, first = 1;
+	int optind = 1, level, f, op, cold;
+
+	while(optind < argc)
+	{
+		if(strcmp(argv[optind], "-h") == 0 ||
+		   strcmp(argv[optind], "--help") == 0)
+		{
+			usage(argv[0]);
+
+			return EXIT_SUCCESS;
+		}
+		else if(strcmp(argv[optind], "--version") == 0)
+		{
+			printf("%s ver. %s   %s  %s\n\n", program, version, author, verdate);
+
+			return EXIT_SUCCESS;
+		}
+		else if(strcmp(argv[optind], "--json") == 0)
+		{
+			json = 1;
+		}
+		else if(strncmp(argv[optind], "--warm=", 7) == 0)
+		{
+			warmbytes = atoi(argv[optind]+7) << 10;
+		}
+		else if(strncmp(argv[optind], "--cold=", 7) == 0)
+		{
+			coldbytes = atoll(argv[optind]+7) << 20;
+		}
+		else if(strncmp(argv[optind], "--time=", 7) == 0)
+		{
+			mintime = atof(argv[optind]+7);
+		}
+		else if(strncmp(argv[optind], "--read=", 7) == 0)
+		{
+			readfile = argv[optind]+7;
+		}
+		else if(strncmp(argv[optind], "--buffers=", 10) == 0)
+		{
+			buffers = argv[optind]+10;
+		}
+		else if(strncmp(argv[optind], "--simd=", 7) == 0)
+		{
+			level = simdlevel(argv[optind]+7);
+			if(level == -2 || mark5_library_setoption(M5A_OPT_SIMDLEVEL, &level) < 0)
+			{
+				fprintf(stderr, "Error: instruction set %s is not usable\n", argv[optind]+7);
+
+				return EXIT_FAILURE;
+			}
+		}
+		else if(argv[optind][0] == '-')
+		{
+			fprintf(stderr, "Error: unknown option %s\n", argv[optind]);
+
+			return EXIT_FAILURE;
+		}
+		else
+		{
+			break;
+		}
+		++optind;
+	}
+	if(warmbytes < 1 || coldbytes < 1 || mintime <= 0.0)
+	{
+		fprintf(stderr, "Error: sizes and time must be positive\n");
+
+		return EXIT_FAILURE;
+	}
+	if(optind < argc)
+	{
+		formats = (const char **)(argv + optind);
+	}
+	if(readfile)
+	{
+		if(optind != argc-1)
+		{
+			fprintf(stderr, "Error: --read needs exactly one <dataformat>\n");
+
+			return EXIT_FAILURE;
+		}
+
+		return benchread(readfile, formats[0], buffers, warmbytes, json) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	mark5_library_getoption(M5A_OPT_SIMDLEVEL, &level);
+	if(json)
+	{
+		printf("{\n  \"program\": \"%s\",\n  \"version\": \"%s\",\n  \"simd\": \"%s\",\n", program, version, simdname(level));
+		printf("  \"warmbytes\": %d,\n  \"coldbytes\": %lld,\n  \"mintime\": %g,\n  \"results\": [", warmbytes, coldbytes, mintime);
+	}
+	else
+	{
+		printf("# vector decoders: %s; rates per core\n", simdname(level));
+		printf("# %-26s %-15s %-5s %8s %12s %10s\n", "format", "operation", "cache", "headers", "Msamp/s", "MB/s");
+	}
+
+	for(f = 0; formats[f]; ++f)
+	{
+		if(new_bench(&B, formats[f], warmbytes, coldbytes) < 0)
+		{
+			if(json)
+			{
+				printf("%s\n    { \"format\": \"%s\", \"error\": \"cannot make stream\" }", first ? "" : ",", formats[f]);
+				first = 0;
+			}
+			else
+			{
+				printf("  %-26s cannot make stream\n", formats[f]);
+			}
+
+			continue;
+		}
+
+		for(op = 0; op < NUM_OP; ++op)
+		{
+			if(!opapplies(B.ms, op))
+			{
+				continue;
+			}
+			for(cold = 0; cold <= 1; ++cold)
+			{
+				rate = timeop(&B, op, cold, mintime);
+				msps = rate*B.chunksamples*B.ms->nchan/1.0e6;
+				bps = rate*B.chunkframes*B.stride;
+				if(json)
+				{
+					printf("%s\n    { \"format\": \"%s\", \"nchan\": %d, \"nbit\": %d, \"complex\": %s, \"framebytes\": %d, \"headers\": %s, ",
+						first ? "" : ",", B.formatname, B.ms->nchan, B.ms->nbit, B.ms->iscomplex ? "true" : "false",
+						B.ms->framebytes, B.headers ? "true" : "false");
+					printf("\"operation\": \"%s\", \"cache\": \"%s\", \"samples_per_call\": %d, ", opnames[op], cold ? "cold" : "warm", B.chunksamples);
+					if(rate < 0.0)
+					{
+						printf("\"error\": \"decode failed\" }");
+					}
+					else
+					{
+						printf("\"msamples_per_s\": %.2f, \"bytes_per_s\": %.0f }", msps, bps);
+					}
+					first = 0;
+				}
+				else if(rate < 0.0)
+				{
+					printf("  %-26s %-15s %-5s %8s decode failed\n", B.formatname, opnames[op], cold ? "cold" : "warm", B.headers ? "yes" : "no");
+				}
+				else
+				{
+					printf("  %-26s %-15s %-5s %8s %12.1f %10.1f\n", B.formatname, opnames[op], cold ? "cold" : "warm", B.headers ? "yes" : "no", msps, bps/1.0e6);
+				}
+				fflush(stdout);
+			}
+		}
+
+		delete_bench(&B);
+	}
+
+	if(json)
+	{
+		printf("\n  ]\n}\n");
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -114,8 +114,7 @@ static int decode_short(const char *filename, const char *formatname, const char
 	int i, j, k, status;
 	int chunk = 20000;
 	int total, unpacked;
-	int *invalid;
-	int *validsum;
+	long long *invalid;
 	int rawsize;
 	int start;
 	unsigned char *raw;
@@ -178,8 +177,7 @@ static int decode_short(const char *filename, const char *formatname, const char
 	}
 	rawsize = ms->nchan*ms->nbit*ms->framebytes/(8LL*ms->databytes) + 2*ms->framebytes;
 	raw = (unsigned char *)malloc(rawsize);
-	invalid = (int *)calloc(ms->nchan, sizeof(int));
-	validsum = (int *)calloc(ms->nchan, sizeof(int));
+	invalid = (long long *)calloc(ms->nchan, sizeof(long long));
 
 	r = fread(raw, 1, rawsize, in);
 	if(strcmp(filename, "-") != 0)
@@ -217,11 +215,6 @@ static int decode_short(const char *filename, const char *formatname, const char
 			unpacked += status;
 		}
 
-		for(j = 0; j < ms->nchan; ++j)
-		{
-			validsum[j] += status;
-		}
-
 		if(ms->format == MK5_FORMAT_VDIF)
 		{
 			const vdif_edv4_header *V;
@@ -231,12 +224,6 @@ static int decode_short(const char *filename, const char *formatname, const char
 			if(V->eversion == 4)
 			{
 				++edv4;
-				blank_vdif_EDV4(raw, start, data, chunk, invalid);
-				
-				for(j = 0; j < ms->nchan; ++j)
-				{
-					validsum[j] -= invalid[j];
-				}
 			}
 		}
 
@@ -254,9 +241,11 @@ static int decode_short(const char *filename, const char *formatname, const char
 
 	if(edv4)
 	{
+		/* channels missing from EDV4 frames were zeroed by the decoder */
+		mark5_stream_get_channel_invalid(ms, invalid);
 		for(j = 0; j < ms->nchan; ++j)
 		{
-			fprintf(stderr, "chan %d : %d / %d samples unpacked\n", j, validsum[j], total);
+			fprintf(stderr, "chan %d : %lld / %d samples unpacked\n", j, unpacked - invalid[j], total);
 		}
 	}
 	else
@@ -274,7 +263,6 @@ static int decode_short(const char *filename, const char *formatname, const char
 
 	free(raw);
 	free(invalid);
-	free(validsum);
 
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,239 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../mark5access/mark5_stream.h"
+
+const char program[] = "m5index";
+const char author[]  = "mark5access developers";
+const char version[] = "0.1";
+const char verdate[] = "20201017";
+
+int usage(const char *pgm)
+{
+	printf("\n");
+
+	printf("%s ver. %s   %s  %s\n\n", program, version, author, verdate);
+	printf("Writes a frame time index of a file, with which seeks within it by\n"
+		"the mark5access library are exact even where frames are missing.\n\n");
+	printf("Usage : %s [options] <file> <dataformat> [<offset>]\n\n", pgm);
+	printf("  <file> is the name of the input file\n\n");
+	printf("  <dataformat> should be of the form: "
+		"<FORMAT>-<Mbps>-<nchan>-<nbit>, e.g.:\n");
+	printf("    VLBA1_2-256-8-2\n");
+	printf("    MKIV1_4-128-2-1\n");
+	printf("    Mark5B-512-16-2\n");
+	printf("    VDIF_1000-64-1-2 (here 1000 is payload size in bytes)\n");
+	printf("  alternatively for VDIF and CODIF, Mbps can be replaced by <FramesPerPeriod>m<AlignmentSeconds>, e.g.\n");
+	printf("    VDIF_1000-64000m1-1-2 (8000 frames per 1 second, x1000 bytes x 8 bits= 64 Mbps)\n\n");
+	printf("  <offset> is number of bytes into file to start indexing\n\n");
+	printf("Options:\n\n");
+	printf("  --output <indexfile>\n");
+	printf("  -o <indexfile>  write the index here instead of <file>.m5index\n\n");
+	printf("  --verbose\n");
+	printf("  -v              print all index entries\n\n");
+	printf("  --check\n");
+	printf("  -c              then seek past every gap and check that the frame\n"
+		"                  found is the one after it and validates\n\n");
+	printf("  --help\n");
+	printf("  -h              print this help info\n\n");
+
+	return EXIT_SUCCESS;
+}
+
+/* seeks through a fresh stream to the first frame of each segment after the first; takes ownership of idx */
+int check_index(const char *filename, const char *formatname, long long offset, struct mark5_index *idx)
+{
+	struct mark5_stream *ms;
+	int i, nbad = 0;
+
+	ms = new_mark5_stream_absorb(new_mark5_stream_file(filename, offset),
+		new_mark5_format_generic_from_string(formatname));
+	if(!ms || mark5_stream_set_index(ms, idx) < 0)
+	{
+		fprintf(stderr, "Error: cannot reopen %s with its index\n", filename);
+		delete_mark5_index(idx);
+		if(ms)
+		{
+			delete_mark5_stream(ms);
+		}
+
+		return EXIT_FAILURE;
+	}
+
+	for(i = 1; i < idx->nentry; ++i)
+	{
+		const struct mark5_index_entry *e = idx->entry + i;
+		long long nfail;
+		int mjd, sec;
+		double ns;
+
+		nfail = ms->nvalidatefail;
+		if(mark5_stream_seek(ms, e->mjd, e->sec, e->ns) < 0)
+		{
+			printf("Segment %d: seek to %d %05d %.0f failed\n", i, e->mjd, e->sec, e->ns);
+			++nbad;
+			continue;
+		}
+		mark5_stream_get_frame_time(ms, &mjd, &sec, &ns);
+		if(ms->nvalidatefail != nfail || mjd != e->mjd || sec != e->sec || (long long)(ns + 0.5) != (long long)(e->ns + 0.5))
+		{
+			printf("Segment %d: seek to %d %05d %.0f found %d %05d %.0f, %s\n", i,
+				e->mjd, e->sec, e->ns, mjd, sec, ns,
+				ms->nvalidatefail != nfail ? "not valid" : "valid");
+			++nbad;
+		}
+	}
+	printf("Seek check: %d of %d gaps crossed\n", idx->nentry - 1 - nbad, idx->nentry - 1);
+
+	/* deletes idx too */
+	delete_mark5_stream(ms);
+
+	return nbad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+	struct mark5_stream *ms;
+	struct mark5_index *idx;
+	const char *filename = 0;
+	const char *formatname = 0;
+	char indexfile[MARK5_STREAM_ID_LENGTH] = "";
+	long long offset = 0;
+	int verbose = 0;
+	int check = 0;
+	int a, nargs = 0;
+
+	for(a = 1; a < argc; ++a)
+	{
+		if(strcmp(argv[a], "-h") == 0 || strcmp(argv[a], "--help") == 0)
+		{
+			return usage(argv[0]);
+		}
+		else if(strcmp(argv[a], "-v") == 0 || strcmp(argv[a], "--verbose") == 0)
+		{
+			++verbose;
+		}
+		else if(strcmp(argv[a], "-c") == 0 || strcmp(argv[a], "--check") == 0)
+		{
+			check = 1;
+		}
+		else if((strcmp(argv[a], "-o") == 0 || strcmp(argv[a], "--output") == 0) && a+1 < argc)
+		{
+			++a;
+			snprintf(indexfile, MARK5_STREAM_ID_LENGTH, "%s", argv[a]);
+		}
+		else if(argv[a][0] == '-' && argv[a][1] != 0)
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[a]);
+
+			return EXIT_FAILURE;
+		}
+		else
+		{
+			switch(nargs)
+			{
+			case 0:
+				filename = argv[a];
+				break;
+			case 1:
+				formatname = argv[a];
+				break;
+			case 2:
+				offset = atoll(argv[a]);
+				break;
+			default:
+				fprintf(stderr, "Too many arguments\n");
+
+				return EXIT_FAILURE;
+			}
+			++nargs;
+		}
+	}
+
+	if(nargs < 2)
+	{
+		return usage(argv[0]);
+	}
+	if(indexfile[0] == 0)
+	{
+		snprintf(indexfile, MARK5_STREAM_ID_LENGTH, "%s.m5index", filename);
+	}
+
+	/* frames are only looked at in place, so map the file where possible */
+	ms = new_mark5_stream_absorb(new_mark5_stream_mmap(filename, offset),
+		new_mark5_format_generic_from_string(formatname));
+	if(!ms)
+	{
+		ms = new_mark5_stream_absorb(new_mark5_stream_file(filename, offset),
+			new_mark5_format_generic_from_string(formatname));
+	}
+	if(!ms)
+	{
+		fprintf(stderr, "Error: problem opening or decoding %s\n", filename);
+
+		return EXIT_FAILURE;
+	}
+
+	idx = new_mark5_index_from_stream(ms);
+	delete_mark5_stream(ms);
+	if(!idx)
+	{
+		fprintf(stderr, "Error: cannot index %s\n", filename);
+
+		return EXIT_FAILURE;
+	}
+
+	if(verbose)
+	{
+		mark5_index_print(idx);
+	}
+	printf("%s: %lld frames, %lld invalid, %d segments%s\n", filename,
+		idx->nframe, idx->ninvalid, idx->nentry, idx->monotonic ? "" : ", not in time order");
+
+	if(mark5_index_write(idx, indexfile) < 0)
+	{
+		delete_mark5_index(idx);
+
+		return EXIT_FAILURE;
+	}
+	printf("Index written to %s\n", indexfile);
+
+	if(check)
+	{
+		return check_index(filename, formatname, offset, idx);
+	}
+
+	delete_mark5_index(idx);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,217 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../mark5access/mark5_stream.h"
+
+const char program[] = "m5shmfeed";
+const char author[]  = "mark5access developers";
+const char version[] = "0.1";
+const char verdate[] = "20201018";
+
+int usage(const char *pgm)
+{
+	printf("\n");
+
+	printf("%s ver. %s   %s  %s\n\n", program, version, author, verdate);
+	printf("Copies a file of frames into a shared memory ring, as a recorder would,\n");
+	printf("for new_mark5_stream_shmring() readers.\n\n");
+	printf("Usage : %s [options] <name> <file>\n\n", pgm);
+	printf("  <name> is the name of the ring, e.g., /m5ring\n\n");
+	printf("  <file> is the data file; - for stdin\n\n");
+	printf("Options:\n\n");
+	printf("  --framebytes=<n>  frame size [from the VDIF header of the first frame]\n\n");
+	printf("  --slots=<n>       frames the ring holds [1024]\n\n");
+	printf("  --fps=<n>         write <n> frames per second [1000; 0 = as fast as possible]\n\n");
+	printf("  --keep            leave the ring in place at the end\n\n");
+	printf("  --help\n");
+	printf("  -h                print this help info\n\n");
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = 0, *filename = 0;
+	struct mark5_shmring_header *ring;
+	FILE *in;
+	unsigned char *frame;
+	long long n;
+	int framebytes = 0, nslot = 1024, fps = 1000, keep = 0;
+	int a, nargs = 0;
+	struct timespec t0;
+
+	for(a = 1; a < argc; ++a)
+	{
+		if(strcmp(argv[a], "-h") == 0 || strcmp(argv[a], "--help") == 0)
+		{
+			return usage(argv[0]);
+		}
+		else if(strncmp(argv[a], "--framebytes=", 13) == 0)
+		{
+			framebytes = atoi(argv[a] + 13);
+		}
+		else if(strncmp(argv[a], "--slots=", 8) == 0)
+		{
+			nslot = atoi(argv[a] + 8);
+		}
+		else if(strncmp(argv[a], "--fps=", 6) == 0)
+		{
+			fps = atoi(argv[a] + 6);
+		}
+		else if(strcmp(argv[a], "--keep") == 0)
+		{
+			keep = 1;
+		}
+		else if(argv[a][0] == '-' && argv[a][1] != 0)
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[a]);
+
+			return EXIT_FAILURE;
+		}
+		else if(nargs == 0)
+		{
+			name = argv[a];
+			++nargs;
+		}
+		else if(nargs == 1)
+		{
+			filename = argv[a];
+			++nargs;
+		}
+		else
+		{
+			fprintf(stderr, "Too many arguments\n");
+
+			return EXIT_FAILURE;
+		}
+	}
+	if(nargs < 2)
+	{
+		return usage(argv[0]);
+	}
+	if(fps < 0)
+	{
+		fprintf(stderr, "Error: fps must be >= 0\n");
+
+		return EXIT_FAILURE;
+	}
+
+	in = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "rb");
+	if(!in)
+	{
+		fprintf(stderr, "Error: cannot open %s\n", filename);
+
+		return EXIT_FAILURE;
+	}
+
+	/* the first frame goes straight into the ring once its size is known */
+	frame = (unsigned char *)malloc(32);
+	if(fread(frame, 32, 1, in) != 1)
+	{
+		fprintf(stderr, "Error: cannot read %s\n", filename);
+
+		return EXIT_FAILURE;
+	}
+	if(framebytes == 0)
+	{
+		framebytes = (((unsigned int *)frame)[2] & 0x00FFFFFF) << 3;
+	}
+	if(framebytes < 32)
+	{
+		fprintf(stderr, "Error: frame size %d is too small\n", framebytes);
+
+		return EXIT_FAILURE;
+	}
+
+	ring = new_mark5_shmring(name, framebytes, nslot);
+	if(!ring)
+	{
+		return EXIT_FAILURE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(n = 0; ; ++n)
+	{
+		unsigned char *slot;
+
+		slot = mark5_shmring_claim(ring);
+		if(n == 0)
+		{
+			memcpy(slot, frame, 32);
+			if(fread(slot + 32, framebytes - 32, 1, in) != 1)
+			{
+				break;
+			}
+		}
+		else if(fread(slot, framebytes, 1, in) != 1)
+		{
+			break;
+		}
+
+		if(fps > 0)
+		{
+			/* keep to the frame rate */
+			struct timespec now, wait;
+			double ahead;
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			ahead = (double)n/fps - (now.tv_sec - t0.tv_sec) - 1.0e-9*(now.tv_nsec - t0.tv_nsec);
+			if(ahead > 0.0)
+			{
+				wait.tv_sec = (time_t)ahead;
+				wait.tv_nsec = (long)((ahead - wait.tv_sec)*1.0e9);
+				nanosleep(&wait, 0);
+			}
+		}
+
+		mark5_shmring_publish(ring);
+	}
+
+	printf("%lld frames of %d bytes written to %s\n", n, framebytes, name);
+
+	free(frame);
+	delete_mark5_shmring(ring);
+	if(!keep)
+	{
+		shm_unlink(name);
+	}
+	if(in != stdin)
+	{
+		fclose(in);
+	}
+
+	return EXIT_SUCCESS;
+}
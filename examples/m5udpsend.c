@@ -0,0 +1,306 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+const char program[] = "m5udpsend";
+const char author[]  = "mark5access developers";
+const char version[] = "0.1";
+const char verdate[] = "20201018";
+
+int usage(const char *pgm)
+{
+	printf("\n");
+
+	printf("%s ver. %s   %s  %s\n\n", program, version, author, verdate);
+	printf("Sends VDIF frames, one per UDP packet, to exercise new_mark5_stream_udp().\n\n");
+	printf("Usage : %s [options] <host> <port> [<file>]\n\n", pgm);
+	printf("  <host> <port> is where to send the packets, e.g., localhost 50000\n\n");
+	printf("  <file> is a single-thread VDIF file to send; without it, frames of\n");
+	printf("     1-channel 2-bit data with random samples are made up\n\n");
+	printf("Options:\n\n");
+	printf("  --psn           prefix each packet with an 8-byte packet serial number\n\n");
+	printf("  --fps=<n>       send <n> frames per second [1000; 0 = as fast as possible]\n\n");
+	printf("  --frames=<n>    send <n> frames [all of the file, or 2 seconds' worth]\n\n");
+	printf("  --payload=<n>   made up frames have <n> bytes of data [8000]\n\n");
+	printf("  --drop=<n>      do not send every <n>th frame\n\n");
+	printf("  --swap=<n>      send every <n>th frame after the one following it\n\n");
+	printf("  --help\n");
+	printf("  -h              print this help info\n\n");
+
+	return EXIT_SUCCESS;
+}
+
+/* a VDIF header for frame number n of a made up stream starting now */
+static void makeheader(unsigned int *header, long long n, int fps, int framebytes, time_t start)
+{
+	struct tm t;
+	int epoch;
+	time_t epochstart;
+
+	gmtime_r(&start, &t);
+	epoch = 2*(t.tm_year - 100) + (t.tm_mon >= 6);
+	t.tm_mon = (epoch % 2)*6;
+	t.tm_mday = 1;
+	t.tm_hour = t.tm_min = t.tm_sec = 0;
+	epochstart = timegm(&t);
+
+	header[0] = (unsigned int)(start - epochstart + n/fps) & 0x3FFFFFFF;
+	header[1] = (unsigned int)(n % fps) | (epoch << 24);
+	header[2] = framebytes/8;		/* 1 channel */
+	header[3] = ('T' << 8) | 'x' | (1 << 26);	/* 2 bits */
+	memset(header + 4, 0, 16);
+}
+
+int main(int argc, char **argv)
+{
+	const char *host = 0, *port = 0, *filename = 0;
+	struct addrinfo hints, *res;
+	FILE *in = 0;
+	unsigned char *packet, *held = 0;
+	unsigned long long psn = 0;
+	long long n, nframe = -1, nsent = 0;
+	int usepsn = 0, fps = 1000, payload = 8000, drop = 0, swap = 0, holding = 0;
+	int framebytes, psnbytes, sock, a, nargs = 0;
+	struct timespec t0;
+	time_t start;
+
+	for(a = 1; a < argc; ++a)
+	{
+		if(strcmp(argv[a], "-h") == 0 || strcmp(argv[a], "--help") == 0)
+		{
+			return usage(argv[0]);
+		}
+		else if(strcmp(argv[a], "--psn") == 0)
+		{
+			usepsn = 1;
+		}
+		else if(strncmp(argv[a], "--fps=", 6) == 0)
+		{
+			fps = atoi(argv[a] + 6);
+		}
+		else if(strncmp(argv[a], "--frames=", 9) == 0)
+		{
+			nframe = atoll(argv[a] + 9);
+		}
+		else if(strncmp(argv[a], "--payload=", 10) == 0)
+		{
+			payload = atoi(argv[a] + 10);
+		}
+		else if(strncmp(argv[a], "--drop=", 7) == 0)
+		{
+			drop = atoi(argv[a] + 7);
+		}
+		else if(strncmp(argv[a], "--swap=", 7) == 0)
+		{
+			swap = atoi(argv[a] + 7);
+		}
+		else if(argv[a][0] == '-')
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[a]);
+
+			return EXIT_FAILURE;
+		}
+		else if(nargs == 0)
+		{
+			host = argv[a];
+			++nargs;
+		}
+		else if(nargs == 1)
+		{
+			port = argv[a];
+			++nargs;
+		}
+		else if(nargs == 2)
+		{
+			filename = argv[a];
+			++nargs;
+		}
+		else
+		{
+			fprintf(stderr, "Too many arguments\n");
+
+			return EXIT_FAILURE;
+		}
+	}
+	if(nargs < 2)
+	{
+		return usage(argv[0]);
+	}
+	if(fps < 0 || payload <= 0 || payload % 8 != 0)
+	{
+		fprintf(stderr, "Error: fps must be >= 0 and payload a positive multiple of 8\n");
+
+		return EXIT_FAILURE;
+	}
+
+	if(filename)
+	{
+		unsigned int header[4];
+
+		in = fopen(filename, "rb");
+		if(!in || fread(header, sizeof(header), 1, in) != 1)
+		{
+			fprintf(stderr, "Error: cannot read %s\n", filename);
+
+			return EXIT_FAILURE;
+		}
+		framebytes = (header[2] & 0x00FFFFFF) << 3;
+		rewind(in);
+	}
+	else
+	{
+		if(fps == 0)
+		{
+			fprintf(stderr, "Error: made up frames need fps > 0\n");
+
+			return EXIT_FAILURE;
+		}
+		framebytes = 32 + payload;
+		if(nframe < 0)
+		{
+			nframe = 2LL*fps;
+		}
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if(getaddrinfo(host, port, &hints, &res) != 0)
+	{
+		fprintf(stderr, "Error: cannot resolve %s:%s\n", host, port);
+
+		return EXIT_FAILURE;
+	}
+	sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if(sock < 0 || connect(sock, res->ai_addr, res->ai_addrlen) < 0)
+	{
+		perror("Error: socket");
+		freeaddrinfo(res);
+
+		return EXIT_FAILURE;
+	}
+	freeaddrinfo(res);
+
+	psnbytes = usepsn ? 8 : 0;
+	packet = (unsigned char *)malloc(psnbytes + framebytes);
+	held = (unsigned char *)malloc(psnbytes + framebytes);
+	srand(1);
+	start = time(0);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for(n = 0; nframe < 0 || n < nframe; ++n)
+	{
+		unsigned char *frame = packet + psnbytes;
+
+		if(in)
+		{
+			if(fread(frame, framebytes, 1, in) != 1)
+			{
+				break;
+			}
+		}
+		else
+		{
+			int i;
+
+			makeheader((unsigned int *)frame, n, fps, framebytes, start);
+			for(i = 32; i < framebytes; ++i)
+			{
+				frame[i] = rand() & 0xFF;
+			}
+		}
+		memcpy(packet, &psn, psnbytes);
+		++psn;
+
+		if(fps > 0)
+		{
+			/* keep to the frame rate */
+			struct timespec now, wait;
+			double ahead;
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			ahead = (double)n/fps - (now.tv_sec - t0.tv_sec) - 1.0e-9*(now.tv_nsec - t0.tv_nsec);
+			if(ahead > 0.0)
+			{
+				wait.tv_sec = (time_t)ahead;
+				wait.tv_nsec = (long)((ahead - wait.tv_sec)*1.0e9);
+				nanosleep(&wait, 0);
+			}
+		}
+
+		if(drop > 0 && n % drop == drop - 1)
+		{
+			continue;
+		}
+		if(swap > 0 && n % swap == swap - 1 && !holding)
+		{
+			/* sent after the next one */
+			unsigned char *p = held;
+
+			held = packet;
+			packet = p;
+			holding = 1;
+			continue;
+		}
+		send(sock, packet, psnbytes + framebytes, 0);
+		++nsent;
+		if(holding)
+		{
+			send(sock, held, psnbytes + framebytes, 0);
+			++nsent;
+			holding = 0;
+		}
+	}
+	if(holding)
+	{
+		send(sock, held, psnbytes + framebytes, 0);
+		++nsent;
+	}
+
+	printf("%lld frames of %d bytes sent\n", nsent, framebytes);
+
+	free(packet);
+	free(held);
+	close(sock);
+	if(in)
+	{
+		fclose(in);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -31,11 +31,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
 #include "../mark5access/mark5_stream.h"
 
 static void usage(const char *pgm)
 {
 	printf("Usage : %s <dataformat> [<n> [<offset>] ]\n", pgm);
+	printf("   or : %s --simd <dataformat> [<n>]\n", pgm);
+	printf("   or : %s --edv4 <VDIF dataformat> [<nframe>]\n", pgm);
 	printf("\n  <dataformat> should be of the form: <FORMAT>-<Mbps>-<nchan>-<nbit>, e.g.:\n");
 	printf("    VLBA1_2-256-8-2\n");
 	printf("    MKIV1_4-128-2-1\n");
@@ -46,7 +50,13 @@ static void usage(const char *pgm)
 	printf("    CODIFC_5000-51200m27-8-1 (51200 frames every 27 seconds, x5000 bytes x 8 bits / 27  ~= 76 Mbps\n");
 	printf("    This allows you to specify rates that are not an integer Mbps value, such as 32/27 CODIF oversampling\n\n");
 	printf("\n  <n>      is samples to look at [default 32]\n");
-	printf("\n  <offset> is samples to slip [default 0]\n\n");
+	printf("\n  <offset> is samples to slip [default 0]\n");
+	printf("\n  --simd   decodes <n> samples [default 65536] of a random payload with the\n");
+	printf("           lookup tables and with each vector instruction set of this cpu,\n");
+	printf("           and fails unless all results are identical\n");
+	printf("\n  --edv4   makes <nframe> [default 48] EDV4 frames with changing channel\n");
+	printf("           validity masks and checks that decoding, high state counts and\n");
+	printf("           statistics leave out the missing channels, at every instruction set\n\n");
 }
 
 static int conf(float ***data, struct mark5_stream **ms, const char *format, int samples, int os)
@@ -88,6 +98,384 @@ static int conf(float ***data, struct mark5_stream **ms, const char *format, int
 	return 0;
 }
 
+static struct mark5_stream *newstream(const char *format, int level)
+{
+	mark5_library_setoption(M5A_OPT_SIMDLEVEL, &level);
+
+	return new_mark5_stream(
+		new_mark5_stream_unpacker(1),
+		new_mark5_format_generic_from_string(format) );
+}
+
+static int unpack(struct mark5_stream *ms, const unsigned char *data, int offset, float **out, int n)
+{
+	if(ms->iscomplex)
+	{
+		return mark5_unpack_complex_with_offset(ms, data, offset, (mark5_float_complex **)out, n);
+	}
+	else
+	{
+		return mark5_unpack_with_offset(ms, data, offset, out, n);
+	}
+}
+
+/* The vector decoders must give exactly what the lookup tables give.  Each
+ * instruction set up to the best one of this cpu is compared with the
+ * lookup tables, from the start of a random payload and from a few samples in.
+ */
+static int simdcheck(const char *format, int n)
+{
+	struct mark5_stream *ref, *ms;
+	unsigned char *data;
+	float **a, **b;
+	long long nbytes, i;
+	int best, level, nval, c, k, t, ra, rb, offset;
+	int nbad = 0;
+
+	best = MK5_SIMD_AUTO;
+	mark5_library_setoption(M5A_OPT_SIMDLEVEL, &best);
+	mark5_library_getoption(M5A_OPT_SIMDLEVEL, &best);
+
+	ref = newstream(format, MK5_SIMD_SCALAR);
+	if(!ref)
+	{
+		fprintf(stderr, "Error: cannot decode format %s\n", format);
+
+		return EXIT_FAILURE;
+	}
+
+	n -= n % ref->samplegranularity;
+	nval = ref->iscomplex ? 2*n : n;
+	nbytes = ((long long)n/ref->framesamples + 2)*ref->framebytes;
+
+	data = (unsigned char *)malloc(nbytes);
+	srand(1);
+	for(i = 0; i < nbytes; ++i)
+	{
+		data[i] = rand() >> 8;
+	}
+	a = (float **)malloc(ref->nchan*sizeof(float *));
+	b = (float **)malloc(ref->nchan*sizeof(float *));
+	for(c = 0; c < ref->nchan; ++c)
+	{
+		a[c] = (float *)malloc(nval*sizeof(float));
+		b[c] = (float *)malloc(nval*sizeof(float));
+	}
+
+	if(best == MK5_SIMD_SCALAR)
+	{
+		printf("%s: no vector instruction set to compare\n", format);
+	}
+
+	/* the x86 levels are ordered; NEON is a family of its own */
+	for(level = (best == MK5_SIMD_NEON ? MK5_SIMD_NEON : MK5_SIMD_SSE41); level <= best; ++level)
+	{
+		ms = newstream(format, level);
+		if(!ms)
+		{
+			fprintf(stderr, "Error: cannot decode format %s at level %d\n", format, level);
+			++nbad;
+
+			continue;
+		}
+		for(k = 0; k < 2; ++k)
+		{
+			offset = 3*k*ref->samplegranularity;
+			for(c = 0; c < ref->nchan; ++c)
+			{
+				for(t = 0; t < nval; ++t)
+				{
+					a[c][t] = 1.0e30;
+					b[c][t] = -1.0e30;
+				}
+			}
+			ra = unpack(ref, data, offset, a, n);
+			rb = unpack(ms, data, offset, b, n);
+			if(ra != rb)
+			{
+				printf("%s level %d offset %d: %d valid samples, not %d\n", format, level, offset, rb, ra);
+				++nbad;
+			}
+			for(c = 0; c < ref->nchan; ++c)
+			{
+				if(memcmp(a[c], b[c], nval*sizeof(float)) != 0)
+				{
+					for(t = 0; a[c][t] == b[c][t]; ++t)
+					{
+					}
+					printf("%s level %d offset %d: channel %d value %d is %f, not %f\n", format, level, offset, c, t, b[c][t], a[c][t]);
+					++nbad;
+				}
+			}
+		}
+		if(nbad == 0)
+		{
+			printf("%s level %d: %d samples identical\n", format, level, n);
+		}
+		delete_mark5_stream(ms);
+	}
+
+	for(c = 0; c < ref->nchan; ++c)
+	{
+		free(a[c]);
+		free(b[c]);
+	}
+	free(a);
+	free(b);
+	free(data);
+	delete_mark5_stream(ref);
+
+	return nbad > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* An EDV4 frame with channels marked missing by mask; frames may also be
+ * marked invalid as a whole.
+ */
+static void edv4frame(const struct mark5_stream *ref, unsigned char *frame, int k, uint64_t mask, int invalid)
+{
+	uint32_t *header = (uint32_t *)frame;
+	int fps, log2nchan;
+
+	fps = (int)(1.0e9/ref->framens + 0.5);
+	for(log2nchan = 0; (1 << log2nchan) < ref->nchan; ++log2nchan)
+	{
+	}
+
+	memset(header, 0, 32);
+	header[0] = (1000 + k/fps) | ((uint32_t)invalid << 31);
+	header[1] = k % fps;
+	header[2] = (ref->framebytes/8) | (log2nchan << 24);
+	header[3] = (ref->nbit - 1) << 26;
+	header[4] = (4 << 24) | (ref->nchan << 16);
+	header[6] = mask;
+	header[7] = mask >> 32;
+}
+
+/* Channels missing from EDV4 frames must be zero when decoded, and left out
+ * of high state counts and statistics; every instruction set, and the lookup
+ * tables, must count their samples as invalid alike.
+ */
+static int edv4check(const char *format, int nframe)
+{
+	struct mark5_stream *ref, *ms;
+	struct mark5_stream_stats *stats;
+	unsigned char *data;
+	float **d;
+	unsigned int *high;
+	long long *invalid, *missing, *present;
+	uint64_t all, mask;
+	long long nbytes, i;
+	double *sum;
+	int best, level, c, f, t, n, chunk, nsamp, r;
+	int nbad = 0;
+
+	best = MK5_SIMD_AUTO;
+	mark5_library_setoption(M5A_OPT_SIMDLEVEL, &best);
+	mark5_library_getoption(M5A_OPT_SIMDLEVEL, &best);
+
+	ref = newstream(format, MK5_SIMD_SCALAR);
+	if(!ref)
+	{
+		fprintf(stderr, "Error: cannot decode format %s\n", format);
+
+		return EXIT_FAILURE;
+	}
+	if(ref->format != MK5_FORMAT_VDIF || ref->iscomplex || ref->nchan > 64 || (ref->nchan & (ref->nchan - 1)) || ref->framebytes - ref->databytes != 32)
+	{
+		fprintf(stderr, "Error: %s is not real VDIF data of up to 64 channels\n", format);
+		delete_mark5_stream(ref);
+
+		return EXIT_FAILURE;
+	}
+
+	/* calls end part way through frames; the last frame is never reached */
+	chunk = ref->framesamples*3/4;
+	chunk -= chunk % ref->samplegranularity;
+	nsamp = ((nframe - 1)*ref->framesamples/chunk)*chunk;
+
+	nbytes = (long long)nframe*ref->framebytes;
+	data = (unsigned char *)malloc(nbytes);
+	srand(1);
+	for(i = 0; i < nbytes; ++i)
+	{
+		data[i] = rand() >> 8;
+	}
+
+	/* expected samples of each channel missing from valid frames */
+	missing = (long long *)calloc(ref->nchan, sizeof(long long));
+	present = (long long *)calloc(ref->nchan, sizeof(long long));
+	invalid = (long long *)calloc(ref->nchan, sizeof(long long));
+	high = (unsigned int *)calloc(ref->nchan, sizeof(unsigned int));
+	sum = (double *)calloc(ref->nchan, sizeof(double));
+	all = ref->nchan == 64 ? ~0ULL : (1ULL << ref->nchan) - 1;
+	for(f = 0; f < nframe; ++f)
+	{
+		switch(f % 6)
+		{
+		case 0:
+			mask = all;
+			break;
+		case 1:
+			mask = all & ~1ULL;
+			break;
+		case 2:
+			mask = all & 0x5555555555555555ULL;
+			break;
+		case 3:
+			mask = 0;
+			break;
+		case 4:
+			mask = all & ~(1ULL << (ref->nchan - 1));
+			break;
+		default:
+			mask = 1;
+			break;
+		}
+		edv4frame(ref, data + (long long)f*ref->framebytes, f, mask, f == 7);
+
+		n = nsamp - f*ref->framesamples;
+		n = n < 0 ? 0 : (n > ref->framesamples ? ref->framesamples : n);
+		for(c = 0; c < ref->nchan && f != 7; ++c)
+		{
+			if((mask >> c) & 1)
+			{
+				present[c] += n;
+			}
+			else
+			{
+				missing[c] += n;
+			}
+		}
+	}
+
+	d = (float **)malloc(ref->nchan*sizeof(float *));
+	for(c = 0; c < ref->nchan; ++c)
+	{
+		d[c] = (float *)malloc(chunk*sizeof(float));
+	}
+
+	for(level = MK5_SIMD_SCALAR; level <= best; level = (level == MK5_SIMD_SCALAR && best == MK5_SIMD_NEON) ? MK5_SIMD_NEON : level + 1)
+	{
+		mark5_library_setoption(M5A_OPT_SIMDLEVEL, &level);
+
+		/* decoding, from which counts and sums are expected */
+		ms = new_mark5_stream(new_mark5_stream_memory(data, nbytes), new_mark5_format_generic_from_string(format));
+		if(!ms)
+		{
+			fprintf(stderr, "Error: cannot open EDV4 frames of format %s at level %d\n", format, level);
+			++nbad;
+
+			continue;
+		}
+		memset(high, 0, ref->nchan*sizeof(unsigned int));
+		memset(sum, 0, ref->nchan*sizeof(double));
+		for(t = 0; t < nsamp; t += chunk)
+		{
+			r = mark5_stream_decode(ms, chunk, d);
+			for(c = 0; c < ref->nchan; ++c)
+			{
+				for(i = 0; i < chunk; ++i)
+				{
+					if(d[c][i] > 1.5 || d[c][i] < -1.5)
+					{
+						++high[c];
+					}
+					sum[c] += d[c][i];
+				}
+				if(t/ref->framesamples % 6 == 3 && d[c][0] != 0.0)
+				{
+					printf("%s level %d: channel %d decoded from a frame missing it\n", format, level, c);
+					++nbad;
+				}
+			}
+			if(r < 0)
+			{
+				break;
+			}
+		}
+		mark5_stream_get_channel_invalid(ms, invalid);
+		for(c = 0; c < ref->nchan; ++c)
+		{
+			if(invalid[c] != missing[c])
+			{
+				printf("%s level %d: decode counts %lld samples of channel %d invalid, not %lld\n", format, level, invalid[c], c, missing[c]);
+				++nbad;
+			}
+		}
+		delete_mark5_stream(ms);
+
+		/* high states, of 2 bit data */
+		ms = new_mark5_stream(new_mark5_stream_memory(data, nbytes), new_mark5_format_generic_from_string(format));
+		if(ms && ref->nbit == 2)
+		{
+			unsigned int *h = (unsigned int *)calloc(ref->nchan, sizeof(unsigned int));
+
+			for(t = 0; t < nsamp; t += chunk)
+			{
+				if(mark5_stream_count_high_states(ms, chunk, h) <= 0)
+				{
+					break;
+				}
+			}
+			mark5_stream_get_channel_invalid(ms, invalid);
+			for(c = 0; t == nsamp && c < ref->nchan; ++c)
+			{
+				if(h[c] != high[c] || invalid[c] != missing[c])
+				{
+					printf("%s level %d: channel %d has %u high states and %lld invalid samples, not %u and %lld\n", format, level, c, h[c], invalid[c], high[c], missing[c]);
+					++nbad;
+				}
+			}
+			free(h);
+		}
+		delete_mark5_stream(ms);
+
+		/* statistics */
+		ms = new_mark5_stream(new_mark5_stream_memory(data, nbytes), new_mark5_format_generic_from_string(format));
+		stats = ms ? new_mark5_stream_stats(ms) : 0;
+		if(stats)
+		{
+			for(t = 0; t < nsamp; t += chunk)
+			{
+				if(mark5_stream_accumulate_stats(ms, chunk, stats) < 0)
+				{
+					break;
+				}
+			}
+			for(c = 0; c < ref->nchan; ++c)
+			{
+				if(stats->nvalid[c] != present[c] || fabs(stats->sum[c] - sum[c]) > 1.0e-3)
+				{
+					printf("%s level %d: channel %d statistics are of %lld samples summing to %f, not %lld and %f\n", format, level, c, stats->nvalid[c], stats->sum[c], present[c], sum[c]);
+					++nbad;
+				}
+			}
+			delete_mark5_stream_stats(stats);
+		}
+		delete_mark5_stream(ms);
+
+		if(nbad == 0)
+		{
+			printf("%s level %d: missing channels left out of %d samples\n", format, level, nsamp);
+		}
+	}
+
+	for(c = 0; c < ref->nchan; ++c)
+	{
+		free(d[c]);
+	}
+	free(d);
+	free(data);
+	free(missing);
+	free(present);
+	free(invalid);
+	free(high);
+	free(sum);
+	delete_mark5_stream(ref);
+
+	return nbad > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 int main(int argc, char **argv)
 {
 	int n = 32, N = 10000000;
@@ -106,6 +494,39 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	if(strcmp(argv[1], "--simd") == 0)
+	{
+		if(argc < 3)
+		{
+			usage(argv[0]);
+
+			return EXIT_FAILURE;
+		}
+		n = 65536;
+		if(argc > 3)
+		{
+			sscanf(argv[3], "%d", &n);
+		}
+
+		return simdcheck(argv[2], n);
+	}
+	if(strcmp(argv[1], "--edv4") == 0)
+	{
+		if(argc < 3)
+		{
+			usage(argv[0]);
+
+			return EXIT_FAILURE;
+		}
+		n = 48;
+		if(argc > 3)
+		{
+			sscanf(argv[3], "%d", &n);
+		}
+
+		return edv4check(argv[2], n);
+	}
+
 	if(argc > 2)
 	{
 		sscanf(argv[2], "%d", &n);
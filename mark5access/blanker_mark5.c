@@ -132,10 +132,17 @@ int blanker_mark5(struct mark5_stream *ms)
 
 	ms->log2blankzonesize = 15;	/* 32768 bytes in size */
 
+	/* larger zones for payloads over 1 MB, as there are MAXBLANKZONES */
+	while(((ms->databytes - 1) >> ms->log2blankzonesize) >= MAXBLANKZONES)
+	{
+		++ms->log2blankzonesize;
+	}
+
 	if(!ms->payload)
 	{
 		ms->blankzonestartvalid[0] = 0;
 		ms->blankzoneendvalid[0] = 0;
+		ms->nvalidrange = 0;
 
 		return 0;
 	}
@@ -192,6 +199,7 @@ int blanker_mark5(struct mark5_stream *ms)
 		zone++;
 	}
 
+	mark5_stream_valid_from_zones(ms);
 
 	return nblanked;
 }
@@ -209,6 +217,7 @@ int blanker_mark4(struct mark5_stream *ms)
 	{
 		ms->blankzonestartvalid[0] = 0;
 		ms->blankzoneendvalid[0] = 0;
+		ms->nvalidrange = 0;
 
 		return 0;
 	}
@@ -276,14 +285,53 @@ int blanker_mark4(struct mark5_stream *ms)
 		nblanked += delta;
 	}
 
+	mark5_stream_valid_from_zones(ms);
+
 	return nblanked;
 }
 
+/* Marks in ms->chanmissing the channels whose bit is clear in the validity
+ * mask of a VDIF EDV4 header.  Each of the masklength bits covers
+ * nchan/masklength adjacent channels.
+ */
+static void vdif_edv4_chanmissing(struct mark5_stream *ms)
+{
+	const uint32_t *header;
+	uint64_t mask;
+	int masklength, d, c;
+
+	ms->chanmissing = 0;
+
+	if(!ms->frame || ms->payloadoffset < 32 || ms->nchan > MARK5_MAXMASKCHAN)
+	{
+		return;
+	}
+
+	header = (const uint32_t *)ms->frame;
+	masklength = (header[4] >> 16) & 0xFF;
+	if((header[4] >> 24) != 4 || masklength < 1 || masklength > ms->nchan || ms->nchan % masklength != 0)
+	{
+		return;
+	}
+	mask = header[6] | ((uint64_t)header[7] << 32);
+
+	d = ms->nchan/masklength;
+	for(c = 0; c < ms->nchan; ++c)
+	{
+		if(!((mask >> (c/d)) & 1))
+		{
+			ms->chanmissing |= 1ULL << c;
+		}
+	}
+}
+
 int blanker_vdif(struct mark5_stream *ms)
 {
 	unsigned long long *data;
 	int nword;
 	
+	ms->nvalidrange = 0;
+
 	if(!ms->payload)
 	{
 		ms->blankzoneendvalid[0] = 0;
@@ -312,6 +360,8 @@ int blanker_vdif(struct mark5_stream *ms)
 	{
 		//fprintf(m5stderr, "Frame is good\n");
 		ms->blankzoneendvalid[0] = 1<<30;
+		mark5_stream_add_valid_range(ms, 0, ms->databytes);
+		vdif_edv4_chanmissing(ms);
 		return nword;
 	}
 }
@@ -321,6 +371,8 @@ int blanker_codif(struct mark5_stream *ms)
 	uint64_t *data;
 	int nword;
 	
+	ms->nvalidrange = 0;
+
 	if(!ms->payload)
 	{
 		ms->blankzoneendvalid[0] = 0;
@@ -349,6 +401,299 @@ int blanker_codif(struct mark5_stream *ms)
 	{
 		//fprintf(m5stderr, "Frame is good\n");
 		ms->blankzoneendvalid[0] = 1<<30;
+		mark5_stream_add_valid_range(ms, 0, ms->databytes);
 		return nword;
 	}
 }
+
+/* The exact blanker.  Rather than looking only at the ends of each zone,
+ * every 64 bit word of the payload is compared with the fill pattern (AVX2:
+ * 16 words at a time), giving the precise byte ranges of fill, including
+ * 32 bit aligned stragglers at their ends.  These are published in
+ * ms->blankrange, the rest of the payload in ms->validrange, and both are
+ * folded into the blank zones used by the lookup table decoders; where a
+ * zone has valid data between two ranges of fill, those decoders blank that
+ * data too.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC_PREREQ(4, 9)) && !defined(WORDS_BIGENDIAN)
+#define MARK5_FILL_X86 1
+#include <immintrin.h>
+#include "mark5access/mark5_unpack_simd.h"
+#endif
+
+/* index of the first of words [i, nword) that is (fill = 1) or is not
+ * (fill = 0) the fill pattern, or nword if none */
+static int findfill_scalar(const unsigned long long *data, int i, int nword, int fill)
+{
+	for(; i < nword; ++i)
+	{
+		if((data[i] == MARK5_FILL_WORD64) == fill)
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
+#ifdef MARK5_FILL_X86
+static __attribute__((target("avx2"))) int findfill_avx2(const unsigned long long *data, int i, int nword, int fill)
+{
+	const __m256i pattern = _mm256_set1_epi64x((long long)MARK5_FILL_WORD64);
+	const int want = fill ? 0 : -1;	/* movemask of a block with no word of interest */
+
+	for(; i + 16 <= nword; i += 16)
+	{
+		const __m256i *p = (const __m256i *)(data + i);
+		__m256i e0, e1, e2, e3;
+
+		e0 = _mm256_cmpeq_epi64(_mm256_loadu_si256(p), pattern);
+		e1 = _mm256_cmpeq_epi64(_mm256_loadu_si256(p + 1), pattern);
+		e2 = _mm256_cmpeq_epi64(_mm256_loadu_si256(p + 2), pattern);
+		e3 = _mm256_cmpeq_epi64(_mm256_loadu_si256(p + 3), pattern);
+		if(fill)
+		{
+			if(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(e0, e1), _mm256_or_si256(e2, e3))) != want)
+			{
+				break;
+			}
+		}
+		else
+		{
+			if(_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(e0, e1), _mm256_and_si256(e2, e3))) != want)
+			{
+				break;
+			}
+		}
+	}
+
+	return findfill_scalar(data, i, nword, fill);
+}
+#endif
+
+/* appends bytes [start, end) to a list of ranges in order, merging with the
+ * last one where they touch */
+static int addrange(struct mark5_byte_range **list, int *n, int *nalloc, int start, int end)
+{
+	struct mark5_byte_range *r;
+
+	if(end <= start)
+	{
+		return 0;
+	}
+	if(*n > 0)
+	{
+		r = *list + *n - 1;
+		if(start <= r->end)
+		{
+			if(end > r->end)
+			{
+				r->end = end;
+			}
+
+			return 0;
+		}
+	}
+	if(*n >= *nalloc)
+	{
+		int m = *nalloc > 0 ? 2*(*nalloc) : 16;
+
+		r = (struct mark5_byte_range *)realloc(*list, m*sizeof(struct mark5_byte_range));
+		if(!r)
+		{
+			return -1;
+		}
+		*list = r;
+		*nalloc = m;
+	}
+	(*list)[*n].start = start;
+	(*list)[*n].end = end;
+	++(*n);
+
+	return 0;
+}
+
+int mark5_stream_add_blank_range(struct mark5_stream *ms, int start, int end)
+{
+	return addrange(&ms->blankrange, &ms->nblankrange, &ms->nblankrangealloc, start, end);
+}
+
+int mark5_stream_add_valid_range(struct mark5_stream *ms, int start, int end)
+{
+	return addrange(&ms->validrange, &ms->nvalidrange, &ms->nvalidrangealloc, start, end);
+}
+
+/* Publishes the valid parts of the payload as set in the blank zones.  As in
+ * the lookup table decoders, only the end of zone 0 counts for VDIF and
+ * CODIF blankers, which leave the zone size at 1 GB.
+ */
+void mark5_stream_valid_from_zones(struct mark5_stream *ms)
+{
+	int z, nzone;
+
+	ms->nvalidrange = 0;
+	if(!ms->payload)
+	{
+		return;
+	}
+
+	nzone = ((ms->databytes - 1) >> ms->log2blankzonesize) + 1;
+	if(nzone > MAXBLANKZONES)
+	{
+		nzone = MAXBLANKZONES;
+	}
+	for(z = 0; z < nzone; ++z)
+	{
+		long long zs, ze, s, e;
+
+		zs = (long long)z << ms->log2blankzonesize;
+		ze = zs + (1LL << ms->log2blankzonesize);
+		s = ms->blankzonestartvalid[z] > zs ? ms->blankzonestartvalid[z] : zs;
+		e = ms->blankzoneendvalid[z] < ze ? ms->blankzoneendvalid[z] : ze;
+		if(e > ms->databytes)
+		{
+			e = ms->databytes;
+		}
+		if(s < e)
+		{
+			mark5_stream_add_valid_range(ms, s, e);
+		}
+	}
+}
+
+int mark5_fill_scan(struct mark5_stream *ms, const unsigned char *data, int nbytes)
+{
+	int (*findfill)(const unsigned long long *data, int i, int nword, int fill) = findfill_scalar;
+	const unsigned long long *data64;
+	const unsigned int *data32;
+	int nword, b, e, nblanked = 0;
+
+#ifdef MARK5_FILL_X86
+	if(mark5_simd_level() >= MK5_SIMD_AVX2)
+	{
+		findfill = findfill_avx2;
+	}
+#endif
+
+	data64 = (const unsigned long long *)data;
+	data32 = (const unsigned int *)data;
+	nword = nbytes/8;
+
+	for(b = findfill(data64, 0, nword, 1); b < nword; b = findfill(data64, e, nword, 1))
+	{
+		int start, end;
+
+		e = findfill(data64, b, nword, 0);
+		start = 8*b;
+		end = 8*e;
+
+		/* 32 bit aligned stragglers */
+		if(b > 0 && data32[2*b - 1] == MARK5_FILL_WORD32)
+		{
+			start -= 4;
+		}
+		if(e < nword && data32[2*e] == MARK5_FILL_WORD32)
+		{
+			end += 4;
+		}
+
+		mark5_stream_add_blank_range(ms, start, end);
+		nblanked += end - start;
+	}
+
+	return nblanked;
+}
+
+int blanker_exact(struct mark5_stream *ms)
+{
+	int z, nzone, r, nblanked;
+	int headerbytes = 0;
+	int onezone;
+
+	ms->nblankrange = 0;
+
+	/* the VDIF and CODIF decoders only look at the end of zone 0 */
+	onezone = (ms->format == MK5_FORMAT_VDIF || ms->format == MK5_FORMAT_VDIFL || ms->format == MK5_FORMAT_VDIFB || ms->format == MK5_FORMAT_CODIF);
+	if(onezone)
+	{
+		ms->log2blankzonesize = 30;
+	}
+	else
+	{
+		for(ms->log2blankzonesize = 15; ((ms->databytes - 1) >> ms->log2blankzonesize) >= MAXBLANKZONES; ++ms->log2blankzonesize);
+	}
+
+	ms->nvalidrange = 0;
+
+	if(!ms->payload)
+	{
+		ms->blankzonestartvalid[0] = 0;
+		ms->blankzoneendvalid[0] = 0;
+
+		return 0;
+	}
+
+	/* the start of a Mark4 payload is the header */
+	if(ms->format == MK5_FORMAT_MARK4)
+	{
+		headerbytes = 160*(ms->framebytes/20000);
+		mark5_stream_add_blank_range(ms, 0, headerbytes);
+	}
+
+	nblanked = mark5_fill_scan(ms, ms->payload, ms->databytes);
+
+	/* the valid ranges are all the rest */
+	for(r = 0, z = 0; r < ms->nblankrange; ++r)
+	{
+		mark5_stream_add_valid_range(ms, z, ms->blankrange[r].start);
+		z = ms->blankrange[r].end;
+	}
+	mark5_stream_add_valid_range(ms, z, ms->databytes);
+
+	/* fold the ranges into the zones */
+	nzone = onezone ? 1 : ((ms->databytes - 1) >> ms->log2blankzonesize) + 1;
+	for(z = 0, r = 0; z < nzone; ++z)
+	{
+		int zs, ze, s;
+
+		zs = z << ms->log2blankzonesize;
+		ze = onezone ? ms->databytes : zs + (1 << ms->log2blankzonesize);
+
+		while(r < ms->nblankrange && ms->blankrange[r].end <= zs)
+		{
+			++r;
+		}
+
+		/* valid from the start of the zone or the end of fill covering it ... */
+		s = zs;
+		if(r < ms->nblankrange && ms->blankrange[r].start <= zs)
+		{
+			s = ms->blankrange[r].end;
+			++r;
+		}
+		if(s >= ze)
+		{
+			ms->blankzonestartvalid[z] = 1<<30;
+			ms->blankzoneendvalid[z] = 0;
+			--r;	/* may cover the next zone too */
+			continue;
+		}
+
+		/* ... to the next fill within it */
+		ms->blankzonestartvalid[z] = s > zs ? s : 0;
+		ms->blankzoneendvalid[z] = (r < ms->nblankrange && ms->blankrange[r].start < ze) ? ms->blankrange[r].start : 1<<30;
+
+		if(onezone && s > zs)
+		{
+			ms->blankzoneendvalid[z] = 0;
+		}
+	}
+
+	if(ms->format == MK5_FORMAT_VDIF)
+	{
+		vdif_edv4_chanmissing(ms);
+	}
+
+	return nblanked;
+}
@@ -38,6 +38,11 @@ int blanker_none(struct mark5_stream *ms)
 	ms->log2blankzonesize = 30;
 	ms->blankzonestartvalid[0] = 0;
 	ms->blankzoneendvalid[0] = 1<<30;
+	ms->nvalidrange = 0;
+	if(ms->payload)
+	{
+		mark5_stream_add_valid_range(ms, 0, ms->databytes);
+	}
 
 	return 0;
 }
@@ -37,6 +37,7 @@
 #include <string.h>
 #include <math.h>
 #include <stdint.h>
+#include <stddef.h>
 #ifdef WORDS_BIGENDIAN
 #include <endian.h>
 #endif
@@ -4461,90 +4462,75 @@ struct mark5_format_generic *new_mark5_format_codif(int framesperperiod,
 	return f;
 }
 
-/* here framesize includes the 64 byte header 
- *
- * return value: 1 if true, 0 if false
- *
- * Note: this only works for nbit = 2^n
+#define CODIF_FRAME_CONFIRM	8	/* most frames after a candidate checked by the frame finder */
+
+/* One pass over the data: the sync word is looked for with memchr() on its
+ * first byte, which the C library does many bytes at a time, and each
+ * candidate is checked against the headers that follow.  The offset whose
+ * following headers agree longest wins, the first one in case of a tie;
+ * confidence is set to their number (1 to 8).
  */
-static int is_legal_codif_framesize(int framesize)
+int find_codif_frame_confidence(const unsigned char *data, int length, size_t *offset, int *framesize, int *headersize, int *confidence)
 {
-	framesize -= 64;
-
-	if(framesize % 8 != 0)
-	{
-		return 0;
-	}
+    const uint32_t sync = 0xABADDEED;
+    const size_t syncpos = offsetof(codif_header, sync);
+    size_t o, end, best = 0;
+    int bestconfidence = 0;
+    uint32_t bestfs = 0;
+
+    if (length < 2*CODIF_HEADER_BYTES) return -1;
+    end = length - 2*CODIF_HEADER_BYTES;	// last offset with room for two headers
+
+    for (o = 0; o <= end; ++o) {
+      codif_header *A, *B;
+      const unsigned char *p;
+      uint32_t fs;
+      size_t next;
+      int k;
+
+      p = memchr(data + o + syncpos, ((const unsigned char *)&sync)[0], end - o + 1);
+      if (!p) break;
+      o = p - data - syncpos;
+
+      A = (codif_header*)(data + o);
+      if (A->sync != sync) continue;
+
+      fs = getCODIFFrameBytes(A);
+      next = o;
+      for (k = 0; k < CODIF_FRAME_CONFIRM; ++k) {
+	next += fs + CODIF_HEADER_BYTES;
+	if (next + CODIF_HEADER_BYTES > (size_t)length) break;
+
+	B = (codif_header*)(data + next);
+	if (B->sync != sync || getCODIFFrameBytes(B) != fs || B->epoch != A->epoch || B->version != A->version ||
+	    getCODIFNumChannels(B) != getCODIFNumChannels(A) || (B->seconds != A->seconds && B->seconds != A->seconds+1)) break;
+	A = B;
+      }
 
-	framesize /= 8;
+      if (k > bestconfidence) {
+	best = o;
+	bestfs = fs;
+	bestconfidence = k;
+	if (k == CODIF_FRAME_CONFIRM) break;
+      }
+    }
 
-	while(framesize % 2 == 0)
-	{
-		framesize /= 2;
-	}
-	while(framesize % 5 == 0)
-	{
-		framesize /= 5;
-	}
+    if (bestconfidence == 0) return -1;
 
-	if(framesize != 1)
-	{
-		return 0;
-	}
-	else
-	{
-		return 1;
-	}
+    *offset = best;
+    *framesize = bestfs + CODIF_HEADER_BYTES;
+    *headersize = CODIF_HEADER_BYTES;
+    if (confidence) *confidence = bestconfidence;
+    return 0;
 }
 
-
-/* if *framesize is set to 0, the frame size will be determined by this call
- * and returned into the same variable.
- *
- * return value is -1 on error (no CODIF found) or 0 if found.
+/* return value is -1 on error (no CODIF found) or 0 if found.
  *
  * here framesize includes the 64 byte header
  */
 int find_codif_frame(const unsigned char *data, int length, size_t *offset, int *framesize, int *headersize)
 {
-    int refEpochA, refEpochB, versionA, versionB, chanA, chanB;
-    uint32_t fsA, fsB, secA, secB;
-    codif_header *header;
-    
-    for (*offset=0; *offset<length; (*offset)++) {
-      header = (codif_header*)(data + *offset);
-      
-      if (header->sync != 0xABADDEED) continue; // Sync
-
-      fsA = getCODIFFrameBytes(header);
-      if (!is_legal_codif_framesize(fsA)) {
-	//continue;
-      }
-      if (fsA+*offset*2*CODIF_HEADER_BYTES> length) continue;  // Need two frame headers plus offset
-
-      secA = header->seconds;
-      refEpochA = header->epoch;
-      versionA = header->version;
-      chanA = getCODIFNumChannels(header);
-
-      header = (codif_header*)(data + *offset + fsA + CODIF_HEADER_BYTES);
-      
-      if (header->sync != 0xABADDEED) continue; // Sync
-
-      fsB = getCODIFFrameBytes(header);
-      secB = header->seconds;
-      refEpochB = header->epoch;
-      versionB = header->version;
-      chanB = getCODIFNumChannels(header);
-      
-      /* does it look reasonable? */
-      if (fsA==fsB && refEpochA==refEpochB && (secA==secB || secA+1==secB) && versionA==versionB && chanA==chanB) {
-	*framesize = fsA+CODIF_HEADER_BYTES;
-	*headersize = CODIF_HEADER_BYTES;
-	return 0;
-      }
-    }
-    return -1;
+    return find_codif_frame_confidence(data, length, offset, framesize, headersize, 0);
 }
 
 int get_codif_chans_per_thread(const codif_header *header)
@@ -45,3 +45,10 @@ int find_codif_frame(const unsigned char *data, int length, size_t *offset, int
 
 	exit(EXIT_FAILURE);
 }
+
+int find_codif_frame_confidence(const unsigned char *data, int length, size_t *offset, int *framesize, int *headersize, int *confidence)
+{
+	fprintf(m5stderr, "mark5_stream: Error - Not compiled with CODIF!! Quitting\n");
+
+	exit(EXIT_FAILURE);
+}
@@ -44,6 +44,11 @@
 static unsigned char VDIF_FILL_BYTES[4] = { 0x44, 0x33, 0x22, 0x11 };
 
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_unpack_simd.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 static const float HiMag = OPTIMAL_2BIT_HIGH;
 static const float FourBit1sigma = 2.95;
@@ -52,12 +57,6 @@ static float lut1bit[256][8];
 static float lut2bit[256][4];
 static float lut4bit[256][2];
 static float lut8bit[256];
-static float zeros[8];
-static float complex complex_zeros[8];
-
-static float complex complex_lut1bit[256][4];
-static float complex complex_lut2bit[256][2];
-static float complex complex_lut4bit[256];
 
 /* for use in counting high states; 2-bit support only at this time */
 static unsigned char countlut2bit[256][4];
@@ -69,6 +68,10 @@ struct mark5_format_vdif
 	int frameheadersize;		/* 16 (legacy) or 32 (normal) */
 	int leapsecs;			/* relative to reference epoch of VDIF data */
 	int completesamplesperword;	/* number of samples for each channel in one 32-bit word */
+	struct mark5_simd_layout simd;	/* used by vdif_decode_simd() only */
+	decodeFunc lutdecode;		/* lookup table decoders, called by vdif_decode_lut() */
+	complex_decodeFunc lutcomplexdecode;
+	countFunc lutcount;		/* lookup table counters, called by vdif_count_lut() */
 };
 
 static void initluts()
@@ -79,13 +82,7 @@ static void initluts()
 	const float lut16level[16] = {-8/FourBit1sigma,-7/FourBit1sigma,-6/FourBit1sigma,-5/FourBit1sigma,-4/FourBit1sigma,
 				      -3/FourBit1sigma,-2/FourBit1sigma,-1/FourBit1sigma,0,1/FourBit1sigma,2/FourBit1sigma,
 				      3/FourBit1sigma,4/FourBit1sigma,5/FourBit1sigma,6/FourBit1sigma,7/FourBit1sigma};
-	int b, i, l, li;
-	
-	for(i = 0; i < 8; i++)
-	{
-		zeros[i] = 0.0;
-		complex_zeros[i] = 0.0+0.0*I;
-	}
+	int b, i, l;
 
 	for(b = 0; b < 256; b++)
 	{
@@ -120,30 +117,6 @@ static void initluts()
 
 		/* lut8bit */
 		lut8bit[b] = (b-128)/3.3;	/* This scaling mimics 2-bit data if 8 bit RMS==~10 */
-
-		/* Complex lookups */
-
-		/* 1 bit real, 1 bit imaginary */
-		for(i = 0; i < 4; i++)
-		{
-		         l =  (b>> (2*i)) & 0x1;
-			 li = (b>> (2*i+1)) & 0x1;
-			 complex_lut1bit[b][i] =  lut2level[l] + lut2level[li]*I;
-		}
-
-		/* 2 bit real, 2 bit imaginary */
-		for(i = 0; i < 2; i++)
-		{
-		         l =  (b>> (4*i)) & 0x3;
-			 li = (b>> (4*i+2)) & 0x3;
-			 complex_lut2bit[b][i] =  lut4level[l] + lut4level[li]*I;
-		}
-
-		/* 4 bit real, 4 bit imaginary */
-		l =  b & 0xF;
-		li = (b>>4) & 0xF;
-		complex_lut4bit[b] =  lut16level[l] + lut16level[li]*I;
-
 	}
 }
 
@@ -217,3098 +190,386 @@ static int mark5_stream_frame_time_vdif(const struct mark5_stream *ms, int *mjd,
 	{
 		*sec = seconds;
 	}
-	if(ns)
-	{
-		*ns = (word1 & 0x00FFFFFF)*ms->framens;
-	}
-
-	return 0;
-}
-
-/************************* decode routines **************************/
-
-static int vdif_decode_1channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		o++;
-		data[0][o] = fp[1];
-		o++;
-		data[0][o] = fp[2];
-		o++;
-		data[0][o] = fp[3];
-		o++;
-		data[0][o] = fp[4];
-		o++;
-		data[0][o] = fp[5];
-		o++;
-		data[0][o] = fp[6];
-		o++;
-		data[0][o] = fp[7];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 8*nblank;
-}
-
-static int vdif_decode_2channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		o++;
-		data[0][o] = fp[2];
-		data[1][o] = fp[3];
-		o++;
-		data[0][o] = fp[4];
-		data[1][o] = fp[5];
-		o++;
-		data[0][o] = fp[6];
-		data[1][o] = fp[7];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 4*nblank;
-}
-
-/* this is 3 channels packed into a 4-channel format.  The highest number channel is ignored */
-static int vdif_decode_3channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		data[2][o] = fp[2];
-		o++;
-		data[0][o] = fp[4];
-		data[1][o] = fp[5];
-		data[2][o] = fp[6];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 2*nblank;
-}
-
-static int vdif_decode_4channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		data[2][o] = fp[2];
-		data[3][o] = fp[3];
-		o++;
-		data[0][o] = fp[4];
-		data[1][o] = fp[5];
-		data[2][o] = fp[6];
-		data[3][o] = fp[7];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 2*nblank;
-}
-
-/* this is 5 channels packed into a 8-channel format.  The 3 highest channels are ignored */
-static int vdif_decode_5channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		data[2][o] = fp[2];
-		data[3][o] = fp[3];
-		data[4][o] = fp[4];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-/* this is 6 channels packed into a 8-channel format.  The 2 highest channels are ignored */
-static int vdif_decode_6channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		data[2][o] = fp[2];
-		data[3][o] = fp[3];
-		data[4][o] = fp[4];
-		data[5][o] = fp[5];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-/* this is 7 channels packed into a 8-channel format.  The highest channel is ignored */
-static int vdif_decode_7channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		data[2][o] = fp[2];
-		data[3][o] = fp[3];
-		data[4][o] = fp[4];
-		data[5][o] = fp[5];
-		data[6][o] = fp[6];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_8channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		data[2][o] = fp[2];
-		data[3][o] = fp[3];
-		data[4][o] = fp[4];
-		data[5][o] = fp[5];
-		data[6][o] = fp[6];
-		data[7][o] = fp[7];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_16channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = zeros;
-			nblank++;
-			i += 2;
-		}
-		else
-		{
-			fp0 = lut1bit[buf[i]];
-			i++;
-			fp1 = lut1bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp0[2];
-		data[3][o] = fp0[3];
-		data[4][o] = fp0[4];
-		data[5][o] = fp0[5];
-		data[6][o] = fp0[6];
-		data[7][o] = fp0[7];
-		data[8][o] = fp1[0];
-		data[9][o] = fp1[1];
-		data[10][o] = fp1[2];
-		data[11][o] = fp1[3];
-		data[12][o] = fp1[4];
-		data[13][o] = fp1[5];
-		data[14][o] = fp1[6];
-		data[15][o] = fp1[7];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_32channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = zeros;
-			nblank++;
-			i += 4;
-		}
-		else
-		{
-			fp0 = lut1bit[buf[i]];
-			i++;
-			fp1 = lut1bit[buf[i]];
-			i++;
-			fp2 = lut1bit[buf[i]];
-			i++;
-			fp3 = lut1bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp0[2];
-		data[3][o] = fp0[3];
-		data[4][o] = fp0[4];
-		data[5][o] = fp0[5];
-		data[6][o] = fp0[6];
-		data[7][o] = fp0[7];
-		data[8][o] = fp1[0];
-		data[9][o] = fp1[1];
-		data[10][o] = fp1[2];
-		data[11][o] = fp1[3];
-		data[12][o] = fp1[4];
-		data[13][o] = fp1[5];
-		data[14][o] = fp1[6];
-		data[15][o] = fp1[7];
-		data[16][o] = fp2[0];
-		data[17][o] = fp2[1];
-		data[18][o] = fp2[2];
-		data[19][o] = fp2[3];
-		data[20][o] = fp2[4];
-		data[21][o] = fp2[5];
-		data[22][o] = fp2[6];
-		data[23][o] = fp2[7];
-		data[24][o] = fp3[0];
-		data[25][o] = fp3[1];
-		data[26][o] = fp3[2];
-		data[27][o] = fp3[3];
-		data[28][o] = fp3[4];
-		data[29][o] = fp3[5];
-		data[30][o] = fp3[6];
-		data[31][o] = fp3[7];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_1channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut2bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		o++;
-		data[0][o] = fp[1];
-		o++;
-		data[0][o] = fp[2];
-		o++;
-		data[0][o] = fp[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 4*nblank;
-}
-
-static int vdif_decode_2channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut2bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		o++;
-		data[0][o] = fp[2];
-		data[1][o] = fp[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 2*nblank;
-}
-
-static int vdif_decode_3channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut2bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		data[2][o] = fp[2];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_4channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut2bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-		data[2][o] = fp[2];
-		data[3][o] = fp[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_5channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = zeros;
-			nblank++;
-			i+=2;
-		}
-		else
-		{
-			fp0 = lut2bit[buf[i]];
-			i++;
-			fp1 = lut2bit[buf[i]];
-			i++;
-		}
-
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp0[2];
-		data[3][o] = fp0[3];
-		data[4][o] = fp1[0];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_6channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = zeros;
-			nblank++;
-			i+=2;
-		}
-		else
-		{
-			fp0 = lut2bit[buf[i]];
-			i++;
-			fp1 = lut2bit[buf[i]];
-			i++;
-		}
-
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp0[2];
-		data[3][o] = fp0[3];
-		data[4][o] = fp1[0];
-		data[5][o] = fp1[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_7channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = zeros;
-			nblank++;
-			i+=2;
-		}
-		else
-		{
-			fp0 = lut2bit[buf[i]];
-			i++;
-			fp1 = lut2bit[buf[i]];
-			i++;
-		}
-
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp0[2];
-		data[3][o] = fp0[3];
-		data[4][o] = fp1[0];
-		data[5][o] = fp1[1];
-		data[6][o] = fp1[2];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_8channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = zeros;
-			nblank++;
-			i+=2;
-		}
-		else
-		{
-			fp0 = lut2bit[buf[i]];
-			i++;
-			fp1 = lut2bit[buf[i]];
-			i++;
-		}
-
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp0[2];
-		data[3][o] = fp0[3];
-		data[4][o] = fp1[0];
-		data[5][o] = fp1[1];
-		data[6][o] = fp1[2];
-		data[7][o] = fp1[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_16channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = zeros;
-			nblank++;
-			i+=4;
-		}
-		else
-		{
-			fp0 = lut2bit[buf[i]];
-			i++;
-			fp1 = lut2bit[buf[i]];
-			i++;
-			fp2 = lut2bit[buf[i]];
-			i++;
-			fp3 = lut2bit[buf[i]];
-			i++;
-		}
-
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp0[2];
-		data[3][o] = fp0[3];
-		data[4][o] = fp1[0];
-		data[5][o] = fp1[1];
-		data[6][o] = fp1[2];
-		data[7][o] = fp1[3];
-		data[8][o] = fp2[0];
-		data[9][o] = fp2[1];
-		data[10][o] = fp2[2];
-		data[11][o] = fp2[3];
-		data[12][o] = fp3[0];
-		data[13][o] = fp3[1];
-		data[14][o] = fp3[2];
-		data[15][o] = fp3[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_32channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3, *fp4, *fp5, *fp6, *fp7;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = fp4 = fp5 = fp6 = fp7 = zeros;
-			nblank++;
-			i+=8;
-		}
-		else
-		{
-			fp0 = lut2bit[buf[i]];
-			i++;
-			fp1 = lut2bit[buf[i]];
-			i++;
-			fp2 = lut2bit[buf[i]];
-			i++;
-			fp3 = lut2bit[buf[i]];
-			i++;
-			fp4 = lut2bit[buf[i]];
-			i++;
-			fp5 = lut2bit[buf[i]];
-			i++;
-			fp6 = lut2bit[buf[i]];
-			i++;
-			fp7 = lut2bit[buf[i]];
-			i++;
-		}
-
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp0[2];
-		data[3][o] = fp0[3];
-		data[4][o] = fp1[0];
-		data[5][o] = fp1[1];
-		data[6][o] = fp1[2];
-		data[7][o] = fp1[3];
-		data[8][o] = fp2[0];
-		data[9][o] = fp2[1];
-		data[10][o] = fp2[2];
-		data[11][o] = fp2[3];
-		data[12][o] = fp3[0];
-		data[13][o] = fp3[1];
-		data[14][o] = fp3[2];
-		data[15][o] = fp3[3];
-		data[16][o] = fp4[0];
-		data[17][o] = fp4[1];
-		data[18][o] = fp4[2];
-		data[19][o] = fp4[3];
-		data[20][o] = fp5[0];
-		data[21][o] = fp5[1];
-		data[22][o] = fp5[2];
-		data[23][o] = fp5[3];
-		data[24][o] = fp6[0];
-		data[25][o] = fp6[1];
-		data[26][o] = fp6[2];
-		data[27][o] = fp6[3];
-		data[28][o] = fp7[0];
-		data[29][o] = fp7[1];
-		data[30][o] = fp7[2];
-		data[31][o] = fp7[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_64channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3, *fp4, *fp5, *fp6, *fp7;
-	const float *fp8, *fp9, *fpA, *fpB, *fpC, *fpD, *fpE, *fpF;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-	
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = fp4 = fp5 = fp6 = fp7 = zeros;
-			fp8 = fp9 = fpA = fpB = fpC = fpD = fpE = fpF = zeros;
-			nblank++;
-			i+=16;
-		}
-		else
-		{
-			fp0 = lut2bit[buf[i]];
-			i++;
-			fp1 = lut2bit[buf[i]];
-			i++;
-			fp2 = lut2bit[buf[i]];
-			i++;
-			fp3 = lut2bit[buf[i]];
-			i++;
-			fp4 = lut2bit[buf[i]];
-			i++;
-			fp5 = lut2bit[buf[i]];
-			i++;
-			fp6 = lut2bit[buf[i]];
-			i++;
-			fp7 = lut2bit[buf[i]];
-			i++;
-			fp8 = lut2bit[buf[i]];
-			i++;
-			fp9 = lut2bit[buf[i]];
-			i++;
-			fpA = lut2bit[buf[i]];
-			i++;
-			fpB = lut2bit[buf[i]];
-			i++;
-			fpC = lut2bit[buf[i]];
-			i++;
-			fpD = lut2bit[buf[i]];
-			i++;
-			fpE = lut2bit[buf[i]];
-			i++;
-			fpF = lut2bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp0[2];
-		data[3][o] = fp0[3];
-		data[4][o] = fp1[0];
-		data[5][o] = fp1[1];
-		data[6][o] = fp1[2];
-		data[7][o] = fp1[3];
-		data[8][o] = fp2[0];
-		data[9][o] = fp2[1];
-		data[10][o] = fp2[2];
-		data[11][o] = fp2[3];
-		data[12][o] = fp3[0];
-		data[13][o] = fp3[1];
-		data[14][o] = fp3[2];
-		data[15][o] = fp3[3];
-		data[16][o] = fp4[0];
-		data[17][o] = fp4[1];
-		data[18][o] = fp4[2];
-		data[19][o] = fp4[3];
-		data[20][o] = fp5[0];
-		data[21][o] = fp5[1];
-		data[22][o] = fp5[2];
-		data[23][o] = fp5[3];
-		data[24][o] = fp6[0];
-		data[25][o] = fp6[1];
-		data[26][o] = fp6[2];
-		data[27][o] = fp6[3];
-		data[28][o] = fp7[0];
-		data[29][o] = fp7[1];
-		data[30][o] = fp7[2];
-		data[31][o] = fp7[3];
-
-		data[32][o] = fp8[0];
-		data[33][o] = fp8[1];
-		data[34][o] = fp8[2];
-		data[35][o] = fp8[3];
-		data[36][o] = fp9[0];
-		data[37][o] = fp9[1];
-		data[38][o] = fp9[2];
-		data[39][o] = fp9[3];
-		data[40][o] = fpA[0];
-		data[41][o] = fpA[1];
-		data[42][o] = fpA[2];
-		data[43][o] = fpA[3];
-		data[44][o] = fpB[0];
-		data[45][o] = fpB[1];
-		data[46][o] = fpB[2];
-		data[47][o] = fpB[3];
-		data[48][o] = fpC[0];
-		data[49][o] = fpC[1];
-		data[50][o] = fpC[2];
-		data[51][o] = fpC[3];
-		data[52][o] = fpD[0];
-		data[53][o] = fpD[1];
-		data[54][o] = fpD[2];
-		data[55][o] = fpD[3];
-		data[56][o] = fpE[0];
-		data[57][o] = fpE[1];
-		data[58][o] = fpE[2];
-		data[59][o] = fpE[3];
-		data[60][o] = fpF[0];
-		data[61][o] = fpF[1];
-		data[62][o] = fpF[2];
-		data[63][o] = fpF[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_1channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut4bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		o++;
-		data[0][o] = fp[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 2*nblank;
-}
-
-static int vdif_decode_2channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = lut4bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-		data[1][o] = fp[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_3channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = zeros;
-			nblank++;
-			i += 2;
-		}
-		else
-		{
-			fp0 = lut4bit[buf[i]];
-			i++;
-			fp1 = lut4bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp1[0];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_4channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = zeros;
-			nblank++;
-			i += 2;
-		}
-		else
-		{
-			fp0 = lut4bit[buf[i]];
-			i++;
-			fp1 = lut4bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp1[0];
-		data[3][o] = fp1[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_5channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = zeros;
-			nblank++;
-			i += 4;
-		}
-		else
-		{
-			fp0 = lut4bit[buf[i]];
-			i++;
-			fp1 = lut4bit[buf[i]];
-			i++;
-			fp2 = lut4bit[buf[i]];
-			i++;
-			fp3 = lut4bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp1[0];
-		data[3][o] = fp1[1];
-		data[4][o] = fp2[0];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_6channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = zeros;
-			nblank++;
-			i += 4;
-		}
-		else
-		{
-			fp0 = lut4bit[buf[i]];
-			i++;
-			fp1 = lut4bit[buf[i]];
-			i++;
-			fp2 = lut4bit[buf[i]];
-			i++;
-			fp3 = lut4bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp1[0];
-		data[3][o] = fp1[1];
-		data[4][o] = fp2[0];
-		data[5][o] = fp2[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_7channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = zeros;
-			nblank++;
-			i += 4;
-		}
-		else
-		{
-			fp0 = lut4bit[buf[i]];
-			i++;
-			fp1 = lut4bit[buf[i]];
-			i++;
-			fp2 = lut4bit[buf[i]];
-			i++;
-			fp3 = lut4bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp1[0];
-		data[3][o] = fp1[1];
-		data[4][o] = fp2[0];
-		data[5][o] = fp2[1];
-		data[6][o] = fp3[0];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_8channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = zeros;
-			nblank++;
-			i += 4;
-		}
-		else
-		{
-			fp0 = lut4bit[buf[i]];
-			i++;
-			fp1 = lut4bit[buf[i]];
-			i++;
-			fp2 = lut4bit[buf[i]];
-			i++;
-			fp3 = lut4bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp0[1];
-		data[2][o] = fp1[0];
-		data[3][o] = fp1[1];
-		data[4][o] = fp2[0];
-		data[5][o] = fp2[1];
-		data[6][o] = fp3[0];
-		data[7][o] = fp3[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_1channel_8bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp = &lut8bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fp[0];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_2channel_8bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp0 = &lut8bit[buf[i]];
-			i++;
-			fp1 = &lut8bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp1[0];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_3channel_8bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp0 = &lut8bit[buf[i]];
-			i++;
-			fp1 = &lut8bit[buf[i]];
-			i++;
-			fp2 = &lut8bit[buf[i]];
-			i++;
-			fp3 = &lut8bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp1[0];
-		data[2][o] = fp2[0];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_4channel_8bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const unsigned char *buf;
-	const float *fp0, *fp1, *fp2, *fp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fp0 = fp1 = fp2 = fp3 = zeros;
-			nblank++;
-		}
-		else
-		{
-			fp0 = &lut8bit[buf[i]];
-			i++;
-			fp1 = &lut8bit[buf[i]];
-			i++;
-			fp2 = &lut8bit[buf[i]];
-			i++;
-			fp3 = &lut8bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fp0[0];
-		data[1][o] = fp1[0];
-		data[2][o] = fp2[0];
-		data[3][o] = fp3[0];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_decode_1channel_32bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
-{
-	const float *buf;
-	int o, i;
-	int nblank = 0;
-
-	buf = (const float*)ms->payload;
-	i = ms->readposition/4;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i*4 >= ms->blankzoneendvalid[0])
-		{
-			data[0][o] = zeros[0];
-			nblank++;
-		}
-		else
-		{
-#ifdef WORDS_BIGENDIAN
-			uint32_t v = *((const uint32_t*)buf + i);
-			v = le32toh(v);
-			data[0][o] = *((float*)&v);
-#else
-			data[0][o] = buf[i];
-#endif
-		}
-
-		i++;
-
-
-		if(i*4 >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = (const float*)ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i*4;
-
-	return nsamp - nblank;
-}
-
-// Complex
-
-static int vdif_complex_decode_1channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp = complex_zeros;
-			nblank++;
-		}
-		else
-		{
-			fcp = complex_lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fcp[0];
-		o++;
-		data[0][o] = fcp[1];
-		o++;
-		data[0][o] = fcp[2];
-		o++;
-		data[0][o] = fcp[3];
-		o++;
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 4*nblank;
-}
-
-static int vdif_complex_decode_2channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp = complex_zeros;
-			nblank++;
-		}
-		else
-		{
-			fcp = complex_lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fcp[0];
-		data[1][o] = fcp[1];
-		o++;
-		data[0][o] = fcp[2];
-		data[1][o] = fcp[3];
-		o++;
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 2*nblank;
-}
-
-static int vdif_complex_decode_4channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp = complex_zeros;
-			nblank++;
-		}
-		else
-		{
-			fcp = complex_lut1bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fcp[0];
-		data[1][o] = fcp[1];
-		data[2][o] = fcp[2];
-		data[3][o] = fcp[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_8channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp0, *fcp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-		        fcp0 = fcp1 = complex_zeros;
-			nblank++;
-			i += 2;
-		}
-		else
-		{
-			fcp0 = complex_lut1bit[buf[i]];
-			i++;
-			fcp1 = complex_lut1bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fcp0[0];
-		data[1][o] = fcp0[1];
-		data[2][o] = fcp0[2];
-		data[3][o] = fcp0[3];
-		data[4][o] = fcp1[0];
-		data[5][o] = fcp1[1];
-		data[6][o] = fcp1[2];
-		data[7][o] = fcp1[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;  // CHECK
-}
-
-static int vdif_complex_decode_16channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp0, *fcp1, *fcp2, *fcp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp0 = fcp1 = fcp2 = fcp3 = complex_zeros;
-			nblank++;
-			i += 4;
-		}
-		else
-		{
-			fcp0 = complex_lut1bit[buf[i]];
-			i++;
-			fcp1 = complex_lut1bit[buf[i]];
-			i++;
-			fcp2 = complex_lut1bit[buf[i]];
-			i++;
-			fcp3 = complex_lut1bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fcp0[0];
-		data[1][o] = fcp0[1];
-		data[2][o] = fcp0[2];
-		data[3][o] = fcp0[3];
-		data[4][o] = fcp1[0];
-		data[5][o] = fcp1[1];
-		data[6][o] = fcp1[2];
-		data[7][o] = fcp1[3];
-		data[8][o] = fcp2[0];
-		data[9][o] = fcp2[1];
-		data[10][o] = fcp2[2];
-		data[11][o] = fcp2[3];
-		data[12][o] = fcp3[0];
-		data[13][o] = fcp3[1];
-		data[14][o] = fcp3[2];
-		data[15][o] = fcp3[3];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_1channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp = complex_zeros;
-			nblank++;
-		}
-		else
-		{
-			fcp = complex_lut2bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fcp[0];
-		o++;
-		data[0][o] = fcp[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - 2*nblank;
-}
-
-static int vdif_complex_decode_2channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp = complex_zeros;
-			nblank++;
-		}
-		else
-		{
-			fcp = complex_lut2bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fcp[0];
-		data[1][o] = fcp[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_4channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp0, *fcp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp0 = fcp1 = complex_zeros;
-			nblank++;
-			i+=2;
-		}
-		else
-		{
-			fcp0 = complex_lut2bit[buf[i]];
-			i++;
-			fcp1 = complex_lut2bit[buf[i]];
-			i++;
-		}
-
-
-		data[0][o] = fcp0[0];
-		data[1][o] = fcp0[1];
-		data[2][o] = fcp1[0];
-		data[3][o] = fcp1[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_8channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp0, *fcp1, *fcp2, *fcp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp0 = fcp1 = fcp2 = fcp3 = complex_zeros;
-			nblank++;
-			i+=4;
-		}
-		else
-		{
-			fcp0 = complex_lut2bit[buf[i]];
-			i++;
-			fcp1 = complex_lut2bit[buf[i]];
-			i++;
-			fcp2 = complex_lut2bit[buf[i]];
-			i++;
-			fcp3 = complex_lut2bit[buf[i]];
-			i++;
-		}
-
-
-		data[0][o] = fcp0[0];
-		data[1][o] = fcp0[1];
-		data[2][o] = fcp1[0];
-		data[3][o] = fcp1[1];
-		data[4][o] = fcp2[0];
-		data[5][o] = fcp2[1];
-		data[6][o] = fcp3[0];
-		data[7][o] = fcp3[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_16channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp0, *fcp1, *fcp2, *fcp3, *fcp4, *fcp5, *fcp6, *fcp7;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp0 = fcp1 = fcp2 = fcp3 = fcp4 = fcp5 = fcp6 = fcp7 = complex_zeros;
-			nblank++;
-			i+=8;
-		}
-		else
-		{
-			fcp0 = complex_lut2bit[buf[i]];
-			i++;
-			fcp1 = complex_lut2bit[buf[i]];
-			i++;
-			fcp2 = complex_lut2bit[buf[i]];
-			i++;
-			fcp3 = complex_lut2bit[buf[i]];
-			i++;
-			fcp4 = complex_lut2bit[buf[i]];
-			i++;
-			fcp5 = complex_lut2bit[buf[i]];
-			i++;
-			fcp6 = complex_lut2bit[buf[i]];
-			i++;
-			fcp7 = complex_lut2bit[buf[i]];
-			i++;
-		}
-
-
-		data[0][o] = fcp0[0];
-		data[1][o] = fcp0[1];
-		data[2][o] = fcp1[0];
-		data[3][o] = fcp1[1];
-		data[4][o] = fcp2[0];
-		data[5][o] = fcp2[1];
-		data[6][o] = fcp3[0];
-		data[7][o] = fcp3[1];
-		data[8][o] = fcp4[0];
-		data[9][o] = fcp4[1];
-		data[10][o] = fcp5[0];
-		data[11][o] = fcp5[1];
-		data[12][o] = fcp6[0];
-		data[13][o] = fcp6[1];
-		data[14][o] = fcp7[0];
-		data[15][o] = fcp7[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_32channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp[16];
-	int o, i, j;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-  		        for (j=0; j<16; j++) fcp[j] = complex_zeros;
-		        nblank++;
-		        i+=16;
-		}
-		else
-		{
-		  for (j=0; j<16; j++) 
-		  {
-		        fcp[j] = complex_lut2bit[buf[i]]; 
-			i++;
-		  }
-		}
-
-		int k=0;
-		for (j=0; j<16; j++) 
-		{
-		        data[k++][o] = fcp[j][0];
-			data[k++][o] = fcp[j][1];
-		}
-
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_64channel_2bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp[32];
-	int o, i, j;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-  		        for (j=0; j<32; j++) fcp[j] = complex_zeros;
-		        nblank++;
-		        i+=32;
-		}
-		else
-		{
-		  for (j=0; j<32; j++) 
-		  {
-		        fcp[j] = complex_lut2bit[buf[i]]; 
-			i++;
-		  }
-		}
-
-		int k=0;
-		for (j=0; j<32; j++) 
-		{
-		        data[k++][o] = fcp[j][0];
-			data[k++][o] = fcp[j][1];
-		}
-
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-
-static int vdif_complex_decode_1channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp = complex_zeros;
-			nblank++;
-		}
-		else
-		{
-			fcp = &complex_lut4bit[buf[i]];
-		}
-
-		i++;
-
-		data[0][o] = fcp[0];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_2channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp0, *fcp1;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp0 = fcp1 = complex_zeros;
-			nblank++;
-			i += 2;
-		}
-		else
-		{
-			fcp0 = &complex_lut4bit[buf[i]];
-			i++;
-			fcp1 = &complex_lut4bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fcp0[0];
-		data[1][o] = fcp0[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_4channel_4bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	const float complex *fcp0, *fcp1, *fcp2, *fcp3;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			fcp0 = fcp1 = fcp2 = fcp3 = complex_zeros;
-			nblank++;
-			i += 4;
-		}
-		else
-		{
-			fcp0 = &complex_lut4bit[buf[i]];
-			i++;
-			fcp1 = &complex_lut4bit[buf[i]];
-			i++;
-			fcp2 = &complex_lut4bit[buf[i]];
-			i++;
-			fcp3 = &complex_lut4bit[buf[i]];
-			i++;
-		}
-
-		data[0][o] = fcp0[0];
-		data[1][o] = fcp0[1];
-		data[2][o] = fcp1[0];
-		data[3][o] = fcp1[1];
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_1channel_8bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			data[0][o] = complex_zeros[0];
-			nblank++;
-		}
-		else
-		{
-		  data[0][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-		  i+= 2;
-		}
-
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_2channel_8bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			data[0][o] = complex_zeros[0];
-			data[1][o] = complex_zeros[0];
-			nblank++;
-		}
-		else
-		{
-			data[0][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[1][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-		}
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_4channel_8bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			data[0][o] = complex_zeros[0];
-			data[1][o] = complex_zeros[0];
-			data[2][o] = complex_zeros[0];
-			data[3][o] = complex_zeros[0];
-			nblank++;
-		}
-		else
-		{
-			data[0][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[1][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[2][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[3][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-		}
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_8channel_8bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	int o, i;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-			data[0][o] = complex_zeros[0];
-			data[1][o] = complex_zeros[0];
-			data[2][o] = complex_zeros[0];
-			data[3][o] = complex_zeros[0];
-			data[4][o] = complex_zeros[0];
-			data[5][o] = complex_zeros[0];
-			data[6][o] = complex_zeros[0];
-			data[7][o] = complex_zeros[0];
-			nblank++;
-		}
-		else
-		{
-			data[0][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[1][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[2][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[3][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[4][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[5][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[6][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-			data[7][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I; 
-			i+=2;
-		}
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
-	}
-
-	ms->readposition = i;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_16channel_8bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const unsigned char *buf;
-	int o, i, j;
-	int nblank = 0;
-
-	buf = ms->payload;
-	i = ms->readposition;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i >= ms->blankzoneendvalid[0])
-		{
-		        for (j=0;j<16;j++) 
-			  data[j][o] = complex_zeros[0];
-			nblank++;
-		}
-		else
-		{
-		  for (j=0; j<16;j++) {
-		        data[j][o] = lut8bit[buf[i]] + lut8bit[buf[i+1]]*I;
-			i +=2;
-		  }
-		}
-
-		if(i >= ms->databytes)
-		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = ms->payload;
-			i = 0;
-		}
+	if(ns)
+	{
+		*ns = (word1 & 0x00FFFFFF)*ms->framens;
 	}
 
-	ms->readposition = i;
+	return 0;
+}
 
-	return nsamp - nblank;
+/************************* decode routines **************************/
+
+/* All of the decoders are instances of vdif_decode_body(), which is
+ * specialized at compile time for the number of channels, bits per value,
+ * complexness and decimation of each instance listed below so that its
+ * loops unroll as far as hand written code would.  Shapes not listed are
+ * decoded by the instance for their number of bits, which reads the number
+ * of channels and the decimation from the stream.
+ *
+ * As usual for VDIF, the channels of one time slot are padded to a power of
+ * 2 bits, and the real part of a complex value precedes its imaginary part.
+ */
+
+/* bits per time slot */
+static inline int vdif_slotbits(int nchan, int nbit, int iscomplex)
+{
+	int valuebits, slotbits;
+
+	valuebits = iscomplex ? 2*nbit : nbit;
+	for(slotbits = valuebits; slotbits < nchan*valuebits; slotbits *= 2);
+
+	return slotbits;
 }
 
-static int vdif_complex_decode_1channel_16bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
+/* the value of nbit bits starting at bit p of buf.  Values shorter than a byte never straddle bytes */
+static inline __attribute__((always_inline)) float vdif_value(const unsigned char *buf, int p, const int nbit)
 {
-	const uint16_t *buf;
-	int o, i;
-	int nblank = 0;
+	const unsigned char *q = buf + (p >> 3);
+	uint32_t u;
+	float x;
 
-	buf = (const uint16_t *)ms->payload;
-	i = ms->readposition/2;
+	switch(nbit)
+	{
+	case 1:
+		return lut1bit[q[0]][p & 7];
+	case 2:
+		return lut2bit[q[0]][(p & 7) >> 1];
+	case 4:
+		return lut4bit[q[0]][(p & 7) >> 2];
+	case 8:
+		return lut8bit[q[0]];
+	case 16:
+		return (int16_t)((q[0] | (q[1] << 8)) ^ 0x8000)/8.0;	/* Assume RMS==8 */
+	default:
+		u = q[0] | (q[1] << 8) | (q[2] << 16) | ((uint32_t)q[3] << 24);
+		memcpy(&x, &u, sizeof(x));
 
-	for(o = 0; o < nsamp; o++)
+		return x;
+	}
+}
+
+/* samples starting at bit b of src: perbyte samples if nonzero, otherwise one.
+ * src is restrict so that its bytes need not be read again after each store.
+ */
+static inline __attribute__((always_inline)) void vdif_unpack(const unsigned char * restrict src, int b, float **data, int o,
+	const int nchan, const int nbit, const int nval, const int perbyte, const int step)
+{
+	int m, s;
+
+	if(perbyte)
 	{
-		if(i*2 >= ms->blankzoneendvalid[0])
-		{
-			data[0][o] = complex_zeros[0];
-			nblank++;
-		}
-		else
+#pragma GCC unroll 64
+		for(m = 0; m < nval*nchan*perbyte; m++)
 		{
-		  data[0][o] = ((int16_t)(buf[i]^0x8000) + (int16_t)(buf[i+1]^0x8000)*I)/8.0;  // Assume RMS==8
-		  i+= 2;
+			s = m/(nval*nchan);
+			data[(m % (nval*nchan))/nval][nval*(o + s) + m%nval] = vdif_value(src, s*step + (m % (nval*nchan))*nbit, nbit);
 		}
-
-
-		if(i*2 >= ms->databytes)
+	}
+	else
+	{
+#pragma GCC unroll 128
+		for(m = 0; m < nval*nchan; m++)
 		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = (const uint16_t *)ms->payload;
-			i = 0;
+			data[m/nval][nval*o + m%nval] = vdif_value(src, b + m*nbit, nbit);
 		}
 	}
-
-	ms->readposition = i*2;
-
-	return nsamp - nblank;
 }
 
-static int vdif_complex_decode_2channel_16bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
+/* For complex data, data[c] points to float complex; each sample is then two floats */
+static inline __attribute__((always_inline)) int vdif_decode_body(struct mark5_stream *ms, int nsamp, float **data,
+	const int nchan, const int nbit, const int iscomplex, const int decimation)
 {
-	const uint16_t *buf;
-	int o, i;
+	const int nval = iscomplex ? 2 : 1;
+	const int step = vdif_slotbits(nchan, nbit, iscomplex)*decimation;	/* bits from one sample to the next */
+	const int perbyte = (step < 8 && 8 % step == 0) ? 8/step : 0;		/* whole samples per byte, if any */
+	const unsigned char *buf;
+	int o, i, b, m;
 	int nblank = 0;
 
-	buf = (const uint16_t *)ms->payload;
-	i = ms->readposition/2;
+	buf = ms->payload;
+	i = ms->readposition;
+	b = 0;	/* bit within byte i; stays 0 unless samples span fractions of bytes */
 
-	for(o = 0; o < nsamp; o++)
+	for(o = 0; o < nsamp; o += (perbyte ? perbyte : 1))
 	{
-		if(i*2 >= ms->blankzoneendvalid[0])
+		if(i >= ms->blankzoneendvalid[0])
 		{
-			data[0][o] = complex_zeros[0];
-			data[1][o] = complex_zeros[0];
-			nblank++;
+			for(m = 0; m < nval*nchan*(perbyte ? perbyte : 1); m++)
+			{
+				data[(m % (nval*nchan))/nval][nval*(o + m/(nval*nchan)) + m%nval] = 0.0;
+			}
+			nblank += (perbyte ? perbyte : 1);
 		}
 		else
 		{
-		        data[0][o] = ((int16_t)(buf[i]^0x8000) + (int16_t)(buf[i+1]^0x8000)*I)/8.0;  // Assume RMS==8
-			i+=2;
-		        data[1][o] = ((int16_t)(buf[i]^0x8000) + (int16_t)(buf[i+1]^0x8000)*I)/8.0;  // Assume RMS==8
-			i+=2;
+			vdif_unpack(buf + i, (step % 8 ? b : 0), data, o, nchan, nbit, nval, perbyte, step);
 		}
 
-		if(i*2 >= ms->databytes)
+		if(perbyte)
 		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = (const uint16_t *)ms->payload;
-			i = 0;
+			i++;
 		}
-	}
-
-	ms->readposition = i*2;
-
-	return nsamp - nblank;
-}
-
-static int vdif_complex_decode_4channel_16bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const uint16_t *buf;
-	int o, i, j;
-	int nblank = 0;
-
-	buf = (const uint16_t *)ms->payload;
-	i = ms->readposition/2;
-
-	for(o = 0; o < nsamp; o++)
-	{
-		if(i*2 >= ms->blankzoneendvalid[0])
+		else if(step % 8 == 0)
 		{
-		  for (j=0; j<4; j++) {
-			data[j][o] = complex_zeros[0];
-			nblank++;
-		  }
+			i += step/8;
 		}
 		else
 		{
-		  for (j=0; j<4; j++) {
-		        data[j][o] = ((int16_t)(buf[i]^0x8000) + (int16_t)(buf[i+1]^0x8000)*I)/8.0;  // Assume RMS==8
-			i+=2;
-		  }
+			b += step;
+			i += b >> 3;
+			b &= 7;
 		}
 
-		if(i*2 >= ms->databytes)
+		if(i >= ms->databytes)
 		{
 			if(mark5_stream_next_frame(ms) < 0)
 			{
 				return -1;
 			}
-			buf = (const uint16_t *)ms->payload;
+			buf = ms->payload;
 			i = 0;
 		}
 	}
 
-	ms->readposition = i*2;
+	ms->readposition = i;
 
 	return nsamp - nblank;
 }
 
-static int vdif_complex_decode_8channel_16bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
-{
-	const uint16_t *buf;
-	int o, i, j;
-	int nblank = 0;
+#define VDIF_DECODER(nchan, nbit) \
+static int vdif_decode_##nchan##channel_##nbit##bit_decimation1(struct mark5_stream *ms, int nsamp, float **data) \
+{ \
+	return vdif_decode_body(ms, nsamp, data, nchan, nbit, 0, 1); \
+}
+
+#define VDIF_COMPLEX_DECODER(nchan, nbit) \
+static int vdif_complex_decode_##nchan##channel_##nbit##bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data) \
+{ \
+	return vdif_decode_body(ms, nsamp, (float **)data, nchan, nbit, 1, 1); \
+}
+
+#define VDIF_GENERIC_DECODERS(nbit) \
+static int vdif_decode_nchannel_##nbit##bit(struct mark5_stream *ms, int nsamp, float **data) \
+{ \
+	return vdif_decode_body(ms, nsamp, data, ms->nchan, nbit, 0, ms->decimation); \
+} \
+static int vdif_complex_decode_nchannel_##nbit##bit(struct mark5_stream *ms, int nsamp, float complex **data) \
+{ \
+	return vdif_decode_body(ms, nsamp, (float **)data, ms->nchan, nbit, 1, ms->decimation); \
+}
+
+/* (nchan, nbit) with their own decimation 1 decoder */
+#define VDIF_REAL_SHAPES(X) \
+	X(1, 1) X(2, 1) X(3, 1) X(4, 1) X(5, 1) X(6, 1) X(7, 1) X(8, 1) X(16, 1) X(32, 1) X(64, 1) \
+	X(1, 2) X(2, 2) X(3, 2) X(4, 2) X(5, 2) X(6, 2) X(7, 2) X(8, 2) X(16, 2) X(32, 2) X(64, 2) \
+	X(1, 4) X(2, 4) X(3, 4) X(4, 4) X(5, 4) X(6, 4) X(7, 4) X(8, 4) X(16, 4) X(32, 4) \
+	X(1, 8) X(2, 8) X(3, 8) X(4, 8) X(8, 8) X(16, 8) \
+	X(1, 16) X(2, 16) X(4, 16) X(8, 16) \
+	X(1, 32)
+
+#define VDIF_COMPLEX_SHAPES(X) \
+	X(1, 1) X(2, 1) X(4, 1) X(8, 1) X(16, 1) X(32, 1) \
+	X(1, 2) X(2, 2) X(4, 2) X(8, 2) X(16, 2) X(32, 2) X(64, 2) \
+	X(1, 4) X(2, 4) X(4, 4) X(8, 4) X(16, 4) \
+	X(1, 8) X(2, 8) X(4, 8) X(8, 8) X(16, 8) \
+	X(1, 16) X(2, 16) X(4, 16) X(8, 16) X(16, 16) \
+	X(1, 32)
+
+VDIF_REAL_SHAPES(VDIF_DECODER)
+VDIF_COMPLEX_SHAPES(VDIF_COMPLEX_DECODER)
+VDIF_GENERIC_DECODERS(1)
+VDIF_GENERIC_DECODERS(2)
+VDIF_GENERIC_DECODERS(4)
+VDIF_GENERIC_DECODERS(8)
+VDIF_GENERIC_DECODERS(16)
+VDIF_GENERIC_DECODERS(32)
+
+/* Decoders for any number of channels whose (decimated) slots are whole
+ * 32-bit words, e.g., 12, 24 or 96 channels of 2 bits.  The words are
+ * unpacked whole, with the positions of all of their values known at
+ * compile time; only the last, partly used word of a slot is checked value
+ * by value.
+ */
 
-	buf = (const uint16_t*)ms->payload;
-	i = ms->readposition/2;
+static inline __attribute__((always_inline)) void vdif_unpack_words(const unsigned char * restrict src, float **data, int o,
+	const int nvalue, const int nbit, const int nval)
+{
+	const int perword = 32/nbit;
+	float **d;
+	int w, v;
 
-	for(o = 0; o < nsamp; o++)
+	for(w = 0; w < nvalue/perword; ++w)
 	{
-		if(i*2 >= ms->blankzoneendvalid[0])
-		{
-		  for (j=0; j<8; j++) {
-			data[j][o] = complex_zeros[0];
-			nblank++;
-		  }
-		}
-		else
+		d = data + w*(perword/nval);
+#pragma GCC unroll 32
+		for(v = 0; v < perword; ++v)
 		{
-		  for (j=0; j<8; j++) {
-		        data[j][o] = ((int16_t)(buf[i]^0x8000) + (int16_t)(buf[i+1]^0x8000)*I)/8.0;  // Assume RMS==8
-			i+=2;
-		  }
+			d[v/nval][nval*o + v%nval] = vdif_value(src + 4*w, v*nbit, nbit);
 		}
-
-		if(i*2 >= ms->databytes)
+	}
+	if(w*perword < nvalue)
+	{
+		d = data + w*(perword/nval);
+#pragma GCC unroll 32
+		for(v = 0; v < perword; ++v)
 		{
-			if(mark5_stream_next_frame(ms) < 0)
+			if(w*perword + v < nvalue)
 			{
-				return -1;
+				d[v/nval][nval*o + v%nval] = vdif_value(src + 4*w, v*nbit, nbit);
 			}
-			buf = (const uint16_t *)ms->payload;
-			i = 0;
 		}
 	}
-
-	ms->readposition = i*2;
-
-	return nsamp - nblank;
 }
 
-static int vdif_complex_decode_16channel_16bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
+static inline __attribute__((always_inline)) int vdif_decode_words_body(struct mark5_stream *ms, int nsamp, float **data, const int nbit, const int iscomplex)
 {
-	const uint16_t *buf;
-	int o, i, j;
+	const int nval = iscomplex ? 2 : 1;
+	const int nvalue = nval*ms->nchan;
+	const int step = vdif_slotbits(ms->nchan, nbit, iscomplex)*ms->decimation/8;	/* bytes from one sample to the next */
+	const unsigned char *buf;
+	int o, i, m;
 	int nblank = 0;
 
-	buf = (const uint16_t *)ms->payload;
-	i = ms->readposition/2;
+	buf = ms->payload;
+	i = ms->readposition;
 
 	for(o = 0; o < nsamp; o++)
 	{
-		if(i*2 >= ms->blankzoneendvalid[0])
+		if(i >= ms->blankzoneendvalid[0])
 		{
-		  for (j=0; j<16; j++) {
-			data[j][o] = complex_zeros[0];
+			for(m = 0; m < nvalue; m++)
+			{
+				data[m/nval][nval*o + m%nval] = 0.0;
+			}
 			nblank++;
-		  }
 		}
 		else
 		{
-		  for (j=0; j<16; j++) {
-		        data[j][o] = ((int16_t)(buf[i]^0x8000) + (int16_t)(buf[i+1]^0x8000)*I)/8.0;  // Assume RMS==8
-			i+=2;
-		  }
+			vdif_unpack_words(buf + i, data, o, nvalue, nbit, nval);
 		}
 
-		if(i*2 >= ms->databytes)
+		i += step;
+
+		if(i >= ms->databytes)
 		{
 			if(mark5_stream_next_frame(ms) < 0)
 			{
 				return -1;
 			}
-			buf = (const uint16_t *)ms->payload;
+			buf = ms->payload;
 			i = 0;
 		}
 	}
 
-	ms->readposition = i*2;
+	ms->readposition = i;
 
 	return nsamp - nblank;
 }
 
-static int vdif_complex_decode_1channel_32bit_decimation1(struct mark5_stream *ms, int nsamp, float complex **data)
+#define VDIF_WORD_DECODERS(nbit) \
+static int vdif_decode_words_##nbit##bit(struct mark5_stream *ms, int nsamp, float **data) \
+{ \
+	return vdif_decode_words_body(ms, nsamp, data, nbit, 0); \
+} \
+static int vdif_complex_decode_words_##nbit##bit(struct mark5_stream *ms, int nsamp, float complex **data) \
+{ \
+	return vdif_decode_words_body(ms, nsamp, (float **)data, nbit, 1); \
+}
+
+VDIF_WORD_DECODERS(1)
+VDIF_WORD_DECODERS(2)
+VDIF_WORD_DECODERS(4)
+VDIF_WORD_DECODERS(8)
+VDIF_WORD_DECODERS(16)
+
+struct vdif_decoder
 {
-	const float *buf;
-	int o, i;
-	int nblank = 0;
+	int nchan, nbit;
+	decodeFunc decode;
+	complex_decodeFunc complex_decode;
+};
 
-	buf = (const float *)ms->payload;
-	i = ms->readposition/4;
+#define VDIF_DECODER_ENTRY(nchan, nbit) { nchan, nbit, vdif_decode_##nchan##channel_##nbit##bit_decimation1, 0 },
+#define VDIF_COMPLEX_DECODER_ENTRY(nchan, nbit) { nchan, nbit, 0, vdif_complex_decode_##nchan##channel_##nbit##bit_decimation1 },
 
-	for(o = 0; o < nsamp; o++)
+static const struct vdif_decoder vdifdecoders[] =
+{
+	VDIF_REAL_SHAPES(VDIF_DECODER_ENTRY)
+	VDIF_COMPLEX_SHAPES(VDIF_COMPLEX_DECODER_ENTRY)
+	{ 0, 1, vdif_decode_nchannel_1bit, vdif_complex_decode_nchannel_1bit },
+	{ 0, 2, vdif_decode_nchannel_2bit, vdif_complex_decode_nchannel_2bit },
+	{ 0, 4, vdif_decode_nchannel_4bit, vdif_complex_decode_nchannel_4bit },
+	{ 0, 8, vdif_decode_nchannel_8bit, vdif_complex_decode_nchannel_8bit },
+	{ 0, 16, vdif_decode_nchannel_16bit, vdif_complex_decode_nchannel_16bit },
+	{ 0, 32, vdif_decode_nchannel_32bit, vdif_complex_decode_nchannel_32bit }
+};
+
+/* the decoder for this shape: a specialized one if listed above, else one for
+ * slots of whole words if possible, else the generic one for its nbit.
+ */
+static void vdif_find_decoder(int nchan, int nbit, int decimation, int iscomplex, decodeFunc *decode, complex_decodeFunc *complex_decode)
+{
+	int k;
+
+	*decode = 0;
+	*complex_decode = 0;
+	for(k = 0; k < (int)(sizeof(vdifdecoders)/sizeof(vdifdecoders[0])); ++k)
 	{
-		if(i*4 >= ms->blankzoneendvalid[0])
+		const struct vdif_decoder *d = vdifdecoders + k;
+
+		if(d->nbit != nbit || (d->nchan != 0 && (d->nchan != nchan || decimation != 1)))
 		{
-			data[0][o] = complex_zeros[0];
-			nblank++;
+			continue;
 		}
-		else
+		if(iscomplex ? d->complex_decode == 0 : d->decode == 0)
 		{
-#ifdef WORDS_BIGENDIAN
-			uint32_t re = *((const uint32_t*)buf + i);
-			uint32_t im = *((const uint32_t*)buf + i + 1);
-			re = le32toh(re);
-			im = le32toh(im);
-			data[0][o] = *((float*)&re) + *((float*)&im)*I;
-#else
-			data[0][o] = buf[i] + buf[i+1]*I;
-#endif
+			continue;
 		}
-
-		i += 2;
-
-
-		if(i*4 >= ms->databytes)
+		if(d->nchan == 0 && nbit <= 16 && (vdif_slotbits(nchan, nbit, iscomplex) % 32) == 0)
 		{
-			if(mark5_stream_next_frame(ms) < 0)
-			{
-				return -1;
-			}
-			buf = (const float *)ms->payload;
-			i = 0;
+			break;
 		}
-	}
+		*decode = iscomplex ? 0 : d->decode;
+		*complex_decode = iscomplex ? d->complex_decode : 0;
 
-	ms->readposition = i*4;
+		return;
+	}
 
-	return nsamp - nblank;
+	/* slots of whole words */
+	switch(nbit)
+	{
+	case 1:
+		*decode = vdif_decode_words_1bit;
+		*complex_decode = vdif_complex_decode_words_1bit;
+		break;
+	case 2:
+		*decode = vdif_decode_words_2bit;
+		*complex_decode = vdif_complex_decode_words_2bit;
+		break;
+	case 4:
+		*decode = vdif_decode_words_4bit;
+		*complex_decode = vdif_complex_decode_words_4bit;
+		break;
+	case 8:
+		*decode = vdif_decode_words_8bit;
+		*complex_decode = vdif_complex_decode_words_8bit;
+		break;
+	case 16:
+		*decode = vdif_decode_words_16bit;
+		*complex_decode = vdif_complex_decode_words_16bit;
+		break;
+	}
+	if(iscomplex)
+	{
+		*decode = 0;
+	}
+	else
+	{
+		*complex_decode = 0;
+	}
 }
 
-/* Other decoders go here */
-
 /************************ 2-bit state counters *********************/
 /* Note: these only count high vs. low states, not full state counts */
 
@@ -3759,20 +1020,267 @@ static int vdif_count_64channel_2bit_decimation1(struct mark5_stream *ms, int ns
 			highstates[63] += fpF[3];
 		}
 
-		if(i >= ms->databytes)
+		if(i >= ms->databytes)
+		{
+			if(mark5_stream_next_frame(ms) < 0)
+			{
+				return -1;
+			}
+			buf = ms->payload;
+			i = 0;
+		}
+	}
+
+	ms->readposition = i;
+
+	return nsamp - nblank;
+}
+
+/* Any number of channels in slots of whole bytes, any decimation */
+static int vdif_count_nchannel_2bit(struct mark5_stream *ms, int nsamp, unsigned int *highstates)
+{
+	const int nchan = ms->nchan;
+	const int step = vdif_slotbits(nchan, 2, 0)*ms->decimation/8;	/* bytes from one sample to the next */
+	const unsigned char *buf;
+	const unsigned char *fp;
+	int o, i, k, c;
+	int nblank = 0;
+
+	buf = ms->payload;
+	i = ms->readposition;
+
+	for(o = 0; o < nsamp; o++)
+	{
+		if(i >= ms->blankzoneendvalid[0])
+		{
+			nblank++;
+		}
+		else
+		{
+			for(k = 0; k < nchan/4; k++)
+			{
+				fp = countlut2bit[buf[i+k]];
+				highstates[4*k] += fp[0];
+				highstates[4*k+1] += fp[1];
+				highstates[4*k+2] += fp[2];
+				highstates[4*k+3] += fp[3];
+			}
+			if(nchan % 4)
+			{
+				fp = countlut2bit[buf[i+k]];
+				for(c = 4*k; c < nchan; c++)
+				{
+					highstates[c] += fp[c - 4*k];
+				}
+			}
+		}
+
+		i += step;
+
+		if(i >= ms->databytes)
+		{
+			if(mark5_stream_next_frame(ms) < 0)
+			{
+				return -1;
+			}
+			buf = ms->payload;
+			i = 0;
+		}
+	}
+
+	ms->readposition = i;
+
+	return nsamp - nblank;
+}
+
+/*************** lookup table decoders with channel validity ***************/
+
+/* The lookup table decoders unpack every channel, so calls are split at
+ * frame boundaries and the channels missing from each frame (VDIF EDV4,
+ * see ms->chanmissing) zeroed once that frame is decoded.  The counters
+ * likewise drop the counts of those channels.
+ */
+static int vdif_samples_left_in_frame(const struct mark5_stream *ms, int nsamp)
+{
+	int left;
+
+	left = (int)((long long)(ms->databytes - ms->readposition)*ms->framesamples/ms->databytes);
+
+	return (left > 0 && left < nsamp) ? left : nsamp;
+}
+
+static int vdif_decode_lut(struct mark5_stream *ms, int nsamp, float **data)
+{
+	const struct mark5_format_vdif *v = (const struct mark5_format_vdif *)(ms->formatdata);
+	float *d[MARK5_MAXMASKCHAN];
+	uint64_t missing;
+	int o, n, r, c;
+	int nvalid = 0;
+
+	if(ms->nchan > MARK5_MAXMASKCHAN)
+	{
+		return v->lutdecode(ms, nsamp, data);
+	}
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		n = vdif_samples_left_in_frame(ms, nsamp - o);
+		missing = ms->chanmissing;
+		for(c = 0; c < ms->nchan; ++c)
+		{
+			d[c] = data[c] + o;
+		}
+
+		r = v->lutdecode(ms, n, d);
+		if(r < 0)
+		{
+			return r;
+		}
+		nvalid += r;
+
+		for(c = 0; missing && c < ms->nchan; ++c)
+		{
+			if((missing >> c) & 1)
+			{
+				memset(d[c], 0, n*sizeof(float));
+				ms->chaninvalid[c] += r;
+			}
+		}
+	}
+
+	return nvalid;
+}
+
+static int vdif_complex_decode_lut(struct mark5_stream *ms, int nsamp, float complex **data)
+{
+	const struct mark5_format_vdif *v = (const struct mark5_format_vdif *)(ms->formatdata);
+	float complex *d[MARK5_MAXMASKCHAN];
+	uint64_t missing;
+	int o, n, r, c;
+	int nvalid = 0;
+
+	if(ms->nchan > MARK5_MAXMASKCHAN)
+	{
+		return v->lutcomplexdecode(ms, nsamp, data);
+	}
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		n = vdif_samples_left_in_frame(ms, nsamp - o);
+		missing = ms->chanmissing;
+		for(c = 0; c < ms->nchan; ++c)
+		{
+			d[c] = data[c] + o;
+		}
+
+		r = v->lutcomplexdecode(ms, n, d);
+		if(r < 0)
+		{
+			return r;
+		}
+		nvalid += r;
+
+		for(c = 0; missing && c < ms->nchan; ++c)
+		{
+			if((missing >> c) & 1)
+			{
+				memset(d[c], 0, n*sizeof(float complex));
+				ms->chaninvalid[c] += r;
+			}
+		}
+	}
+
+	return nvalid;
+}
+
+static int vdif_count_lut(struct mark5_stream *ms, int nsamp, unsigned int *highstates)
+{
+	const struct mark5_format_vdif *v = (const struct mark5_format_vdif *)(ms->formatdata);
+	unsigned int h[MARK5_MAXMASKCHAN];
+	uint64_t missing;
+	int o, n, r, c;
+	int nvalid = 0;
+
+	if(ms->nchan > MARK5_MAXMASKCHAN)
+	{
+		return v->lutcount(ms, nsamp, highstates);
+	}
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		n = vdif_samples_left_in_frame(ms, nsamp - o);
+		missing = ms->chanmissing;
+		if(!missing)
+		{
+			r = v->lutcount(ms, n, highstates);
+			if(r < 0)
+			{
+				return r;
+			}
+			nvalid += r;
+
+			continue;
+		}
+
+		/* missing channels count as invalid rather than as data */
+		memset(h, 0, ms->nchan*sizeof(unsigned int));
+		r = v->lutcount(ms, n, h);
+		if(r < 0)
 		{
-			if(mark5_stream_next_frame(ms) < 0)
+			return r;
+		}
+		nvalid += r;
+
+		for(c = 0; c < ms->nchan; ++c)
+		{
+			if((missing >> c) & 1)
 			{
-				return -1;
+				ms->chaninvalid[c] += r;
+			}
+			else
+			{
+				highstates[c] += h[c];
 			}
-			buf = ms->payload;
-			i = 0;
 		}
 	}
 
-	ms->readposition = i;
+	return nvalid;
+}
 
-	return nsamp - nblank;
+/******************** vectorized decode routines *******************/
+
+/* Decode 1, 2 and 4 bit data of any shape whose decimated samples fill
+ * whole units of up to 16 bytes, and count 2 bit high states, using the
+ * kernels chosen for this cpu.
+ */
+static int vdif_decode_simd(struct mark5_stream *ms, int nsamp, float **data)
+{
+	return mark5_simd_decode_stream(ms, &((const struct mark5_format_vdif *)(ms->formatdata))->simd, 0, nsamp, data);
+}
+
+/* complex data are decoded as real and imaginary values of each channel in turn */
+static int vdif_complex_decode_simd(struct mark5_stream *ms, int nsamp, float complex **data)
+{
+	int n;
+
+	n = mark5_simd_decode_stream(ms, &((const struct mark5_format_vdif *)(ms->formatdata))->simd, 0, 2*nsamp, (float **)data);
+
+	return n < 0 ? n : n/2;
+}
+
+static int vdif_decode_channels_simd(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data)
+{
+	return mark5_simd_decode_channels_stream(ms, &((const struct mark5_format_vdif *)(ms->formatdata))->simd, 0, nsamp, chanlist, nsel, data);
+}
+
+static int vdif_stats_simd(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats)
+{
+	return mark5_simd_stats_stream(ms, &((const struct mark5_format_vdif *)(ms->formatdata))->simd, 0, nsamp, stats);
+}
+
+static int vdif_count_simd(struct mark5_stream *ms, int nsamp, unsigned int *highstates)
+{
+	return mark5_simd_count_stream(ms, &((const struct mark5_format_vdif *)(ms->formatdata))->simd, 0, nsamp, highstates);
 }
 
 /******************************************************************/
@@ -3819,6 +1327,7 @@ static int mark5_format_vdif_init(struct mark5_stream *ms)
 	const unsigned char *headerbytes;
 	unsigned char bitspersample;
 	int dataframelength;
+	int step;	/* bits from one decoded sample to the next */
 	double dns;
 
 	if(!ms)
@@ -3841,14 +1350,11 @@ static int mark5_format_vdif_init(struct mark5_stream *ms)
 	ms->framebytes = f->databytesperpacket + f->frameheadersize;
 	ms->blanker = blanker_vdif;
 
-	/* FIXME: if nbit is not a power of 2, this formula breaks down! */
-	ms->samplegranularity = 8/(ms->nchan*bitspersample*ms->decimation);
-	if(ms->samplegranularity <= 0)
-	{
-		ms->samplegranularity = 1;
-	}
+	/* decoders stop only at byte boundaries */
+	step = vdif_slotbits(ms->nchan, ms->nbit, ms->iscomplex)*ms->decimation;
+	for(ms->samplegranularity = 1; (ms->samplegranularity*step) % 8 != 0; ms->samplegranularity++);
 	
-	ms->framesamples = ms->databytes*8/(ms->nchan*bitspersample*ms->decimation);
+	ms->framesamples = ms->databytes*8/step;
 
 	// Don't think these are needed..... CJP
         f->completesamplesperword = 32/(bitspersample*ms->nchan);
@@ -3960,7 +1466,7 @@ static int mark5_format_vdif_init(struct mark5_stream *ms)
 		ms->payloadoffset = f->frameheadersize;
 		ms->databytes = f->databytesperpacket;
 		ms->framebytes = f->databytesperpacket + f->frameheadersize;
-		ms->framesamples = ms->databytes*8/(ms->nchan*bitspersample*ms->decimation);
+		ms->framesamples = ms->databytes*8/step;
 		
 		/* get time again so ms->framens is used */
 		ms->gettime(ms, &ms->mjd, &ms->sec, &dns);
@@ -3969,6 +1475,13 @@ static int mark5_format_vdif_init(struct mark5_stream *ms)
 		/* WRITEME */
 	}
 
+	if(((int64_t)ms->databytes*8) % step != 0)
+	{
+		fprintf(m5stderr, "Error: mark5_format_vdif_init: %d byte frames do not hold a whole number of samples at decimation %d\n", ms->databytes, ms->decimation);
+
+		return -1;
+	}
+
 	ms->gframens = (int)(ms->framegranularity*ms->framens + 0.5);
 
 	if(f->frameheadersize == 32)
@@ -4091,7 +1604,6 @@ struct mark5_format_generic *new_mark5_format_generalized_vdif(int framesperperi
 	static int first = 1;
 	struct mark5_format_generic *f;
 	struct mark5_format_vdif *v;
-	int decoderindex = 0;
 
 	if(first)
 	{
@@ -4099,42 +1611,14 @@ struct mark5_format_generic *new_mark5_format_generalized_vdif(int framesperperi
 		first = 0;
 	}
 
-	if(decimation == 1) /* inc by 1024 for each successive value to allow full range of nchan and nbit */
+	if(decimation < 1)
 	{
-		decoderindex += 0;
-	}
-	else
-	{
-		fprintf(m5stderr, "VDIF decimation must be 1 for now\n");
-		
+		fprintf(m5stderr, "VDIF decimation must be >= 1\n");
+
 		return 0;
 	}
 
-	if(nbit == 1) /* inc by 1000 for each successive value to allow full range of nchan */
-	{
-		decoderindex += 0;
-	}
-	else if(nbit == 2)
-	{
-		decoderindex += 1000;
-	}
-	else if(nbit == 4)
-	{
-		decoderindex += 2000;
-	}
-	else if(nbit == 8)
-	{
-		decoderindex += 3000;
-	}
-	else if(nbit == 16)
-	{
-		decoderindex += 4000;
-	}
-	else if(nbit == 32)
-	{
-		decoderindex += 5000;
-	}
-	else
+	if(nbit != 1 && nbit != 2 && nbit != 4 && nbit != 8 && nbit != 16 && nbit != 32)
 	{
 		fprintf(m5stderr, "VDIF nbit must be 1, 2, 4, 8, 16 or 32 for now\n");
 		
@@ -4148,8 +1632,6 @@ struct mark5_format_generic *new_mark5_format_generalized_vdif(int framesperperi
 		return 0;
 	}
 
-	decoderindex += nchan;
-
 	v = (struct mark5_format_vdif *)calloc(1, sizeof(struct mark5_format_vdif));
 	f = (struct mark5_format_generic *)calloc(1, sizeof(struct mark5_format_generic));
 
@@ -4176,233 +1658,99 @@ struct mark5_format_generic *new_mark5_format_generalized_vdif(int framesperperi
 	f->complex_decode = 0;
 	f->count = 0;
 
-	if(!usecomplex) 
+	vdif_find_decoder(nchan, nbit, decimation, usecomplex, &v->lutdecode, &v->lutcomplexdecode);
+	if(v->lutdecode)
 	{
-	    switch(decoderindex)
-	    {
-	        case 1:
-			f->decode = vdif_decode_1channel_1bit_decimation1;
-			break;
-		case 2:
-			f->decode = vdif_decode_2channel_1bit_decimation1;
-			break;
-		case 3:
-			f->decode = vdif_decode_3channel_1bit_decimation1;
-			break;
-		case 4:
-			f->decode = vdif_decode_4channel_1bit_decimation1;
-			break;
-		case 5:
-			f->decode = vdif_decode_5channel_1bit_decimation1;
-			break;
-		case 6:
-			f->decode = vdif_decode_6channel_1bit_decimation1;
-			break;
-		case 7:
-			f->decode = vdif_decode_7channel_1bit_decimation1;
-			break;
-		case 8:
-			f->decode = vdif_decode_8channel_1bit_decimation1;
-			break;
-		case 16:
-			f->decode = vdif_decode_16channel_1bit_decimation1;
-			break;
-	        case 32:
-			f->decode = vdif_decode_32channel_1bit_decimation1;
-			break;
-
-		case 1001:
-			f->decode = vdif_decode_1channel_2bit_decimation1;
+		f->decode = vdif_decode_lut;
+	}
+	if(v->lutcomplexdecode)
+	{
+		f->complex_decode = vdif_complex_decode_lut;
+	}
+	if(usecomplex)
+	{
+		f->iscomplex = 1;
+	}
+	else if(decimation == 1)
+	{
+		switch(nchan*(nbit == 2))
+		{
+		case 1:
 			f->count = vdif_count_1channel_2bit_decimation1;
 			break;
-		case 1002:
-			f->decode = vdif_decode_2channel_2bit_decimation1;
+		case 2:
 			f->count = vdif_count_2channel_2bit_decimation1;
 			break;
-		case 1003:
-			f->decode = vdif_decode_3channel_2bit_decimation1;
-			break;
-		case 1004:
-			f->decode = vdif_decode_4channel_2bit_decimation1;
+		case 4:
 			f->count = vdif_count_4channel_2bit_decimation1;
 			break;
-		case 1005:
-			f->decode = vdif_decode_5channel_2bit_decimation1;
-			break;
-		case 1006:
-			f->decode = vdif_decode_6channel_2bit_decimation1;
-			break;
-		case 1007:
-			f->decode = vdif_decode_7channel_2bit_decimation1;
-			break;
-		case 1008:
-			f->decode = vdif_decode_8channel_2bit_decimation1;
+		case 8:
 			f->count = vdif_count_8channel_2bit_decimation1;
 			break;
-		case 1016:
-			f->decode = vdif_decode_16channel_2bit_decimation1;
+		case 16:
 			f->count = vdif_count_16channel_2bit_decimation1;
 			break;
-		case 1032:
-			f->decode = vdif_decode_32channel_2bit_decimation1;
+		case 32:
 			f->count = vdif_count_32channel_2bit_decimation1;
 			break;
-		case 1064:
-			f->decode = vdif_decode_64channel_2bit_decimation1;
+		case 64:
 			f->count = vdif_count_64channel_2bit_decimation1;
 			break;
-
-		case 2001:
-			f->decode = vdif_decode_1channel_4bit_decimation1;
-			break;
-		case 2002:
-			f->decode = vdif_decode_2channel_4bit_decimation1;
-			break;
-		case 2003:
-			f->decode = vdif_decode_3channel_4bit_decimation1;
-			break;
-		case 2004:
-			f->decode = vdif_decode_4channel_4bit_decimation1;
-			break;
-		case 2005:
-			f->decode = vdif_decode_5channel_4bit_decimation1;
-			break;
-		case 2006:
-			f->decode = vdif_decode_6channel_4bit_decimation1;
-			break;
-		case 2007:
-			f->decode = vdif_decode_7channel_4bit_decimation1;
-			break;
-		case 2008:
-			f->decode = vdif_decode_8channel_4bit_decimation1;
-			break;
-
-		case 3001:
-			f->decode = vdif_decode_1channel_8bit_decimation1;
-			break;
-		case 3002:
-			f->decode = vdif_decode_2channel_8bit_decimation1;
-			break;
-		case 3003:
-			f->decode = vdif_decode_3channel_8bit_decimation1;
-			break;
-		case 3004:
-			f->decode = vdif_decode_4channel_8bit_decimation1;
-			break;
-
-		case 5001:
-			f->decode = vdif_decode_1channel_32bit_decimation1;
-			break;
-	    }
-
-	    if(f->decode == 0)
-	    {
-		fprintf(m5stderr, "VDIF: Unsupported combination decimation=%d, channels=%d and bits=%d\n", decimation, nchan, nbit);
-		free(v);
-		free(f);
-		
-		return 0;
-	    }
+		}
 	}
-	else
+	if(!usecomplex && nbit == 2 && f->count == 0 && vdif_slotbits(nchan, nbit, 0)*decimation % 8 == 0)
 	{
-	  f->iscomplex = 1;
-	  switch(decoderindex)
-	    {
-	        case 1:
-			f->complex_decode = vdif_complex_decode_1channel_1bit_decimation1;
-			break;
-		case 2:
-			f->complex_decode = vdif_complex_decode_2channel_1bit_decimation1;
-			break;
-		case 4:
-			f->complex_decode = vdif_complex_decode_4channel_1bit_decimation1;
-			break;
-		case 8:
-			f->complex_decode = vdif_complex_decode_8channel_1bit_decimation1;
-			break;
-		case 16:
-			f->complex_decode = vdif_complex_decode_16channel_1bit_decimation1;
-			break;
-
-		case 1001:
-			f->complex_decode = vdif_complex_decode_1channel_2bit_decimation1;
-			break;
-		case 1002:
-			f->complex_decode = vdif_complex_decode_2channel_2bit_decimation1;
-			break;
-		case 1004:
-			f->complex_decode = vdif_complex_decode_4channel_2bit_decimation1;
-			break;
-		case 1008:
-			f->complex_decode = vdif_complex_decode_8channel_2bit_decimation1;
-			break;
-		case 1016:
-			f->complex_decode = vdif_complex_decode_16channel_2bit_decimation1;
-			break;
-		case 1032:
-			f->complex_decode = vdif_complex_decode_32channel_2bit_decimation1;
-			break;
-		case 1064:
-			f->complex_decode = vdif_complex_decode_64channel_2bit_decimation1;
-			break;
-
-		case 2001:
-			f->complex_decode = vdif_complex_decode_1channel_4bit_decimation1;
-			break;
-		case 2002:
-			f->complex_decode = vdif_complex_decode_2channel_4bit_decimation1;
-			break;
-		case 2004:
-			f->complex_decode = vdif_complex_decode_4channel_4bit_decimation1;
-			break;
-
-		case 3001:
-			f->complex_decode = vdif_complex_decode_1channel_8bit_decimation1;
-			break;
-		case 3002:
-			f->complex_decode = vdif_complex_decode_2channel_8bit_decimation1;
-			break;
-		case 3004:
-			f->complex_decode = vdif_complex_decode_4channel_8bit_decimation1;
-			break;
-		case 3008:
-			f->complex_decode = vdif_complex_decode_8channel_8bit_decimation1;
-			break;
-		case 3016:
-			f->complex_decode = vdif_complex_decode_16channel_8bit_decimation1;
-			break;
-
-		case 4001:
-			f->complex_decode = vdif_complex_decode_1channel_16bit_decimation1;
-			break;
-		case 4002:
-			f->complex_decode = vdif_complex_decode_2channel_16bit_decimation1;
-			break;
-		case 4004:
-			f->complex_decode = vdif_complex_decode_4channel_16bit_decimation1;
-			break;
-		case 4008:
-			f->complex_decode = vdif_complex_decode_8channel_16bit_decimation1;
-			break;
-		case 4016:
-			f->complex_decode = vdif_complex_decode_16channel_16bit_decimation1;
-			break;
-
-		case 5001:
-			f->complex_decode = vdif_complex_decode_1channel_32bit_decimation1;
-			break;
-	    }
-
-	    if(f->complex_decode == 0)
-	    {
-		fprintf(m5stderr, "VDIF: Unsupported combination decimation=%d, channels=%d and bits=%d\n", decimation, nchan, nbit);
-		free(v);
-		free(f);
+		f->count = vdif_count_nchannel_2bit;
+	}
+	if(f->count)
+	{
+		v->lutcount = f->count;
+		f->count = vdif_count_lut;
+	}
 
-		return 0;
-	    }
+	/* Use the vector unpacker when the cpu (and M5A_OPT_SIMDLEVEL) allows.
+	 * Bit layouts match the decoders above.
+	 */
+	if(nbit <= 4)
+	{
+		float levels[16];
+		int l;
 
+		for(l = 0; l < (1 << nbit); ++l)
+		{
+			if(nbit == 1)
+			{
+				levels[l] = lut1bit[l][0];
+			}
+			else if(nbit == 2)
+			{
+				levels[l] = lut2bit[l][0];
+			}
+			else
+			{
+				levels[l] = lut4bit[l][0];
+			}
+		}
+		if(mark5_simd_layout_init(&v->simd, nbit, nchan, vdif_slotbits(nchan, nbit, usecomplex), decimation, usecomplex, levels) == 0)
+		{
+			if(usecomplex)
+			{
+				f->complex_decode = vdif_complex_decode_simd;
+			}
+			else
+			{
+				f->decode = vdif_decode_simd;
+				f->decode_channels = vdif_decode_channels_simd;
+			}
+		}
+		if(!usecomplex && mark5_simd_stats_supported(&v->simd))
+		{
+			f->accumulate_stats = vdif_stats_simd;
+		}
+		if(v->simd.counter)
+		{
+			f->count = vdif_count_simd;
+		}
 	}
 
 	return f;
@@ -4474,130 +1822,169 @@ static int is_legal_vdifl_framesize(int framesize)
 	}
 }
 
-/* if *framesize is set to 0, the frame size will be determined by this call
- * and returned into the same variable.
- *
- * return value is -1 on error (no VDIF found) or 0 if found.
- *
- * here framesize includes the 32 byte header
+#define VDIF_FRAME_CONFIRM	8	/* most frames after a candidate checked by the frame finders */
+
+/* Returns how many of the up to VDIF_FRAME_CONFIRM frames of fs bytes
+ * following the one at offset have, in a row, headers agreeing with it: same
+ * frame length, reference epoch and legacy bit, and seconds the same or one
+ * more than in the frame before.
  */
-int find_vdif_frame(const unsigned char *data, size_t length, size_t *offset, int *framesize)
+static int confirm_vdif_frame(const unsigned char *data, size_t length, size_t offset, int fs, int headerbytes)
 {
-	int fs, fs0, fs1;
-
-	if(framesize && *framesize)
-	{
-		fs0 = fs1 = *framesize;
-	}
-	else
-	{
-		fs0 = 40;
-		fs1 = 8232;
-	}
+	const unsigned int *A, *B;
+	int k;
 
-	for(fs = fs0; fs <= fs1; ++fs)
+	A = (const unsigned int *)(data + offset);
+	for(k = 0; k < VDIF_FRAME_CONFIRM; ++k)
 	{
-		size_t maxOffset;
-
-		if(!is_legal_vdif_framesize(fs))
-		{
-			continue;
-		}
+		unsigned int secA, secB;
 
-		maxOffset = 5*fs;	/* check over a maximum of 5 frame lengths */
-		if(maxOffset > length - fs - 32)
+		offset += fs;
+		if(offset + headerbytes > length)
 		{
-			maxOffset = length - fs - 32;
+			break;
 		}
-
-		for(*offset = 0; *offset < maxOffset; *offset += 8)
+		B = (const unsigned int *)(data + offset);
+		secA = A[0] & 0x3FFFFFFF;
+		secB = B[0] & 0x3FFFFFFF;
+		if(((A[2] ^ B[2]) & 0x00FFFFFF) != 0 ||
+		   ((A[1] ^ B[1]) & 0x3F000000) != 0 ||
+		   ((A[0] ^ B[0]) & 0x40000000) != 0 ||
+		   (secB != secA && secB != secA + 1))
 		{
-			unsigned int secA, secB;
-			unsigned int refEpochA, refEpochB;
-			unsigned int fsA, fsB;
-			const unsigned int *frame;
-
-			frame = ((unsigned int *)data) + *offset/4;
-			secA      = frame[0] & 0x3FFFFFFF;
-			refEpochA = (frame[1] >> 24) & 0x3F;
-			fsA       = (frame[2] & 0x00FFFFFF) << 3;
-			frame += fs/4;
-			secB      = frame[0] & 0x3FFFFFFF;
-			refEpochB = (frame[1] >> 24) & 0x3F;
-			fsB       = (frame[2] & 0x00FFFFFF) << 3;
-
-			/* does it look reasonable? */
-			if(fsA == fs && fsB == fs && refEpochA == refEpochB && (secA == secB || secA+1 == secB))
-			{
-				*framesize = fs;
-
-				return 0;
-			}
-
+			break;
 		}
+		A = B;
 	}
 
-	return -1;
+	return k;
 }
 
-/* same as above, but for legacy frames */
-int find_vdifl_frame(const unsigned char *data, size_t length, size_t *offset, int *framesize)
+/* One pass over the 8-byte aligned offsets within 5 frame lengths of the
+ * start: the frame length in word 2 of the would-be header there is checked
+ * for being in range (4 offsets at a time with SSE2), then legal, and then
+ * against the headers that follow.  The offset whose following headers agree
+ * longest wins, the first one in case of a tie.
+ */
+static int locate_vdif_frame(const unsigned char *data, size_t length, size_t *offset, int *framesize, int *confidence,
+	int headerbytes, int fs0, int fs1, int (*islegal)(int))
 {
-	int fs, fs0, fs1;
+	size_t o, end, best = 0;
+	int bestfs = 0, bestconfidence = 0;
+	unsigned int lo, hi;
 
 	if(framesize && *framesize)
 	{
 		fs0 = fs1 = *framesize;
 	}
-	else
+	if(length <= (size_t)fs0 + headerbytes)
+	{
+		return -1;
+	}
+	end = 5*(size_t)fs1;
+	if(end > length - fs0 - headerbytes)
 	{
-		fs0 = 24;
-		fs1 = 8216;
+		end = length - fs0 - headerbytes;
 	}
+	lo = fs0/8;
+	hi = fs1/8;
 
-	for(fs = fs0; fs <= fs1; ++fs)
+	for(o = 0; o < end; )
 	{
-		size_t maxOffset;
+		unsigned int mask = 1;
+		int n = 1, i;
 
-		if(!is_legal_vdifl_framesize(fs))
+#ifdef __SSE2__
+		if(o + 24 < end && o + 40 <= length)
 		{
-			continue;
-		}
+			__m128i a, b, w;
 
-		maxOffset = 5*fs;	/* check over a maximum of 5 frame lengths */
-		if(maxOffset > length - fs - 16)
-		{
-			maxOffset = length - fs - 16;
+			a = _mm_loadu_si128((const __m128i *)(data + o + 8));
+			b = _mm_loadu_si128((const __m128i *)(data + o + 24));
+			/* word 2 of the headers at o, o+8, o+16 and o+24 */
+			w = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+			w = _mm_and_si128(w, _mm_set1_epi32(0x00FFFFFF));
+			w = _mm_and_si128(_mm_cmpgt_epi32(w, _mm_set1_epi32(lo - 1)), _mm_cmplt_epi32(w, _mm_set1_epi32(hi + 1)));
+			mask = _mm_movemask_ps(_mm_castsi128_ps(w));
+			n = 4;
 		}
-
-		for(*offset = 0; *offset < maxOffset; *offset += 8)
+#endif
+		for(i = 0; i < n; ++i, o += 8)
 		{
-			unsigned int secA, secB;
-			unsigned int refEpochA, refEpochB;
-			unsigned int fsA, fsB;
-			const unsigned int *frame;
-
-			frame = ((unsigned int *)data) + *offset/4;
-			secA      = frame[0] & 0x3FFFFFFF;
-			refEpochA = (frame[1] >> 24) & 0x3F;
-			fsA       = (frame[2] & 0x00FFFFFF) << 3;
-			frame += fs/4;
-			secB      = frame[0] & 0x3FFFFFFF;
-			refEpochB = (frame[1] >> 24) & 0x3F;
-			fsB       = (frame[2] & 0x00FFFFFF) << 3;
-
-			/* does it look reasonable? */
-			if(fsA == fs && fsB == fs && refEpochA == refEpochB && (secA == secB || secA+1 == secB))
-			{
-				*framesize = fs;
+			unsigned int words;
+			int fs, c;
 
-				return 0;
+			if(!(mask & (1 << i)))
+			{
+				continue;
 			}
-
+			words = ((const unsigned int *)(data + o))[2] & 0x00FFFFFF;
+			if(words < lo || words > hi)
+			{
+				continue;
+			}
+			fs = words << 3;
+			if(o >= 5*(size_t)fs || o + fs + headerbytes >= length || !islegal(fs))
+			{
+				continue;
+			}
+			c = confirm_vdif_frame(data, length, o, fs, headerbytes);
+			if(c > bestconfidence)
+			{
+				best = o;
+				bestfs = fs;
+				bestconfidence = c;
+			}
+		}
+		if(bestconfidence == VDIF_FRAME_CONFIRM)
+		{
+			break;
 		}
 	}
 
-	return -1;
+	if(bestconfidence == 0)
+	{
+		return -1;
+	}
+	*offset = best;
+	*framesize = bestfs;
+	if(confidence)
+	{
+		*confidence = bestconfidence;
+	}
+
+	return 0;
+}
+
+/* if *framesize is set to 0, the frame size will be determined by this call
+ * and returned into the same variable.
+ *
+ * return value is -1 on error (no VDIF found) or 0 if found.
+ *
+ * here framesize includes the 32 byte header
+ */
+int find_vdif_frame(const unsigned char *data, size_t length, size_t *offset, int *framesize)
+{
+	return locate_vdif_frame(data, length, offset, framesize, 0, 32, 40, 8232, is_legal_vdif_framesize);
+}
+
+/* as above; confidence is set to the number of frames, up to 8, after the
+ * one found whose headers agree with it
+ */
+int find_vdif_frame_confidence(const unsigned char *data, size_t length, size_t *offset, int *framesize, int *confidence)
+{
+	return locate_vdif_frame(data, length, offset, framesize, confidence, 32, 40, 8232, is_legal_vdif_framesize);
+}
+
+/* same as above, but for legacy frames */
+int find_vdifl_frame(const unsigned char *data, size_t length, size_t *offset, int *framesize)
+{
+	return locate_vdif_frame(data, length, offset, framesize, 0, 16, 24, 8216, is_legal_vdifl_framesize);
+}
+
+int find_vdifl_frame_confidence(const unsigned char *data, size_t length, size_t *offset, int *framesize, int *confidence)
+{
+	return locate_vdif_frame(data, length, offset, framesize, confidence, 16, 24, 8216, is_legal_vdifl_framesize);
 }
 
 int get_vdif_chans_per_thread(const unsigned char *data)
@@ -0,0 +1,492 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mark5access/mark5_stream.h"
+
+/* An opt-in cache of small results about data files, such as detected
+ * formats and start and end times, so that looking at the same files again
+ * needs no data reads.  Entries are text lines
+ *
+ *   <dev> <inode> <size> <mtime s> <mtime ns> <key> <value>
+ *
+ * and only match a file with the same device, inode, size and mtime, so a
+ * file that is rewritten, or a name that now refers to another file, is
+ * simply not found.  Lines are only ever appended, each by a single write,
+ * so several processes can share one cache file; a later line for the same
+ * file and key supersedes an earlier one.  The cache is either one file
+ * (e.g., ~/.mark5access.cache) or, with the path "sidecar", a file
+ * MARK5_CACHE_SIDECAR in the directory of each data file.  It is off until
+ * a path is set with M5A_OPT_CACHE or MARK5ACCESS_CACHE.
+ */
+
+#define MARK5_CACHE_MAXPATH	1024
+#define MARK5_CACHE_MAXLINE	1024
+#define MARK5_CACHE_NBUCKET	4096
+#define MARK5_CACHE_PROBEBYTES	(1<<20)	/* read at each end of a file to summarize it */
+#define MARK5_CACHE_TAILFRAMES	4	/* frames' worth tried first at the end */
+
+struct mark5_cache_entry
+{
+	unsigned long long dev, ino;
+	long long size, mtime, mtimens;
+	char *key;
+	char *value;
+	struct mark5_cache_entry *next;
+};
+
+/* the entries of one cache file, as read so far */
+struct mark5_cache_file
+{
+	char path[MARK5_CACHE_MAXPATH];
+	long long loaded;		/* bytes of the file parsed */
+	int warned;
+	struct mark5_cache_entry *bucket[MARK5_CACHE_NBUCKET];
+	struct mark5_cache_file *next;
+};
+
+static pthread_mutex_t cachelock = PTHREAD_MUTEX_INITIALIZER;
+static char cachepath[MARK5_CACHE_MAXPATH] = "";
+static struct mark5_cache_file *cachefiles = 0;
+
+int mark5_cache_set_path(const char *path)
+{
+	if(!path || strlen(path) >= MARK5_CACHE_MAXPATH)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&cachelock);
+	strcpy(cachepath, path);
+	pthread_mutex_unlock(&cachelock);
+
+	return 0;
+}
+
+const char *mark5_cache_get_path(void)
+{
+	return cachepath;
+}
+
+static unsigned int mark5_cache_hash(unsigned long long dev, unsigned long long ino, const char *key)
+{
+	unsigned long long h;
+
+	h = dev*0x9E3779B97F4A7C15ULL ^ ino;
+	while(*key)
+	{
+		h = h*31 + (unsigned char)*key;
+		++key;
+	}
+
+	return (unsigned int)((h ^ (h >> 29)) % MARK5_CACHE_NBUCKET);
+}
+
+static void mark5_cache_insert(struct mark5_cache_file *C, const struct mark5_cache_entry *e)
+{
+	struct mark5_cache_entry *E;
+	unsigned int h;
+
+	h = mark5_cache_hash(e->dev, e->ino, e->key);
+	for(E = C->bucket[h]; E; E = E->next)
+	{
+		if(E->dev == e->dev && E->ino == e->ino && strcmp(E->key, e->key) == 0)
+		{
+			break;
+		}
+	}
+	if(E)
+	{
+		free(E->value);
+	}
+	else
+	{
+		E = (struct mark5_cache_entry *)malloc(sizeof(struct mark5_cache_entry));
+		E->dev = e->dev;
+		E->ino = e->ino;
+		E->key = strdup(e->key);
+		E->next = C->bucket[h];
+		C->bucket[h] = E;
+	}
+	E->size = e->size;
+	E->mtime = e->mtime;
+	E->mtimens = e->mtimens;
+	E->value = strdup(e->value);
+}
+
+/* parses one line; the line is modified */
+static int mark5_cache_parse(struct mark5_cache_entry *e, char *line)
+{
+	int n = 0;
+	char *v;
+
+	if(sscanf(line, "%llu %llu %lld %lld %lld %n", &e->dev, &e->ino, &e->size, &e->mtime, &e->mtimens, &n) < 5 || n == 0)
+	{
+		return -1;
+	}
+	e->key = line + n;
+	v = strchr(e->key, ' ');
+	if(!v || v == e->key)
+	{
+		return -1;
+	}
+	*v = 0;
+	e->value = v + 1;
+
+	return 0;
+}
+
+/* reads whatever has been appended to the cache file since last time */
+static void mark5_cache_load(struct mark5_cache_file *C)
+{
+	char line[MARK5_CACHE_MAXLINE];
+	FILE *in;
+
+	in = fopen(C->path, "r");
+	if(!in)
+	{
+		return;
+	}
+	if(fseeko(in, C->loaded, SEEK_SET) == 0)
+	{
+		while(fgets(line, MARK5_CACHE_MAXLINE, in))
+		{
+			struct mark5_cache_entry e;
+			int l;
+
+			l = strlen(line);
+			if(l == 0 || line[l-1] != '\n')
+			{
+				/* a line still being written, or too long to be ours */
+				if(l < MARK5_CACHE_MAXLINE - 1)
+				{
+					break;
+				}
+				C->loaded += l;
+				continue;
+			}
+			C->loaded += l;
+			line[l-1] = 0;
+			if(mark5_cache_parse(&e, line) == 0)
+			{
+				mark5_cache_insert(C, &e);
+			}
+		}
+	}
+	fclose(in);
+}
+
+/* the cache file for a data file, or 0 if caching is off; needs the lock */
+static struct mark5_cache_file *mark5_cache_open(const char *filename)
+{
+	char path[MARK5_CACHE_MAXPATH];
+	struct mark5_cache_file *C;
+
+	if(cachepath[0] == 0)
+	{
+		return 0;
+	}
+	if(strcmp(cachepath, "sidecar") == 0)
+	{
+		const char *slash;
+		int n;
+
+		slash = strrchr(filename, '/');
+		if(slash)
+		{
+			n = snprintf(path, MARK5_CACHE_MAXPATH, "%.*s/%s", (int)(slash - filename), filename, MARK5_CACHE_SIDECAR);
+		}
+		else
+		{
+			n = snprintf(path, MARK5_CACHE_MAXPATH, "%s", MARK5_CACHE_SIDECAR);
+		}
+		if(n >= MARK5_CACHE_MAXPATH)
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		strcpy(path, cachepath);
+	}
+
+	for(C = cachefiles; C; C = C->next)
+	{
+		if(strcmp(C->path, path) == 0)
+		{
+			return C;
+		}
+	}
+
+	C = (struct mark5_cache_file *)calloc(1, sizeof(struct mark5_cache_file));
+	strcpy(C->path, path);
+	C->next = cachefiles;
+	cachefiles = C;
+
+	return C;
+}
+
+int mark5_cache_get(const char *filename, const char *key, char *value, int maxlength)
+{
+	struct mark5_cache_file *C;
+	struct mark5_cache_entry *E;
+	struct stat st;
+	int rv = -1;
+
+	if(!filename || !key || !value || maxlength <= 0 || stat(filename, &st) != 0)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&cachelock);
+	C = mark5_cache_open(filename);
+	if(C)
+	{
+		mark5_cache_load(C);
+		for(E = C->bucket[mark5_cache_hash(st.st_dev, st.st_ino, key)]; E; E = E->next)
+		{
+			if(E->dev == (unsigned long long)st.st_dev && E->ino == (unsigned long long)st.st_ino && strcmp(E->key, key) == 0)
+			{
+				if(E->size == (long long)st.st_size && E->mtime == (long long)st.st_mtim.tv_sec && E->mtimens == (long long)st.st_mtim.tv_nsec && (int)strlen(E->value) < maxlength)
+				{
+					strcpy(value, E->value);
+					rv = 0;
+				}
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&cachelock);
+
+	return rv;
+}
+
+int mark5_cache_put(const char *filename, const char *key, const char *value)
+{
+	char line[MARK5_CACHE_MAXLINE];
+	struct mark5_cache_file *C;
+	struct mark5_cache_entry e;
+	struct stat st;
+	int fd, n, rv = -1;
+
+	if(!filename || !key || !value || key[0] == 0 || strpbrk(key, " \n") || strchr(value, '\n') || stat(filename, &st) != 0)
+	{
+		return -1;
+	}
+
+	e.dev = st.st_dev;
+	e.ino = st.st_ino;
+	e.size = st.st_size;
+	e.mtime = st.st_mtim.tv_sec;
+	e.mtimens = st.st_mtim.tv_nsec;
+	n = snprintf(line, MARK5_CACHE_MAXLINE, "%llu %llu %lld %lld %lld %s %s\n", e.dev, e.ino, e.size, e.mtime, e.mtimens, key, value);
+	if(n >= MARK5_CACHE_MAXLINE)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&cachelock);
+	C = mark5_cache_open(filename);
+	if(C)
+	{
+		fd = open(C->path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+		if(fd >= 0)
+		{
+			if(write(fd, line, n) == n)
+			{
+				rv = 0;
+			}
+			close(fd);
+		}
+		if(rv == 0)
+		{
+			e.key = (char *)key;
+			e.value = (char *)value;
+			mark5_cache_insert(C, &e);
+		}
+		else if(!C->warned)
+		{
+			fprintf(m5stderr, "Warning: mark5_cache_put: cannot add to %s; not caching there\n", C->path);
+			C->warned = 1;
+		}
+	}
+	pthread_mutex_unlock(&cachelock);
+
+	return rv;
+}
+
+/* format and time of the first frame in the n bytes at offset */
+static struct mark5_format *mark5_cache_probe(FILE *in, long long offset, int n, unsigned char *buffer)
+{
+	struct mark5_stream_generic *s;
+	struct mark5_format *mf;
+
+	if(fseeko(in, offset, SEEK_SET) != 0 || fread(buffer, 1, n, in) != (size_t)n)
+	{
+		return 0;
+	}
+	s = new_mark5_stream_memory(buffer, n);
+	mf = new_mark5_format_from_stream(s);
+	delete_mark5_stream_generic(s);
+
+	return mf;
+}
+
+int mark5_summarize_file(struct mark5_file_summary *sum, const char *filename)
+{
+	char value[MARK5_CACHE_MAXLINE];
+	struct mark5_format *mf, *tf;
+	struct mark5_format *f;
+	unsigned char *buffer;
+	struct stat st;
+	long long tail, nframe;
+	double ns;
+	FILE *in;
+	int n;
+
+	if(!sum || !filename)
+	{
+		return -1;
+	}
+	memset(sum, 0, sizeof(struct mark5_file_summary));
+	f = &sum->format;
+
+	if(mark5_cache_get(filename, "summary", value, MARK5_CACHE_MAXLINE) == 0)
+	{
+		if(sscanf(value, "%d %lg %d %d %d %d %d %lg %d %d %d %d %d %d %d %d %d %lld %d %d %d",
+			(int *)&f->format, &f->Mbps, &f->nchan, &f->nbit, &f->frameoffset, &f->framebytes, &f->databytes, &f->framens,
+			&f->mjd, &f->sec, &f->ns, &f->ntrack, &f->fanout, &f->framesperperiod, &f->alignmentseconds, &f->decimation, &f->score,
+			&sum->filesize, &sum->endmjd, &sum->endsec, &sum->endns) == 21)
+		{
+			return 0;
+		}
+		memset(sum, 0, sizeof(struct mark5_file_summary));
+	}
+
+	if(stat(filename, &st) != 0)
+	{
+		return -1;
+	}
+	sum->filesize = st.st_size;
+	n = sum->filesize < MARK5_CACHE_PROBEBYTES ? sum->filesize : MARK5_CACHE_PROBEBYTES;
+	if(n <= 0)
+	{
+		return -1;
+	}
+
+	in = fopen(filename, "r");
+	if(!in)
+	{
+		return -1;
+	}
+	buffer = (unsigned char *)malloc(n);
+
+	mf = mark5_cache_probe(in, 0, n, buffer);
+	if(!mf)
+	{
+		free(buffer);
+		fclose(in);
+
+		return -2;
+	}
+	*f = *mf;
+	delete_mark5_format(mf);
+
+	/* the end time is that of the last whole frame, counted on from the
+	 * first frame found near the end; looking at only the last few frames
+	 * keeps that count, and so reliance on the frame rate, small.  Probes
+	 * start on the frame grid of the start of the file, as finders may only
+	 * look at aligned offsets and a file may end part way through a frame */
+	tail = sum->filesize - MARK5_CACHE_TAILFRAMES*(long long)f->framebytes;
+	tail -= (tail - f->frameoffset) % f->framebytes;
+	tf = 0;
+	if(tail > 0 && sum->filesize - tail <= n)
+	{
+		tf = mark5_cache_probe(in, tail, sum->filesize - tail, buffer);
+	}
+	if(!tf)
+	{
+		tail = sum->filesize - n;
+		tail += (f->frameoffset - tail % f->framebytes + f->framebytes) % f->framebytes;
+		tf = mark5_cache_probe(in, tail, sum->filesize - tail, buffer);
+	}
+	free(buffer);
+	fclose(in);
+	if(!tf)
+	{
+		return -3;
+	}
+	nframe = (sum->filesize - tail - tf->frameoffset)/tf->framebytes;
+	ns = tf->ns + (nframe - 1)*tf->framens;
+	sum->endmjd = tf->mjd;
+	sum->endsec = tf->sec + (long long)(ns/1.0e9);
+	sum->endns = (int)(ns - 1.0e9*(long long)(ns/1.0e9) + 0.5);
+	sum->endmjd += sum->endsec/86400;
+	sum->endsec %= 86400;
+	delete_mark5_format(tf);
+
+	snprintf(value, MARK5_CACHE_MAXLINE, "%d %.17g %d %d %d %d %d %.17g %d %d %d %d %d %d %d %d %d %lld %d %d %d",
+		f->format, f->Mbps, f->nchan, f->nbit, f->frameoffset, f->framebytes, f->databytes, f->framens,
+		f->mjd, f->sec, f->ns, f->ntrack, f->fanout, f->framesperperiod, f->alignmentseconds, f->decimation, f->score,
+		sum->filesize, sum->endmjd, sum->endsec, sum->endns);
+	mark5_cache_put(filename, "summary", value);
+
+	return 0;
+}
+
+struct mark5_format *new_mark5_format_from_file(const char *filename)
+{
+	struct mark5_file_summary sum;
+	struct mark5_format *mf;
+
+	if(mark5_summarize_file(&sum, filename) != 0)
+	{
+		return 0;
+	}
+	mf = (struct mark5_format *)malloc(sizeof(struct mark5_format));
+	*mf = sum.format;
+
+	return mf;
+}
+
+void print_mark5_file_summary(const struct mark5_file_summary *sum)
+{
+	print_mark5_format(&sum->format);
+	fprintf(m5stdout, "  file size = %lld\n", sum->filesize);
+	fprintf(m5stdout, "  end mjd = %d sec = %d ns = %d\n", sum->endmjd, sum->endsec, sum->endns);
+}
@@ -37,6 +37,7 @@
 #include <string.h>
 #include <math.h>
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_unpack_simd.h"
 
 #define MK5B_PAYLOADSIZE 10000
 
@@ -49,6 +50,7 @@ struct mark5_format_mark5b
 {
 	int nbitstream;
 	int kday;	/* kilo-mjd: ie 51000, 52000, ... */
+	struct mark5_simd_layout simd;	/* used by d2k_decode_simd() and d2k_count_simd() only */
 };
 
 static float lut1bit[256][8];
@@ -96,6 +98,29 @@ static void d2k_initluts()
 	}
 }
 
+/******************** vectorized decode routines *******************/
+
+/* Undecimated data only */
+static int d2k_decode_simd(struct mark5_stream *ms, int nsamp, float **data)
+{
+	return mark5_simd_decode_stream(ms, &((const struct mark5_format_mark5b *)(ms->formatdata))->simd, 0, nsamp, data);
+}
+
+static int d2k_decode_channels_simd(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data)
+{
+	return mark5_simd_decode_channels_stream(ms, &((const struct mark5_format_mark5b *)(ms->formatdata))->simd, 0, nsamp, chanlist, nsel, data);
+}
+
+static int d2k_stats_simd(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats)
+{
+	return mark5_simd_stats_stream(ms, &((const struct mark5_format_mark5b *)(ms->formatdata))->simd, 0, nsamp, stats);
+}
+
+static int d2k_count_simd(struct mark5_stream *ms, int nsamp, unsigned int *highstates)
+{
+	return mark5_simd_count_stream(ms, &((const struct mark5_format_mark5b *)(ms->formatdata))->simd, 0, nsamp, highstates);
+}
+
 static int mark5_format_d2k_make_formatname(struct mark5_stream *ms)
 {
 	snprintf(ms->formatname, MARK5_STREAM_ID_LENGTH, "D2K-%.0f-%d-%d", 
@@ -217,7 +242,10 @@ static void mark5_format_mark5b_genheaders(const struct mark5_stream *ms, int n,
 
 		for(f = 0; f < ms->framegranularity; ++f)
 		{
+			/* a zeroed header is a valid one */
+			memset(where, 0, ms->payloadoffset);
 			*((unsigned int *)where) = d2kSync;
+			where += ms->framebytes;
 		}
 	}
 }
@@ -3201,6 +3229,34 @@ struct mark5_format_generic *new_mark5_format_d2k(int Mbps, int nchan, int nbit,
 		return 0;
 	}
 
+	/* Use the vector unpacker when the cpu (and M5A_OPT_SIMDLEVEL) allows */
+	if(decimation == 1)
+	{
+		float levels[4];
+		int l;
+
+		for(l = 0; l < (1 << nbit); ++l)
+		{
+			levels[l] = (nbit == 1) ? lut1bit[l][0] : lut2bit[l][0];
+		}
+		if(mark5_simd_layout_init(&m->simd, nbit, nchan, nbitstream, 1, 0, levels) == 0)
+		{
+			f->decode = d2k_decode_simd;
+			f->decode_channels = d2k_decode_channels_simd;
+		}
+		if(mark5_simd_stats_supported(&m->simd))
+		{
+			f->accumulate_stats = d2k_stats_simd;
+		}
+		/* the 1 channel counter above advances 3 samples per byte; keep
+		 * its results so they do not depend on the cpu
+		 */
+		if(m->simd.counter && nbitstream > 2)
+		{
+			f->count = d2k_count_simd;
+		}
+	}
+
 	return f;
 }
 
@@ -42,6 +42,7 @@
 #include <string.h>
 #include <math.h>
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_unpack_simd.h"
 
 #define KVN5B_PAYLOADSIZE 10000
 
@@ -54,6 +55,7 @@ struct mark5_format_kvn5b
 {
 	int nbitstream;
 	int kday;	/* kilo-mjd: ie 51000, 52000, ... */
+	struct mark5_simd_layout simd;	/* used by kvn5b_decode_simd() only */
 };
 
 static float lut1bit[256][8];
@@ -212,7 +214,10 @@ static void mark5_format_kvn5b_genheaders(const struct mark5_stream *ms, int n,
 
 		for(f = 0; f < ms->framegranularity; ++f)
 		{
+			/* a zeroed header is a valid one */
+			memset(where, 0, ms->payloadoffset);
 			*((unsigned int *)where) = kvn5bSync;
+			where += ms->framebytes;
 		}
 	}
 }
@@ -2834,6 +2839,26 @@ static int kvn5b_count_32bitstream_2bit_decimation4(struct mark5_stream *ms, int
 
 /******************************************************************/
 
+/******************** vectorized decode routines *******************/
+
+/* Undecimated data only.  Several KVN modes do not store the channels in
+ * plain order, so the bit positions are taken from the decoder it replaces.
+ */
+static int kvn5b_decode_simd(struct mark5_stream *ms, int nsamp, float **data)
+{
+	return mark5_simd_decode_stream(ms, &((const struct mark5_format_kvn5b *)(ms->formatdata))->simd, 0, nsamp, data);
+}
+
+static int kvn5b_decode_channels_simd(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data)
+{
+	return mark5_simd_decode_channels_stream(ms, &((const struct mark5_format_kvn5b *)(ms->formatdata))->simd, 0, nsamp, chanlist, nsel, data);
+}
+
+static int kvn5b_stats_simd(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats)
+{
+	return mark5_simd_stats_stream(ms, &((const struct mark5_format_kvn5b *)(ms->formatdata))->simd, 0, nsamp, stats);
+}
+
 static int mark5_format_kvn5b_make_formatname(struct mark5_stream *ms)
 {
 	snprintf(ms->formatname, MARK5_STREAM_ID_LENGTH, "KVN5B-%.0f-%d-%d", ms->Mbps, ms->nchan, ms->nbit);
@@ -3273,5 +3298,28 @@ struct mark5_format_generic *new_mark5_format_kvn5b(int Mbps, int nchan, int nbi
 		return 0;
 	}
 
+	/* Use the vector unpacker when the cpu (and M5A_OPT_SIMDLEVEL) allows;
+	 * a unit of 32 bits holds whole samples in all modes
+	 */
+	if(decimation == 1)
+	{
+		float levels[4];
+		int l;
+
+		for(l = 0; l < 4; ++l)
+		{
+			levels[l] = lut2bit[l][0];
+		}
+		if(mark5_simd_layout_probe(&m->simd, f->decode, nbit, nchan, 4, 32/nbitstream, levels, 0) == 0)
+		{
+			f->decode = kvn5b_decode_simd;
+			f->decode_channels = kvn5b_decode_channels_simd;
+		}
+		if(mark5_simd_stats_supported(&m->simd))
+		{
+			f->accumulate_stats = kvn5b_stats_simd;
+		}
+	}
+
 	return f;
 }
@@ -37,6 +37,7 @@
 #include <string.h>
 #include "config.h"
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_unpack_simd.h"
 
 #define PAYLOADSIZE 20000
 #define VALIDSTART 96
@@ -78,6 +79,7 @@ struct mark5_format_mark4
 	int ntrack;
 	int fanout;
 	int decade;	/* for proper date decoding.  should be 0, 10, 20... */
+	struct mark5_simd_layout simd;	/* used by mark4_decode_simd() only */
 };
 
 int countbits(unsigned char v);
@@ -6776,6 +6778,24 @@ static int mark4_decode_2bit_64track_fanout4_decimation4(struct mark5_stream *ms
 
 /******************************************************************/
 
+/******************** vectorized decode routines *******************/
+
+/* Undecimated data only; bit positions are those of the decoder it replaces */
+static int mark4_decode_simd(struct mark5_stream *ms, int nsamp, float **data)
+{
+	return mark5_simd_decode_stream(ms, &((const struct mark5_format_mark4 *)(ms->formatdata))->simd, 0, nsamp, data);
+}
+
+static int mark4_decode_channels_simd(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data)
+{
+	return mark5_simd_decode_channels_stream(ms, &((const struct mark5_format_mark4 *)(ms->formatdata))->simd, 0, nsamp, chanlist, nsel, data);
+}
+
+static int mark4_stats_simd(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats)
+{
+	return mark5_simd_stats_stream(ms, &((const struct mark5_format_mark4 *)(ms->formatdata))->simd, 0, nsamp, stats);
+}
+
 static int mark5_format_mark4_make_formatname(struct mark5_stream *ms)
 {
 	const struct mark5_format_mark4 *f;
@@ -7136,6 +7156,27 @@ struct mark5_format_generic *new_mark5_format_mark4(int Mbps, int nchan,
 		return 0;
 	}
 
+	/* Use the vector unpacker when the cpu (and M5A_OPT_SIMDLEVEL) allows */
+	if(decimation == 1)
+	{
+		float levels[4];
+		int l;
+
+		for(l = 0; l < (1 << nbit); ++l)
+		{
+			levels[l] = (nbit == 1) ? lut1bit[l][0] : lut2bit1[l][0];
+		}
+		if(mark5_simd_layout_probe(&v->simd, f->decode, nbit, nchan, ntrack >= 8 ? ntrack/8 : 1, fanout, levels, 0) == 0)
+		{
+			f->decode = mark4_decode_simd;
+			f->decode_channels = mark4_decode_channels_simd;
+		}
+		if(mark5_simd_stats_supported(&v->simd))
+		{
+			f->accumulate_stats = mark4_stats_simd;
+		}
+	}
+
 	return f;
 }
 
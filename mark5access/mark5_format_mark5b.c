@@ -37,6 +37,7 @@
 #include <string.h>
 #include <math.h>
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_unpack_simd.h"
 
 #define MK5B_PAYLOADSIZE 10000
 
@@ -49,6 +50,7 @@ struct mark5_format_mark5b
 {
 	int nbitstream;
 	int kday;	/* kilo-mjd: ie 51000, 52000, ... */
+	struct mark5_simd_layout simd;	/* used by mark5b_decode_simd() and mark5b_count_simd() only */
 };
 
 static float lut1bit[256][8];
@@ -205,7 +207,10 @@ static void mark5_format_mark5b_genheaders(const struct mark5_stream *ms, int n,
 
 		for(f = 0; f < ms->framegranularity; ++f)
 		{
+			/* a zeroed header is a valid one */
+			memset(where, 0, ms->payloadoffset);
 			*((unsigned int *)where) = mark5bSync;
+			where += ms->framebytes;
 		}
 	}
 }
@@ -2809,6 +2814,29 @@ static int mark5b_count_32bitstream_2bit_decimation4(struct mark5_stream *ms, in
 
 /******************************************************************/
 
+/******************** vectorized decode routines *******************/
+
+/* Undecimated data only; frames with the TVG bit of the header set are blanked */
+static int mark5b_decode_simd(struct mark5_stream *ms, int nsamp, float **data)
+{
+	return mark5_simd_decode_stream(ms, &((const struct mark5_format_mark5b *)(ms->formatdata))->simd, -11, nsamp, data);
+}
+
+static int mark5b_decode_channels_simd(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data)
+{
+	return mark5_simd_decode_channels_stream(ms, &((const struct mark5_format_mark5b *)(ms->formatdata))->simd, -11, nsamp, chanlist, nsel, data);
+}
+
+static int mark5b_stats_simd(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats)
+{
+	return mark5_simd_stats_stream(ms, &((const struct mark5_format_mark5b *)(ms->formatdata))->simd, -11, nsamp, stats);
+}
+
+static int mark5b_count_simd(struct mark5_stream *ms, int nsamp, unsigned int *highstates)
+{
+	return mark5_simd_count_stream(ms, &((const struct mark5_format_mark5b *)(ms->formatdata))->simd, -11, nsamp, highstates);
+}
+
 static int mark5_format_mark5b_make_formatname(struct mark5_stream *ms)
 {
 	snprintf(ms->formatname, MARK5_STREAM_ID_LENGTH, "Mark5B-%d-%d-%d", 
@@ -3245,5 +3273,33 @@ struct mark5_format_generic *new_mark5_format_mark5b(int Mbps, int nchan, int nb
 		return 0;
 	}
 
+	/* Use the vector unpacker when the cpu (and M5A_OPT_SIMDLEVEL) allows */
+	if(decimation == 1)
+	{
+		float levels[4];
+		int l;
+
+		for(l = 0; l < (1 << nbit); ++l)
+		{
+			levels[l] = (nbit == 1) ? lut1bit[l][0] : lut2bit[l][0];
+		}
+		if(mark5_simd_layout_init(&m->simd, nbit, nchan, nbitstream, 1, 0, levels) == 0)
+		{
+			f->decode = mark5b_decode_simd;
+			f->decode_channels = mark5b_decode_channels_simd;
+		}
+		if(mark5_simd_stats_supported(&m->simd))
+		{
+			f->accumulate_stats = mark5b_stats_simd;
+		}
+		/* the 1 channel counter above advances 3 samples per byte; keep
+		 * its results so they do not depend on the cpu
+		 */
+		if(m->simd.counter && nbitstream > 2)
+		{
+			f->count = mark5b_count_simd;
+		}
+	}
+
 	return f;
 }
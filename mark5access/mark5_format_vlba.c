@@ -38,13 +38,15 @@
 #include <math.h>
 #include "config.h"
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_unpack_simd.h"
 
 #define PAYLOADSIZE 20000
 
 /* the high mag value for 2-bit reconstruction */
 static const float HiMag = OPTIMAL_2BIT_HIGH;
 
-static unsigned int *modulate = 0;
+/* the NRZM modulation of each unit, one bit each; see mark5_simd_modulation() */
+static unsigned char *modulate = 0;
 
 static float lut1bit[2][256][8];  /* For all 1-bit modes */
 static float lut2bit1[2][256][4]; /* fanout 1 @ 8/16t, fanout 4 @ 32/64t ! */
@@ -85,6 +87,7 @@ struct mark5_format_vlba
 	int ntrack;
 	int fanout;
 	int kday;	/* kilo-mjd days.  51000, 52000, ... */
+	struct mark5_simd_layout simd;	/* used by vlba_decode_simd() only */
 };
 
 static void initluts()
@@ -171,7 +174,8 @@ static void initmodulate()
 	
 	if(!modulate) 
 	{
-		modulate = (unsigned int *)calloc(PAYLOADSIZE, sizeof(unsigned int));
+		/* padded for the vector unpacker, which reads 16 bytes at a time */
+		modulate = (unsigned char *)calloc(PAYLOADSIZE/8 + 16, 1);
 	}
 	
 	for(i = 0; i < PAYLOADSIZE; ++i)
@@ -182,7 +186,7 @@ static void initmodulate()
 			ff[n] = ff[n-1];
 		}
 		ff[0] = k;
-		modulate[i] = k;
+		modulate[i/8] |= k << (i%8);
 		if(i % 8 == 7) /* Skip the parity bit */
 		{
 			k = ff[10] ^ ff[12] ^ ff[13] ^ ff[15];
@@ -538,7 +542,7 @@ static int vlba_decode_1bit_1track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -583,7 +587,7 @@ static int vlba_decode_1bit_1track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += 2;
 
@@ -629,7 +633,7 @@ static int vlba_decode_1bit_1track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -674,7 +678,7 @@ static int vlba_decode_1bit_2track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -720,7 +724,7 @@ static int vlba_decode_1bit_2track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += 2;
 
@@ -767,7 +771,7 @@ static int vlba_decode_1bit_2track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -813,7 +817,7 @@ static int vlba_decode_1bit_2track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -860,7 +864,7 @@ static int vlba_decode_1bit_2track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -906,7 +910,7 @@ static int vlba_decode_1bit_2track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -951,7 +955,7 @@ static int vlba_decode_1bit_4track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -999,7 +1003,7 @@ static int vlba_decode_1bit_4track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += 2;
 
@@ -1048,7 +1052,7 @@ static int vlba_decode_1bit_4track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -1096,7 +1100,7 @@ static int vlba_decode_1bit_4track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -1145,7 +1149,7 @@ static int vlba_decode_1bit_4track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -1192,7 +1196,7 @@ static int vlba_decode_1bit_4track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -1238,7 +1242,7 @@ static int vlba_decode_1bit_4track_fanout4_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -1289,7 +1293,7 @@ static int vlba_decode_1bit_4track_fanout4_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -1337,7 +1341,7 @@ static int vlba_decode_1bit_4track_fanout4_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -1382,7 +1386,7 @@ static int vlba_decode_1bit_8track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -1434,7 +1438,7 @@ static int vlba_decode_1bit_8track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += 2;
 
@@ -1487,7 +1491,7 @@ static int vlba_decode_1bit_8track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -1539,7 +1543,7 @@ static int vlba_decode_1bit_8track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -1592,7 +1596,7 @@ static int vlba_decode_1bit_8track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -1641,7 +1645,7 @@ static int vlba_decode_1bit_8track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -1689,7 +1693,7 @@ static int vlba_decode_1bit_8track_fanout4_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -1744,7 +1748,7 @@ static int vlba_decode_1bit_8track_fanout4_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -1794,7 +1798,7 @@ static int vlba_decode_1bit_8track_fanout4_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut1bit[modulate[i]][buf[i]];
+			fp = lut1bit[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -1842,9 +1846,9 @@ static int vlba_decode_1bit_16track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -1908,9 +1912,9 @@ static int vlba_decode_1bit_16track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			i += 3;
 		}
 		m += 2;
@@ -1977,9 +1981,9 @@ static int vlba_decode_1bit_16track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -2043,9 +2047,9 @@ static int vlba_decode_1bit_16track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -2110,9 +2114,9 @@ static int vlba_decode_1bit_16track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -2171,9 +2175,9 @@ static int vlba_decode_1bit_16track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -2229,9 +2233,9 @@ static int vlba_decode_1bit_16track_fanout4_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -2298,9 +2302,9 @@ static int vlba_decode_1bit_16track_fanout4_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -2360,9 +2364,9 @@ static int vlba_decode_1bit_16track_fanout4_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -2414,13 +2418,13 @@ static int vlba_decode_1bit_32track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -2500,13 +2504,13 @@ static int vlba_decode_1bit_32track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			i += 5;
 		}
 		m += 2;
@@ -2593,13 +2597,13 @@ static int vlba_decode_1bit_32track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -2679,13 +2683,13 @@ static int vlba_decode_1bit_32track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -2766,13 +2770,13 @@ static int vlba_decode_1bit_32track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -2843,13 +2847,13 @@ static int vlba_decode_1bit_32track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -2913,13 +2917,13 @@ static int vlba_decode_1bit_32track_fanout4_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -3002,13 +3006,13 @@ static int vlba_decode_1bit_32track_fanout4_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -3080,13 +3084,13 @@ static int vlba_decode_1bit_32track_fanout4_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -3142,21 +3146,21 @@ static int vlba_decode_1bit_64track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut1bit[modulate[m]][buf[i]];
+			fp4 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut1bit[modulate[m]][buf[i]];
+			fp5 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut1bit[modulate[m]][buf[i]];
+			fp6 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut1bit[modulate[m]][buf[i]];
+			fp7 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -3268,21 +3272,21 @@ static int vlba_decode_1bit_64track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut1bit[modulate[m]][buf[i]];
+			fp4 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut1bit[modulate[m]][buf[i]];
+			fp5 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut1bit[modulate[m]][buf[i]];
+			fp6 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut1bit[modulate[m]][buf[i]];
+			fp7 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			i += 9;
 		}
 		m += 2;
@@ -3396,21 +3400,21 @@ static int vlba_decode_1bit_64track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut1bit[modulate[m]][buf[i]];
+			fp4 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut1bit[modulate[m]][buf[i]];
+			fp5 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut1bit[modulate[m]][buf[i]];
+			fp6 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut1bit[modulate[m]][buf[i]];
+			fp7 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -3522,21 +3526,21 @@ static int vlba_decode_1bit_64track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut1bit[modulate[m]][buf[i]];
+			fp4 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut1bit[modulate[m]][buf[i]];
+			fp5 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut1bit[modulate[m]][buf[i]];
+			fp6 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut1bit[modulate[m]][buf[i]];
+			fp7 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -3649,21 +3653,21 @@ static int vlba_decode_1bit_64track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut1bit[modulate[m]][buf[i]];
+			fp4 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut1bit[modulate[m]][buf[i]];
+			fp5 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut1bit[modulate[m]][buf[i]];
+			fp6 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut1bit[modulate[m]][buf[i]];
+			fp7 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -3745,21 +3749,21 @@ static int vlba_decode_1bit_64track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut1bit[modulate[m]][buf[i]];
+			fp4 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut1bit[modulate[m]][buf[i]];
+			fp5 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut1bit[modulate[m]][buf[i]];
+			fp6 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut1bit[modulate[m]][buf[i]];
+			fp7 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -3839,21 +3843,21 @@ static int vlba_decode_1bit_64track_fanout4_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut1bit[modulate[m]][buf[i]];
+			fp4 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut1bit[modulate[m]][buf[i]];
+			fp5 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut1bit[modulate[m]][buf[i]];
+			fp6 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut1bit[modulate[m]][buf[i]];
+			fp7 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -3969,21 +3973,21 @@ static int vlba_decode_1bit_64track_fanout4_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut1bit[modulate[m]][buf[i]];
+			fp4 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut1bit[modulate[m]][buf[i]];
+			fp5 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut1bit[modulate[m]][buf[i]];
+			fp6 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut1bit[modulate[m]][buf[i]];
+			fp7 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -4066,21 +4070,21 @@ static int vlba_decode_1bit_64track_fanout4_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut1bit[modulate[m]][buf[i]];
+			fp0 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut1bit[modulate[m]][buf[i]];
+			fp1 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut1bit[modulate[m]][buf[i]];
+			fp2 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut1bit[modulate[m]][buf[i]];
+			fp3 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut1bit[modulate[m]][buf[i]];
+			fp4 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut1bit[modulate[m]][buf[i]];
+			fp5 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut1bit[modulate[m]][buf[i]];
+			fp6 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut1bit[modulate[m]][buf[i]];
+			fp7 = lut1bit[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -4144,7 +4148,7 @@ static int vlba_decode_2bit_2track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit1[modulate[i]][buf[i]];
+			fp = lut2bit1[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -4189,7 +4193,7 @@ static int vlba_decode_2bit_2track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit1[modulate[i]][buf[i]];
+			fp = lut2bit1[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += 2;
 
@@ -4235,7 +4239,7 @@ static int vlba_decode_2bit_2track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit1[modulate[i]][buf[i]];
+			fp = lut2bit1[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -4280,7 +4284,7 @@ static int vlba_decode_2bit_4track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit1[modulate[i]][buf[i]];
+			fp = lut2bit1[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -4326,7 +4330,7 @@ static int vlba_decode_2bit_4track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit1[modulate[i]][buf[i]];
+			fp = lut2bit1[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += 2;
 
@@ -4373,7 +4377,7 @@ static int vlba_decode_2bit_4track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit1[modulate[i]][buf[i]];
+			fp = lut2bit1[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -4419,7 +4423,7 @@ static int vlba_decode_2bit_4track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit2[modulate[i]][buf[i]];
+			fp = lut2bit2[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -4466,7 +4470,7 @@ static int vlba_decode_2bit_4track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit2[modulate[i]][buf[i]];
+			fp = lut2bit2[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -4512,7 +4516,7 @@ static int vlba_decode_2bit_4track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit2[modulate[i]][buf[i]];
+			fp = lut2bit2[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -4557,7 +4561,7 @@ static int vlba_decode_2bit_8track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit1[modulate[i]][buf[i]];
+			fp = lut2bit1[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -4606,7 +4610,7 @@ static int vlba_decode_2bit_8track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit1[modulate[i]][buf[i]];
+			fp = lut2bit1[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += 2;
 
@@ -4656,7 +4660,7 @@ static int vlba_decode_2bit_8track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit1[modulate[i]][buf[i]];
+			fp = lut2bit1[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -4704,7 +4708,7 @@ static int vlba_decode_2bit_8track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit2[modulate[i]][buf[i]];
+			fp = lut2bit2[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -4753,7 +4757,7 @@ static int vlba_decode_2bit_8track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit2[modulate[i]][buf[i]];
+			fp = lut2bit2[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -4800,7 +4804,7 @@ static int vlba_decode_2bit_8track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit2[modulate[i]][buf[i]];
+			fp = lut2bit2[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -4846,7 +4850,7 @@ static int vlba_decode_2bit_8track_fanout4_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit3[modulate[i]][buf[i]];
+			fp = lut2bit3[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -4897,7 +4901,7 @@ static int vlba_decode_2bit_8track_fanout4_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit3[modulate[i]][buf[i]];
+			fp = lut2bit3[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		++i;
 
@@ -4945,7 +4949,7 @@ static int vlba_decode_2bit_8track_fanout4_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp = lut2bit3[modulate[i]][buf[i]];
+			fp = lut2bit3[mark5_simd_modulation(modulate, i)][buf[i]];
 		}
 		i += df;
 
@@ -4992,9 +4996,9 @@ static int vlba_decode_2bit_16track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit1[modulate[m]][buf[i]];
+			fp0 = lut2bit1[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit1[modulate[m]][buf[i]];
+			fp1 = lut2bit1[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -5050,9 +5054,9 @@ static int vlba_decode_2bit_16track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit1[modulate[m]][buf[i]];
+			fp0 = lut2bit1[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit1[modulate[m]][buf[i]];
+			fp1 = lut2bit1[mark5_simd_modulation(modulate, m)][buf[i]];
 			i += 3;
 		}
 		m += 2;
@@ -5111,9 +5115,9 @@ static int vlba_decode_2bit_16track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit1[modulate[m]][buf[i]];
+			fp0 = lut2bit1[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit1[modulate[m]][buf[i]];
+			fp1 = lut2bit1[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -5169,9 +5173,9 @@ static int vlba_decode_2bit_16track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit2[modulate[m]][buf[i]];
+			fp0 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit2[modulate[m]][buf[i]];
+			fp1 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -5228,9 +5232,9 @@ static int vlba_decode_2bit_16track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit2[modulate[m]][buf[i]];
+			fp0 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit2[modulate[m]][buf[i]];
+			fp1 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -5285,9 +5289,9 @@ static int vlba_decode_2bit_16track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit2[modulate[m]][buf[i]];
+			fp0 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit2[modulate[m]][buf[i]];
+			fp1 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -5339,9 +5343,9 @@ static int vlba_decode_2bit_16track_fanout4_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit3[modulate[m]][buf[i]];
+			fp0 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit3[modulate[m]][buf[i]];
+			fp1 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -5400,9 +5404,9 @@ static int vlba_decode_2bit_16track_fanout4_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit3[modulate[m]][buf[i]];
+			fp0 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit3[modulate[m]][buf[i]];
+			fp1 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -5458,9 +5462,9 @@ static int vlba_decode_2bit_16track_fanout4_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit3[modulate[m]][buf[i]];
+			fp0 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit3[modulate[m]][buf[i]];
+			fp1 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -5510,13 +5514,13 @@ static int vlba_decode_2bit_32track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit2[modulate[m]][buf[i]];
+			fp0 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit2[modulate[m]][buf[i]];
+			fp1 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit2[modulate[m]][buf[i]];
+			fp2 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit2[modulate[m]][buf[i]];
+			fp3 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -5580,13 +5584,13 @@ static int vlba_decode_2bit_32track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit2[modulate[m]][buf[i]];
+			fp0 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit2[modulate[m]][buf[i]];
+			fp1 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit2[modulate[m]][buf[i]];
+			fp2 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit2[modulate[m]][buf[i]];
+			fp3 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			i += 5;
 		}
 		m += 2;
@@ -5657,13 +5661,13 @@ static int vlba_decode_2bit_32track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit2[modulate[m]][buf[i]];
+			fp0 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit2[modulate[m]][buf[i]];
+			fp1 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit2[modulate[m]][buf[i]];
+			fp2 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit2[modulate[m]][buf[i]];
+			fp3 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -5727,13 +5731,13 @@ static int vlba_decode_2bit_32track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit3[modulate[m]][buf[i]];
+			fp0 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit3[modulate[m]][buf[i]];
+			fp1 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit3[modulate[m]][buf[i]];
+			fp2 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit3[modulate[m]][buf[i]];
+			fp3 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -5798,13 +5802,13 @@ static int vlba_decode_2bit_32track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit3[modulate[m]][buf[i]];
+			fp0 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit3[modulate[m]][buf[i]];
+			fp1 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit3[modulate[m]][buf[i]];
+			fp2 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit3[modulate[m]][buf[i]];
+			fp3 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -5867,13 +5871,13 @@ static int vlba_decode_2bit_32track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit3[modulate[m]][buf[i]];
+			fp0 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit3[modulate[m]][buf[i]];
+			fp1 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit3[modulate[m]][buf[i]];
+			fp2 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit3[modulate[m]][buf[i]];
+			fp3 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -5933,10 +5937,10 @@ static int vlba_decode_2bit_32track_fanout4_decimation1(struct mark5_stream *ms,
 		else
 		{
 			bits = reorder32(buf[i]);
-			fp0 = lut2bit1[modulate[i]][bytes[0]];
-			fp1 = lut2bit1[modulate[i]][bytes[1]];
-			fp2 = lut2bit1[modulate[i]][bytes[2]];
-			fp3 = lut2bit1[modulate[i]][bytes[3]];
+			fp0 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[0]];
+			fp1 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[1]];
+			fp2 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[2]];
+			fp3 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[3]];
 		}
 		++i;
 
@@ -6005,10 +6009,10 @@ static int vlba_decode_2bit_32track_fanout4_decimation2(struct mark5_stream *ms,
 		else
 		{
 			bits = reorder32(buf[i]);
-			fp0 = lut2bit1[modulate[i]][bytes[0]];
-			fp1 = lut2bit1[modulate[i]][bytes[1]];
-			fp2 = lut2bit1[modulate[i]][bytes[2]];
-			fp3 = lut2bit1[modulate[i]][bytes[3]];
+			fp0 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[0]];
+			fp1 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[1]];
+			fp2 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[2]];
+			fp3 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[3]];
 		}
 		++i;
 
@@ -6068,10 +6072,10 @@ static int vlba_decode_2bit_32track_fanout4_decimation4(struct mark5_stream *ms,
 		else
 		{
 			bits = reorder32(buf[i]);
-			fp0 = lut2bit1[modulate[i]][bytes[0]];
-			fp1 = lut2bit1[modulate[i]][bytes[1]];
-			fp2 = lut2bit1[modulate[i]][bytes[2]];
-			fp3 = lut2bit1[modulate[i]][bytes[3]];
+			fp0 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[0]];
+			fp1 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[1]];
+			fp2 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[2]];
+			fp3 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[3]];
 		}
 		i += df;
 
@@ -6121,21 +6125,21 @@ static int vlba_decode_2bit_64track_fanout1_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit2[modulate[m]][buf[i]];
+			fp0 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit2[modulate[m]][buf[i]];
+			fp1 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit2[modulate[m]][buf[i]];
+			fp2 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit2[modulate[m]][buf[i]];
+			fp3 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut2bit2[modulate[m]][buf[i]];
+			fp4 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut2bit2[modulate[m]][buf[i]];
+			fp5 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut2bit2[modulate[m]][buf[i]];
+			fp6 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut2bit2[modulate[m]][buf[i]];
+			fp7 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -6215,21 +6219,21 @@ static int vlba_decode_2bit_64track_fanout1_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit2[modulate[m]][buf[i]];
+			fp0 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit2[modulate[m]][buf[i]];
+			fp1 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit2[modulate[m]][buf[i]];
+			fp2 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit2[modulate[m]][buf[i]];
+			fp3 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut2bit2[modulate[m]][buf[i]];
+			fp4 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut2bit2[modulate[m]][buf[i]];
+			fp5 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut2bit2[modulate[m]][buf[i]];
+			fp6 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut2bit2[modulate[m]][buf[i]];
+			fp7 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			i += 9;
 		}
 		m += 2;
@@ -6311,21 +6315,21 @@ static int vlba_decode_2bit_64track_fanout1_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit2[modulate[m]][buf[i]];
+			fp0 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit2[modulate[m]][buf[i]];
+			fp1 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit2[modulate[m]][buf[i]];
+			fp2 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit2[modulate[m]][buf[i]];
+			fp3 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut2bit2[modulate[m]][buf[i]];
+			fp4 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut2bit2[modulate[m]][buf[i]];
+			fp5 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut2bit2[modulate[m]][buf[i]];
+			fp6 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut2bit2[modulate[m]][buf[i]];
+			fp7 = lut2bit2[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -6405,21 +6409,21 @@ static int vlba_decode_2bit_64track_fanout2_decimation1(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit3[modulate[m]][buf[i]];
+			fp0 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit3[modulate[m]][buf[i]];
+			fp1 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit3[modulate[m]][buf[i]];
+			fp2 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit3[modulate[m]][buf[i]];
+			fp3 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut2bit3[modulate[m]][buf[i]];
+			fp4 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut2bit3[modulate[m]][buf[i]];
+			fp5 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut2bit3[modulate[m]][buf[i]];
+			fp6 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut2bit3[modulate[m]][buf[i]];
+			fp7 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -6500,21 +6504,21 @@ static int vlba_decode_2bit_64track_fanout2_decimation2(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit3[modulate[m]][buf[i]];
+			fp0 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit3[modulate[m]][buf[i]];
+			fp1 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit3[modulate[m]][buf[i]];
+			fp2 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit3[modulate[m]][buf[i]];
+			fp3 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut2bit3[modulate[m]][buf[i]];
+			fp4 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut2bit3[modulate[m]][buf[i]];
+			fp5 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut2bit3[modulate[m]][buf[i]];
+			fp6 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut2bit3[modulate[m]][buf[i]];
+			fp7 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
 		}
 		++m;
@@ -6580,21 +6584,21 @@ static int vlba_decode_2bit_64track_fanout2_decimation4(struct mark5_stream *ms,
 		}
 		else
 		{
-			fp0 = lut2bit3[modulate[m]][buf[i]];
+			fp0 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp1 = lut2bit3[modulate[m]][buf[i]];
+			fp1 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp2 = lut2bit3[modulate[m]][buf[i]];
+			fp2 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp3 = lut2bit3[modulate[m]][buf[i]];
+			fp3 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp4 = lut2bit3[modulate[m]][buf[i]];
+			fp4 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp5 = lut2bit3[modulate[m]][buf[i]];
+			fp5 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp6 = lut2bit3[modulate[m]][buf[i]];
+			fp6 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 			++i;
-			fp7 = lut2bit3[modulate[m]][buf[i]];
+			fp7 = lut2bit3[mark5_simd_modulation(modulate, m)][buf[i]];
 		}
 		i += df;
 		m += df2;
@@ -6662,14 +6666,14 @@ static int vlba_decode_2bit_64track_fanout4_decimation1(struct mark5_stream *ms,
 		else
 		{
 			bits = reorder64(buf[i]);
-			fp0 = lut2bit1[modulate[i]][bytes[0]];
-			fp1 = lut2bit1[modulate[i]][bytes[1]];
-			fp2 = lut2bit1[modulate[i]][bytes[2]];
-			fp3 = lut2bit1[modulate[i]][bytes[3]];
-			fp4 = lut2bit1[modulate[i]][bytes[4]];
-			fp5 = lut2bit1[modulate[i]][bytes[5]];
-			fp6 = lut2bit1[modulate[i]][bytes[6]];
-			fp7 = lut2bit1[modulate[i]][bytes[7]];
+			fp0 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[0]];
+			fp1 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[1]];
+			fp2 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[2]];
+			fp3 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[3]];
+			fp4 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[4]];
+			fp5 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[5]];
+			fp6 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[6]];
+			fp7 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[7]];
 		}
 		++i;
 		
@@ -6754,14 +6758,14 @@ static int vlba_decode_2bit_64track_fanout4_decimation2(struct mark5_stream *ms,
 		else
 		{
 			bits = reorder64(buf[i]);
-			fp0 = lut2bit1[modulate[i]][bytes[0]];
-			fp1 = lut2bit1[modulate[i]][bytes[1]];
-			fp2 = lut2bit1[modulate[i]][bytes[2]];
-			fp3 = lut2bit1[modulate[i]][bytes[3]];
-			fp4 = lut2bit1[modulate[i]][bytes[4]];
-			fp5 = lut2bit1[modulate[i]][bytes[5]];
-			fp6 = lut2bit1[modulate[i]][bytes[6]];
-			fp7 = lut2bit1[modulate[i]][bytes[7]];
+			fp0 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[0]];
+			fp1 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[1]];
+			fp2 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[2]];
+			fp3 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[3]];
+			fp4 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[4]];
+			fp5 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[5]];
+			fp6 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[6]];
+			fp7 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[7]];
 		}
 		++i;
 		
@@ -6829,14 +6833,14 @@ static int vlba_decode_2bit_64track_fanout4_decimation4(struct mark5_stream *ms,
 		else
 		{
 			bits = reorder64(buf[i]);
-			fp0 = lut2bit1[modulate[i]][bytes[0]];
-			fp1 = lut2bit1[modulate[i]][bytes[1]];
-			fp2 = lut2bit1[modulate[i]][bytes[2]];
-			fp3 = lut2bit1[modulate[i]][bytes[3]];
-			fp4 = lut2bit1[modulate[i]][bytes[4]];
-			fp5 = lut2bit1[modulate[i]][bytes[5]];
-			fp6 = lut2bit1[modulate[i]][bytes[6]];
-			fp7 = lut2bit1[modulate[i]][bytes[7]];
+			fp0 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[0]];
+			fp1 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[1]];
+			fp2 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[2]];
+			fp3 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[3]];
+			fp4 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[4]];
+			fp5 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[5]];
+			fp6 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[6]];
+			fp7 = lut2bit1[mark5_simd_modulation(modulate, i)][bytes[7]];
 		}
 		i += df;
 		
@@ -9490,6 +9494,24 @@ static int vlba_count_2bit_64track_fanout4_decimation4(struct mark5_stream *ms,
 
 /******************************************************************/
 
+/******************** vectorized decode routines *******************/
+
+/* Undecimated data only; bit positions are those of the decoder it replaces */
+static int vlba_decode_simd(struct mark5_stream *ms, int nsamp, float **data)
+{
+	return mark5_simd_decode_stream(ms, &((const struct mark5_format_vlba *)(ms->formatdata))->simd, 0, nsamp, data);
+}
+
+static int vlba_decode_channels_simd(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data)
+{
+	return mark5_simd_decode_channels_stream(ms, &((const struct mark5_format_vlba *)(ms->formatdata))->simd, 0, nsamp, chanlist, nsel, data);
+}
+
+static int vlba_stats_simd(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats)
+{
+	return mark5_simd_stats_stream(ms, &((const struct mark5_format_vlba *)(ms->formatdata))->simd, 0, nsamp, stats);
+}
+
 static int mark5_format_vlba_make_formatname(struct mark5_stream *ms)
 {
 	const struct mark5_format_vlba *f;
@@ -10093,5 +10115,26 @@ struct mark5_format_generic *new_mark5_format_vlba(int Mbps, int nchan, int nbit
 		return 0;
 	}
 
+	/* Use the vector unpacker when the cpu (and M5A_OPT_SIMDLEVEL) allows */
+	if(decimation == 1)
+	{
+		float levels[4];
+		int l;
+
+		for(l = 0; l < (1 << nbit); ++l)
+		{
+			levels[l] = (nbit == 1) ? lut1bit[0][l][0] : lut2bit1[0][l][0];
+		}
+		if(mark5_simd_layout_probe(&v->simd, f->decode, nbit, nchan, ntrack >= 8 ? ntrack/8 : 1, fanout, levels, modulate) == 0)
+		{
+			f->decode = vlba_decode_simd;
+			f->decode_channels = vlba_decode_channels_simd;
+		}
+		if(mark5_simd_stats_supported(&v->simd))
+		{
+			f->accumulate_stats = vlba_stats_simd;
+		}
+	}
+
 	return f;
 }
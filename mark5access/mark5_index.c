@@ -0,0 +1,511 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "mark5access/mark5_stream.h"
+
+/* A stream with dropped frames no longer has its n'th frame at n frame
+ * durations after its start, so mark5_stream_seek() cannot compute where a
+ * time is.  The index records the frame number and time of every frame that
+ * does not follow in time from the last valid one, so a seek becomes a
+ * look-up followed by the usual computation within one continuous segment.
+ */
+
+#define MARK5_INDEX_ALLOC	64
+
+/* t1 - t0, in ns */
+static double mark5_index_diffns(int mjd1, int sec1, double ns1, int mjd0, int sec0, double ns0)
+{
+	return 86400000000000.0*(mjd1 - mjd0) + 1000000000.0*(sec1 - sec0) + (ns1 - ns0);
+}
+
+/* is frame f at the time expected from frame g? */
+static int mark5_index_insequence(const struct mark5_index_entry *f, const struct mark5_index_entry *g, double framens)
+{
+	double dt;
+
+	dt = mark5_index_diffns(f->mjd, f->sec, f->ns, g->mjd, g->sec, g->ns) - (f->framenum - g->framenum)*framens;
+
+	return fabs(dt) <= framens/2.0;
+}
+
+static struct mark5_index_entry *mark5_index_add_entry(struct mark5_index *idx)
+{
+	if(idx->nentry >= idx->nalloc)
+	{
+		struct mark5_index_entry *entry;
+		int nalloc;
+
+		nalloc = idx->nalloc > 0 ? 2*idx->nalloc : MARK5_INDEX_ALLOC;
+		entry = (struct mark5_index_entry *)realloc(idx->entry, nalloc*sizeof(struct mark5_index_entry));
+		if(!entry)
+		{
+			fprintf(m5stderr, "Error allocating memory for %d index entries\n", nalloc);
+
+			return 0;
+		}
+		idx->entry = entry;
+		idx->nalloc = nalloc;
+	}
+
+	return idx->entry + idx->nentry++;
+}
+
+static struct mark5_index *new_mark5_index(void)
+{
+	struct mark5_index *idx;
+
+	idx = (struct mark5_index *)calloc(1, sizeof(struct mark5_index));
+	if(!idx)
+	{
+		fprintf(m5stderr, "Error allocating memory for mark5_index\n");
+
+		return 0;
+	}
+	idx->monotonic = 1;
+
+	return idx;
+}
+
+void delete_mark5_index(struct mark5_index *idx)
+{
+	if(idx)
+	{
+		if(idx->entry)
+		{
+			free(idx->entry);
+		}
+		free(idx);
+	}
+}
+
+/* Every frame's time is compared with the time expected from the last frame
+ * in sequence.  validate() cannot be used for that as it compares with the
+ * time expected from the start of the stream, which fails after any gap.
+ * A frame out of sequence starts a new entry once the frame after it (or
+ * later, skipping junk) is in sequence with it; fill pattern never is.
+ */
+struct mark5_index *new_mark5_index_from_stream(struct mark5_stream *ms)
+{
+	struct mark5_index *idx;
+	struct mark5_index_entry *e = 0;
+	struct mark5_index_entry last;		/* last frame in sequence */
+	struct mark5_index_entry pending;	/* frame out of sequence, maybe the first of a new one */
+	int havepending = 0;
+
+	if(!ms || !ms->gettime || ms->framens <= 0.0)
+	{
+		return 0;
+	}
+
+	idx = new_mark5_index();
+	if(!idx)
+	{
+		return 0;
+	}
+	snprintf(idx->formatname, MARK5_STREAM_ID_LENGTH, "%s", ms->formatname);
+	idx->framebytes = ms->framebytes;
+	idx->frameoffset = ms->frameoffset;
+	idx->framens = ms->framens;
+	memset(&last, 0, sizeof(last));
+	memset(&pending, 0, sizeof(pending));
+
+	/* only the headers are looked at: no blanking and no decoding */
+	while(ms->frame)
+	{
+		struct mark5_index_entry f;
+
+		f.framenum = ms->framenum;
+		f.nframe = 1;
+		if(ms->gettime(ms, &f.mjd, &f.sec, &f.ns) < 0)
+		{
+			++idx->ninvalid;
+		}
+		else if(e && mark5_index_insequence(&f, &last, idx->framens))
+		{
+			e->nframe = f.framenum - e->framenum + 1;
+			last = f;
+		}
+		else
+		{
+			int confirmed;
+
+			confirmed = havepending && mark5_index_insequence(&f, &pending, idx->framens);
+			if(confirmed || (!e && ms->validate(ms)))
+			{
+				if(confirmed)
+				{
+					--idx->ninvalid;	/* the pending frame was in sequence after all */
+				}
+				else
+				{
+					pending = f;
+				}
+				if(e && mark5_index_diffns(pending.mjd, pending.sec, pending.ns, e->mjd, e->sec, e->ns) <= 0.0)
+				{
+					idx->monotonic = 0;
+				}
+				e = mark5_index_add_entry(idx);
+				if(!e)
+				{
+					delete_mark5_index(idx);
+
+					return 0;
+				}
+				*e = pending;
+				e->nframe = f.framenum - e->framenum + 1;
+				last = f;
+				havepending = 0;
+			}
+			else
+			{
+				pending = f;
+				havepending = 1;
+				++idx->ninvalid;
+			}
+		}
+		idx->nframe = ms->framenum + 1;
+
+		if(ms->next(ms) < 0)
+		{
+			break;
+		}
+	}
+	ms->payload = 0;
+
+	return idx;
+}
+
+struct mark5_index *new_mark5_index_from_file(const char *filename)
+{
+	struct mark5_index *idx;
+	FILE *in;
+	char line[256];
+	int lineno = 0;
+
+	in = fopen(filename, "r");
+	if(!in)
+	{
+		fprintf(m5stderr, "Cannot open index file <%s>\n", filename);
+
+		return 0;
+	}
+
+	idx = new_mark5_index();
+	if(!idx)
+	{
+		fclose(in);
+
+		return 0;
+	}
+
+	while(fgets(line, sizeof(line), in))
+	{
+		struct mark5_index_entry entry, *e;
+		long long byteoffset;
+
+		++lineno;
+		if(line[0] == '#' || line[0] == '\n')
+		{
+			continue;
+		}
+		if(sscanf(line, "FORMAT %255s", idx->formatname) == 1 ||
+		   sscanf(line, "FRAMEBYTES %d", &idx->framebytes) == 1 ||
+		   sscanf(line, "FRAMEOFFSET %d", &idx->frameoffset) == 1 ||
+		   sscanf(line, "FRAMENS %lf", &idx->framens) == 1 ||
+		   sscanf(line, "NFRAME %lld", &idx->nframe) == 1 ||
+		   sscanf(line, "NINVALID %lld", &idx->ninvalid) == 1)
+		{
+			continue;
+		}
+		if(sscanf(line, "%lld %lld %lld %d %d %lf", &entry.framenum, &byteoffset, &entry.nframe, &entry.mjd, &entry.sec, &entry.ns) != 6)
+		{
+			fprintf(m5stderr, "Index file <%s> line %d cannot be parsed: %s", filename, lineno, line);
+			delete_mark5_index(idx);
+			fclose(in);
+
+			return 0;
+		}
+		if(idx->nentry > 0)
+		{
+			e = idx->entry + idx->nentry - 1;
+			if(mark5_index_diffns(entry.mjd, entry.sec, entry.ns, e->mjd, e->sec, e->ns) <= 0.0)
+			{
+				idx->monotonic = 0;
+			}
+		}
+		e = mark5_index_add_entry(idx);
+		if(!e)
+		{
+			delete_mark5_index(idx);
+			fclose(in);
+
+			return 0;
+		}
+		*e = entry;
+	}
+	fclose(in);
+
+	if(idx->framebytes <= 0 || idx->framens <= 0.0)
+	{
+		fprintf(m5stderr, "Index file <%s> lacks FRAMEBYTES or FRAMENS\n", filename);
+		delete_mark5_index(idx);
+
+		return 0;
+	}
+
+	return idx;
+}
+
+int mark5_index_write(const struct mark5_index *idx, const char *filename)
+{
+	FILE *out;
+	int i;
+
+	if(!idx)
+	{
+		return -1;
+	}
+
+	out = fopen(filename, "w");
+	if(!out)
+	{
+		fprintf(m5stderr, "Cannot open index file <%s> for write\n", filename);
+
+		return -1;
+	}
+
+	fprintf(out, "# mark5access frame index\n");
+	fprintf(out, "FORMAT %s\n", idx->formatname);
+	fprintf(out, "FRAMEBYTES %d\n", idx->framebytes);
+	fprintf(out, "FRAMEOFFSET %d\n", idx->frameoffset);
+	fprintf(out, "FRAMENS %.6f\n", idx->framens);
+	fprintf(out, "NFRAME %lld\n", idx->nframe);
+	fprintf(out, "NINVALID %lld\n", idx->ninvalid);
+	fprintf(out, "# framenum byteoffset nframe mjd sec ns\n");
+	for(i = 0; i < idx->nentry; ++i)
+	{
+		const struct mark5_index_entry *e = idx->entry + i;
+
+		fprintf(out, "%lld %lld %lld %d %d %.6f\n", e->framenum,
+			idx->frameoffset + e->framenum*idx->framebytes,
+			e->nframe, e->mjd, e->sec, e->ns);
+	}
+
+	if(fclose(out) != 0)
+	{
+		fprintf(m5stderr, "Error writing index file <%s>\n", filename);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+void mark5_index_print(const struct mark5_index *idx)
+{
+	int i;
+
+	fprintf(m5stdout, "Mark5 index: %p\n", idx);
+	if(!idx)
+	{
+		return;
+	}
+	fprintf(m5stdout, "  format = %s\n", idx->formatname);
+	fprintf(m5stdout, "  frame bytes = %d\n", idx->framebytes);
+	fprintf(m5stdout, "  frame offset = %d\n", idx->frameoffset);
+	fprintf(m5stdout, "  frame duration = %8.2f ns\n", idx->framens);
+	fprintf(m5stdout, "  frames = %lld, %lld invalid\n", idx->nframe, idx->ninvalid);
+	fprintf(m5stdout, "  entries = %d%s\n", idx->nentry, idx->monotonic ? "" : " (not in time order)");
+	for(i = 0; i < idx->nentry; ++i)
+	{
+		const struct mark5_index_entry *e = idx->entry + i;
+
+		fprintf(m5stdout, "    frame %lld x %lld : mjd/sec = %d %05d.%09.0f\n",
+			e->framenum, e->nframe, e->mjd, e->sec, e->ns);
+	}
+}
+
+int mark5_index_find(const struct mark5_index *idx, int mjd, int sec, double ns, long long *framenum)
+{
+	const struct mark5_index_entry *e, *next = 0;
+	double d, dnext = 0.0;
+	long long k;
+	int i;
+
+	if(!idx || idx->nentry < 1)
+	{
+		return -1;
+	}
+
+	if(idx->monotonic)
+	{
+		int lo = 0, hi = idx->nentry;
+
+		/* last entry not after the given time */
+		while(hi - lo > 1)
+		{
+			int mid = (lo + hi)/2;
+
+			e = idx->entry + mid;
+			if(mark5_index_diffns(mjd, sec, ns, e->mjd, e->sec, e->ns) < 0.0)
+			{
+				hi = mid;
+			}
+			else
+			{
+				lo = mid;
+			}
+		}
+		e = idx->entry + lo;
+		d = mark5_index_diffns(mjd, sec, ns, e->mjd, e->sec, e->ns);
+		if(d < 0.0)	/* before start of stream */
+		{
+			return -1;
+		}
+		k = (long long)(d/idx->framens);
+		if(k < e->nframe)
+		{
+			*framenum = e->framenum + k;
+
+			return 0;
+		}
+		if(lo + 1 < idx->nentry)	/* in a gap */
+		{
+			*framenum = idx->entry[lo + 1].framenum;
+
+			return 0;
+		}
+
+		return -1;
+	}
+
+	/* out of time order: look through all segments, else take the first frame after the time */
+	for(i = 0; i < idx->nentry; ++i)
+	{
+		e = idx->entry + i;
+		d = mark5_index_diffns(mjd, sec, ns, e->mjd, e->sec, e->ns);
+		if(d >= 0.0)
+		{
+			k = (long long)(d/idx->framens);
+			if(k < e->nframe)
+			{
+				*framenum = e->framenum + k;
+
+				return 0;
+			}
+		}
+		else if(!next || d > dnext)
+		{
+			next = e;
+			dnext = d;
+		}
+	}
+	if(next)
+	{
+		*framenum = next->framenum;
+
+		return 0;
+	}
+
+	return -1;
+}
+
+int mark5_index_frame_time(const struct mark5_index *idx, long long framenum, int *mjd, int *sec, double *ns)
+{
+	const struct mark5_index_entry *e;
+	long long k;
+	int i;
+
+	if(!idx)
+	{
+		return -1;
+	}
+
+	for(i = 0; i < idx->nentry; ++i)
+	{
+		e = idx->entry + i;
+		k = framenum - e->framenum;
+		if(k >= 0 && k < e->nframe)
+		{
+			*mjd = e->mjd;
+			*sec = e->sec;
+			*ns = e->ns + k*idx->framens;
+			*sec += (int)(*ns/1000000000.0);
+			*ns -= 1000000000.0*(int)(*ns/1000000000.0);
+			*mjd += *sec/86400;
+			*sec %= 86400;
+
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int mark5_stream_set_index(struct mark5_stream *ms, struct mark5_index *idx)
+{
+	if(!ms)
+	{
+		return -1;
+	}
+	if(idx)
+	{
+		if(idx->framebytes != ms->framebytes || idx->frameoffset != ms->frameoffset ||
+		   fabs(idx->framens - ms->framens) > 1.0e-6*ms->framens)
+		{
+			fprintf(m5stderr, "mark5_stream_set_index: index of %s (%d bytes at offset %d, %f ns) does not fit stream %s (%d bytes at offset %d, %f ns)\n",
+				idx->formatname, idx->framebytes, idx->frameoffset, idx->framens,
+				ms->formatname, ms->framebytes, ms->frameoffset, ms->framens);
+
+			return -1;
+		}
+		if(idx->nentry > 0 && idx->entry[0].framenum == 0 &&
+		   fabs(mark5_index_diffns(idx->entry[0].mjd, idx->entry[0].sec, idx->entry[0].ns, ms->mjd, ms->sec, ms->ns)) > ms->framens/2.0)
+		{
+			fprintf(m5stderr, "mark5_stream_set_index: index starts at mjd/sec = %d %05d, stream %s at %d %05d\n",
+				idx->entry[0].mjd, idx->entry[0].sec, ms->streamname, ms->mjd, ms->sec);
+
+			return -1;
+		}
+	}
+	if(ms->frameindex && ms->frameindex != idx)
+	{
+		delete_mark5_index(ms->frameindex);
+	}
+	ms->frameindex = idx;
+
+	return 0;
+}
@@ -38,10 +38,13 @@
 #include <string.h>
 #include <math.h>
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 
 #include "config.h"
 
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_unpack_simd.h"
 
 FILE* m5stderr = (FILE*)NULL;
 FILE* m5stdout = (FILE*)NULL;
@@ -59,6 +62,9 @@ void __attribute__ ((constructor)) autocall_mark5_library_init(void)
 
 void mark5_library_init(void)
 {
+	const char *e;
+	int level = MK5_SIMD_AUTO;
+
 	// Apply all defaults
 	// Note: Apple OS X: during auto-((constructor)) the C-lib stdout, stderr may still be uninitialized/null
 	if(stdout != NULL)
@@ -69,6 +75,50 @@ void mark5_library_init(void)
 	{
 		m5stderr = stderr;
 	}
+
+	// Allow decoder instruction set to be pinned, e.g., for benchmarking
+	e = getenv("MARK5ACCESS_SIMD");
+	if(e != NULL)
+	{
+		level = mark5_simd_level_from_name(e);
+		if(level < MK5_SIMD_AUTO)
+		{
+			if(m5stderr != NULL)
+			{
+				fprintf(m5stderr, "Warning: MARK5ACCESS_SIMD=%s not understood; using best available\n", e);
+			}
+			level = MK5_SIMD_AUTO;
+		}
+	}
+	mark5_simd_set_level(level);
+
+	// Allow file streams to read ahead in a thread, e.g., from slow disks
+	e = getenv("MARK5ACCESS_READAHEAD");
+	if(e != NULL)
+	{
+		if(mark5_stream_file_set_readahead(atoi(e)) != 0 && m5stderr != NULL)
+		{
+			fprintf(m5stderr, "Warning: MARK5ACCESS_READAHEAD=%s not usable; reading synchronously\n", e);
+		}
+	}
+	e = getenv("MARK5ACCESS_FILEIO");
+	if(e != NULL)
+	{
+		if(mark5_stream_file_set_fileio(atoi(e)) != 0 && m5stderr != NULL)
+		{
+			fprintf(m5stderr, "Warning: MARK5ACCESS_FILEIO=%s not understood; ignored\n", e);
+		}
+	}
+
+	// Allow file summaries to be kept between runs
+	e = getenv("MARK5ACCESS_CACHE");
+	if(e != NULL)
+	{
+		if(mark5_cache_set_path(e) != 0 && m5stderr != NULL)
+		{
+			fprintf(m5stderr, "Warning: MARK5ACCESS_CACHE=%s not usable; not caching\n", e);
+		}
+	}
 }
 
 static void mark5_library_consistent(void)
@@ -101,6 +151,18 @@ int mark5_library_getoption(const int mk5option, void *result)
 		case M5A_OPT_STDERRFD:
 			*((FILE**)result) = m5stderr;
 			return sizeof(FILE*);
+		case M5A_OPT_SIMDLEVEL:
+			*((int*)result) = mark5_simd_level();
+			return sizeof(int);
+		case M5A_OPT_READAHEAD:
+			*((int*)result) = mark5_stream_file_get_readahead();
+			return sizeof(int);
+		case M5A_OPT_FILEIO:
+			*((int*)result) = mark5_stream_file_get_fileio();
+			return sizeof(int);
+		case M5A_OPT_CACHE:
+			*((const char**)result) = mark5_cache_get_path();
+			return sizeof(const char*);
 		default:
 			break;
 	}
@@ -129,6 +191,30 @@ int mark5_library_setoption(const int mk5option, void *value)
 			m5stderr = (FILE*)value;
 			rc = sizeof(FILE*);
 			break;
+		case M5A_OPT_SIMDLEVEL:
+			if(mark5_simd_set_level(*((int*)value)) == 0)
+			{
+				rc = sizeof(int);
+			}
+			break;
+		case M5A_OPT_READAHEAD:
+			if(mark5_stream_file_set_readahead(*((int*)value)) == 0)
+			{
+				rc = sizeof(int);
+			}
+			break;
+		case M5A_OPT_FILEIO:
+			if(mark5_stream_file_set_fileio(*((int*)value)) == 0)
+			{
+				rc = sizeof(int);
+			}
+			break;
+		case M5A_OPT_CACHE:
+			if(mark5_cache_set_path((const char*)value) == 0)
+			{
+				rc = sizeof(const char*);
+			}
+			break;
 		default:
 			rc = -1;
 			break;		
@@ -148,6 +234,12 @@ static void mark5_stream_blank_frame(struct mark5_stream *ms)
 		ms->blankzonestartvalid[z] = 1<<30;
 		ms->blankzoneendvalid[z] = 0;
 	}
+	ms->nvalidrange = 0;
+	if(ms->blanker == blanker_exact)
+	{
+		ms->nblankrange = 0;
+		mark5_stream_add_blank_range(ms, 0, ms->databytes);
+	}
 }
 
 int mark5_stream_next_frame(struct mark5_stream *ms)
@@ -189,6 +281,7 @@ int mark5_stream_next_frame(struct mark5_stream *ms)
 	}
 	
 	/* blank bad data if any */
+	ms->chanmissing = 0;
 	if(v)
 	{
 		ms->blanker(ms);
@@ -233,6 +326,8 @@ static int set_format(struct mark5_stream *ms, const struct mark5_format_generic
 		ms->final_format = f->final_format;
 		ms->decode = f->decode;
 		ms->count = f->count;
+		ms->decode_channels = f->decode_channels;
+		ms->accumulate_stats = f->accumulate_stats;
 		ms->iscomplex = f->iscomplex;
 		ms->complex_decode = f->complex_decode;
 		ms->validate = f->validate;
@@ -451,9 +546,9 @@ struct mark5_format_generic *new_mark5_format_generic_from_string( const char *f
 		}
 		return new_mark5_format_kvn5b(a, b, c, e);
 	}
-	else if(strncasecmp(formatname, "D2K-", 6) == 0)
+	else if(strncasecmp(formatname, "D2K-", 4) == 0)
 	{
-		r = sscanf(formatname+6, "%d-%d-%d/%d", &a, &b, &c, &e);
+		r = sscanf(formatname+4, "%d-%d-%d/%d", &a, &b, &c, &e);
 		if(r < 3)
 		{
 			return 0;
@@ -742,9 +837,9 @@ struct mark5_format *new_mark5_format_from_name(const char *formatname)
 			decimation = e;
 		}
 	}
-	else if(strncasecmp(formatname, "D2K-", 6) == 0)
+	else if(strncasecmp(formatname, "D2K-", 4) == 0)
 	{
-		r = sscanf(formatname+6, "%d-%d-%d/%d", &b, &c, &d, &e);
+		r = sscanf(formatname+4, "%d-%d-%d/%d", &b, &c, &d, &e);
 		if(r < 3)
 		{
 			return 0;
@@ -1003,314 +1098,530 @@ struct mark5_format *new_mark5_format_from_name(const char *formatname)
 	return f;
 }
 
-struct mark5_format *new_mark5_format_from_stream(struct mark5_stream_generic *s)
-{
-	struct mark5_stream *ms;
-	struct mark5_format_generic *f;
-	struct mark5_format *mf;
-	int status, ntrack;
-	size_t offset;
-	int framesize, headersize;
+/* Format detection.  Cheap checks of the sync words or headers of each
+ * format family over the first window of the stream propose candidates,
+ * each scored by how many of up to MARK5_DETECT_CONFIRM frames after the
+ * first one found have a sync word or header agreeing with it in the right
+ * place.  Only the candidates are then fully checked, by the format's own
+ * init on that same window, several at once on threads.  Once a candidate
+ * with the highest possible score has passed, those not yet started that
+ * scored lower are skipped.
+ */
 
-	mark5_library_consistent();
-	
-	if(!s)
-	{
-		return 0;
-	}
-	
-	mf = (struct mark5_format *)calloc(1, sizeof(struct mark5_format));
-	
-	ms = (struct mark5_stream *)calloc(1, sizeof(struct mark5_stream));
-	
-	if(set_stream(ms, s) < 0)
-	{
-		free(mf);
-		free(ms);
+#define MARK5_DETECT_CONFIRM		8
+#define MARK5_DETECT_MAXCANDIDATES	16
+#define MARK5_DETECT_MAXTHREADS		8
 
-		fprintf(m5stderr, "new_mark5_format_from_stream: Incomplete stream.\n");
-		
-		return 0;
-	}
+struct mark5_detect_candidate
+{
+	enum Mark5Format format;
+	int ntrack;
+	long long offset;		/* of the first frame, for VDIF and CODIF */
+	int score;			/* from the cheap check */
+	int order;			/* position in the old try order; breaks ties in score */
+	struct mark5_format_generic *f;	/* made beforehand: constructors fill shared tables */
+	struct mark5_format result;
+	int status;			/* 1 = passed, 0 = failed, -1 = skipped */
+};
+
+struct mark5_detect
+{
+	const unsigned char *data;
+	long long length;
+	struct mark5_detect_candidate candidate[MARK5_DETECT_MAXCANDIDATES];
+	int ncandidate;
+	int next;			/* candidate to check next */
+	int bestscore;			/* highest score passed so far */
+	pthread_mutex_t lock;
+};
+
+/* Mark5B: each 10016 byte frame starts with the sync word 0xABADDEED */
+static int mark5_detect_mark5b(const unsigned char *data, long long length)
+{
+	const unsigned int sync = 0xABADDEED;
+	const int framebytes = 10016;
+	long long o;
+	int best = 0;
 
-	status = s->init_stream(ms);
-	if(status < 0)
+	for(o = 0; o + framebytes + 4 <= length && o < framebytes; ++o)
 	{
-		free(mf);
-		delete_mark5_stream(ms);
-		fprintf(m5stderr, "new_mark5_format_from_stream: init_stream() failed\n");
-		
-		return 0;
-	}
+		const unsigned char *p;
+		int k;
 
-	/* Now go through known formats, looking for a match with the data */
-	
-	/* Mark5b */
-	f = new_mark5_format_mark5b(0, 16, 2, 1);
-	set_format(ms, f);
-	status = mark5_format_init(ms);
-	if(status < 0)
-	{
-		if(f->final_format)
+		p = (const unsigned char *)memchr(data + o, ((const unsigned char *)&sync)[0], framebytes - o);
+		if(!p)
 		{
-			f->final_format(ms);
+			break;
 		}
-		free(f);
-	}
-	else
-	{
-		copy_format(ms, mf);
-		mf->format = MK5_FORMAT_MARK5B;
-		mf->ntrack = 0;
-		delete_mark5_stream(ms);
-		
-		return mf;
-	}
-	/* Warning: there is no way to know if data is KVN5B vs. Mark5B format.  Don't search for KVN5B as that is less standard. */
-
-	/* VLBA modes */
-	for(ntrack = 8; ntrack <= 64; ntrack*=2)
-	{
-		f = new_mark5_format_vlba(0, ntrack, 1, 1, 1);
-		set_format(ms, f);
-		status = mark5_format_init(ms);
-		if(status < 0)
+		o = p - data;
+		if(memcmp(p, &sync, 4) != 0)
 		{
-			if(f->final_format)
-			{
-				f->final_format(ms);
-			}
-			free(f);
+			continue;
 		}
-		else
+		for(k = 0; k < MARK5_DETECT_CONFIRM; ++k)
 		{
-			copy_format(ms, mf);
-			mf->format = MK5_FORMAT_VLBA;
-			mf->ntrack = ntrack;
-			mf->fanout = ntrack/(ms->nbit*ms->nchan);
-			delete_mark5_stream(ms);
-			
-			return mf;
+			p += framebytes;
+			if(p + 4 > data + length || memcmp(p, &sync, 4) != 0)
+			{
+				break;
+			}
 		}
-	}
-	
-	/* Mark4 modes */
-	for(ntrack = 8; ntrack <= 64; ntrack*=2)
-	{
-		f = new_mark5_format_mark4(0, ntrack, 1, 1, 1);
-		set_format(ms, f);
-		status = mark5_format_init(ms);
-		if(status < 0)
+		if(k > best)
 		{
-			if(f->final_format)
+			best = k;
+			if(k == MARK5_DETECT_CONFIRM)
 			{
-				f->final_format(ms);
+				break;
 			}
-			free(f);
 		}
-		else
+	}
+
+	return best;
+}
+
+/* are the n bytes at p (nearly) all ones, as in a VLBA or Mark4 sync word? */
+static int mark5_detect_ones(const unsigned char *p, int n)
+{
+	int i;
+
+	for(i = 0; i < n; ++i)
+	{
+		if(__builtin_popcount(p[i]) < 6)
 		{
-			copy_format(ms, mf);
-			mf->format = MK5_FORMAT_MARK4;
-			mf->ntrack = ntrack;
-			mf->fanout = ntrack/(ms->nbit*ms->nchan);
-			delete_mark5_stream(ms);
-			
-			return mf;
+			return 0;
 		}
 	}
 
-	/* VDIF */
-	framesize = 0;
-	if(find_vdif_frame(ms->datawindow, ms->datawindowsize, &offset, &framesize) >= 0)
+	return 1;
+}
+
+/* VLBA and Mark4: a sync word of 32 set bits on every track, so 4*ntrack
+ * bytes of ones, recurs every framebytes.  Runs of ones are looked for
+ * 8 bytes at a time.
+ */
+static int mark5_detect_tracks(const unsigned char *data, long long length, int framebytes, int ntrack)
+{
+	const int syncbytes = 4*ntrack;
+	long long o;
+	int best = 0;
+
+	for(o = 0; o + 8 <= length && o < framebytes + syncbytes; o += 8)
 	{
-		ms->frameoffset = offset;
-		f = new_mark5_format_vdif(
-			1024, 	// Need to give it something.  This will be wrong in general and will have to be fixed by downstream software.
-			get_vdif_chans_per_thread(ms->datawindow+offset),
-			get_vdif_quantization_bits(ms->datawindow+offset),
-			1,
-			framesize-32,
-			32,
-			get_vdif_complex(ms->datawindow+offset) );
+		unsigned long long w;
+		long long start, s;
+		int k;
 
-		set_format(ms, f);
-		status = mark5_format_init(ms);
-		if(status < 0)
+		memcpy(&w, data + o, 8);
+		if(w != ~0ULL)
 		{
-			if(f->final_format)
-			{
-				f->final_format(ms);
-			}
-			free(f);
+			continue;
 		}
-		else
+		/* the start of the run of ones holding these 8 bytes */
+		start = o;
+		while(start > 0 && o - start < syncbytes && __builtin_popcount(data[start - 1]) >= 6)
 		{
-			copy_format(ms, mf);
-			mf->format = MK5_FORMAT_VDIF;
-			mf->ntrack = get_vdif_threads(ms->datawindow+offset, ms->datawindowsize-offset, framesize);
-			delete_mark5_stream(ms);
-			
-			return mf;
+			--start;
 		}
-	}
-
-	/* VDIFL */
-	framesize = 0;
-	if(find_vdifl_frame(ms->datawindow, ms->datawindowsize, &offset, &framesize) >= 0)
-	{
-		ms->frameoffset = offset;
-		f = new_mark5_format_vdif(
-			1024, 	// Need to give it something.  This will be wrong in general and will have to be fixed by downstream software.
-			get_vdif_chans_per_thread(ms->datawindow+offset),
-			get_vdif_quantization_bits(ms->datawindow+offset),
-			1,
-			framesize-16,
-			16,
-			get_vdif_complex(ms->datawindow+offset) );
-
-		set_format(ms, f);
-		status = mark5_format_init(ms);
-		if(status < 0)
+		if(start + syncbytes > length || !mark5_detect_ones(data + start, syncbytes))
 		{
-			if(f->final_format)
+			continue;
+		}
+		for(k = 0, s = start; k < MARK5_DETECT_CONFIRM; ++k)
+		{
+			s += framebytes;
+			if(s + syncbytes > length || !mark5_detect_ones(data + s, syncbytes))
 			{
-				f->final_format(ms);
+				break;
 			}
-			free(f);
 		}
-		else
+		if(k > best)
 		{
-			copy_format(ms, mf);
-			mf->format = MK5_FORMAT_VDIF;
-			mf->ntrack = get_vdif_threads(ms->datawindow+offset, ms->datawindowsize-offset, framesize);
-			delete_mark5_stream(ms);
-			
-			return mf;
+			best = k;
+			if(k == MARK5_DETECT_CONFIRM)
+			{
+				break;
+			}
 		}
+		o = start + syncbytes;
+		o -= o % 8;
 	}
 
-#ifdef HAVE_CODIFIO
-	/* CODIF */
-	framesize = 0;
-	headersize = 0;
-	if (find_codif_frame(ms->datawindow, ms->datawindowsize, &offset, &framesize, &headersize) >= 0)
-	{
-	    void * header;
-	    header = (void*)ms->datawindow+offset;
-
-	    ms->frameoffset = offset;
-	    f = new_mark5_format_codif(
-		  getCODIFFramesPerPeriod(header),
-		  getCODIFPeriod(header),
-		  getCODIFNumChannels(header),
-		  getCODIFBitsPerSample(header),
-		  1, /* decimation */
-		  framesize-headersize,
-		  headersize,
-		  getCODIFComplex(header));
-
-	    set_format(ms, f);
-	    status = mark5_format_init(ms);
-	    if(status < 0)
-	      {
-		  if(f->final_format)
-		    {
-			f->final_format(ms);
-		    }
-		  free(f);
-	      }
-	    else
-	      {
-		  copy_format(ms, mf);
-		  mf->format = MK5_FORMAT_CODIF;
-		  mf->ntrack = get_codif_threads(ms->datawindow+offset, ms->datawindowsize-offset, framesize);
-		  delete_mark5_stream(ms);
-		  return mf;
-	      }
-	}
-#endif
-	
-	/* No match found */
-	free(mf);
-	free(ms);
-
-	return 0;
+	return best;
 }
 
-void print_mark5_format(const struct mark5_format *mf)
+static void mark5_detect_add(struct mark5_detect *D, enum Mark5Format format, int ntrack, long long offset, int score, struct mark5_format_generic *f)
 {
-	fprintf(m5stdout, "mark5_format : %p\n", mf);
-	if(!mf)
+	struct mark5_detect_candidate *C;
+
+	if(!f)
 	{
 		return;
 	}
-	fprintf(m5stdout, "  format ID = %d\n", mf->format);
-	fprintf(m5stdout, "  Mbps = %f\n", mf->Mbps);
-	fprintf(m5stdout, "  Frames per period = %d\n", mf->framesperperiod);
-	fprintf(m5stdout, "  Alignment seconds = %d\n", mf->alignmentseconds);
-	fprintf(m5stdout, "  nchan = %d\n", mf->nchan);
-	fprintf(m5stdout, "  nbit = %d\n", mf->nbit);
-	fprintf(m5stdout, "  frameoffset = %d\n", mf->frameoffset);
-	fprintf(m5stdout, "  framebytes = %d\n", mf->framebytes);
-	fprintf(m5stdout, "  framens = %f\n", mf->framens);
-	fprintf(m5stdout, "  mjd = %d sec = %d ns = %d\n", mf->mjd, mf->sec, mf->ns);
-	if(mf->format == MK5_FORMAT_VDIF || mf->format == MK5_FORMAT_VDIFL || mf->format == MK5_FORMAT_CODIF)
+	if(D->ncandidate >= MARK5_DETECT_MAXCANDIDATES)
 	{
-		fprintf(m5stdout, "  nthread = %d\n", mf->ntrack);
+		delete_mark5_format_generic(f);
+
+		return;
 	}
-	else
+	C = D->candidate + D->ncandidate;
+	C->format = format;
+	C->ntrack = ntrack;
+	C->offset = offset;
+	C->score = score;
+	C->order = D->ncandidate;
+	C->f = f;
+	C->status = -1;
+	++D->ncandidate;
+}
+
+/* the full check of one candidate, on its own stream over the shared window */
+static void mark5_detect_check(const struct mark5_detect *D, struct mark5_detect_candidate *C)
+{
+	struct mark5_stream_generic *s;
+	struct mark5_stream *ms;
+	struct mark5_format *mf = &C->result;
+
+	C->status = 0;
+
+	s = new_mark5_stream_memory(D->data, D->length);
+	ms = (struct mark5_stream *)calloc(1, sizeof(struct mark5_stream));
+	if(set_stream(ms, s) < 0 || s->init_stream(ms) < 0 || set_format(ms, C->f) < 0)
 	{
-		fprintf(m5stdout, "  ntrack = %d\n", mf->ntrack);
+		delete_mark5_stream(ms);
+		delete_mark5_stream_generic(s);
+
+		return;
 	}
-	if(mf->format == MK5_FORMAT_VLBA || mf->format == MK5_FORMAT_MARK4 || mf->format == MK5_FORMAT_VLBN)
+	ms->frameoffset = C->offset;
+	if(mark5_format_init(ms) >= 0)
 	{
-		fprintf(m5stdout, "  fanout = %d\n", mf->fanout);
+		copy_format(ms, mf);
+		mf->format = C->format;
+		mf->score = C->score;
+		switch(C->format)
+		{
+		case MK5_FORMAT_VLBA:
+		case MK5_FORMAT_MARK4:
+			mf->ntrack = C->ntrack;
+			mf->fanout = C->ntrack/(ms->nbit*ms->nchan);
+			break;
+		case MK5_FORMAT_VDIF:
+			mf->ntrack = get_vdif_threads(ms->datawindow + C->offset, ms->datawindowsize - C->offset, ms->framebytes);
+			break;
+#ifdef HAVE_CODIFIO
+		case MK5_FORMAT_CODIF:
+			mf->ntrack = get_codif_threads(ms->datawindow + C->offset, ms->datawindowsize - C->offset, ms->framebytes);
+			break;
+#endif
+		default:
+			mf->ntrack = 0;
+			break;
+		}
+		C->status = 1;
 	}
-	fprintf(m5stdout, "  decimation = %d\n", mf->decimation);
+	delete_mark5_stream(ms);
+	delete_mark5_stream_generic(s);
 }
 
-void delete_mark5_format(struct mark5_format *mf)
+static void *mark5_detect_worker(void *arg)
 {
-	if(mf)
+	struct mark5_detect *D = (struct mark5_detect *)arg;
+
+	for(;;)
 	{
-		free(mf);
+		struct mark5_detect_candidate *C;
+
+		pthread_mutex_lock(&D->lock);
+		/* candidates are in order of score; stop once one can do no better */
+		if(D->next >= D->ncandidate || D->candidate[D->next].score < D->bestscore)
+		{
+			pthread_mutex_unlock(&D->lock);
+
+			return 0;
+		}
+		C = D->candidate + D->next;
+		++D->next;
+		pthread_mutex_unlock(&D->lock);
+
+		mark5_detect_check(D, C);
+
+		if(C->status == 1 && C->score == MARK5_DETECT_CONFIRM)
+		{
+			pthread_mutex_lock(&D->lock);
+			D->bestscore = C->score;
+			pthread_mutex_unlock(&D->lock);
+		}
 	}
 }
 
-struct mark5_stream *new_mark5_stream(const struct mark5_stream_generic *s, const struct mark5_format_generic *f)
+/* by score, then in the order the formats used to be tried */
+static int mark5_detect_compare(const void *a, const void *b)
+{
+	const struct mark5_detect_candidate *A = (const struct mark5_detect_candidate *)a;
+	const struct mark5_detect_candidate *B = (const struct mark5_detect_candidate *)b;
+
+	if(A->score != B->score)
+	{
+		return B->score - A->score;
+	}
+
+	return A->order - B->order;
+}
+
+int new_mark5_format_candidates_from_stream(struct mark5_stream_generic *s, struct mark5_format **formats, int maxformats)
 {
 	struct mark5_stream *ms;
-	int status;
+	struct mark5_detect D;
+	pthread_t threads[MARK5_DETECT_MAXTHREADS];
+	int nthread, t, c, n, ntrack, score, framesize;
+	size_t offset;
 
 	mark5_library_consistent();
-
-	ms = (struct mark5_stream *)calloc(1, sizeof(struct mark5_stream));
-       	if(!ms)
+	
+	if(!s || !formats || maxformats <= 0)
 	{
-		fprintf(m5stderr, "Error allocating memory for mark5_stream\n");
-		
-		return 0;
+		return -1;
 	}
-
-	ms->format = MK5_FORMAT_UNKNOWN;
+	
+	ms = (struct mark5_stream *)calloc(1, sizeof(struct mark5_stream));
 	
 	if(set_stream(ms, s) < 0)
 	{
-		fprintf(m5stderr, "new_mark5_stream: Incomplete stream.\n");
 		free(ms);
+
+		fprintf(m5stderr, "new_mark5_format_candidates_from_stream: Incomplete stream.\n");
 		
-		return 0;
+		return -1;
 	}
-	if(set_format(ms, f) < 0)
+
+	if(s->init_stream(ms) < 0)
 	{
-		fprintf(m5stderr, "new_mark5_stream: Incomplete format.\n");
-		free(ms);
+		delete_mark5_stream(ms);
+		fprintf(m5stderr, "new_mark5_format_candidates_from_stream: init_stream() failed\n");
 		
-		return 0;
+		return -1;
 	}
 
-	ms->log2blankzonesize = 30;
+	/* the window the stream starts with is the shared probe buffer */
+	memset(&D, 0, sizeof(D));
+	D.data = ms->datawindow;
+	D.length = ms->datawindowsize;
+
+	if(D.data && D.length > 0)
+	{
+		/* Mark5b; there is no way to tell KVN5B from it, so that is not proposed */
+		score = mark5_detect_mark5b(D.data, D.length);
+		if(score > 0)
+		{
+			mark5_detect_add(&D, MK5_FORMAT_MARK5B, 0, 0, score, new_mark5_format_mark5b(0, 16, 2, 1));
+		}
+
+		/* VLBA and Mark4 modes */
+		for(ntrack = 8; ntrack <= 64; ntrack*=2)
+		{
+			score = mark5_detect_tracks(D.data, D.length, 2520*ntrack, ntrack);
+			if(score > 0)
+			{
+				mark5_detect_add(&D, MK5_FORMAT_VLBA, ntrack, 0, score, new_mark5_format_vlba(0, ntrack, 1, 1, 1));
+			}
+		}
+		for(ntrack = 8; ntrack <= 64; ntrack*=2)
+		{
+			score = mark5_detect_tracks(D.data, D.length, 2500*ntrack, ntrack);
+			if(score > 0)
+			{
+				mark5_detect_add(&D, MK5_FORMAT_MARK4, ntrack, 0, score, new_mark5_format_mark4(0, ntrack, 1, 1, 1));
+			}
+		}
+
+		/* VDIF */
+		framesize = 0;
+		if(find_vdif_frame_confidence(D.data, D.length, &offset, &framesize, &score) >= 0)
+		{
+			mark5_detect_add(&D, MK5_FORMAT_VDIF, 0, offset, score, new_mark5_format_vdif(
+				1024, 	// Need to give it something.  This will be wrong in general and will have to be fixed by downstream software.
+				get_vdif_chans_per_thread(D.data+offset),
+				get_vdif_quantization_bits(D.data+offset),
+				1,
+				framesize-32,
+				32,
+				get_vdif_complex(D.data+offset) ));
+		}
+
+		/* VDIFL */
+		framesize = 0;
+		if(find_vdifl_frame_confidence(D.data, D.length, &offset, &framesize, &score) >= 0)
+		{
+			mark5_detect_add(&D, MK5_FORMAT_VDIF, 0, offset, score, new_mark5_format_vdif(
+				1024,
+				get_vdif_chans_per_thread(D.data+offset),
+				get_vdif_quantization_bits(D.data+offset),
+				1,
+				framesize-16,
+				16,
+				get_vdif_complex(D.data+offset) ));
+		}
+
+#ifdef HAVE_CODIFIO
+		/* CODIF */
+		{
+			int headersize = 0;
+
+			framesize = 0;
+			if(find_codif_frame_confidence(D.data, D.length > INT_MAX ? INT_MAX : D.length, &offset, &framesize, &headersize, &score) >= 0)
+			{
+				void *header = (void *)(D.data + offset);
+
+				mark5_detect_add(&D, MK5_FORMAT_CODIF, 0, offset, score, new_mark5_format_codif(
+					getCODIFFramesPerPeriod(header),
+					getCODIFPeriod(header),
+					getCODIFNumChannels(header),
+					getCODIFBitsPerSample(header),
+					1, /* decimation */
+					framesize-headersize,
+					headersize,
+					getCODIFComplex(header)));
+			}
+		}
+#endif
+	}
+
+	qsort(D.candidate, D.ncandidate, sizeof(struct mark5_detect_candidate), mark5_detect_compare);
+
+	/* the decoders chosen at init depend on this; look once, before the threads */
+	mark5_simd_detect();
+
+	nthread = sysconf(_SC_NPROCESSORS_ONLN);
+	if(nthread > D.ncandidate)
+	{
+		nthread = D.ncandidate;
+	}
+	if(nthread > MARK5_DETECT_MAXTHREADS)
+	{
+		nthread = MARK5_DETECT_MAXTHREADS;
+	}
+	pthread_mutex_init(&D.lock, 0);
+	for(t = 1; t < nthread; ++t)
+	{
+		if(pthread_create(threads + t, 0, mark5_detect_worker, &D) != 0)
+		{
+			nthread = t;
+			break;
+		}
+	}
+	mark5_detect_worker(&D);
+	for(t = 1; t < nthread; ++t)
+	{
+		pthread_join(threads[t], 0);
+	}
+	pthread_mutex_destroy(&D.lock);
+
+	n = 0;
+	for(c = 0; c < D.ncandidate; ++c)
+	{
+		if(D.candidate[c].status == 1 && n < maxformats)
+		{
+			formats[n] = (struct mark5_format *)malloc(sizeof(struct mark5_format));
+			*formats[n] = D.candidate[c].result;
+			++n;
+		}
+		delete_mark5_format_generic(D.candidate[c].f);
+	}
+
+	delete_mark5_stream(ms);
+
+	return n;
+}
+
+struct mark5_format *new_mark5_format_from_stream(struct mark5_stream_generic *s)
+{
+	struct mark5_format *mf = 0;
+
+	if(new_mark5_format_candidates_from_stream(s, &mf, 1) <= 0)
+	{
+		return 0;
+	}
+
+	return mf;
+}
+
+void print_mark5_format(const struct mark5_format *mf)
+{
+	fprintf(m5stdout, "mark5_format : %p\n", mf);
+	if(!mf)
+	{
+		return;
+	}
+	fprintf(m5stdout, "  format ID = %d\n", mf->format);
+	fprintf(m5stdout, "  Mbps = %f\n", mf->Mbps);
+	fprintf(m5stdout, "  Frames per period = %d\n", mf->framesperperiod);
+	fprintf(m5stdout, "  Alignment seconds = %d\n", mf->alignmentseconds);
+	fprintf(m5stdout, "  nchan = %d\n", mf->nchan);
+	fprintf(m5stdout, "  nbit = %d\n", mf->nbit);
+	fprintf(m5stdout, "  frameoffset = %d\n", mf->frameoffset);
+	fprintf(m5stdout, "  framebytes = %d\n", mf->framebytes);
+	fprintf(m5stdout, "  framens = %f\n", mf->framens);
+	fprintf(m5stdout, "  mjd = %d sec = %d ns = %d\n", mf->mjd, mf->sec, mf->ns);
+	if(mf->format == MK5_FORMAT_VDIF || mf->format == MK5_FORMAT_VDIFL || mf->format == MK5_FORMAT_CODIF)
+	{
+		fprintf(m5stdout, "  nthread = %d\n", mf->ntrack);
+	}
+	else
+	{
+		fprintf(m5stdout, "  ntrack = %d\n", mf->ntrack);
+	}
+	if(mf->format == MK5_FORMAT_VLBA || mf->format == MK5_FORMAT_MARK4 || mf->format == MK5_FORMAT_VLBN)
+	{
+		fprintf(m5stdout, "  fanout = %d\n", mf->fanout);
+	}
+	fprintf(m5stdout, "  decimation = %d\n", mf->decimation);
+	if(mf->score > 0)
+	{
+		fprintf(m5stdout, "  detection score = %d\n", mf->score);
+	}
+}
+
+void delete_mark5_format(struct mark5_format *mf)
+{
+	if(mf)
+	{
+		free(mf);
+	}
+}
+
+struct mark5_stream *new_mark5_stream(const struct mark5_stream_generic *s, const struct mark5_format_generic *f)
+{
+	struct mark5_stream *ms;
+	int status;
+
+	mark5_library_consistent();
+
+	ms = (struct mark5_stream *)calloc(1, sizeof(struct mark5_stream));
+       	if(!ms)
+	{
+		fprintf(m5stderr, "Error allocating memory for mark5_stream\n");
+		
+		return 0;
+	}
+
+	ms->format = MK5_FORMAT_UNKNOWN;
+	
+	if(set_stream(ms, s) < 0)
+	{
+		fprintf(m5stderr, "new_mark5_stream: Incomplete stream.\n");
+		free(ms);
+		
+		return 0;
+	}
+	if(set_format(ms, f) < 0)
+	{
+		fprintf(m5stderr, "new_mark5_stream: Incomplete format.\n");
+		free(ms);
+		
+		return 0;
+	}
+
+	ms->log2blankzonesize = 30;
 	ms->blanker = blanker_none;
 
 	status = s->init_stream(ms);
@@ -1388,6 +1699,12 @@ void delete_mark5_stream(struct mark5_stream *ms)
 		{
 			ms->final_format(ms);
 		}
+		if(ms->frameindex)
+		{
+			delete_mark5_index(ms->frameindex);
+		}
+		free(ms->blankrange);
+		free(ms->validrange);
 		free(ms);
 	}
 }
@@ -1480,7 +1797,7 @@ int mark5_stream_seek(struct mark5_stream *ms, int mjd, int sec, double ns)
 {
 	int status;
 	double jumpns;
-	long long n;
+	long long n, framenum;
 
 	if(!ms)
 	{
@@ -1496,7 +1813,28 @@ int mark5_stream_seek(struct mark5_stream *ms, int mjd, int sec, double ns)
 		{
 			return -1;
 		}
-		n = jumpns / ms->framens - 1;
+		if(ms->frameindex)	/* exact, even across gaps */
+		{
+			int fmjd, fsec;
+			double fns;
+
+			if(mark5_index_find(ms->frameindex, mjd, sec, ns, &n) < 0 ||
+			   mark5_index_frame_time(ms->frameindex, n, &fmjd, &fsec, &fns) < 0)
+			{
+				return -1;
+			}
+			--n;
+
+			/* framenum counts frame periods since the start, as validate() expects; n is the position in the data */
+			framenum = llround((86400000000000.0*(fmjd - ms->mjd)
+			                  + 1000000000.0*(fsec - ms->sec)
+			                  + (fns - ms->ns)) / ms->framens) - 1;
+		}
+		else
+		{
+			n = jumpns / ms->framens - 1;
+			framenum = n;
+		}
 
 		//status = ms->seek(ms, n + ms->framenum);
 		status = ms->seek(ms, n);
@@ -1506,7 +1844,7 @@ int mark5_stream_seek(struct mark5_stream *ms, int mjd, int sec, double ns)
 			return -1;
 		}
 
-		ms->framenum = n;
+		ms->framenum = framenum;
 
 		mark5_stream_next_frame(ms);
 
@@ -1581,6 +1919,9 @@ int mark5_stream_set_blanker(struct mark5_stream *ms,
 	case MK5_BLANKER_MARK5:
 		ms->blanker = blanker_mark5;
 		break;
+	case MK5_BLANKER_EXACT:
+		ms->blanker = blanker_exact;
+		break;
 	default:
 		return -1;
 	}
@@ -1741,6 +2082,530 @@ int mark5_stream_decode_double_complex(struct mark5_stream *ms, int nsamp, mark5
 }
 
 
+/* The integer decoders run the float decoders over chunks small enough to
+ * stay in cache, so only the integer output goes out to memory.
+ */
+#define MARK5_INT_CHUNK	16384	/* floats of scratch space */
+
+/* Factor taking decoded values back to integers.  For 4, 8 and 16 bit data
+ * it matches the lookup tables of format_vdif.c and format_codif.c; for 1
+ * and 2 bit data it takes +-1 to +-1 and +-OPTIMAL_2BIT_HIGH to +-3 after rounding.
+ */
+static float intscale(int nbit)
+{
+	switch(nbit)
+	{
+	case 4:
+		return 2.95;
+	case 8:
+		return 3.3;
+	case 16:
+		return 8.0;
+	default:
+		return 3.0/OPTIMAL_2BIT_HIGH;
+	}
+}
+
+/* chunk size in samples, a multiple of ms->samplegranularity */
+static int intchunk(const struct mark5_stream *ms, int perchan)
+{
+	int n;
+
+	n = MARK5_INT_CHUNK/(perchan*ms->nchan);
+	n -= n % ms->samplegranularity;
+	if(n < ms->samplegranularity)
+	{
+		n = ms->samplegranularity;
+	}
+
+	return n;
+}
+
+static int decode_int(struct mark5_stream *ms, int nsamp, int8_t **data8, int16_t **data16)
+{
+	float **f;
+	float scale;
+	int c, o, n, r, chunk;
+	int nvalid = 0;
+
+	if(!ms)
+	{
+		return -1;
+	}
+	if((data8 && ms->nbit > 8) || ms->nbit > 16)
+	{
+		return -1;
+	}
+
+	scale = intscale(ms->nbit);
+	chunk = intchunk(ms, 1);
+	if(chunk > nsamp)
+	{
+		chunk = nsamp;
+	}
+
+	f = (float **)malloc(ms->nchan*sizeof(float *));
+	f[0] = (float *)malloc(ms->nchan*chunk*sizeof(float));
+	for(c = 1; c < ms->nchan; ++c)
+	{
+		f[c] = f[0] + c*chunk;
+	}
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		n = nsamp - o < chunk ? nsamp - o : chunk;
+		r = mark5_stream_decode(ms, n, f);
+		if(r < 0)
+		{
+			nvalid = r;
+
+			break;
+		}
+		nvalid += r;
+
+		for(c = 0; c < ms->nchan; ++c)
+		{
+			if(data8)
+			{
+				mark5_simd_float_to_int8(f[c], n, scale, data8[c] + o);
+			}
+			else
+			{
+				mark5_simd_float_to_int16(f[c], n, scale, data16[c] + o);
+			}
+		}
+	}
+
+	free(f[0]);
+	free(f);
+
+	return nvalid;
+}
+
+static int decode_int_complex(struct mark5_stream *ms, int nsamp, mark5_int8_complex **data8, mark5_int16_complex **data16)
+{
+	mark5_float_complex **f;
+	float scale;
+	int c, o, n, r, chunk;
+	int nvalid = 0;
+
+	if(!ms)
+	{
+		return -1;
+	}
+	if((data8 && ms->nbit > 8) || ms->nbit > 16)
+	{
+		return -1;
+	}
+
+	scale = intscale(ms->nbit);
+	chunk = intchunk(ms, 2);
+	if(chunk > nsamp)
+	{
+		chunk = nsamp;
+	}
+
+	f = (mark5_float_complex **)malloc(ms->nchan*sizeof(mark5_float_complex *));
+	f[0] = (mark5_float_complex *)malloc(ms->nchan*chunk*sizeof(mark5_float_complex));
+	for(c = 1; c < ms->nchan; ++c)
+	{
+		f[c] = f[0] + c*chunk;
+	}
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		n = nsamp - o < chunk ? nsamp - o : chunk;
+		r = mark5_stream_decode_complex(ms, n, f);
+		if(r < 0)
+		{
+			nvalid = r;
+
+			break;
+		}
+		nvalid += r;
+
+		/* real and imaginary parts are in the same order in both */
+		for(c = 0; c < ms->nchan; ++c)
+		{
+			if(data8)
+			{
+				mark5_simd_float_to_int8((const float *)(f[c]), 2*n, scale, (int8_t *)(data8[c] + o));
+			}
+			else
+			{
+				mark5_simd_float_to_int16((const float *)(f[c]), 2*n, scale, (int16_t *)(data16[c] + o));
+			}
+		}
+	}
+
+	free(f[0]);
+	free(f);
+
+	return nvalid;
+}
+
+int mark5_stream_decode_int8(struct mark5_stream *ms, int nsamp, int8_t **data)
+{
+	return decode_int(ms, nsamp, data, 0);
+}
+
+int mark5_stream_decode_int16(struct mark5_stream *ms, int nsamp, int16_t **data)
+{
+	return decode_int(ms, nsamp, 0, data);
+}
+
+int mark5_stream_decode_int8_complex(struct mark5_stream *ms, int nsamp, mark5_int8_complex **data)
+{
+	return decode_int_complex(ms, nsamp, data, 0);
+}
+
+int mark5_stream_decode_int16_complex(struct mark5_stream *ms, int nsamp, mark5_int16_complex **data)
+{
+	return decode_int_complex(ms, nsamp, 0, data);
+}
+
+/* Formats without a channel selecting decoder are decoded in full, a chunk
+ * at a time, keeping only the selected channels.
+ */
+static int decode_channels_all(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data)
+{
+	float **f;
+	int c, k, o, n, r, chunk;
+	int nvalid = 0;
+
+	chunk = intchunk(ms, 1);
+	if(chunk > nsamp)
+	{
+		chunk = nsamp;
+	}
+
+	f = (float **)malloc(ms->nchan*sizeof(float *));
+	f[0] = (float *)malloc(ms->nchan*chunk*sizeof(float));
+	for(c = 1; c < ms->nchan; ++c)
+	{
+		f[c] = f[0] + c*chunk;
+	}
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		n = nsamp - o < chunk ? nsamp - o : chunk;
+		r = mark5_stream_decode(ms, n, f);
+		if(r < 0)
+		{
+			nvalid = r;
+
+			break;
+		}
+		nvalid += r;
+
+		for(k = 0; k < nsel; ++k)
+		{
+			memcpy(data[k] + o, f[chanlist[k]], n*sizeof(float));
+		}
+	}
+
+	free(f[0]);
+	free(f);
+
+	return nvalid;
+}
+
+int mark5_stream_decode_channels(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data)
+{
+	int j, k;
+
+	if(!ms || !chanlist || !data || nsel < 1 || nsel > ms->nchan)
+	{
+		return -1;
+	}
+	if(ms->readposition < 0 || ms->iscomplex)
+	{
+		return -1;
+	}
+	if(nsamp % ms->samplegranularity != 0)
+	{
+		return -1;
+	}
+	for(k = 0; k < nsel; ++k)
+	{
+		if(chanlist[k] < 0 || chanlist[k] >= ms->nchan || !data[k])
+		{
+			return -1;
+		}
+		for(j = 0; j < k; ++j)
+		{
+			if(chanlist[j] == chanlist[k])
+			{
+				return -1;
+			}
+		}
+	}
+
+	if(ms->decode_channels)
+	{
+		return ms->decode_channels(ms, nsamp, chanlist, nsel, data);
+	}
+	else
+	{
+		return decode_channels_all(ms, nsamp, chanlist, nsel, data);
+	}
+}
+
+int mark5_stream_get_channel_invalid(const struct mark5_stream *ms, long long *invalid)
+{
+	int c;
+
+	if(!ms || !invalid)
+	{
+		return -1;
+	}
+
+	for(c = 0; c < ms->nchan; ++c)
+	{
+		invalid[c] = c < MARK5_MAXMASKCHAN ? ms->chaninvalid[c] : 0;
+	}
+
+	return 0;
+}
+
+void mark5_stream_reset_channel_invalid(struct mark5_stream *ms)
+{
+	if(ms)
+	{
+		memset(ms->chaninvalid, 0, sizeof(ms->chaninvalid));
+	}
+}
+
+/* histograms are kept for the sample sizes with well defined levels */
+static int statsnstate(int nbit)
+{
+	return (nbit == 1 || nbit == 2 || nbit == 4 || nbit == 8) ? 1 << nbit : 0;
+}
+
+struct mark5_stream_stats *new_mark5_stream_stats(const struct mark5_stream *ms)
+{
+	struct mark5_stream_stats *stats;
+
+	if(!ms || ms->nchan < 1)
+	{
+		return 0;
+	}
+
+	stats = (struct mark5_stream_stats *)calloc(1, sizeof(struct mark5_stream_stats));
+	stats->nchan = ms->nchan;
+	stats->nstate = statsnstate(ms->nbit);
+	stats->nvalid = (long long *)calloc(ms->nchan, sizeof(long long));
+	stats->sum = (double *)calloc(ms->nchan, sizeof(double));
+	stats->sumsq = (double *)calloc(ms->nchan, sizeof(double));
+	if(stats->nstate > 0)
+	{
+		stats->histogram = (long long *)calloc(ms->nchan*stats->nstate, sizeof(long long));
+	}
+
+	return stats;
+}
+
+void delete_mark5_stream_stats(struct mark5_stream_stats *stats)
+{
+	if(stats)
+	{
+		free(stats->nvalid);
+		free(stats->sum);
+		free(stats->sumsq);
+		free(stats->histogram);
+		free(stats);
+	}
+}
+
+void mark5_stream_stats_clear(struct mark5_stream_stats *stats)
+{
+	if(stats)
+	{
+		memset(stats->nvalid, 0, stats->nchan*sizeof(long long));
+		memset(stats->sum, 0, stats->nchan*sizeof(double));
+		memset(stats->sumsq, 0, stats->nchan*sizeof(double));
+		if(stats->histogram)
+		{
+			memset(stats->histogram, 0, stats->nchan*stats->nstate*sizeof(long long));
+		}
+	}
+}
+
+/* Histogram bins of decoded values: the integer decoders' value (see
+ * intscale()) less the lowest one, halved for the odd 1 and 2 bit values.
+ * Four histograms are kept so runs of equal values do not wait on each
+ * other.
+ */
+static void statsbins(const float *x, int n, int nbit, long long *histogram)
+{
+	unsigned int h[4][256];
+	float a, b;
+	int i, k, nstate;
+
+	nstate = statsnstate(nbit);
+	if(nbit <= 2)
+	{
+		a = intscale(nbit)/2.0;
+		b = (nstate - 1)/2.0 + 0.5;
+	}
+	else
+	{
+		a = intscale(nbit);
+		b = (nstate/2) + 0.5;
+	}
+
+	memset(h, 0, sizeof(h));
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		for(k = 0; k < 4; ++k)
+		{
+			++h[k][(int)(x[i+k]*a + b) & (nstate - 1)];
+		}
+	}
+	for(; i < n; ++i)
+	{
+		++h[0][(int)(x[i]*a + b) & (nstate - 1)];
+	}
+	for(k = 0; k < nstate; ++k)
+	{
+		histogram[k] += h[0][k] + h[1][k] + h[2][k] + h[3][k];
+	}
+}
+
+/* Formats without their own statistics code are decoded a chunk at a
+ * time.  Blanked samples decode to 0, and are taken back out of the bin
+ * that 0 falls in.
+ */
+static int stats_all(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats)
+{
+	struct mark5_stream_stats *part;
+	float **f;
+	float zero = 0.0;
+	long long zerobin[256];
+	long long invalid[MARK5_MAXMASKCHAN];
+	double s[4], ss[4];
+	int c, i, k, o, n, r, b, m, chunk;
+	int nvalid = 0;
+
+	part = new_mark5_stream_stats(ms);
+	chunk = intchunk(ms, 1);
+	if(chunk > nsamp)
+	{
+		chunk = nsamp;
+	}
+
+	f = (float **)malloc(ms->nchan*sizeof(float *));
+	f[0] = (float *)malloc(ms->nchan*chunk*sizeof(float));
+	for(c = 1; c < ms->nchan; ++c)
+	{
+		f[c] = f[0] + c*chunk;
+	}
+
+	memset(zerobin, 0, sizeof(zerobin));
+	b = 0;
+	if(part->nstate > 0)
+	{
+		statsbins(&zero, 1, ms->nbit, zerobin);
+		for(b = 0; zerobin[b] == 0; ++b)
+		{
+		}
+	}
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		n = nsamp - o < chunk ? nsamp - o : chunk;
+		memcpy(invalid, ms->chaninvalid, sizeof(invalid));
+		r = mark5_stream_decode(ms, n, f);
+		if(r < 0)
+		{
+			nvalid = r;
+
+			break;
+		}
+		nvalid += r;
+
+		for(c = 0; c < ms->nchan; ++c)
+		{
+			/* several partial sums, so that the additions can overlap */
+			memset(s, 0, sizeof(s));
+			memset(ss, 0, sizeof(ss));
+			for(i = 0; i + 4 <= n; i += 4)
+			{
+				for(k = 0; k < 4; ++k)
+				{
+					s[k] += f[c][i+k];
+					ss[k] += (double)f[c][i+k]*f[c][i+k];
+				}
+			}
+			for(; i < n; ++i)
+			{
+				s[0] += f[c][i];
+				ss[0] += (double)f[c][i]*f[c][i];
+			}
+			part->sum[c] += (s[0] + s[1]) + (s[2] + s[3]);
+			part->sumsq[c] += (ss[0] + ss[1]) + (ss[2] + ss[3]);
+			/* samples of channels missing from their frames were zeroed, as blanked ones */
+			m = c < MARK5_MAXMASKCHAN ? ms->chaninvalid[c] - invalid[c] : 0;
+			part->nvalid[c] += r - m;
+			if(part->nstate > 0)
+			{
+				statsbins(f[c], n, ms->nbit, part->histogram + c*part->nstate);
+				part->histogram[c*part->nstate + b] -= n - r + m;
+			}
+		}
+	}
+
+	if(nvalid >= 0)
+	{
+		for(c = 0; c < ms->nchan; ++c)
+		{
+			stats->nvalid[c] += part->nvalid[c];
+			stats->sum[c] += part->sum[c];
+			stats->sumsq[c] += part->sumsq[c];
+			for(i = 0; i < part->nstate; ++i)
+			{
+				stats->histogram[c*part->nstate + i] += part->histogram[c*part->nstate + i];
+			}
+		}
+	}
+
+	free(f[0]);
+	free(f);
+	delete_mark5_stream_stats(part);
+
+	return nvalid;
+}
+
+int mark5_stream_accumulate_stats(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats)
+{
+	if(!ms || !stats)
+	{
+		return -1;
+	}
+	if(ms->readposition < 0 || ms->iscomplex)
+	{
+		return -1;
+	}
+	if(stats->nchan != ms->nchan || stats->nstate != statsnstate(ms->nbit))
+	{
+		return -1;
+	}
+	if(nsamp % ms->samplegranularity != 0)
+	{
+		return -1;
+	}
+
+	if(ms->accumulate_stats)
+	{
+		return ms->accumulate_stats(ms, nsamp, stats);
+	}
+	else
+	{
+		return stats_all(ms, nsamp, stats);
+	}
+}
+
+
 void delete_mark5_stream_generic(struct mark5_stream_generic *s)
 {
 	if(s)
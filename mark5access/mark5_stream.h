@@ -51,6 +51,10 @@ typedef float complex  mark5_float_complex;
 #include <stdint.h>
 #include <stdio.h>
 
+/* complex integer samples, as produced by mark5_stream_decode_int8_complex() etc. */
+typedef struct { int8_t re, im; } mark5_int8_complex;
+typedef struct { int16_t re, im; } mark5_int16_complex;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -74,14 +78,75 @@ enum Mark5Format
 #define MAXBLANKZONES		32
 #define OPTIMAL_2BIT_HIGH	3.3359
 #define MARK5_STREAM_ID_LENGTH	256
-#define MARK5_STREAM_MAXBUFSIZE (1<<20)	/* maximum bytes for buffer, length must fit 'int' */
+#define MARK5_STREAM_MAXBUFSIZE (1<<20)	/* default bytes for file stream buffer; also most bytes searched for the first frame */
+#define MARK5_STREAM_MINBUFSIZE (1<<18)	/* least bytes for file stream buffer, room for a few of the largest frames */
 
 enum Mark5Blanker
 {
 	MK5_BLANKER_NONE  = 0,
 	MK5_BLANKER_MARK5 = 1,
 	MK5_BLANKER_VDIF  = 2,
-	MK5_BLANKER_CODIF = 3
+	MK5_BLANKER_CODIF = 3,
+	MK5_BLANKER_EXACT = 4		/* whole payload compared with the fill pattern */
+};
+
+/* instruction sets usable by the decoders; see M5A_OPT_SIMDLEVEL */
+enum Mark5SimdLevel
+{
+	MK5_SIMD_AUTO     = -1,		/* best supported by the cpu */
+	MK5_SIMD_SCALAR   =  0,		/* lookup tables only */
+	MK5_SIMD_SSE41    =  1,
+	MK5_SIMD_AVX2     =  2,
+	MK5_SIMD_AVX512BW =  3,
+	MK5_SIMD_NEON     =  4
+};
+
+/* Per channel statistics, see mark5_stream_accumulate_stats() */
+struct mark5_stream_stats
+{
+	int nchan;
+	int nstate;		/* histogram bins per channel: 1 << nbit for 1, 2, 4 and 8 bit data, else 0 */
+	long long *nvalid;	/* [nchan] samples accumulated; blanked ones are not */
+	double *sum;		/* [nchan] sum of decoded values */
+	double *sumsq;		/* [nchan] sum of their squares */
+	long long *histogram;	/* [nchan*nstate] number of samples decoding to each value, lowest first */
+};
+
+/* Frame time index of a stream, see new_mark5_index_from_stream().  One entry
+ * is kept for the first frame and for each frame whose time does not follow
+ * from that of the last valid frame before it, e.g., after dropped frames.
+ */
+struct mark5_index_entry
+{
+	long long framenum;	/* frame number within the stream, 0 at frameoffset */
+	long long nframe;	/* frames from this one to the last valid one in time sequence with it */
+	int mjd;
+	int sec;
+	double ns;
+};
+
+struct mark5_index
+{
+	char formatname[MARK5_STREAM_ID_LENGTH];
+	int framebytes;
+	int frameoffset;
+	double framens;
+	long long nframe;	/* frames in the stream */
+	long long ninvalid;	/* frames not in time sequence with any other */
+	int monotonic;		/* entries are in increasing time order */
+	int nentry;
+	int nalloc;
+	struct mark5_index_entry *entry;
+};
+
+/* channels covered by ms->chanmissing; any others are always decoded */
+#define MARK5_MAXMASKCHAN	64
+
+/* bytes [start, end) of a payload; see ms->validrange */
+struct mark5_byte_range
+{
+	int start;
+	int end;
 };
 
 struct mark5_stream
@@ -124,7 +189,8 @@ struct mark5_stream
 	const unsigned char *datawindow;	/* pointer to data window */
 	int readposition;	/* index into frame of current read */
 
-	/* data blanking */
+	/* data blanking, by zones of 1 << log2blankzonesize bytes, as read
+	 * by the lookup table decoders; see also validrange below */
 	int log2blankzonesize;
 	int blankzonestartvalid[MAXBLANKZONES];
 	int blankzoneendvalid[MAXBLANKZONES];
@@ -154,6 +220,32 @@ struct mark5_stream
 	 * to satisfy the matching validate function
 	 */
 	void (*genheaders)(const struct mark5_stream *ms, int n, unsigned char *where);
+
+	/* optional format commands; new members go at the end to keep the layout */
+	int (*decode_channels)(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data);
+	int (*accumulate_stats)(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats);
+
+	/* if set, mark5_stream_seek() looks frames up here; see mark5_stream_set_index() */
+	struct mark5_index *frameindex;
+
+	/* fill found in the current payload, in order, by the exact blanker */
+	struct mark5_byte_range *blankrange;
+	int nblankrange;
+	int nblankrangealloc;
+
+	/* the parts of the current payload to decode, in order and not touching,
+	 * as set by every blanker; there is no limit to their number, and
+	 * unlike the zones above they are not bound to the frame size */
+	struct mark5_byte_range *validrange;
+	int nvalidrange;
+	int nvalidrangealloc;
+
+	/* channels without data in the current frame, bit c for channel c, as
+	 * marked in the frame header (VDIF EDV4 validity mask) and set by the
+	 * blanker.  Decoders write zeros for these channels and count the
+	 * samples in chaninvalid; see mark5_stream_get_channel_invalid() */
+	uint64_t chanmissing;
+	long long chaninvalid[MARK5_MAXMASKCHAN];
 };
 
 struct mark5_stream_generic
@@ -169,6 +261,8 @@ struct mark5_stream_generic
 typedef	int (*decodeFunc)(struct mark5_stream*, int, float**); 
 typedef	int (*complex_decodeFunc)(struct mark5_stream*, int, mark5_float_complex**); 
 typedef int (*countFunc)(struct mark5_stream *, int, unsigned int *); 
+typedef int (*decodeChannelsFunc)(struct mark5_stream *, int, const int *, int, float **);
+typedef int (*statisticsFunc)(struct mark5_stream *, int, struct mark5_stream_stats *);
   
 struct mark5_format_generic
 {
@@ -196,6 +290,8 @@ struct mark5_format_generic
 	int nbit;
 	int decimation;					/* decimationling factor */
 	void (*genheaders)(const struct mark5_stream *ms, int n, unsigned char *where);
+	decodeChannelsFunc decode_channels;		/* optional; see mark5_stream_decode_channels() */
+	statisticsFunc accumulate_stats;		/* optional; see mark5_stream_accumulate_stats() */
 };
 
 void delete_mark5_stream_generic(struct mark5_stream_generic *s);
@@ -237,18 +333,186 @@ int mark5_stream_decode_double_complex(struct mark5_stream *ms, int nsamp, mark5
 
 int mark5_stream_count_high_states(struct mark5_stream *ms, int nsamp, unsigned int *highstates);
 
+/* Integer output.  1 and 2 bit samples decode to -1, +1 and (high states)
+ * -3, +3; wider samples to the signed integer that mark5_stream_decode()
+ * would scale to floating point.  Blanked samples are 0.  The int8 versions
+ * require nbit <= 8, the int16 versions nbit <= 16.  Return values are as for mark5_stream_decode().
+ */
+int mark5_stream_decode_int8(struct mark5_stream *ms, int nsamp, int8_t **data);
+
+int mark5_stream_decode_int16(struct mark5_stream *ms, int nsamp, int16_t **data);
+
+int mark5_stream_decode_int8_complex(struct mark5_stream *ms, int nsamp, mark5_int8_complex **data);
+
+int mark5_stream_decode_int16_complex(struct mark5_stream *ms, int nsamp, mark5_int16_complex **data);
+
+/* Decode only the nsel channels listed in chanlist, channel chanlist[k]
+ * going to data[k].  Channels must be distinct; real data only.  Where the
+ * format has a vector decoder the other channels are never unpacked, so the
+ * cost falls about in proportion to the fraction of channels selected.
+ * Return values are as for mark5_stream_decode().
+ */
+int mark5_stream_decode_channels(struct mark5_stream *ms, int nsamp, const int *chanlist, int nsel, float **data);
+
+/* Copies into invalid[] (ms->nchan entries) the number of samples of each
+ * channel decoded as zero because the frame header marked the channel
+ * missing (VDIF EDV4), counted since the stream was opened or last reset.
+ * These are on top of samples blanked for the whole frame, which the decode
+ * functions leave out of their return values.  Returns 0 on success.
+ */
+int mark5_stream_get_channel_invalid(const struct mark5_stream *ms, long long *invalid);
+
+void mark5_stream_reset_channel_invalid(struct mark5_stream *ms);
+
+/* Statistics of the next nsamp samples of each channel, which are consumed
+ * as by mark5_stream_decode(), added to stats.  Where the format allows,
+ * they come straight from counts of the packed data without decoding.
+ * Return values are as for mark5_stream_decode(); on error stats is not
+ * changed.  Real data only.
+ */
+struct mark5_stream_stats *new_mark5_stream_stats(const struct mark5_stream *ms);
+
+void delete_mark5_stream_stats(struct mark5_stream_stats *stats);
+
+void mark5_stream_stats_clear(struct mark5_stream_stats *stats);
+
+int mark5_stream_accumulate_stats(struct mark5_stream *ms, int nsamp, struct mark5_stream_stats *stats);
+
 /* SPECIFIC STREAM TYPES */
 
 /*   Memory based stream */
 
-struct mark5_stream_generic *new_mark5_stream_memory(const void *data, unsigned int nbytes);
+struct mark5_stream_generic *new_mark5_stream_memory(const void *data, long long nbytes);
 
 /*   File based stream */
 
 struct mark5_stream_generic *new_mark5_stream_file(const char *filename, long long offset);
 
+/* buffer (window) size, instead of MARK5_STREAM_MAXBUFSIZE, for a file stream not yet made into a mark5_stream */
+int mark5_stream_file_set_buffersize(struct mark5_stream_generic *s, long long nbytes);
+
 int mark5_stream_file_add_infile(struct mark5_stream *ms, const char *filename);
 
+/*   Memory mapped file stream: frames are decoded in place, without copying.
+ *	Regular files only; seeking is O(1)
+ */
+
+struct mark5_stream_generic *new_mark5_stream_mmap(const char *filename, long long offset);
+
+/*   Multi-thread VDIF: the packets of the threads (all those found near the
+ *	start if threadids = 0) are corner-turned on the fly into single-thread
+ *	frames holding the channels of all of them, with EDV4 validity masks
+ *	telling missing packets; framespersecond is that of each thread.
+ *	new_mark5_format_vdif_mux() gives the format of these frames.
+ *	Files or stdin ("-"); seeking is not supported
+ */
+
+struct mark5_stream_generic *new_mark5_stream_vdif_mux(const char *filename, long long offset, int framespersecond, int nthread, const int *threadids);
+
+struct mark5_format_generic *new_mark5_format_vdif_mux(const struct mark5_stream_generic *s, int decimation);
+
+/*   VDIF from a UDP port: single-thread frames, one per packet after an
+ *	optional PSN prefix of psnbytes (e.g., 8); out of order packets are put
+ *	in order, lost ones blanked.  The stream ends after 10 s without data
+ */
+
+struct mark5_stream_udp_stats
+{
+	long long npacket;	/* VDIF packets received */
+	long long nlost;	/* frames never received; blanked */
+	long long nreorder;	/* packets received after a later one */
+	long long nlate;	/* packets received too late to be used */
+	long long nduplicate;
+	long long nbad;		/* packets not VDIF frames of the stream's size */
+	long long nstray;	/* packets far ahead of the stream, dropped */
+	long long nresync;	/* times the stream went back in time to follow the packets */
+};
+
+struct mark5_stream_generic *new_mark5_stream_udp(int port, int framespersecond, int psnbytes);
+
+int mark5_stream_udp_get_stats(const struct mark5_stream *ms, struct mark5_stream_udp_stats *stats);
+
+/*   Shared memory ring of frames: one producer, any number of reading
+ *	streams, each decoding frames in place.  A stream starts at the newest
+ *	frame (the oldest once the producer has finished); frames overwritten
+ *	before a stream gets to them are blanked.  The stream ends 10 s after
+ *	the last frame, or at once if the producer has finished
+ */
+
+#define MARK5_SHMRING_MAGIC	0x4D35524EU
+#define MARK5_SHMRING_VERSION	1
+
+/* at the start of the segment; followed by long long seq[nslot], which for
+ * each slot is n+1 once it holds all of frame n and 0 while it is written.
+ * Frame n is in slot n % nslot, at dataoffset + slot*framebytes
+ */
+struct mark5_shmring_header
+{
+	unsigned int magic;
+	unsigned int version;
+	int framebytes;
+	int nslot;
+	long long dataoffset;
+	long long writeseq;	/* frames published */
+	int closed;		/* set by the producer when done */
+	int reserved;
+};
+
+struct mark5_stream_shmring_stats
+{
+	long long nframe;	/* frames read from the ring */
+	long long noverrun;	/* frames overwritten before being read; blanked */
+	long long ntorn;	/* frames overwritten while being decoded */
+};
+
+struct mark5_stream_generic *new_mark5_stream_shmring(const char *name);
+
+int mark5_stream_shmring_get_stats(const struct mark5_stream *ms, struct mark5_stream_shmring_stats *stats);
+
+/* producer side: creates (or recreates) the ring; name as for shm_open() */
+struct mark5_shmring_header *new_mark5_shmring(const char *name, int framebytes, int nslot);
+
+/* returns where to write the next frame, then publish it */
+unsigned char *mark5_shmring_claim(struct mark5_shmring_header *ring);
+
+void mark5_shmring_publish(struct mark5_shmring_header *ring);
+
+/* marks the ring finished and unmaps it; shm_unlink() removes it */
+void delete_mark5_shmring(struct mark5_shmring_header *ring);
+
+/*   Mark6 scatter-gather scan: the version 2 block files of the scan on all
+ *	disks are read in parallel, one thread per file, and the blocks decoded
+ *	in sequence order; missing blocks are blanked.  scanname is a scan name
+ *	(looked for in /mnt/disks/<n>/<m>/data/) or a glob pattern for the files
+ */
+
+struct mark5_stream_generic *new_mark5_stream_mark6(const char *scanname);
+
+/*   Frame time index: built in one pass over the frame headers of a stream,
+ *	kept in a text file (by convention <datafile>.m5index) and used by
+ *	mark5_stream_seek() to find frames exactly despite gaps in the data
+ */
+
+/* reads ms from its current frame to its end; use a freshly opened stream */
+struct mark5_index *new_mark5_index_from_stream(struct mark5_stream *ms);
+
+struct mark5_index *new_mark5_index_from_file(const char *filename);
+
+int mark5_index_write(const struct mark5_index *idx, const char *filename);
+
+void delete_mark5_index(struct mark5_index *idx);
+
+void mark5_index_print(const struct mark5_index *idx);
+
+/* frame at or, if in a gap, just after the given time; -1 if before the first or after the last frame */
+int mark5_index_find(const struct mark5_index *idx, int mjd, int sec, double ns, long long *framenum);
+
+/* time of a frame listed in the index; -1 if it is in no segment */
+int mark5_index_frame_time(const struct mark5_index *idx, long long framenum, int *mjd, int *sec, double *ns);
+
+/* the stream takes ownership of idx and deletes it with itself; idx = 0 removes the index */
+int mark5_stream_set_index(struct mark5_stream *ms, struct mark5_index *idx);
+
 /*   Just an unpacker: for repeated unpacking of a particular format from
  *	arbitrary memory locations 
  */
@@ -263,6 +527,14 @@ int mark5_unpack_complex(struct mark5_stream *ms, const void *packed, mark5_floa
 
 int mark5_unpack_complex_with_offset(struct mark5_stream *ms, const void *packed, int offsetsamples, mark5_float_complex **unpacked, int nsamp);
 
+int mark5_unpack_int8(struct mark5_stream *ms, const void *packed, int8_t **unpacked, int nsamp);
+
+int mark5_unpack_int16(struct mark5_stream *ms, const void *packed, int16_t **unpacked, int nsamp);
+
+int mark5_unpack_int8_complex(struct mark5_stream *ms, const void *packed, mark5_int8_complex **unpacked, int nsamp);
+
+int mark5_unpack_int16_complex(struct mark5_stream *ms, const void *packed, mark5_int16_complex **unpacked, int nsamp);
+
 
 /* SPECIFIC FORMAT TYPES */
 
@@ -292,6 +564,11 @@ int find_vdif_frame(const unsigned char *data, size_t length, size_t *offset, in
 
 int find_vdifl_frame(const unsigned char *data, size_t length, size_t *offset, int *framesize);
 
+/* as above, also giving the number of frames (1 to 8) after the one found whose headers agree with it */
+int find_vdif_frame_confidence(const unsigned char *data, size_t length, size_t *offset, int *framesize, int *confidence);
+
+int find_vdifl_frame_confidence(const unsigned char *data, size_t length, size_t *offset, int *framesize, int *confidence);
+
 int get_vdif_chans_per_thread(const unsigned char *data);
 
 int get_vdif_quantization_bits(const unsigned char *data);
@@ -300,6 +577,10 @@ int get_vdif_complex(const unsigned char *data);
 
 int get_vdif_threads(const unsigned char *data, size_t length, int dataframesize);
 
+/* Zero the channels of EDV4 frames marked missing in already decoded data.
+ * The VDIF decoders now do this themselves (see ms->chanmissing), so these
+ * are needed only for data decoded by other means.
+ */
 void blank_vdif_EDV4(const void *packed, int offsetsamples, float **unpacked, int nsamp, int *invalidsamples);
 
 void blank_vdif_EDV4_complex(const void *packed, int offsetsamples, mark5_float_complex **unpacked, int nsamp, int *invalidsamples);
@@ -311,6 +592,8 @@ struct mark5_format_generic *new_mark5_format_codif(int framesperperiod, int ali
 
 int find_codif_frame(const unsigned char *data, int length, size_t *offset, int *framesize, int *headersize);
 
+int find_codif_frame_confidence(const unsigned char *data, int length, size_t *offset, int *framesize, int *headersize, int *confidence);
+
 int get_codif_threads(const unsigned char *data, size_t length, int dataframesize);
   
 /*   KVNMark5B format: under development */
@@ -346,6 +629,15 @@ int blanker_vdif(struct mark5_stream *ms);
 
 int blanker_codif(struct mark5_stream *ms);
 
+/* Blanker finding all fill in the payload, for any format; also lists it in
+ * ms->blankrange */
+
+int blanker_exact(struct mark5_stream *ms);
+
+/* adds the byte ranges of fill in data to ms->blankrange; returns bytes of fill */
+
+int mark5_fill_scan(struct mark5_stream *ms, const unsigned char *data, int nbytes);
+
 /* TO PARTIALLY DETERMINE DATA FORMAT FROM DATA OR DESCRIPTION */
 
 /* contains information that can be determined by a glance at data or name */
@@ -364,6 +656,7 @@ struct mark5_format
 	int framesperperiod;	  /* Number of frames every "alignmentseconds" */
 	int alignmentseconds;	  /* Smallest integer number of seconds with an integer number of frames */
 	int decimation;
+	int score;		  /* frames (of up to 8) that confirmed a detected format */
 };
 
 const char *mark5_stream_list_formats();
@@ -373,10 +666,37 @@ struct mark5_format *new_mark5_format_from_name(const char *formatname);
 struct mark5_format *new_mark5_format_from_stream(
 	struct mark5_stream_generic *s);
 
+/* Every format that passes, best first; returns how many were put in formats */
+int new_mark5_format_candidates_from_stream(struct mark5_stream_generic *s,
+	struct mark5_format **formats, int maxformats);
+
 void delete_mark5_format(struct mark5_format *mf);
 
 void print_mark5_format(const struct mark5_format *mf);
 
+/* FILE SUMMARIES, CACHED IF M5A_OPT_CACHE IS SET; see mark5_cache.c */
+
+struct mark5_file_summary
+{
+	struct mark5_format format;	/* as detected at the start of the file */
+	long long filesize;
+	int endmjd, endsec, endns;	/* time of the last whole frame */
+};
+
+int mark5_summarize_file(struct mark5_file_summary *sum, const char *filename);
+
+void print_mark5_file_summary(const struct mark5_file_summary *sum);
+
+/* the format detected at the start of a file, from the cache if there */
+struct mark5_format *new_mark5_format_from_file(const char *filename);
+
+/* the cache file in each data directory with M5A_OPT_CACHE "sidecar" */
+#define MARK5_CACHE_SIDECAR	".mark5access.cache"
+
+/* small text values about a file, kept while the file is unchanged */
+int mark5_cache_get(const char *filename, const char *key, char *value, int maxlength);
+int mark5_cache_put(const char *filename, const char *key, const char *value);
+
 
 /* OTHER USEFUL FUNCTIONS */
 double correct_2bit_power(double x);
@@ -393,12 +713,29 @@ int mark5_library_setoption(const int mk5option, void* value);
 
 #define M5A_OPT_STDOUTFD 1
 #define M5A_OPT_STDERRFD 2
+#define M5A_OPT_SIMDLEVEL 3	/* int, enum Mark5SimdLevel; applies to formats made afterwards */
+#define M5A_OPT_READAHEAD 4	/* int, buffers read ahead (0 to 16, 0 = off), by io_uring where available, else a thread; applies to file streams made afterwards */
+#define M5A_OPT_FILEIO 5	/* int, MK5_FILEIO_* flags; applies to file streams made afterwards */
+#define M5A_OPT_CACHE 6		/* const char *, file summary cache file, "sidecar" for one per data directory, "" = off */
+
+#define MK5_FILEIO_DIRECT	1	/* io_uring readahead: read with O_DIRECT, bypassing the page cache */
+#define MK5_FILEIO_NOURING	2	/* read ahead with a thread even where io_uring is available */
 extern FILE* m5stderr;
 extern FILE* m5stdout;
 
 /* private functions, not intended for external use */
 
 int mark5_stream_next_frame(struct mark5_stream *ms);
+int mark5_stream_add_blank_range(struct mark5_stream *ms, int start, int end);
+int mark5_stream_add_valid_range(struct mark5_stream *ms, int start, int end);
+void mark5_stream_valid_from_zones(struct mark5_stream *ms);
+
+int mark5_stream_file_set_readahead(int nbuffers);
+int mark5_stream_file_get_readahead(void);
+int mark5_stream_file_set_fileio(int flags);
+int mark5_stream_file_get_fileio(void);
+int mark5_cache_set_path(const char *path);
+const char *mark5_cache_get_path(void);
 
 
 /* for compatibility */
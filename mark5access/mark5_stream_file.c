@@ -27,18 +27,92 @@
 //
 //============================================================================
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* O_DIRECT */
+#endif
+
 #include "config.h"
 
 #include <sys/types.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_uring.h"
 
 #define MAX_MARK5_STREAM_FILES	32	/* probably way too small */
+#define MAX_MARK5_STREAM_READAHEAD	16
+#define MARK5_STREAM_FILE_ALIGN	4096	/* of O_DIRECT reads */
+
+/* buffers read ahead for streams made from now on; see M5A_OPT_READAHEAD */
+static int defaultreadahead = 0;
+static int defaultfileio = 0;
+
+/* With readahead, a thread keeps up to nbuf-1 buffers beyond the one being
+ * decoded filled, each with the next fetchsize bytes of the stream, so that
+ * reading and decoding overlap.  All file access (in, curfile, filesize) is
+ * by the thread while it runs; the stream pauses it to seek or add files.
+ */
+struct mark5_stream_file_readahead
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+#endif
+	int nbuf;
+	unsigned char *buf[MAX_MARK5_STREAM_READAHEAD+1];
+	long long length[MAX_MARK5_STREAM_READAHEAD+1];	/* bytes read into each buffer */
+	int curfile[MAX_MARK5_STREAM_READAHEAD+1];	/* file being read at the end of each */
+	int framebytes;		/* a read shorter than this ends the stream */
+	int cur;		/* buffer being decoded */
+	int count;		/* filled buffers following it */
+	int eof;		/* no more buffers will be filled */
+	int reading;		/* 1 while the thread reads */
+	int pause;
+	int quit;
+	int namedfile;		/* file in ms->streamname */
+};
+
+/* Where io_uring is available the same is done without a thread: reads of
+ * the next windows of the current file are kept in flight in the kernel.  A
+ * window running past the end of the file is read synchronously when its
+ * turn comes, with mark5_stream_file_read(), which moves on to the next
+ * file; nothing is queued behind it until then.
+ */
+enum mark5_stream_file_uring_state
+{
+	URING_FREE = 0,
+	URING_INFLIGHT,		/* read submitted */
+	URING_DONE,		/* read completed, result in res[] */
+	URING_SYNC		/* to be read synchronously */
+};
+
+struct mark5_stream_file_uring
+{
+	struct mark5_uring *U;
+	int nbuf;
+	int fixed;		/* 1 if the buffers are registered with the kernel */
+	int direct;		/* descriptor of the current file opened O_DIRECT, or -1 */
+	int directfile;		/* which file that is */
+	unsigned char *base[MAX_MARK5_STREAM_READAHEAD+1];	/* page aligned */
+	long long pos[MAX_MARK5_STREAM_READAHEAD+1];	/* position in the file of each window */
+	int delta[MAX_MARK5_STREAM_READAHEAD+1];	/* O_DIRECT: bytes before the window in base[] */
+	int state[MAX_MARK5_STREAM_READAHEAD+1];
+	int res[MAX_MARK5_STREAM_READAHEAD+1];
+	int cur;		/* buffer being decoded */
+	int count;		/* buffers queued after it */
+	int blocked;		/* a URING_SYNC window is queued */
+	int eof;
+	long long readpos;	/* position in the current file of the next window */
+};
 
 struct mark5_stream_file
 {
@@ -46,103 +120,687 @@ struct mark5_stream_file
 	long long filesize;
 	char files[MAX_MARK5_STREAM_FILES][MARK5_STREAM_ID_LENGTH];
 	int nfiles;
-	int buffersize;
+	long long buffersize;
+
+	/* byte of the stream at which each file starts; known for the first nstart files, see mark5_stream_file_locate() */
+	long long filestart[MAX_MARK5_STREAM_FILES+1];
+	int nstart;
 
 	int curfile;
-	int fetchsize;
+	long long fetchsize;
 	int in;
 	unsigned char *buffer;
 	unsigned char *end;
 	unsigned char *last;
+
+	int nreadahead;		/* buffers to read ahead, or 0 */
+	int fileio;		/* MK5_FILEIO_* flags */
+	struct mark5_stream_file_readahead *R;
+	struct mark5_stream_file_uring *Q;
 };
 
-/* loads fetchsize bytes into memory */
-static int mark5_stream_file_fill(struct mark5_stream *ms, int offset, int length)
+static void mark5_stream_file_name(struct mark5_stream *ms, int curfile)
 {
 	struct mark5_stream_file *F;
+
+	F = (struct mark5_stream_file *)(ms->inputdata);
+
+	snprintf(ms->streamname, MARK5_STREAM_ID_LENGTH, "File-%d/%d=%s", curfile, F->nfiles, F->files[curfile]);
+}
+
+/* closes the current file and opens file filenum instead */
+static int mark5_stream_file_open(struct mark5_stream_file *F, int filenum)
+{
 	struct stat fileStatus;
-	int n;
 	int err;
+
+	if(F->in >= 0)
+	{
+		close(F->in);
+	}
+	F->curfile = filenum;
+	F->in = open(F->files[filenum], O_RDONLY);
+	if(F->in < 0)
+	{
+		fprintf(m5stderr, "File cannot be opened (2) : <%s> : in = %d\n", F->files[filenum], F->in);
+		perror(0);
+
+		return -1;
+	}
+	err = fstat(F->in, &fileStatus);
+	if(err < 0)
+	{
+		fprintf(m5stderr, "Error looking at file (2) : <%s> : err = %d\n", F->files[filenum], err);
+		perror(0);
+
+		return -1;
+	}
+
+	F->filesize = fileStatus.st_size;
+
+	return 0;
+}
+
+/* The files of a stream are read as one run of bytes, from the offset into
+ * the first on, so frames may span two files.  The file holding a given
+ * byte of the stream is found from the sizes of the files before it, which
+ * are looked up only when a seek first goes past them.  Returns the file
+ * number and sets *filepos to the position within it; -1 if beyond the end.
+ */
+static int mark5_stream_file_locate(struct mark5_stream_file *F, long long pos, long long *filepos)
+{
+	struct stat fileStatus;
+	int i;
+
+	for(i = 0; i < F->nfiles; ++i)
+	{
+		long long skip = (i == 0) ? F->offset : 0;
+
+		if(i + 1 >= F->nstart)
+		{
+			if(stat(F->files[i], &fileStatus) < 0)
+			{
+				fprintf(m5stderr, "Error looking at file (3) : <%s>\n", F->files[i]);
+				perror(0);
+
+				return -1;
+			}
+			F->filestart[i+1] = F->filestart[i] + fileStatus.st_size - skip;
+			F->nstart = i + 2;
+		}
+		if(pos < F->filestart[i+1])
+		{
+			*filepos = pos - F->filestart[i] + skip;
+
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/* reads length bytes from the current file and those after it; returns the number read, or -1 on error */
+static long long mark5_stream_file_read(struct mark5_stream_file *F, unsigned char *buffer, long long length)
+{
+	long long n = 0;
+	ssize_t p;
+
+	for(;;)
+	{
+		/* a single read() returns at most about 2 GB, and stdin may return less anyway */
+		while(n < length && F->in >= 0)
+		{
+			p = read(F->in, buffer+n, length-n);
+			if(p <= 0)
+			{
+				break;
+			}
+			n += p;
+		}
+
+		if(n >= length || F->in == 0)
+		{
+			break;
+		}
+
+		if(F->in >= 0)
+		{
+			close(F->in);
+			F->in = -1;
+			F->curfile++;
+		}
+		
+		if(F->curfile >= F->nfiles)
+		{
+			break;
+		}
+		if(mark5_stream_file_open(F, F->curfile) < 0)
+		{
+			return -1;
+		}
+	}
+
+	if(F->in == 0 && n < length)
+	{
+		/* short reads of stdin end the stream */
+		return -1;
+	}
+
+	return n;
+}
+
+/* loads fetchsize bytes into memory */
+static long long mark5_stream_file_fill(struct mark5_stream *ms, long long offset, long long length)
+{
+	struct mark5_stream_file *F;
+	long long n;
+	int curfile;
 	unsigned char *buffer;
 	
 	F = (struct mark5_stream_file *)(ms->inputdata);
 
 	if(length > F->buffersize)
 	{
-		fprintf(m5stderr, "Error filling from file: <%s> : request for %d bytes exceeds buffersize of %d\n", F->files[F->curfile], length, F->buffersize);
+		fprintf(m5stderr, "Error filling from file: <%s> : request for %lld bytes exceeds buffersize of %lld\n", F->files[F->curfile], length, F->buffersize);
 		perror(0);
 	}
 
 	buffer = F->buffer + offset;
 
-	n = read(F->in, buffer, length);
+	curfile = F->curfile;
+	n = mark5_stream_file_read(F, buffer, length);
+	if(F->curfile != curfile)
+	{
+		mark5_stream_file_name(ms, F->curfile);
+	}
+	if(n < 0)
+	{
+		return -1;
+	}
 	
-	if(F->in == 0)
+	if(n < ms->framebytes)
 	{
-		/* handle short reads specially for stdin */
-		while(n < length)
+		ms->readposition = -1;
+
+		return -1;
+	}
+	
+	if(n < length)
+	{
+		F->last = buffer + n;
+	}
+
+	return n;
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *mark5_stream_file_readahead_thread(void *arg)
+{
+	struct mark5_stream_file *F;
+	struct mark5_stream_file_readahead *R;
+	long long n;
+	int b;
+
+	F = (struct mark5_stream_file *)arg;
+	R = F->R;
+
+	pthread_mutex_lock(&R->lock);
+	for(;;)
+	{
+		while(!R->quit && (R->pause || R->eof || R->count >= R->nbuf-1))
+		{
+			pthread_cond_wait(&R->cond, &R->lock);
+		}
+		if(R->quit)
 		{
-			int p;
+			break;
+		}
 
-			p = read(F->in, buffer+n, length-n);
+		/* never the buffer being decoded, as count < nbuf-1 */
+		b = (R->cur + R->count + 1) % R->nbuf;
+		R->reading = 1;
+		pthread_mutex_unlock(&R->lock);
 
-			if(p <= 0)
+		n = mark5_stream_file_read(F, R->buf[b], F->fetchsize);
+
+		pthread_mutex_lock(&R->lock);
+		R->reading = 0;
+		R->length[b] = n;
+		R->curfile[b] = F->curfile;
+		if(n < R->framebytes)
+		{
+			R->eof = 1;
+		}
+		else
+		{
+			++R->count;
+			if(n < F->fetchsize)
 			{
-				return -1;
+				R->eof = 1;
 			}
+		}
+		pthread_cond_broadcast(&R->cond);
+	}
+	pthread_mutex_unlock(&R->lock);
 
-			n += p;
+	return 0;
+}
+
+/* called from mark5_stream_file_next() once frame size and fetchsize are known */
+static void mark5_stream_file_readahead_start(struct mark5_stream *ms)
+{
+	struct mark5_stream_file *F;
+	struct mark5_stream_file_readahead *R;
+	int b;
+
+	F = (struct mark5_stream_file *)(ms->inputdata);
+
+	R = (struct mark5_stream_file_readahead *)calloc(1, sizeof(struct mark5_stream_file_readahead));
+	R->nbuf = F->nreadahead + 1;
+	R->framebytes = ms->framebytes;
+	R->namedfile = F->curfile;
+	R->buf[0] = F->buffer;
+	for(b = 1; b < R->nbuf; ++b)
+	{
+		R->buf[b] = (unsigned char *)malloc(F->buffersize);
+		if(!R->buf[b])
+		{
+			break;
 		}
 	}
-	else
+	if(b < R->nbuf || pthread_mutex_init(&R->lock, 0) != 0)
+	{
+		fprintf(m5stderr, "Warning: cannot allocate %d readahead buffers; reading synchronously\n", F->nreadahead);
+		while(--b > 0)
+		{
+			free(R->buf[b]);
+		}
+		free(R);
+		F->nreadahead = 0;
+
+		return;
+	}
+	pthread_cond_init(&R->cond, 0);
+	F->R = R;
+	if(pthread_create(&R->thread, 0, mark5_stream_file_readahead_thread, F) != 0)
+	{
+		fprintf(m5stderr, "Warning: cannot start readahead thread; reading synchronously\n");
+		pthread_cond_destroy(&R->cond);
+		pthread_mutex_destroy(&R->lock);
+		for(b = 1; b < R->nbuf; ++b)
+		{
+			free(R->buf[b]);
+		}
+		free(R);
+		F->R = 0;
+		F->nreadahead = 0;
+	}
+}
+
+/* moves to the next filled buffer, waiting for it if need be; returns its length, or -1 at end of data */
+static long long mark5_stream_file_readahead_take(struct mark5_stream *ms)
+{
+	struct mark5_stream_file *F;
+	struct mark5_stream_file_readahead *R;
+	long long n = -1;
+
+	F = (struct mark5_stream_file *)(ms->inputdata);
+	R = F->R;
+
+	pthread_mutex_lock(&R->lock);
+	while(R->count == 0 && !R->eof)
 	{
-		while(n < length)
+		pthread_cond_wait(&R->cond, &R->lock);
+	}
+	if(R->count > 0)
+	{
+		R->cur = (R->cur + 1) % R->nbuf;
+		--R->count;
+		n = R->length[R->cur];
+		F->buffer = R->buf[R->cur];
+		if(R->curfile[R->cur] != R->namedfile)
 		{
-			if(F->in >= 0)
+			R->namedfile = R->curfile[R->cur];
+			mark5_stream_file_name(ms, R->namedfile);
+		}
+		pthread_cond_broadcast(&R->cond);
+	}
+	pthread_mutex_unlock(&R->lock);
+
+	return n;
+}
+
+/* waits for the thread to finish any read and keeps it from starting another */
+static void mark5_stream_file_readahead_pause(struct mark5_stream_file *F)
+{
+	struct mark5_stream_file_readahead *R = F->R;
+
+	pthread_mutex_lock(&R->lock);
+	R->pause = 1;
+	while(R->reading)
+	{
+		pthread_cond_wait(&R->cond, &R->lock);
+	}
+	pthread_mutex_unlock(&R->lock);
+}
+
+/* flush, if set, discards what was read ahead, as after a seek */
+static void mark5_stream_file_readahead_resume(struct mark5_stream_file *F, int flush)
+{
+	struct mark5_stream_file_readahead *R = F->R;
+
+	pthread_mutex_lock(&R->lock);
+	if(flush)
+	{
+		R->count = 0;
+		R->eof = 0;
+	}
+	R->pause = 0;
+	pthread_cond_broadcast(&R->cond);
+	pthread_mutex_unlock(&R->lock);
+}
+
+static void mark5_stream_file_readahead_stop(struct mark5_stream_file *F)
+{
+	struct mark5_stream_file_readahead *R = F->R;
+	int b;
+
+	pthread_mutex_lock(&R->lock);
+	R->quit = 1;
+	pthread_cond_broadcast(&R->cond);
+	pthread_mutex_unlock(&R->lock);
+	pthread_join(R->thread, 0);
+
+	pthread_cond_destroy(&R->cond);
+	pthread_mutex_destroy(&R->lock);
+	for(b = 0; b < R->nbuf; ++b)
+	{
+		if(R->buf[b] != F->buffer)
+		{
+			free(R->buf[b]);
+		}
+	}
+	free(R);
+	F->R = 0;
+}
+#endif
+
+/* makes Q->direct a descriptor of the current file opened O_DIRECT, if wanted and possible */
+static void mark5_stream_file_uring_direct(struct mark5_stream_file *F)
+{
+	struct mark5_stream_file_uring *Q = F->Q;
+
+	if(Q->direct >= 0 && Q->directfile == F->curfile)
+	{
+		return;
+	}
+	if(Q->direct >= 0)
+	{
+		close(Q->direct);
+		Q->direct = -1;
+	}
+#ifdef O_DIRECT
+	if((F->fileio & MK5_FILEIO_DIRECT) && F->curfile < F->nfiles)
+	{
+		/* fails on, e.g., tmpfs; buffered reads are then used */
+		Q->direct = open(F->files[F->curfile], O_RDONLY | O_DIRECT);
+		Q->directfile = F->curfile;
+	}
+#endif
+}
+
+/* queues reads of the following windows into all free buffers */
+static void mark5_stream_file_uring_queue(struct mark5_stream_file *F)
+{
+	struct mark5_stream_file_uring *Q = F->Q;
+	int b, n = 0;
+
+	while(!Q->blocked && !Q->eof && Q->count < Q->nbuf-1)
+	{
+		b = (Q->cur + Q->count + 1) % Q->nbuf;
+		Q->pos[b] = Q->readpos;
+		Q->delta[b] = 0;
+		if(Q->readpos + F->fetchsize > F->filesize)
+		{
+			Q->state[b] = URING_SYNC;
+			Q->blocked = 1;
+		}
+		else
+		{
+			int fd = F->in;
+			long long pos = Q->readpos;
+			int length = F->fetchsize;
+
+			if(Q->direct >= 0)
 			{
-				close(F->in);
+				fd = Q->direct;
+				Q->delta[b] = pos % MARK5_STREAM_FILE_ALIGN;
+				pos -= Q->delta[b];
+				length = (Q->delta[b] + length + MARK5_STREAM_FILE_ALIGN - 1)/MARK5_STREAM_FILE_ALIGN*MARK5_STREAM_FILE_ALIGN;
 			}
-			F->in = -1;
-			F->curfile++;
-			
-			snprintf(ms->streamname, MARK5_STREAM_ID_LENGTH, "File-%d/%d=%s", F->curfile, F->nfiles, F->files[F->curfile]);
-			if(F->curfile >= F->nfiles)
+			if(mark5_uring_queue_read(Q->U, fd, Q->base[b], Q->fixed ? b : -1, length, pos, b) == 0)
 			{
-				break;
+				Q->state[b] = URING_INFLIGHT;
+				++n;
 			}
-			F->in = open(F->files[F->curfile], O_RDONLY);
-			if(F->in < 0)
+			else
 			{
-				fprintf(m5stderr, "File cannot be opened (2) : <%s> : in = %d\n", F->files[F->curfile], F->in);
-				perror(0);
+				/* read by mark5_stream_file_uring_take() instead */
+				Q->state[b] = URING_DONE;
+				Q->res[b] = -1;
+			}
+			Q->readpos += F->fetchsize;
+		}
+		++Q->count;
+	}
+	if(n > 0 && mark5_uring_submit(Q->U) < 0)
+	{
+		for(b = 0; b < Q->nbuf; ++b)
+		{
+			if(Q->state[b] == URING_INFLIGHT)
+			{
+				Q->state[b] = URING_DONE;
+				Q->res[b] = -1;
+			}
+		}
+	}
+}
 
-				return -1;
+/* waits for one completion */
+static int mark5_stream_file_uring_complete(struct mark5_stream_file_uring *Q)
+{
+	unsigned long long tag;
+	int res;
+
+	if(mark5_uring_wait(Q->U, &tag, &res) < 0 || tag >= (unsigned long long)Q->nbuf)
+	{
+		return -1;
+	}
+	Q->state[tag] = URING_DONE;
+	Q->res[tag] = res;
+
+	return 0;
+}
+
+/* waits for all reads in flight and forgets what was queued, before a seek */
+static void mark5_stream_file_uring_drain(struct mark5_stream_file *F)
+{
+	struct mark5_stream_file_uring *Q = F->Q;
+	int b;
+
+	for(;;)
+	{
+		for(b = 0; b < Q->nbuf; ++b)
+		{
+			if(Q->state[b] == URING_INFLIGHT)
+			{
+				break;
 			}
-			err = fstat(F->in, &fileStatus);
-			if(err < 0)
+		}
+		if(b == Q->nbuf || mark5_stream_file_uring_complete(Q) < 0)
+		{
+			break;
+		}
+	}
+	for(b = 0; b < Q->nbuf; ++b)
+	{
+		Q->state[b] = URING_FREE;
+	}
+	Q->count = 0;
+	Q->blocked = 0;
+	Q->eof = 0;
+}
+
+static void mark5_stream_file_uring_stop(struct mark5_stream_file *F)
+{
+	struct mark5_stream_file_uring *Q = F->Q;
+	int b;
+
+	mark5_stream_file_uring_drain(F);
+	mark5_uring_delete(Q->U);
+	if(Q->direct >= 0)
+	{
+		close(Q->direct);
+	}
+	for(b = 0; b < Q->nbuf; ++b)
+	{
+		free(Q->base[b]);
+	}
+	free(Q);
+	F->Q = 0;
+	F->buffer = 0;
+}
+
+/* called from mark5_stream_file_next() once frame size and fetchsize are known; returns -1 if io_uring cannot be used */
+static int mark5_stream_file_uring_start(struct mark5_stream *ms)
+{
+	struct mark5_stream_file *F;
+	struct mark5_stream_file_uring *Q;
+	struct stat fileStatus;
+	int b;
+	size_t size;
+	ptrdiff_t shift;
+
+	F = (struct mark5_stream_file *)(ms->inputdata);
+
+	/* one read per window, whose length the kernel returns as an int */
+	if((F->fileio & MK5_FILEIO_NOURING) || F->fetchsize > (1<<30) || F->in <= 0 || fstat(F->in, &fileStatus) < 0 || !S_ISREG(fileStatus.st_mode))
+	{
+		return -1;
+	}
+
+	Q = (struct mark5_stream_file_uring *)calloc(1, sizeof(struct mark5_stream_file_uring));
+	Q->U = mark5_uring_new(F->nreadahead);
+	if(!Q->U)
+	{
+		free(Q);
+
+		return -1;
+	}
+	Q->nbuf = F->nreadahead + 1;
+	Q->direct = -1;
+	size = F->buffersize + 2*MARK5_STREAM_FILE_ALIGN;
+	for(b = 0; b < Q->nbuf; ++b)
+	{
+		void *p;
+
+		if(posix_memalign(&p, MARK5_STREAM_FILE_ALIGN, size) != 0)
+		{
+			while(--b >= 0)
 			{
-				fprintf(m5stderr, "Error looking at file (2) : <%s> : err = %d\n", F->files[F->curfile], err);
-				perror(0);
+				free(Q->base[b]);
+			}
+			mark5_uring_delete(Q->U);
+			free(Q);
+
+			return -1;
+		}
+		Q->base[b] = (unsigned char *)p;
+	}
+	Q->fixed = (mark5_uring_register_buffers(Q->U, Q->base, Q->nbuf, size) == 0);
+
+	/* the window being decoded moves into the first buffer */
+	memcpy(Q->base[0], F->buffer, F->buffersize);
+	shift = Q->base[0] - F->buffer;
+	ms->frame += shift;
+	ms->datawindow = Q->base[0];
+	F->end += shift;
+	F->last += shift;
+	free(F->buffer);
+	F->buffer = Q->base[0];
+
+	F->Q = Q;
+	Q->readpos = lseek(F->in, 0, SEEK_CUR);
+	mark5_stream_file_uring_direct(F);
+	mark5_stream_file_uring_queue(F);
+
+	return 0;
+}
+
+/* moves to the next window, waiting for it if need be; returns its length, or -1 at end of data */
+static long long mark5_stream_file_uring_take(struct mark5_stream *ms)
+{
+	struct mark5_stream_file *F;
+	struct mark5_stream_file_uring *Q;
+	long long n;
+	int b;
 
+	F = (struct mark5_stream_file *)(ms->inputdata);
+	Q = F->Q;
+
+	if(Q->count == 0)
+	{
+		return -1;
+	}
+	b = (Q->cur + 1) % Q->nbuf;
+
+	if(Q->state[b] == URING_SYNC)
+	{
+		int curfile = F->curfile;
+
+		if(lseek(F->in, Q->pos[b], SEEK_SET) < 0)
+		{
+			return -1;
+		}
+		n = mark5_stream_file_read(F, Q->base[b], F->fetchsize);
+		if(F->curfile != curfile)
+		{
+			mark5_stream_file_name(ms, F->curfile);
+			mark5_stream_file_uring_direct(F);
+		}
+		if(n < F->fetchsize || F->in < 0)
+		{
+			Q->eof = 1;
+		}
+		else
+		{
+			Q->readpos = lseek(F->in, 0, SEEK_CUR);
+		}
+		Q->blocked = 0;
+	}
+	else
+	{
+		while(Q->state[b] == URING_INFLIGHT)
+		{
+			if(mark5_stream_file_uring_complete(Q) < 0)
+			{
 				return -1;
 			}
+		}
+		n = Q->res[b] - Q->delta[b];
+		if(n > F->fetchsize)
+		{
+			n = F->fetchsize;
+		}
+		if(n < 0)
+		{
+			n = 0;
+		}
+		/* errors and short reads, which are rare, are completed by plain reads */
+		while(n < F->fetchsize)
+		{
+			ssize_t r = pread(F->in, Q->base[b] + Q->delta[b] + n, F->fetchsize - n, Q->pos[b] + n);
 
-			F->filesize = fileStatus.st_size;
-			n += read(F->in, buffer+n, length-n);
+			if(r <= 0)
+			{
+				Q->eof = 1;
+				break;
+			}
+			n += r;
 		}
 	}
-	
+
+	Q->state[b] = URING_FREE;
+	Q->cur = b;
+	--Q->count;
+	F->buffer = Q->base[b] + Q->delta[b];
+
 	if(n < ms->framebytes)
 	{
-		ms->readposition = -1;
-
 		return -1;
 	}
-	
-	if(n < length)
-	{
-		F->last = buffer + n;
-	}
+
+	mark5_stream_file_uring_queue(F);
 
 	return n;
 }
@@ -150,7 +808,8 @@ static int mark5_stream_file_fill(struct mark5_stream *ms, int offset, int lengt
 static int mark5_stream_file_init(struct mark5_stream *ms)
 {
 	struct mark5_stream_file *F;
-	int r;
+	long long r;
+	ssize_t nr;
 
 	F = (struct mark5_stream_file *)(ms->inputdata);
 
@@ -172,7 +831,6 @@ static int mark5_stream_file_init(struct mark5_stream *ms)
 		{
 			/* seek by reading if stdin */
 			long long togo = F->offset;
-			ssize_t nr;
 
 			while(togo > 0)
 			{
@@ -205,10 +863,17 @@ static int mark5_stream_file_init(struct mark5_stream *ms)
 	ms->datawindowsize = F->buffersize;
 
 	/* only load half a buffer-full to start with */
-	r = read(F->in, F->buffer, F->buffersize/2);
+	for(r = 0; r < F->buffersize/2; r += nr)
+	{
+		nr = read(F->in, F->buffer + r, F->buffersize/2 - r);
+		if(nr <= 0)
+		{
+			break;
+		}
+	}
 	if(r < F->buffersize/2)
 	{
-		fprintf(m5stderr, "mark5_stream_file_init: Initial read of %d was short (%d bytes actually read).  Shortening datawindowsize\n", F->buffersize, r);
+		fprintf(m5stderr, "mark5_stream_file_init: Initial read of %lld was short (%lld bytes actually read).  Shortening datawindowsize\n", F->buffersize, r);
 		ms->datawindowsize = F->buffersize = r;
 	}
 
@@ -226,10 +891,10 @@ static int mark5_stream_file_next(struct mark5_stream *ms)
 		/* only F->buffersize/2 were loaded so far. */
 		/* now load exactly enough to end read on the frame boundary just before or at end of buffer */
 
-		int nload;
-		int nframes;
-		int status;
-		int l;	/* amount needed to finish partial frame at end of first load */
+		long long nload;
+		long long nframes;
+		long long status;
+		long long l;	/* amount needed to finish partial frame at end of first load */
 
 		nframes = (F->buffersize)/ms->framebytes; 
 		F->fetchsize = nframes*ms->framebytes;
@@ -251,19 +916,58 @@ static int mark5_stream_file_next(struct mark5_stream *ms)
 		}
 	}
 
+	if(F->nreadahead > 0 && F->R == 0 && F->Q == 0)
+	{
+		if(mark5_stream_file_uring_start(ms) < 0)
+		{
+#ifdef HAVE_LIBPTHREAD
+			mark5_stream_file_readahead_start(ms);
+#else
+			F->nreadahead = 0;
+#endif
+		}
+	}
+
 	/* usually this is all that needs to be done */
 	ms->frame += ms->framebytes;
 	
-	if(ms->frame + ms->framebytes > F->end)
+	/* a short window read ahead is followed by more if files were added since */
+	if(ms->frame + ms->framebytes > F->end || (F->R && ms->frame + ms->framebytes > F->last))
 	{
-		int status;
+		long long status;
 
-		ms->frame = F->buffer;
+		if(F->R || F->Q)
+		{
+			/* the next window was read while this one was decoded */
+#ifdef HAVE_LIBPTHREAD
+			if(F->R)
+			{
+				status = mark5_stream_file_readahead_take(ms);
+			}
+			else
+#endif
+			{
+				status = mark5_stream_file_uring_take(ms);
+			}
+			if(status < 0)
+			{
+				ms->readposition = -1;
 
-		status = mark5_stream_file_fill(ms, 0, F->fetchsize);
-		if(status < 0)
+				return -1;
+			}
+			ms->frame = F->buffer;
+			F->end = F->buffer + F->fetchsize;
+			F->last = F->buffer + status;
+		}
+		else
 		{
-			return -1;
+			ms->frame = F->buffer;
+
+			status = mark5_stream_file_fill(ms, 0, F->fetchsize);
+			if(status < 0)
+			{
+				return -1;
+			}
 		}
 	}
 
@@ -284,40 +988,79 @@ static int mark5_stream_file_next(struct mark5_stream *ms)
 static int mark5_stream_file_seek(struct mark5_stream *ms, long long framenum)
 {
 	struct mark5_stream_file *F;
-	off_t pos, sook;
-	int nframes, status;
+	long long pos, nframes, status;
+	off_t sook;
+	int filenum;
 
 	F = (struct mark5_stream_file *)(ms->inputdata);
-	
-	pos = framenum*ms->framebytes + ms->frameoffset;
 
-#warning "FIXME: look into other files?"
-	if(framenum < 0 || pos > F->filesize)	
+	/* stdin cannot seek */
+	if(framenum < 0 || F->in == 0)
 	{
 		return -1;
 	}
 
+	filenum = mark5_stream_file_locate(F, framenum*ms->framebytes + ms->frameoffset, &pos);
+	if(filenum < 0)
+	{
+		return -1;
+	}
+
+#ifdef HAVE_LIBPTHREAD
+	if(F->R)
+	{
+		mark5_stream_file_readahead_pause(F);
+	}
+#endif
+	if(F->Q)
+	{
+		mark5_stream_file_uring_drain(F);
+		F->buffer = F->Q->base[F->Q->cur];
+	}
+
 	nframes = (F->buffersize)/ms->framebytes;
 	F->fetchsize = nframes*ms->framebytes;
 	F->end = F->buffer + F->fetchsize;
 	F->last = F->end;
 	ms->frame = F->buffer;
 
-	sook = lseek(F->in, pos, SEEK_SET);
+	if(filenum != F->curfile || F->in < 0)
+	{
+		sook = mark5_stream_file_open(F, filenum);
+		mark5_stream_file_name(ms, filenum);
+	}
+	else
+	{
+		sook = 0;
+	}
+	if(sook >= 0)
+	{
+		sook = lseek(F->in, pos, SEEK_SET);
+	}
 	if(sook < 0)
 	{
-		fprintf(stderr, "Seek error: pos=%lld\n", (long long int)pos);
-
-		return -1;
+		fprintf(stderr, "Seek error: file %d pos=%lld\n", filenum, pos);
+		status = -1;
+	}
+	else
+	{
+		status = mark5_stream_file_fill(ms, 0, F->fetchsize);
 	}
 
-	status = mark5_stream_file_fill(ms, 0, F->fetchsize);
-	if(status < 0)
+#ifdef HAVE_LIBPTHREAD
+	if(F->R)
 	{
-		return -1;
+		mark5_stream_file_readahead_resume(F, 1);
+	}
+#endif
+	if(F->Q && status >= 0 && F->in >= 0)
+	{
+		F->Q->readpos = lseek(F->in, 0, SEEK_CUR);
+		mark5_stream_file_uring_direct(F);
+		mark5_stream_file_uring_queue(F);
 	}
 
-	return 0;
+	return status < 0 ? -1 : 0;
 }
 
 static int mark5_stream_file_final(struct mark5_stream *ms)
@@ -326,6 +1069,16 @@ static int mark5_stream_file_final(struct mark5_stream *ms)
 
 	F = (struct mark5_stream_file *)(ms->inputdata);
 
+#ifdef HAVE_LIBPTHREAD
+	if(F->R)
+	{
+		mark5_stream_file_readahead_stop(F);
+	}
+#endif
+	if(F->Q)
+	{
+		mark5_stream_file_uring_stop(F);
+	}
 	if(F->in >= 0)
 	{
 		close(F->in);
@@ -395,7 +1148,10 @@ struct mark5_stream_generic *new_mark5_stream_file(const char *filename, long lo
 		snprintf(F->files[0], MARK5_STREAM_ID_LENGTH, "%s", filename);
 	}
 	F->nfiles = 1;
+	F->nstart = 1;
 	F->offset = offset;
+	F->nreadahead = defaultreadahead;
+	F->fileio = defaultfileio;
 
 	V->init_stream = mark5_stream_file_init;
 	V->next = mark5_stream_file_next;
@@ -407,6 +1163,30 @@ struct mark5_stream_generic *new_mark5_stream_file(const char *filename, long lo
 	return V;
 }
 
+int mark5_stream_file_set_buffersize(struct mark5_stream_generic *s, long long nbytes)
+{
+	struct mark5_stream_file *F;
+
+	if(s->init_stream != mark5_stream_file_init)
+	{
+		fprintf(m5stderr, "mark5_stream_file_set_buffersize: " "Wrong stream type!\n");
+
+		return -1;
+	}
+	if(nbytes < MARK5_STREAM_MINBUFSIZE)
+	{
+		fprintf(m5stderr, "mark5_stream_file_set_buffersize: %lld bytes is too small; at least %d are needed\n", nbytes, MARK5_STREAM_MINBUFSIZE);
+
+		return -1;
+	}
+
+	F = (struct mark5_stream_file *)(s->inputdata);
+
+	F->buffersize = (F->in != 0 && F->filesize < nbytes) ? F->filesize : nbytes;
+
+	return 0;
+}
+
 int mark5_stream_file_add_infile(struct mark5_stream *ms, const char *filename)
 {
 	struct mark5_stream_file *F;
@@ -422,8 +1202,27 @@ int mark5_stream_file_add_infile(struct mark5_stream *ms, const char *filename)
 
 	if(F->nfiles < MAX_MARK5_STREAM_FILES)
 	{
+#ifdef HAVE_LIBPTHREAD
+		if(F->R)
+		{
+			mark5_stream_file_readahead_pause(F);
+		}
+#endif
 		snprintf(F->files[F->nfiles], MARK5_STREAM_ID_LENGTH, "%s", filename);
 		F->nfiles++;
+#ifdef HAVE_LIBPTHREAD
+		if(F->R)
+		{
+			/* the thread may have stopped at the end of the previous last file */
+			pthread_mutex_lock(&F->R->lock);
+			if(F->curfile < F->nfiles)
+			{
+				F->R->eof = 0;
+			}
+			pthread_mutex_unlock(&F->R->lock);
+			mark5_stream_file_readahead_resume(F, 0);
+		}
+#endif
 		snprintf(ms->streamname, MARK5_STREAM_ID_LENGTH, "File-%d/%d=%s", F->curfile, F->nfiles, filename);
 	
 		return F->nfiles;
@@ -433,3 +1232,35 @@ int mark5_stream_file_add_infile(struct mark5_stream *ms, const char *filename)
 		return -1;
 	}
 }
+
+int mark5_stream_file_set_readahead(int nbuffers)
+{
+	if(nbuffers < 0 || nbuffers > MAX_MARK5_STREAM_READAHEAD)
+	{
+		return -1;
+	}
+	defaultreadahead = nbuffers;
+
+	return 0;
+}
+
+int mark5_stream_file_get_readahead(void)
+{
+	return defaultreadahead;
+}
+
+int mark5_stream_file_set_fileio(int flags)
+{
+	if(flags & ~(MK5_FILEIO_DIRECT | MK5_FILEIO_NOURING))
+	{
+		return -1;
+	}
+	defaultfileio = flags;
+
+	return 0;
+}
+
+int mark5_stream_file_get_fileio(void)
+{
+	return defaultfileio;
+}
@@ -0,0 +1,496 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mark5access/mark5_stream.h"
+
+/* A Mark6 scan is scattered over one file per disk.  Each file has a short
+ * header and then blocks, each with a header giving its sequence number
+ * within the scan and its size; the scan is the payloads of all the blocks
+ * in sequence order.  This stream reads the files in parallel, one thread
+ * per file, into a window of block slots (block b into slot b % nslot), and
+ * decodes the blocks in order straight from the slots.  The few bytes of a
+ * frame cut by a block end are copied in front of the next block.  A block
+ * that no file has is decoded as zeros, which fail validation and so are
+ * blanked.  The libmark6sg scatter-gather library is not needed.
+ */
+
+#define MARK6_SYNC_WORD			0xfeed6666
+#define MARK5_STREAM_MARK6_ROOT		"/mnt/disks/*/*/data/"
+#define MARK5_STREAM_MARK6_MAXFILES	64
+#define MARK5_STREAM_MARK6_CARRY	(256<<10)	/* room for a frame cut by a block end */
+#define MARK5_STREAM_MARK6_SPARESLOTS	4		/* slots beyond one per file */
+
+/* Mark6 file header, version 2 */
+struct mark6_file_header
+{
+	unsigned int syncword;
+	int version;
+	int blocksize;		/* largest block, including its header */
+	int packetformat;
+	int packetsize;
+};
+
+/* Mark6 block header, version 2 */
+struct mark6_block_header
+{
+	int blocknum;
+	int wbsize;		/* including this header */
+};
+
+struct mark5_stream_mark6;
+
+struct mark5_stream_mark6_file
+{
+	struct mark5_stream_mark6 *M;
+	int fd;
+	long long nextblock;		/* the block the thread is placing; LLONG_MAX when done */
+	pthread_t thread;
+	int running;
+};
+
+struct mark5_stream_mark6
+{
+	char scanname[MARK5_STREAM_ID_LENGTH];
+	int nfile;
+	char filename[MARK5_STREAM_MARK6_MAXFILES][MARK5_STREAM_ID_LENGTH];
+	struct mark5_stream_mark6_file file[MARK5_STREAM_MARK6_MAXFILES];
+	int blocksize;			/* largest payload */
+
+	int nslot;
+	unsigned char **slot;		/* [nslot][MARK5_STREAM_MARK6_CARRY + blocksize] */
+	long long *slotblock;		/* block in the slot, or -1 */
+	int *slotbytes;
+	long long want;			/* block being decoded */
+	int stop;
+	long long nmissing;
+	long long nbad;			/* blocks with nonsense headers; rest of the file ignored */
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+static void *mark5_stream_mark6_reader(void *arg)
+{
+	struct mark5_stream_mark6_file *F = (struct mark5_stream_mark6_file *)arg;
+	struct mark5_stream_mark6 *M = F->M;
+	struct mark6_block_header header;
+	long long b;
+	int n, s;
+
+	for(;;)
+	{
+		if(read(F->fd, &header, sizeof(header)) != sizeof(header))
+		{
+			break;
+		}
+		b = header.blocknum;
+		n = header.wbsize - (int)sizeof(header);
+		if(b < 0 || n < 0 || n > M->blocksize)
+		{
+			pthread_mutex_lock(&M->lock);
+			++M->nbad;
+			pthread_mutex_unlock(&M->lock);
+
+			break;
+		}
+
+		pthread_mutex_lock(&M->lock);
+		F->nextblock = b;
+		pthread_cond_broadcast(&M->cond);
+		while(!M->stop && b >= M->want + M->nslot)
+		{
+			pthread_cond_wait(&M->cond, &M->lock);
+		}
+		if(M->stop)
+		{
+			pthread_mutex_unlock(&M->lock);
+
+			break;
+		}
+		if(b < M->want)
+		{
+			/* given up as missing, or a repeat */
+			pthread_mutex_unlock(&M->lock);
+			lseek(F->fd, n, SEEK_CUR);
+
+			continue;
+		}
+		pthread_mutex_unlock(&M->lock);
+
+		/* slot b % nslot held block b - nslot, decoded already */
+		s = b % M->nslot;
+		n = read(F->fd, M->slot[s] + MARK5_STREAM_MARK6_CARRY, n);
+		if(n < 0)
+		{
+			n = 0;
+		}
+
+		pthread_mutex_lock(&M->lock);
+		M->slotblock[s] = b;
+		M->slotbytes[s] = n;
+		pthread_cond_broadcast(&M->cond);
+		pthread_mutex_unlock(&M->lock);
+	}
+
+	pthread_mutex_lock(&M->lock);
+	F->nextblock = LLONG_MAX;
+	pthread_cond_broadcast(&M->cond);
+	pthread_mutex_unlock(&M->lock);
+
+	return 0;
+}
+
+/* Waits for block b, M->want or the one after.  Returns its slot, or -1 if
+ * no file has it or any later block.  A block no file has is zero filled.
+ */
+static int mark5_stream_mark6_get(struct mark5_stream_mark6 *M, long long b)
+{
+	int s, f;
+
+	s = b % M->nslot;
+
+	pthread_mutex_lock(&M->lock);
+	for(;;)
+	{
+		long long next = LLONG_MAX;
+
+		if(M->slotblock[s] == b)
+		{
+			break;
+		}
+		for(f = 0; f < M->nfile; ++f)
+		{
+			if(M->file[f].nextblock < next)
+			{
+				next = M->file[f].nextblock;
+			}
+		}
+		if(next > b)
+		{
+			/* every file is past it */
+			if(next == LLONG_MAX)
+			{
+				s = -1;
+			}
+			else
+			{
+				memset(M->slot[s] + MARK5_STREAM_MARK6_CARRY, 0, M->blocksize);
+				M->slotblock[s] = b;
+				M->slotbytes[s] = M->blocksize;
+				++M->nmissing;
+			}
+
+			break;
+		}
+		pthread_cond_wait(&M->cond, &M->lock);
+	}
+	pthread_mutex_unlock(&M->lock);
+
+	return s;
+}
+
+static int mark5_stream_mark6_init(struct mark5_stream *ms)
+{
+	struct mark5_stream_mark6 *M;
+	long long first = LLONG_MAX;
+	int f, s;
+
+	M = (struct mark5_stream_mark6 *)(ms->inputdata);
+
+	snprintf(ms->streamname, MARK5_STREAM_ID_LENGTH, "MARK6=%.*s", MARK5_STREAM_ID_LENGTH-7, M->scanname);
+
+	pthread_mutex_init(&M->lock, 0);
+	pthread_cond_init(&M->cond, 0);
+
+	for(f = 0; f < M->nfile; ++f)
+	{
+		M->file[f].fd = -1;
+	}
+	for(f = 0; f < M->nfile; ++f)
+	{
+		struct mark5_stream_mark6_file *F = M->file + f;
+		struct mark6_file_header fileheader;
+		struct mark6_block_header header;
+
+		F->M = M;
+		F->fd = open(M->filename[f], O_RDONLY);
+		if(F->fd < 0)
+		{
+			fprintf(m5stderr, "mark5_stream_mark6_init: cannot open %s\n", M->filename[f]);
+
+			return -1;
+		}
+		if(read(F->fd, &fileheader, sizeof(fileheader)) != sizeof(fileheader) ||
+		   fileheader.syncword != MARK6_SYNC_WORD || fileheader.version != 2 ||
+		   fileheader.blocksize <= (int)sizeof(header))
+		{
+			fprintf(m5stderr, "mark5_stream_mark6_init: %s is not a version 2 Mark6 file\n", M->filename[f]);
+
+			return -1;
+		}
+		if(fileheader.blocksize - (int)sizeof(header) > M->blocksize)
+		{
+			M->blocksize = fileheader.blocksize - sizeof(header);
+		}
+
+		/* the scan starts at the lowest first block */
+		if(pread(F->fd, &header, sizeof(header), sizeof(fileheader)) == sizeof(header))
+		{
+			F->nextblock = header.blocknum;
+			if(header.blocknum < first)
+			{
+				first = header.blocknum;
+			}
+		}
+		else
+		{
+			F->nextblock = LLONG_MAX;
+		}
+	}
+	if(first == LLONG_MAX)
+	{
+		fprintf(m5stderr, "mark5_stream_mark6_init: no data in %s\n", M->scanname);
+
+		return -1;
+	}
+
+	M->nslot = M->nfile + MARK5_STREAM_MARK6_SPARESLOTS;
+	M->slot = (unsigned char **)calloc(M->nslot, sizeof(unsigned char *));
+	M->slotblock = (long long *)malloc(M->nslot*sizeof(long long));
+	M->slotbytes = (int *)calloc(M->nslot, sizeof(int));
+	for(s = 0; s < M->nslot; ++s)
+	{
+		M->slot[s] = (unsigned char *)malloc((long long)MARK5_STREAM_MARK6_CARRY + M->blocksize);
+		if(!M->slot[s])
+		{
+			fprintf(m5stderr, "mark5_stream_mark6_init: cannot allocate %d blocks of %d bytes\n", M->nslot, M->blocksize);
+
+			return -1;
+		}
+		M->slotblock[s] = -1;
+	}
+	M->want = first;
+
+	for(f = 0; f < M->nfile; ++f)
+	{
+		if(pthread_create(&M->file[f].thread, 0, mark5_stream_mark6_reader, M->file + f) != 0)
+		{
+			fprintf(m5stderr, "mark5_stream_mark6_init: cannot start reader of %s\n", M->filename[f]);
+			M->file[f].nextblock = LLONG_MAX;
+		}
+		else
+		{
+			M->file[f].running = 1;
+		}
+	}
+
+	s = mark5_stream_mark6_get(M, M->want);
+	if(s < 0)
+	{
+		return -1;
+	}
+	ms->datawindow = M->slot[s] + MARK5_STREAM_MARK6_CARRY;
+	ms->datawindowsize = M->slotbytes[s];
+
+	return 0;
+}
+
+static int mark5_stream_mark6_next(struct mark5_stream *ms)
+{
+	struct mark5_stream_mark6 *M;
+
+	M = (struct mark5_stream_mark6 *)(ms->inputdata);
+
+	ms->frame += ms->framebytes;
+
+	while(ms->frame + ms->framebytes > ms->datawindow + ms->datawindowsize)
+	{
+		long long remain;
+		unsigned char *start;
+		int s;
+
+		remain = ms->datawindow + ms->datawindowsize - ms->frame;
+		if(remain < 0 || remain > MARK5_STREAM_MARK6_CARRY)
+		{
+			remain = 0;
+		}
+
+		s = mark5_stream_mark6_get(M, M->want + 1);
+		if(s < 0)
+		{
+			ms->readposition = -1;
+
+			return -1;
+		}
+
+		/* the cut frame goes in front of the next block, then the block before is given back */
+		start = M->slot[s] + MARK5_STREAM_MARK6_CARRY - remain;
+		memcpy(start, ms->frame, remain);
+		ms->datawindow = start;
+		ms->datawindowsize = remain + M->slotbytes[s];
+		ms->frame = start;
+
+		pthread_mutex_lock(&M->lock);
+		++M->want;
+		pthread_cond_broadcast(&M->cond);
+		pthread_mutex_unlock(&M->lock);
+	}
+
+	/* successfully got new frame, so increment it */
+	++ms->framenum;
+	ms->readposition = 0;
+
+	return ms->framebytes;
+}
+
+static int mark5_stream_mark6_final(struct mark5_stream *ms)
+{
+	struct mark5_stream_mark6 *M;
+	int f, s;
+
+	M = (struct mark5_stream_mark6 *)(ms->inputdata);
+
+	pthread_mutex_lock(&M->lock);
+	M->stop = 1;
+	pthread_cond_broadcast(&M->cond);
+	pthread_mutex_unlock(&M->lock);
+
+	for(f = 0; f < M->nfile; ++f)
+	{
+		if(M->file[f].running)
+		{
+			pthread_join(M->file[f].thread, 0);
+		}
+	}
+	if(M->nmissing > 0 || M->nbad > 0)
+	{
+		fprintf(m5stderr, "Warning: %s: %lld blocks missing (blanked), %lld bad block headers\n",
+			ms->streamname, M->nmissing, M->nbad);
+	}
+
+	for(f = 0; f < M->nfile; ++f)
+	{
+		if(M->file[f].fd >= 0)
+		{
+			close(M->file[f].fd);
+		}
+	}
+	if(M->slot)
+	{
+		for(s = 0; s < M->nslot; ++s)
+		{
+			if(M->slot[s])
+			{
+				free(M->slot[s]);
+			}
+		}
+		free(M->slot);
+	}
+	if(M->slotblock)
+	{
+		free(M->slotblock);
+	}
+	if(M->slotbytes)
+	{
+		free(M->slotbytes);
+	}
+	pthread_mutex_destroy(&M->lock);
+	pthread_cond_destroy(&M->cond);
+
+	free(M);
+
+	return 0;
+}
+
+/* scanname is a scan name, found on the usual Mark6 mount points, or a
+ * path or pattern matching the files of the scan
+ */
+struct mark5_stream_generic *new_mark5_stream_mark6(const char *scanname)
+{
+	struct mark5_stream_generic *V;
+	struct mark5_stream_mark6 *M;
+	char pattern[MARK5_STREAM_ID_LENGTH + 32];
+	glob_t g;
+	int f;
+
+	if(strchr(scanname, '/'))
+	{
+		snprintf(pattern, sizeof(pattern), "%s", scanname);
+	}
+	else
+	{
+		snprintf(pattern, sizeof(pattern), "%s%s", MARK5_STREAM_MARK6_ROOT, scanname);
+	}
+	if(glob(pattern, 0, 0, &g) != 0 || g.gl_pathc == 0)
+	{
+		fprintf(m5stderr, "new_mark5_stream_mark6: no files match %s\n", pattern);
+
+		return 0;
+	}
+	if(g.gl_pathc > MARK5_STREAM_MARK6_MAXFILES)
+	{
+		fprintf(m5stderr, "new_mark5_stream_mark6: %d files match %s; at most %d are allowed\n",
+			(int)(g.gl_pathc), pattern, MARK5_STREAM_MARK6_MAXFILES);
+		globfree(&g);
+
+		return 0;
+	}
+
+	V = (struct mark5_stream_generic *)calloc(1, sizeof(struct mark5_stream_generic));
+	M = (struct mark5_stream_mark6 *)calloc(1, sizeof(struct mark5_stream_mark6));
+
+	snprintf(M->scanname, MARK5_STREAM_ID_LENGTH, "%s", scanname);
+	M->nfile = g.gl_pathc;
+	for(f = 0; f < M->nfile; ++f)
+	{
+		snprintf(M->filename[f], MARK5_STREAM_ID_LENGTH, "%s", g.gl_pathv[f]);
+	}
+	globfree(&g);
+
+	V->init_stream = mark5_stream_mark6_init;
+	V->next = mark5_stream_mark6_next;
+	V->final_stream = mark5_stream_mark6_final;
+	V->inputdata = M;
+	V->inputdatasize = sizeof(struct mark5_stream_mark6);
+
+	return V;
+}
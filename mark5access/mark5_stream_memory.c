@@ -35,13 +35,13 @@ struct mark5_stream_memory
 {
 	const unsigned char *start;
 	const unsigned char *end;			/* derived by init() */
-	unsigned int nbytes;
+	long long nbytes;
 };
 
 static int mark5_stream_memory_init(struct mark5_stream *ms)
 {
 	const unsigned char *start;
-	unsigned int nbytes;
+	long long nbytes;
 
 	snprintf(ms->streamname, MARK5_STREAM_ID_LENGTH, "Memory");
 
@@ -102,7 +102,7 @@ static int mark5_stream_memory_final(struct mark5_stream *ms)
 	return 0;
 }
 
-struct mark5_stream_generic *new_mark5_stream_memory(const void *data, unsigned int nbytes)
+struct mark5_stream_generic *new_mark5_stream_memory(const void *data, long long nbytes)
 {
 	struct mark5_stream_generic *s;
 	struct mark5_stream_memory *M;
@@ -0,0 +1,306 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mark5access/mark5_stream.h"
+
+/* Frames are decoded in place from a read-only mapping of the file, so
+ * unlike the file stream no byte is copied.  Where the address space
+ * allows, the whole file is mapped once; otherwise a window of it is,
+ * and moved along as the frames run past its end.
+ */
+
+#define MARK5_STREAM_MMAP_WINDOW	(256LL<<20)	/* bytes mapped at a time, 32-bit systems */
+#define MARK5_STREAM_MMAP_READAHEAD	(16LL<<20)	/* bytes asked for ahead of the current frame */
+
+struct mark5_stream_mmap
+{
+	char filename[MARK5_STREAM_ID_LENGTH];
+	long long offset;	/* of the start of the stream within the file */
+	long long filesize;
+	long long windowsize;
+	int in;
+
+	const unsigned char *map;
+	long long mapstart;	/* file position of map[0], a multiple of the page size */
+	long long maplength;
+	long long advised;	/* file position up to which readahead has been asked for */
+};
+
+/* ask the kernel to start reading what will soon be needed */
+static void mark5_stream_mmap_advise(struct mark5_stream_mmap *M, long long pos)
+{
+#ifdef MADV_WILLNEED
+	long long end;
+
+	if(pos + MARK5_STREAM_MMAP_READAHEAD/2 < M->advised)
+	{
+		return;
+	}
+	if(M->advised < pos)
+	{
+		M->advised = pos - (pos - M->mapstart) % sysconf(_SC_PAGESIZE);
+	}
+	end = pos + MARK5_STREAM_MMAP_READAHEAD;
+	if(end > M->mapstart + M->maplength)
+	{
+		end = M->mapstart + M->maplength;
+	}
+	if(end > M->advised)
+	{
+		madvise((void *)(M->map + (M->advised - M->mapstart)), end - M->advised, MADV_WILLNEED);
+		M->advised = end;
+	}
+#endif
+}
+
+/* map the window starting at or just before file position pos */
+static int mark5_stream_mmap_map(struct mark5_stream_mmap *M, long long pos)
+{
+	long long start, length;
+	void *map;
+
+	start = pos - pos % sysconf(_SC_PAGESIZE);
+	length = M->filesize - start;
+	if(length > M->windowsize)
+	{
+		length = M->windowsize;
+	}
+
+	if(M->map)
+	{
+		munmap((void *)(M->map), M->maplength);
+		M->map = 0;
+	}
+
+	map = mmap(0, length, PROT_READ, MAP_SHARED, M->in, start);
+	if(map == MAP_FAILED)
+	{
+		fprintf(m5stderr, "Error mapping file : <%s> : %lld bytes at %lld\n", M->filename, length, start);
+		perror(0);
+
+		return -1;
+	}
+#ifdef MADV_SEQUENTIAL
+	madvise(map, length, MADV_SEQUENTIAL);
+#endif
+
+	M->map = (const unsigned char *)map;
+	M->mapstart = start;
+	M->maplength = length;
+	M->advised = start;
+	mark5_stream_mmap_advise(M, pos);
+
+	return 0;
+}
+
+static int mark5_stream_mmap_init(struct mark5_stream *ms)
+{
+	struct mark5_stream_mmap *M;
+
+	M = (struct mark5_stream_mmap *)(ms->inputdata);
+
+	snprintf(ms->streamname, MARK5_STREAM_ID_LENGTH, "Mmap=%.*s", MARK5_STREAM_ID_LENGTH-6, M->filename);
+
+	M->map = 0;
+	if(mark5_stream_mmap_map(M, M->offset) < 0)
+	{
+		return -1;
+	}
+
+	ms->datawindow = M->map + (M->offset - M->mapstart);
+	ms->datawindowsize = M->maplength - (M->offset - M->mapstart);
+
+	return 0;
+}
+
+static int mark5_stream_mmap_next(struct mark5_stream *ms)
+{
+	struct mark5_stream_mmap *M;
+	long long pos;
+
+	M = (struct mark5_stream_mmap *)(ms->inputdata);
+
+	ms->frame += ms->framebytes;
+	pos = M->mapstart + (ms->frame - M->map);
+
+	if(ms->frame + ms->framebytes > M->map + M->maplength)
+	{
+		if(pos + ms->framebytes > M->filesize)
+		{
+			ms->readposition = -1;
+
+			return -1;
+		}
+
+		/* move the window along */
+		if(mark5_stream_mmap_map(M, pos) < 0)
+		{
+			ms->readposition = -1;
+
+			return -1;
+		}
+		ms->frame = M->map + (pos - M->mapstart);
+		ms->datawindow = M->map;
+		ms->datawindowsize = M->maplength;
+	}
+	else
+	{
+		mark5_stream_mmap_advise(M, pos);
+	}
+
+	/* successfully got new frame, so increment it */
+	++ms->framenum;
+	ms->readposition = 0;
+
+	return ms->framebytes;
+}
+
+static int mark5_stream_mmap_seek(struct mark5_stream *ms, long long framenum)
+{
+	struct mark5_stream_mmap *M;
+	long long pos;
+
+	M = (struct mark5_stream_mmap *)(ms->inputdata);
+
+	pos = M->offset + ms->frameoffset + framenum*ms->framebytes;
+	if(framenum < 0 || pos + ms->framebytes > M->filesize)
+	{
+		ms->readposition = -1;
+
+		return -1;
+	}
+
+	if(pos < M->mapstart || pos + ms->framebytes > M->mapstart + M->maplength)
+	{
+		if(mark5_stream_mmap_map(M, pos) < 0)
+		{
+			ms->readposition = -1;
+
+			return -1;
+		}
+		ms->datawindow = M->map;
+		ms->datawindowsize = M->maplength;
+	}
+	else
+	{
+		/* readahead starts over from the new position */
+		M->advised = pos;
+		mark5_stream_mmap_advise(M, pos);
+	}
+	ms->frame = M->map + (pos - M->mapstart);
+
+	return 0;
+}
+
+static int mark5_stream_mmap_final(struct mark5_stream *ms)
+{
+	struct mark5_stream_mmap *M;
+
+	M = (struct mark5_stream_mmap *)(ms->inputdata);
+
+	if(M->map)
+	{
+		munmap((void *)(M->map), M->maplength);
+	}
+	if(M->in >= 0)
+	{
+		close(M->in);
+	}
+
+	free(M);
+
+	return 0;
+}
+
+struct mark5_stream_generic *new_mark5_stream_mmap(const char *filename, long long offset)
+{
+	struct mark5_stream_generic *V;
+	struct mark5_stream_mmap *M;
+	struct stat fileStatus;
+	int in;
+
+	in = open(filename, O_RDONLY);
+	if(in < 0)
+	{
+		fprintf(m5stderr, "File cannot be opened : <%s> : in = %d\n", filename, in);
+		perror(0);
+
+		return 0;
+	}
+	if(fstat(in, &fileStatus) < 0)
+	{
+		fprintf(m5stderr, "Error looking at file : <%s>\n", filename);
+		perror(0);
+		close(in);
+
+		return 0;
+	}
+	if(!S_ISREG(fileStatus.st_mode))
+	{
+		fprintf(m5stderr, "new_mark5_stream_mmap: <%s> is not a regular file; use new_mark5_stream_file()\n", filename);
+		close(in);
+
+		return 0;
+	}
+	if(offset < 0 || offset >= fileStatus.st_size)
+	{
+		fprintf(m5stderr, "new_mark5_stream_mmap: offset %lld is beyond the end of <%s>\n", offset, filename);
+		close(in);
+
+		return 0;
+	}
+
+	V = (struct mark5_stream_generic *)calloc(1, sizeof(struct mark5_stream_generic));
+	M = (struct mark5_stream_mmap *)calloc(1, sizeof(struct mark5_stream_mmap));
+
+	snprintf(M->filename, MARK5_STREAM_ID_LENGTH, "%s", filename);
+	M->in = in;
+	M->offset = offset;
+	M->filesize = fileStatus.st_size;
+	M->windowsize = sizeof(void *) >= 8 ? M->filesize : MARK5_STREAM_MMAP_WINDOW;
+
+	V->init_stream = mark5_stream_mmap_init;
+	V->next = mark5_stream_mmap_next;
+	V->seek = mark5_stream_mmap_seek;
+	V->final_stream = mark5_stream_mmap_final;
+	V->inputdata = M;
+	V->inputdatasize = sizeof(struct mark5_stream_mmap);
+
+	return V;
+}
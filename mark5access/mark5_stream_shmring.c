@@ -0,0 +1,444 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mark5access/mark5_stream.h"
+
+/* Frames in a POSIX shared memory ring written by one producer and read by
+ * any number of streams, each at its own pace.  Frame n goes into slot
+ * n % nslot.  Before writing a slot the producer zeroes its sequence counter;
+ * once the frame is complete the counter becomes n+1 and then writeseq n+1.
+ * Readers map the segment read-only and decode frames in place.  A reader
+ * that falls so far behind that the producer is about to reuse the slot it
+ * wants skips ahead to half a ring behind the producer; the frames skipped
+ * are given as a zeroed frame, which fails validation and so is blanked.
+ * No new frame for MARK5_STREAM_SHMRING_TIMEOUT ms, or a closed ring with
+ * no more frames, ends the stream.
+ */
+
+#define MARK5_STREAM_SHMRING_TIMEOUT	10000	/* ms */
+#define MARK5_STREAM_SHMRING_POLL	100	/* us between looks at an idle ring */
+#define MARK5_STREAM_SHMRING_NINIT	4	/* contiguous frames given to format init */
+#define MARK5_STREAM_SHMRING_MINSLOT	8
+
+struct mark5_stream_shmring
+{
+	char name[MARK5_STREAM_ID_LENGTH];
+	struct mark5_shmring_header *ring;
+	long long mapsize;
+	const long long *seq;		/* [nslot] */
+	const unsigned char *slots;	/* [nslot*framebytes] */
+	int framebytes;
+	int nslot;
+	int guard;			/* slots kept free between the producer and the frame read */
+	long long cur;			/* frame at ms->frame */
+	long long resume;		/* frames before this are blank */
+	unsigned char *blank;		/* [framebytes], zeroed */
+
+	struct mark5_stream_shmring_stats stats;
+};
+
+static long long *mark5_shmring_seq(struct mark5_shmring_header *ring)
+{
+	return (long long *)(ring + 1);
+}
+
+static long long mark5_shmring_mapsize(const struct mark5_shmring_header *ring)
+{
+	return ring->dataoffset + (long long)(ring->nslot)*ring->framebytes;
+}
+
+struct mark5_shmring_header *new_mark5_shmring(const char *name, int framebytes, int nslot)
+{
+	struct mark5_shmring_header *ring;
+	long long dataoffset, size;
+	int fd;
+
+	if(framebytes <= 0 || framebytes % 8 != 0 || nslot < MARK5_STREAM_SHMRING_MINSLOT)
+	{
+		fprintf(m5stderr, "new_mark5_shmring: need frame bytes a positive multiple of 8 and at least %d slots\n", MARK5_STREAM_SHMRING_MINSLOT);
+
+		return 0;
+	}
+
+	/* the frames start on a page boundary after the header and slot counters */
+	dataoffset = sizeof(struct mark5_shmring_header) + (long long)nslot*sizeof(long long);
+	dataoffset = (dataoffset + 4095) & ~4095LL;
+	size = dataoffset + (long long)nslot*framebytes;
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+	{
+		fprintf(m5stderr, "new_mark5_shmring: cannot create %s\n", name);
+		perror(0);
+
+		return 0;
+	}
+	if(ftruncate(fd, size) < 0)
+	{
+		fprintf(m5stderr, "new_mark5_shmring: cannot make %s %lld bytes long\n", name, size);
+		perror(0);
+		close(fd);
+
+		return 0;
+	}
+	ring = (struct mark5_shmring_header *)mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(ring == MAP_FAILED)
+	{
+		perror("new_mark5_shmring: mmap");
+
+		return 0;
+	}
+
+	/* a fresh segment is all zeros: no frames, every slot counter 0 */
+	ring->version = MARK5_SHMRING_VERSION;
+	ring->framebytes = framebytes;
+	ring->nslot = nslot;
+	ring->dataoffset = dataoffset;
+	__atomic_store_n(&ring->magic, MARK5_SHMRING_MAGIC, __ATOMIC_RELEASE);
+
+	return ring;
+}
+
+unsigned char *mark5_shmring_claim(struct mark5_shmring_header *ring)
+{
+	long long n;
+	int slot;
+
+	n = ring->writeseq;
+	slot = n % ring->nslot;
+
+	/* readers see the slot is being rewritten before any of it changes */
+	__atomic_store_n(mark5_shmring_seq(ring) + slot, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	return (unsigned char *)ring + ring->dataoffset + (long long)slot*ring->framebytes;
+}
+
+void mark5_shmring_publish(struct mark5_shmring_header *ring)
+{
+	long long n;
+
+	n = ring->writeseq;
+	__atomic_store_n(mark5_shmring_seq(ring) + n % ring->nslot, n + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&ring->writeseq, n + 1, __ATOMIC_RELEASE);
+}
+
+void delete_mark5_shmring(struct mark5_shmring_header *ring)
+{
+	if(ring)
+	{
+		__atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+		munmap(ring, mark5_shmring_mapsize(ring));
+	}
+}
+
+/* returns writeseq once frame n is published, or -1 at the end */
+static long long mark5_stream_shmring_wait(const struct mark5_stream_shmring *U, long long n)
+{
+	struct timespec poll;
+	long long w;
+	int waited = 0;
+
+	poll.tv_sec = 0;
+	poll.tv_nsec = MARK5_STREAM_SHMRING_POLL*1000;
+
+	for(;;)
+	{
+		w = __atomic_load_n(&U->ring->writeseq, __ATOMIC_ACQUIRE);
+		if(w > n)
+		{
+			return w;
+		}
+		if(__atomic_load_n(&U->ring->closed, __ATOMIC_ACQUIRE))
+		{
+			/* frames published just before closing still count */
+			w = __atomic_load_n(&U->ring->writeseq, __ATOMIC_ACQUIRE);
+
+			return w > n ? w : -1;
+		}
+		if(waited >= MARK5_STREAM_SHMRING_TIMEOUT*1000)
+		{
+			return -1;
+		}
+		nanosleep(&poll, 0);
+		waited += MARK5_STREAM_SHMRING_POLL;
+	}
+}
+
+/* is frame n in its slot, with room to decode it before the producer comes back? */
+static int mark5_stream_shmring_safe(const struct mark5_stream_shmring *U, long long n, long long w)
+{
+	if(w - n > U->nslot - U->guard)
+	{
+		return 0;
+	}
+
+	return __atomic_load_n(U->seq + n % U->nslot, __ATOMIC_ACQUIRE) == n + 1;
+}
+
+static int mark5_stream_shmring_init(struct mark5_stream *ms)
+{
+	struct mark5_stream_shmring *U;
+	struct mark5_shmring_header header;
+	long long n, w;
+	int fd, slot, ninit;
+
+	U = (struct mark5_stream_shmring *)(ms->inputdata);
+
+	snprintf(ms->streamname, MARK5_STREAM_ID_LENGTH, "SHM=%.*s", MARK5_STREAM_ID_LENGTH-5, U->name);
+
+	fd = shm_open(U->name, O_RDONLY, 0);
+	if(fd < 0)
+	{
+		fprintf(m5stderr, "mark5_stream_shmring_init: cannot open %s\n", U->name);
+		perror(0);
+
+		return -1;
+	}
+	if(read(fd, &header, sizeof(header)) != sizeof(header) ||
+	   header.magic != MARK5_SHMRING_MAGIC || header.version != MARK5_SHMRING_VERSION ||
+	   header.nslot < MARK5_STREAM_SHMRING_MINSLOT || header.framebytes <= 0)
+	{
+		fprintf(m5stderr, "mark5_stream_shmring_init: %s is not a mark5access frame ring\n", U->name);
+		close(fd);
+
+		return -1;
+	}
+	U->mapsize = mark5_shmring_mapsize(&header);
+	U->ring = (struct mark5_shmring_header *)mmap(0, U->mapsize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(U->ring == MAP_FAILED)
+	{
+		U->ring = 0;
+		perror("mark5_stream_shmring_init: mmap");
+
+		return -1;
+	}
+	U->framebytes = header.framebytes;
+	U->nslot = header.nslot;
+	U->guard = U->nslot/8;
+	U->seq = mark5_shmring_seq(U->ring);
+	U->slots = (const unsigned char *)(U->ring) + header.dataoffset;
+	U->blank = (unsigned char *)calloc(1, U->framebytes);
+
+	/* start at the newest frame of a live ring, or the oldest of a finished one */
+	w = mark5_stream_shmring_wait(U, 0);
+	if(w < 0)
+	{
+		fprintf(m5stderr, "mark5_stream_shmring_init: no frames in %s\n", U->name);
+
+		return -1;
+	}
+	if(__atomic_load_n(&U->ring->closed, __ATOMIC_ACQUIRE))
+	{
+		n = w - U->nslot + U->guard;
+		if(n < 0)
+		{
+			n = 0;
+		}
+	}
+	else
+	{
+		n = w - 1;
+	}
+
+	/* format init needs a few frames contiguous in memory */
+	ninit = MARK5_STREAM_SHMRING_NINIT;
+	slot = n % U->nslot;
+	if(slot + ninit > U->nslot)
+	{
+		n += U->nslot - slot;
+	}
+	for(;;)
+	{
+		w = mark5_stream_shmring_wait(U, n + ninit - 1);
+		if(w < 0)
+		{
+			/* a finished ring with fewer frames: make do */
+			w = __atomic_load_n(&U->ring->writeseq, __ATOMIC_ACQUIRE);
+			ninit = w - n;
+			if(ninit <= 0 || n % U->nslot + ninit > U->nslot)
+			{
+				fprintf(m5stderr, "mark5_stream_shmring_init: too few frames in %s\n", U->name);
+
+				return -1;
+			}
+		}
+		if(mark5_stream_shmring_safe(U, n, w))
+		{
+			break;
+		}
+		/* overtaken while waiting: start again half a ring behind */
+		n = w - U->nslot/2;
+		slot = n % U->nslot;
+		if(slot + ninit > U->nslot)
+		{
+			n += U->nslot - slot;
+		}
+	}
+	U->cur = U->resume = n;
+	++U->stats.nframe;
+
+	ms->datawindow = (unsigned char *)(U->slots + (long long)(n % U->nslot)*U->framebytes);
+	ms->datawindowsize = (long long)ninit*U->framebytes;
+
+	return 0;
+}
+
+static int mark5_stream_shmring_next(struct mark5_stream *ms)
+{
+	struct mark5_stream_shmring *U;
+	long long n, w;
+
+	U = (struct mark5_stream_shmring *)(ms->inputdata);
+
+	/* was the frame just decoded rewritten meanwhile? */
+	if(U->cur >= U->resume)
+	{
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(U->seq + U->cur % U->nslot, __ATOMIC_RELAXED) != U->cur + 1)
+		{
+			++U->stats.ntorn;
+		}
+	}
+
+	n = U->cur + 1;
+	if(n < U->resume)
+	{
+		ms->frame = U->blank;
+	}
+	else
+	{
+		w = mark5_stream_shmring_wait(U, n);
+		if(w < 0)
+		{
+			ms->readposition = -1;
+
+			return -1;
+		}
+		if(mark5_stream_shmring_safe(U, n, w))
+		{
+			ms->frame = (unsigned char *)(U->slots + (long long)(n % U->nslot)*U->framebytes);
+			++U->stats.nframe;
+		}
+		else
+		{
+			U->resume = w - U->nslot/2;
+			if(U->resume <= n)
+			{
+				U->resume = n + 1;
+			}
+			U->stats.noverrun += U->resume - n;
+			ms->frame = U->blank;
+		}
+	}
+	U->cur = n;
+
+	/* successfully got new frame, so increment it */
+	++ms->framenum;
+	ms->readposition = 0;
+
+	return ms->framebytes;
+}
+
+static int mark5_stream_shmring_final(struct mark5_stream *ms)
+{
+	struct mark5_stream_shmring *U;
+
+	U = (struct mark5_stream_shmring *)(ms->inputdata);
+
+	if(U->ring)
+	{
+		munmap(U->ring, U->mapsize);
+	}
+	if(U->blank)
+	{
+		free(U->blank);
+	}
+
+	free(U);
+
+	return 0;
+}
+
+struct mark5_stream_generic *new_mark5_stream_shmring(const char *name)
+{
+	struct mark5_stream_generic *V;
+	struct mark5_stream_shmring *U;
+
+	if(!name || strlen(name) >= MARK5_STREAM_ID_LENGTH)
+	{
+		fprintf(m5stderr, "new_mark5_stream_shmring: bad ring name\n");
+
+		return 0;
+	}
+
+	V = (struct mark5_stream_generic *)calloc(1, sizeof(struct mark5_stream_generic));
+	U = (struct mark5_stream_shmring *)calloc(1, sizeof(struct mark5_stream_shmring));
+
+	strcpy(U->name, name);
+
+	V->init_stream = mark5_stream_shmring_init;
+	V->next = mark5_stream_shmring_next;
+	V->final_stream = mark5_stream_shmring_final;
+	V->inputdata = U;
+	V->inputdatasize = sizeof(struct mark5_stream_shmring);
+
+	return V;
+}
+
+int mark5_stream_shmring_get_stats(const struct mark5_stream *ms, struct mark5_stream_shmring_stats *stats)
+{
+	const struct mark5_stream_shmring *U;
+
+	if(!ms || ms->init_stream != mark5_stream_shmring_init)
+	{
+		fprintf(m5stderr, "mark5_stream_shmring_get_stats: " "Wrong stream type!\n");
+
+		return -1;
+	}
+
+	U = (const struct mark5_stream_shmring *)(ms->inputdata);
+	*stats = U->stats;
+
+	return 0;
+}
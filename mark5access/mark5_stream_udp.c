@@ -0,0 +1,529 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+
+#define _GNU_SOURCE
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mark5access/mark5_stream.h"
+
+/* Single-thread VDIF received from a UDP port, one frame per packet, after
+ * an optional packet serial number (PSN) prefix.  Packets are received many
+ * at a time and placed by time into a batch of consecutive frames, or into
+ * the next batch, so they may arrive up to a batch length out of order.
+ * Frames never received are given headers with the invalid bit set, so they
+ * are blanked.  No packet for MARK5_STREAM_UDP_TIMEOUT ms ends the stream.
+ */
+
+#define MARK5_STREAM_UDP_NMSG		64		/* packets per receive call */
+#define MARK5_STREAM_UDP_MAXPACKET	65536
+#define MARK5_STREAM_UDP_BATCH		(1<<20)		/* bytes of frames per batch */
+#define MARK5_STREAM_UDP_RCVBUF		(64<<20)	/* socket receive buffer asked for */
+#define MARK5_STREAM_UDP_MAXSTRAY	64		/* packets in a row out of reach of the batches that make the stream follow them */
+#define MARK5_STREAM_UDP_TIMEOUT	10000
+
+struct mark5_stream_udp
+{
+	int port;
+	int sock;
+	int psnbytes;
+	int framespersecond;
+	int framebytes;			/* from the first packet */
+	int nwindow;			/* frames per batch */
+	unsigned int header[8];		/* of the first packet, for frames not received */
+
+	unsigned char *packets;		/* [MARK5_STREAM_UDP_NMSG*MARK5_STREAM_UDP_MAXPACKET] */
+	int length[MARK5_STREAM_UDP_NMSG];
+	int npacket;			/* received by the last call */
+	int ipacket;			/* next one to place */
+	int eof;
+
+	unsigned char *batch[2];	/* [nwindow*framebytes] */
+	unsigned char *present[2];	/* [nwindow] */
+	int npresent[2];
+	int lastpresent[2];		/* highest frame of the batch received, or -1 */
+	int cur;			/* batch being decoded; the other is the next one */
+	long long base;			/* time of first frame of batch[cur], as sec*framespersecond + frame */
+	long long latest;		/* time of the latest packet so far */
+	int nstrayrun;			/* packets in a row out of reach of the batches */
+
+	struct mark5_stream_udp_stats stats;
+};
+
+static long long mark5_stream_udp_time(const struct mark5_stream_udp *U, const unsigned char *frame)
+{
+	const unsigned int *header = (const unsigned int *)frame;
+
+	return (long long)(header[0] & 0x3FFFFFFF)*U->framespersecond + (header[1] & 0x00FFFFFF);
+}
+
+/* returns the next frame received, its PSN stripped, or 0 once none comes in time */
+static const unsigned char *mark5_stream_udp_receive(struct mark5_stream_udp *U, int *length)
+{
+	const unsigned char *packet;
+
+	while(U->ipacket >= U->npacket)
+	{
+		int n;
+
+		if(U->eof)
+		{
+			return 0;
+		}
+#ifdef HAVE_RECVMMSG
+		{
+			struct mmsghdr msgs[MARK5_STREAM_UDP_NMSG];
+			struct iovec iovecs[MARK5_STREAM_UDP_NMSG];
+			int i;
+
+			memset(msgs, 0, sizeof(msgs));
+			for(i = 0; i < MARK5_STREAM_UDP_NMSG; ++i)
+			{
+				iovecs[i].iov_base = U->packets + (long long)i*MARK5_STREAM_UDP_MAXPACKET;
+				iovecs[i].iov_len = MARK5_STREAM_UDP_MAXPACKET;
+				msgs[i].msg_hdr.msg_iov = iovecs + i;
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+			/* blocks (up to the timeout) for the first packet only */
+			n = recvmmsg(U->sock, msgs, MARK5_STREAM_UDP_NMSG, MSG_WAITFORONE, 0);
+			for(i = 0; i < n; ++i)
+			{
+				U->length[i] = msgs[i].msg_len;
+			}
+		}
+#else
+		n = recv(U->sock, U->packets, MARK5_STREAM_UDP_MAXPACKET, 0);
+		if(n >= 0)
+		{
+			U->length[0] = n;
+			n = 1;
+		}
+#endif
+		if(n < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				perror("mark5_stream_udp");
+			}
+			U->eof = 1;
+
+			return 0;
+		}
+		U->npacket = n;
+		U->ipacket = 0;
+	}
+
+	packet = U->packets + (long long)(U->ipacket)*MARK5_STREAM_UDP_MAXPACKET;
+	*length = U->length[U->ipacket] - U->psnbytes;
+	++U->ipacket;
+
+	return packet + U->psnbytes;
+}
+
+/* is this a VDIF frame of the stream's size? */
+static int mark5_stream_udp_check(const struct mark5_stream_udp *U, const unsigned char *frame, int length)
+{
+	const unsigned int *header = (const unsigned int *)frame;
+
+	if(length < 32 || ((header[2] & 0x00FFFFFF) << 3) != (unsigned int)length)
+	{
+		return 0;
+	}
+
+	return U->framebytes == 0 || length == U->framebytes;
+}
+
+static void mark5_stream_udp_clear(struct mark5_stream_udp *U, int b)
+{
+	memset(U->present[b], 0, U->nwindow);
+	U->npresent[b] = 0;
+	U->lastpresent[b] = -1;
+}
+
+/* gives the frames of batch b that were not received headers marked invalid */
+static void mark5_stream_udp_headers(struct mark5_stream_udp *U, int b, long long base, int nframe)
+{
+	int k;
+
+	for(k = 0; k < nframe; ++k)
+	{
+		unsigned int *header;
+		long long t;
+
+		if(U->present[b][k])
+		{
+			continue;
+		}
+		header = (unsigned int *)(U->batch[b] + (long long)k*U->framebytes);
+		t = base + k;
+		memcpy(header, U->header, sizeof(U->header) < (size_t)U->framebytes ? sizeof(U->header) : (size_t)U->framebytes);
+		header[0] = (U->header[0] & 0x40000000) | 0x80000000 | ((unsigned int)(t / U->framespersecond) & 0x3FFFFFFF);
+		header[1] = (U->header[1] & 0xFF000000) | (unsigned int)(t % U->framespersecond);
+		++U->stats.nlost;
+	}
+}
+
+/* Places packets until the current batch is complete: every frame is in, or
+ * a packet beyond the next batch arrives or none arrives in time.  Returns
+ * the number of frames of the current batch to decode.
+ */
+static int mark5_stream_udp_fill(struct mark5_stream_udp *U)
+{
+	const unsigned char *frame;
+	int cur = U->cur, next = 1 - U->cur;
+	int length, b, k, nframe;
+	long long t;
+
+	while(U->npresent[cur] < U->nwindow)
+	{
+		frame = mark5_stream_udp_receive(U, &length);
+		if(!frame)
+		{
+			break;
+		}
+		if(!mark5_stream_udp_check(U, frame, length))
+		{
+			++U->stats.nbad;
+			continue;
+		}
+		++U->stats.npacket;
+
+		t = mark5_stream_udp_time(U, frame);
+		if(t < U->base || t >= U->base + 3*U->nwindow)
+		{
+			/* a stray packet, unless a run of them says the packets have
+			 * moved: the sender restarted, its clock stepped, or there was
+			 * a long break in the data */
+			if(++U->nstrayrun < MARK5_STREAM_UDP_MAXSTRAY)
+			{
+				if(t < U->base)
+				{
+					++U->stats.nlate;
+				}
+				else
+				{
+					++U->stats.nstray;
+				}
+				continue;
+			}
+			if(t < U->base)
+			{
+				/* back in time: drop the batches and resume at the packet */
+				mark5_stream_udp_clear(U, cur);
+				mark5_stream_udp_clear(U, next);
+				U->base = U->latest = t;
+				++U->stats.nresync;
+			}
+		}
+		if(t < U->latest)
+		{
+			++U->stats.nreorder;
+		}
+		else
+		{
+			U->latest = t;
+		}
+		if(t >= U->base + 2*U->nwindow)
+		{
+			if(U->npresent[cur] > 0 || U->npresent[next] > 0)
+			{
+				/* keep it for a later batch */
+				--U->ipacket;
+				--U->stats.npacket;
+				break;
+			}
+			/* a break in the data: resume at the packet */
+			U->base = t;
+		}
+		U->nstrayrun = 0;
+
+		if(t < U->base + U->nwindow)
+		{
+			b = cur;
+			k = t - U->base;
+		}
+		else
+		{
+			b = next;
+			k = t - U->base - U->nwindow;
+		}
+		if(U->present[b][k])
+		{
+			++U->stats.nduplicate;
+			continue;
+		}
+		memcpy(U->batch[b] + (long long)k*U->framebytes, frame, U->framebytes);
+		U->present[b][k] = 1;
+		++U->npresent[b];
+		if(k > U->lastpresent[b])
+		{
+			U->lastpresent[b] = k;
+		}
+	}
+
+	if(U->eof && U->npresent[next] == 0)
+	{
+		/* the end: no frames after the last packet */
+		nframe = U->lastpresent[cur] + 1;
+	}
+	else
+	{
+		nframe = U->nwindow;
+	}
+	mark5_stream_udp_headers(U, cur, U->base, nframe);
+
+	return nframe;
+}
+
+static int mark5_stream_udp_init(struct mark5_stream *ms)
+{
+	struct mark5_stream_udp *U;
+	const unsigned char *frame;
+	int length, b;
+
+	U = (struct mark5_stream_udp *)(ms->inputdata);
+
+	snprintf(ms->streamname, MARK5_STREAM_ID_LENGTH, "UDP=%d", U->port);
+
+	U->packets = (unsigned char *)malloc((long long)MARK5_STREAM_UDP_NMSG*MARK5_STREAM_UDP_MAXPACKET);
+	if(!U->packets)
+	{
+		return -1;
+	}
+
+	/* the first VDIF packet sets the frame size */
+	for(;;)
+	{
+		frame = mark5_stream_udp_receive(U, &length);
+		if(!frame)
+		{
+			fprintf(m5stderr, "mark5_stream_udp_init: no VDIF packets received on port %d\n", U->port);
+
+			return -1;
+		}
+		if(mark5_stream_udp_check(U, frame, length))
+		{
+			break;
+		}
+		++U->stats.nbad;
+	}
+	U->framebytes = length;
+	memcpy(U->header, frame, sizeof(U->header));
+	U->base = U->latest = mark5_stream_udp_time(U, frame);
+	--U->ipacket;	/* placed by mark5_stream_udp_fill() */
+
+	U->nwindow = MARK5_STREAM_UDP_BATCH/U->framebytes;
+	if(U->nwindow < 4)
+	{
+		U->nwindow = 4;
+	}
+	for(b = 0; b < 2; ++b)
+	{
+		U->batch[b] = (unsigned char *)malloc((long long)(U->nwindow)*U->framebytes);
+		U->present[b] = (unsigned char *)malloc(U->nwindow);
+		if(!U->batch[b] || !U->present[b])
+		{
+			fprintf(m5stderr, "mark5_stream_udp_init: cannot allocate %d frames of %d bytes\n", U->nwindow, U->framebytes);
+
+			return -1;
+		}
+		mark5_stream_udp_clear(U, b);
+	}
+	U->cur = 0;
+
+	ms->datawindow = U->batch[U->cur];
+	ms->datawindowsize = (long long)mark5_stream_udp_fill(U)*U->framebytes;
+
+	return 0;
+}
+
+static int mark5_stream_udp_next(struct mark5_stream *ms)
+{
+	struct mark5_stream_udp *U;
+
+	U = (struct mark5_stream_udp *)(ms->inputdata);
+
+	ms->frame += ms->framebytes;
+
+	if(ms->frame + ms->framebytes > ms->datawindow + ms->datawindowsize)
+	{
+		int n;
+
+		if(ms->datawindowsize < (long long)(U->nwindow)*U->framebytes)
+		{
+			ms->readposition = -1;
+
+			return -1;
+		}
+
+		/* the batch just decoded is reused for the one after the next */
+		mark5_stream_udp_clear(U, U->cur);
+		U->cur = 1 - U->cur;
+		U->base += U->nwindow;
+
+		n = mark5_stream_udp_fill(U);
+		if(n <= 0)
+		{
+			ms->readposition = -1;
+
+			return -1;
+		}
+		ms->datawindow = U->batch[U->cur];
+		ms->datawindowsize = (long long)n*U->framebytes;
+		ms->frame = ms->datawindow;
+	}
+
+	/* successfully got new frame, so increment it */
+	++ms->framenum;
+	ms->readposition = 0;
+
+	return ms->framebytes;
+}
+
+static int mark5_stream_udp_final(struct mark5_stream *ms)
+{
+	struct mark5_stream_udp *U;
+	int b;
+
+	U = (struct mark5_stream_udp *)(ms->inputdata);
+
+	for(b = 0; b < 2; ++b)
+	{
+		if(U->batch[b])
+		{
+			free(U->batch[b]);
+		}
+		if(U->present[b])
+		{
+			free(U->present[b]);
+		}
+	}
+	if(U->packets)
+	{
+		free(U->packets);
+	}
+	if(U->sock >= 0)
+	{
+		close(U->sock);
+	}
+
+	free(U);
+
+	return 0;
+}
+
+struct mark5_stream_generic *new_mark5_stream_udp(int port, int framespersecond, int psnbytes)
+{
+	struct mark5_stream_generic *V;
+	struct mark5_stream_udp *U;
+	struct sockaddr_in addr;
+	struct timeval tv;
+	int sock, size;
+
+	if(framespersecond <= 0 || psnbytes < 0)
+	{
+		fprintf(m5stderr, "new_mark5_stream_udp: need frames per second > 0 and PSN bytes >= 0\n");
+
+		return 0;
+	}
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if(sock < 0)
+	{
+		perror("new_mark5_stream_udp: socket");
+
+		return 0;
+	}
+
+	/* ask for a large buffer, as packets arrive while a batch is decoded; the kernel may give less */
+	size = MARK5_STREAM_UDP_RCVBUF;
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	tv.tv_sec = MARK5_STREAM_UDP_TIMEOUT/1000;
+	tv.tv_usec = (MARK5_STREAM_UDP_TIMEOUT%1000)*1000;
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		fprintf(m5stderr, "new_mark5_stream_udp: cannot bind port %d\n", port);
+		perror(0);
+		close(sock);
+
+		return 0;
+	}
+
+	V = (struct mark5_stream_generic *)calloc(1, sizeof(struct mark5_stream_generic));
+	U = (struct mark5_stream_udp *)calloc(1, sizeof(struct mark5_stream_udp));
+
+	U->port = port;
+	U->sock = sock;
+	U->framespersecond = framespersecond;
+	U->psnbytes = psnbytes;
+
+	V->init_stream = mark5_stream_udp_init;
+	V->next = mark5_stream_udp_next;
+	V->final_stream = mark5_stream_udp_final;
+	V->inputdata = U;
+	V->inputdatasize = sizeof(struct mark5_stream_udp);
+
+	return V;
+}
+
+int mark5_stream_udp_get_stats(const struct mark5_stream *ms, struct mark5_stream_udp_stats *stats)
+{
+	const struct mark5_stream_udp *U;
+
+	if(!ms || ms->init_stream != mark5_stream_udp_init)
+	{
+		fprintf(m5stderr, "mark5_stream_udp_get_stats: " "Wrong stream type!\n");
+
+		return -1;
+	}
+
+	U = (const struct mark5_stream_udp *)(ms->inputdata);
+	*stats = U->stats;
+
+	return 0;
+}
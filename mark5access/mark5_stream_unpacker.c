@@ -108,7 +108,8 @@ struct mark5_stream_generic *new_mark5_stream_unpacker(int noheaders)
 	return V;
 }
 
-int mark5_unpack(struct mark5_stream *ms, const void *packed, float **unpacked, int nsamp)
+/* point the stream at the start of new packed data */
+static void mark5_unpack_start(struct mark5_stream *ms, const void *packed)
 {
 	if(ms->next == mark5_stream_unpacker_next_noheaders)
 	{
@@ -122,6 +123,11 @@ int mark5_unpack(struct mark5_stream *ms, const void *packed, float **unpacked,
 		mark5_stream_next_frame(ms); //this also sets ms->payload()
 	}
 	ms->readposition = 0;
+}
+
+int mark5_unpack(struct mark5_stream *ms, const void *packed, float **unpacked, int nsamp)
+{
+	mark5_unpack_start(ms, packed);
 
 	return ms->decode(ms, nsamp, unpacked);
 }
@@ -151,19 +157,7 @@ int mark5_unpack_with_offset(struct mark5_stream *ms, const void *packed, int of
 
 int mark5_unpack_complex(struct mark5_stream *ms, const void *packed, mark5_float_complex **unpacked, int nsamp)
 {
-	if(ms->next == mark5_stream_unpacker_next_noheaders)
-	{
-		ms->payload = (const unsigned char *)packed;
-		ms->blanker(ms);
-	}
-	else
-	{
-		//go back to previous frame so we can make use of next() and its validation
-		ms->frame = (const unsigned char *)packed - ms->framebytes;
-		mark5_stream_next_frame(ms); //this also sets ms->payload()
-	}
-
-	ms->readposition = 0;
+	mark5_unpack_start(ms, packed);
 
 	return ms->complex_decode(ms, nsamp, unpacked);
 }
@@ -191,3 +185,32 @@ int mark5_unpack_complex_with_offset(struct mark5_stream *ms, const void *packed
 	return ms->complex_decode(ms, nsamp, unpacked);
 }
 
+/* Integer versions; see mark5_stream_decode_int8() for the values produced */
+
+int mark5_unpack_int8(struct mark5_stream *ms, const void *packed, int8_t **unpacked, int nsamp)
+{
+	mark5_unpack_start(ms, packed);
+
+	return mark5_stream_decode_int8(ms, nsamp, unpacked);
+}
+
+int mark5_unpack_int16(struct mark5_stream *ms, const void *packed, int16_t **unpacked, int nsamp)
+{
+	mark5_unpack_start(ms, packed);
+
+	return mark5_stream_decode_int16(ms, nsamp, unpacked);
+}
+
+int mark5_unpack_int8_complex(struct mark5_stream *ms, const void *packed, mark5_int8_complex **unpacked, int nsamp)
+{
+	mark5_unpack_start(ms, packed);
+
+	return mark5_stream_decode_int8_complex(ms, nsamp, unpacked);
+}
+
+int mark5_unpack_int16_complex(struct mark5_stream *ms, const void *packed, mark5_int16_complex **unpacked, int nsamp)
+{
+	mark5_unpack_start(ms, packed);
+
+	return mark5_stream_decode_int16_complex(ms, nsamp, unpacked);
+}
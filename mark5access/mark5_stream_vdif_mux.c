@@ -0,0 +1,725 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mark5access/mark5_stream.h"
+
+/* In multi-thread VDIF each thread carries some of the channels in packets
+ * of its own, interleaved in the file in roughly, but not exactly, time
+ * order.  This stream collects the packets of all threads for a batch of
+ * consecutive frame times and corner-turns them into single-thread frames
+ * with all the channels, as the decoders expect.  Thread i of the list
+ * given supplies channels i*chansperthread and up.  The channel count is
+ * padded to a power of 2 with empty channels.
+ *
+ * Packets are placed into the batch being assembled or into the next one,
+ * so they may arrive up to a batch length late.  Output frames carry EDV4
+ * headers whose validity mask has one bit per thread (see blank_vdif_EDV4());
+ * frames with no packet of any thread are marked invalid.  The decoders
+ * apply the mask to at most MARK5_MAXMASKCHAN channels, so beyond that a
+ * frame missing any thread is marked invalid as a whole.
+ */
+
+#define MAX_VDIF_MUX_THREADS		64	/* one validity mask bit each */
+#define MARK5_STREAM_VDIF_MUX_BATCH	(4<<20)	/* bytes of output frames per batch */
+#define MARK5_STREAM_VDIF_MUX_READ	(4<<20)	/* bytes of input read at a time */
+#define MARK5_STREAM_VDIF_MUX_HEADER	32	/* bytes of output frame header */
+#define MARK5_STREAM_VDIF_MUX_MAXSTRAY	64	/* packets in a row out of reach of the batches that make the stream follow them */
+
+struct mark5_stream_vdif_mux
+{
+	char filename[MARK5_STREAM_ID_LENGTH];
+	int in;
+	int framespersecond;
+
+	/* input packets */
+	int inputframebytes;
+	int inputheaderbytes;
+	int chansperthread;
+	int nbit;
+	int iscomplex;
+	int nthread;
+	int threadid[MAX_VDIF_MUX_THREADS];
+	signed char slot[1024];		/* thread id -> position in threadid[], or -1 */
+
+	/* output frames */
+	int nslot;			/* nthread rounded up to a power of 2 */
+	int outputframebytes;
+	int nwindow;			/* frames per batch */
+	int epoch;
+	int stationid;
+
+	unsigned char *inbuf;		/* allocated by the constructor, which reads the start of the file into it */
+	long long inbufsize;
+	long long inlength;		/* bytes in inbuf */
+	long long inpos;		/* of the next packet in inbuf */
+	int eof;
+
+	unsigned char *batch[2];	/* [nwindow*outputframebytes] */
+	unsigned long long *present[2];	/* [nwindow] bit per slot of packets placed */
+	int npresent[2];
+	int lastpresent[2];		/* highest frame of the batch with a packet, or -1 */
+	int cur;			/* batch being decoded; the other is the next one */
+	long long base;			/* time of first frame of batch[cur], as sec*framespersecond + frame */
+	int nstrayrun;			/* packets in a row out of reach of the batches */
+	long long nlate, nstray, nduplicate, nresync, nrestart;
+};
+
+static long long mark5_stream_vdif_mux_time(const struct mark5_stream_vdif_mux *M, const unsigned char *packet)
+{
+	const unsigned int *header = (const unsigned int *)packet;
+
+	return (long long)(header[0] & 0x3FFFFFFF)*M->framespersecond + (header[1] & 0x00FFFFFF);
+}
+
+/* reads more of the file once fewer than a packet's worth of bytes are left */
+static void mark5_stream_vdif_mux_refill(struct mark5_stream_vdif_mux *M)
+{
+	long long n;
+	ssize_t r;
+
+	if(M->eof || M->inlength - M->inpos >= M->inputframebytes)
+	{
+		return;
+	}
+
+	n = M->inlength - M->inpos;
+	memmove(M->inbuf, M->inbuf + M->inpos, n);
+	M->inpos = 0;
+	while(n < M->inbufsize)
+	{
+		r = read(M->in, M->inbuf + n, M->inbufsize - n);
+		if(r <= 0)
+		{
+			M->eof = 1;
+			break;
+		}
+		n += r;
+	}
+	M->inlength = n;
+}
+
+/* returns the next packet with a header of the right size, without consuming it; 0 at end of file */
+static const unsigned char *mark5_stream_vdif_mux_packet(struct mark5_stream_vdif_mux *M)
+{
+	for(;;)
+	{
+		const unsigned int *header;
+
+		mark5_stream_vdif_mux_refill(M);
+		if(M->inlength - M->inpos < M->inputframebytes)
+		{
+			return 0;
+		}
+		header = (const unsigned int *)(M->inbuf + M->inpos);
+		if(((header[2] & 0x00FFFFFF) << 3) == (unsigned int)M->inputframebytes)
+		{
+			return M->inbuf + M->inpos;
+		}
+
+		/* lost sync: packets are 8-byte multiples, so look 8 bytes on */
+		M->inpos += 8;
+		++M->nresync;
+	}
+}
+
+/* copies the samples of one packet into the slot's channels of an output frame, which is zeroed beforehand */
+static void mark5_stream_vdif_mux_cornerturn(const struct mark5_stream_vdif_mux *M, const unsigned char *in, unsigned char *out, int slot)
+{
+	int w;		/* bits per time sample of a packet */
+	int nsamp, s;
+
+	w = M->chansperthread*M->nbit*(M->iscomplex ? 2 : 1);
+	nsamp = (M->inputframebytes - M->inputheaderbytes)*8/w;
+
+	/* VDIF words are little endian, so the payload is a run of bits starting with bit 0 of byte 0 */
+	if(w % 8 == 0)
+	{
+		int nb = w/8;
+		int stride = nb*M->nslot;
+
+		out += slot*nb;
+		switch(nb)
+		{
+		case 1:
+			for(s = 0; s < nsamp; ++s)
+			{
+				out[s*stride] = in[s];
+			}
+			break;
+		case 2:
+			for(s = 0; s < nsamp; ++s)
+			{
+				memcpy(out + s*stride, in + 2*s, 2);
+			}
+			break;
+		case 4:
+			for(s = 0; s < nsamp; ++s)
+			{
+				memcpy(out + s*stride, in + 4*s, 4);
+			}
+			break;
+		default:
+			for(s = 0; s < nsamp; ++s)
+			{
+				memcpy(out + s*stride, in + (long long)nb*s, nb);
+			}
+			break;
+		}
+	}
+	else if(8 % w == 0 && (w*M->nslot) % 8 == 0)	/* 1, 2 or 4 bits, at the same place in every output byte */
+	{
+		unsigned int mask = (1 << w) - 1;
+		int stride = w*M->nslot/8;
+		int shift = (w*slot) % 8;
+		int nbytes = nsamp*w/8;
+		int i, j;
+
+		out += w*slot/8;
+		for(i = 0; i < nbytes; ++i)
+		{
+			unsigned int v = in[i];
+
+			for(j = 0; j < 8; j += w)
+			{
+				*out |= ((v >> j) & mask) << shift;
+				out += stride;
+			}
+		}
+	}
+	else if(8 % w == 0)	/* samples never span bytes */
+	{
+		unsigned int mask = (1 << w) - 1;
+		int step = w*M->nslot;
+		long long outbit = w*slot;
+		int inbit;
+
+		for(s = 0, inbit = 0; s < nsamp; ++s, inbit += w, outbit += step)
+		{
+			out[outbit >> 3] |= ((in[inbit >> 3] >> (inbit & 7)) & mask) << (outbit & 7);
+		}
+	}
+	else
+	{
+		long long inbit = 0, outbit;
+		int b;
+
+		for(s = 0; s < nsamp; ++s)
+		{
+			outbit = ((long long)s*M->nslot + slot)*w;
+			for(b = 0; b < w; ++b, ++inbit, ++outbit)
+			{
+				out[outbit >> 3] |= ((in[inbit >> 3] >> (inbit & 7)) & 1) << (outbit & 7);
+			}
+		}
+	}
+}
+
+static void mark5_stream_vdif_mux_clear(struct mark5_stream_vdif_mux *M, int b)
+{
+	memset(M->batch[b], 0, (size_t)(M->nwindow)*M->outputframebytes);
+	memset(M->present[b], 0, M->nwindow*sizeof(unsigned long long));
+	M->npresent[b] = 0;
+	M->lastpresent[b] = -1;
+}
+
+/* writes the headers of the frames of batch b, which starts at time base */
+static void mark5_stream_vdif_mux_headers(struct mark5_stream_vdif_mux *M, int b, long long base)
+{
+	int k, log2nchan;
+	int nchan;
+	unsigned long long allpresent;
+
+	nchan = M->nslot*M->chansperthread;
+	allpresent = M->nthread < 64 ? (1ULL << M->nthread) - 1 : ~0ULL;
+	for(log2nchan = 0; (1 << log2nchan) < nchan; ++log2nchan)
+	{
+	}
+
+	for(k = 0; k < M->nwindow; ++k)
+	{
+		unsigned int *header = (unsigned int *)(M->batch[b] + (long long)k*M->outputframebytes);
+		long long t = base + k;
+
+		header[0] = (unsigned int)(t / M->framespersecond) & 0x3FFFFFFF;
+		if(M->present[b][k] == 0 || (nchan > MARK5_MAXMASKCHAN && M->present[b][k] != allpresent))
+		{
+			header[0] |= 0x80000000;	/* invalid */
+		}
+		header[1] = (unsigned int)(t % M->framespersecond) | (M->epoch << 24);
+		header[2] = (M->outputframebytes/8) | (log2nchan << 24);
+		header[3] = M->stationid | ((M->nbit - 1) << 26) | (M->iscomplex << 31);
+		header[4] = (M->nslot << 16) | (4 << 24);	/* EDV4, nslot mask bits */
+		header[5] = 0xACABFEED;
+		memcpy(header + 6, M->present[b] + k, 8);
+	}
+}
+
+/* Places packets until the current batch is complete: every thread of every
+ * frame is in, or a packet beyond the next batch or the end of the file is
+ * reached.  Returns the number of frames of the current batch to decode.
+ */
+static int mark5_stream_vdif_mux_fill(struct mark5_stream_vdif_mux *M)
+{
+	const unsigned char *packet;
+	int cur = M->cur, next = 1 - M->cur;
+	int b, k, slot;
+	long long t;
+
+	while(M->npresent[cur] < M->nwindow*M->nthread)
+	{
+		packet = mark5_stream_vdif_mux_packet(M);
+		if(!packet)
+		{
+			break;
+		}
+		slot = M->slot[(packet[14] | (packet[15] << 8)) & 0x03FF];
+		if(slot < 0 || (packet[3] & 0x80))	/* other threads and invalid packets are left out */
+		{
+			M->inpos += M->inputframebytes;
+			continue;
+		}
+
+		t = mark5_stream_vdif_mux_time(M, packet);
+		if(t < M->base || t >= M->base + 3*M->nwindow)
+		{
+			/* a stray header, unless a run of them says the recording
+			 * stepped in time */
+			if(++M->nstrayrun < MARK5_STREAM_VDIF_MUX_MAXSTRAY)
+			{
+				if(t < M->base)
+				{
+					++M->nlate;
+				}
+				else
+				{
+					++M->nstray;
+				}
+				M->inpos += M->inputframebytes;
+				continue;
+			}
+			if(t < M->base)
+			{
+				/* back in time: drop the batches and resume at the packet */
+				mark5_stream_vdif_mux_clear(M, cur);
+				mark5_stream_vdif_mux_clear(M, next);
+				M->base = t;
+				++M->nrestart;
+			}
+		}
+		if(t >= M->base + 2*M->nwindow)
+		{
+			if(M->npresent[cur] > 0 || M->npresent[next] > 0)
+			{
+				break;	/* leave it for a later batch */
+			}
+			/* a gap in the recording: resume at the packet */
+			M->base = t;
+		}
+		M->nstrayrun = 0;
+
+		if(t < M->base + M->nwindow)
+		{
+			b = cur;
+			k = t - M->base;
+		}
+		else
+		{
+			b = next;
+			k = t - M->base - M->nwindow;
+		}
+		if(M->present[b][k] & (1ULL << slot))
+		{
+			++M->nduplicate;
+		}
+		else
+		{
+			mark5_stream_vdif_mux_cornerturn(M, packet + M->inputheaderbytes,
+				M->batch[b] + (long long)k*M->outputframebytes + MARK5_STREAM_VDIF_MUX_HEADER, slot);
+			M->present[b][k] |= 1ULL << slot;
+			++M->npresent[b];
+			if(k > M->lastpresent[b])
+			{
+				M->lastpresent[b] = k;
+			}
+		}
+		M->inpos += M->inputframebytes;
+	}
+
+	mark5_stream_vdif_mux_headers(M, cur, M->base);
+
+	if(M->eof && M->npresent[next] == 0 && M->inlength - M->inpos < M->inputframebytes)
+	{
+		/* the end: no frames after the last packet */
+		return M->lastpresent[cur] + 1;
+	}
+
+	return M->nwindow;
+}
+
+static int mark5_stream_vdif_mux_init(struct mark5_stream *ms)
+{
+	struct mark5_stream_vdif_mux *M;
+	const unsigned char *packet;
+	long long pos, t;
+	int b, n;
+
+	M = (struct mark5_stream_vdif_mux *)(ms->inputdata);
+
+	snprintf(ms->streamname, MARK5_STREAM_ID_LENGTH, "VDIFMux=%.*s", MARK5_STREAM_ID_LENGTH-9, M->filename);
+
+	for(b = 0; b < 2; ++b)
+	{
+		M->batch[b] = (unsigned char *)malloc((size_t)(M->nwindow)*M->outputframebytes);
+		M->present[b] = (unsigned long long *)malloc(M->nwindow*sizeof(unsigned long long));
+		if(!M->batch[b] || !M->present[b])
+		{
+			fprintf(m5stderr, "mark5_stream_vdif_mux_init: cannot allocate %d frames of %d bytes\n", M->nwindow, M->outputframebytes);
+
+			return -1;
+		}
+		mark5_stream_vdif_mux_clear(M, b);
+	}
+	M->cur = 0;
+
+	/* start with the earliest packet among the first batch's worth */
+	packet = mark5_stream_vdif_mux_packet(M);
+	if(!packet)
+	{
+		fprintf(m5stderr, "mark5_stream_vdif_mux_init: no VDIF packets of %d bytes in <%s>\n", M->inputframebytes, M->filename);
+
+		return -1;
+	}
+	M->base = mark5_stream_vdif_mux_time(M, packet);
+	M->epoch = packet[7] & 0x3F;
+	M->stationid = packet[12] | (packet[13] << 8);
+	for(pos = M->inpos, n = 0; pos + M->inputframebytes <= M->inlength && n < M->nwindow*M->nthread; pos += M->inputframebytes, ++n)
+	{
+		const unsigned int *header = (const unsigned int *)(M->inbuf + pos);
+
+		if(((header[2] & 0x00FFFFFF) << 3) != (unsigned int)M->inputframebytes)
+		{
+			break;
+		}
+		if(M->slot[(header[3] >> 16) & 0x03FF] < 0)
+		{
+			continue;
+		}
+		t = mark5_stream_vdif_mux_time(M, M->inbuf + pos);
+		if(t < M->base && M->base - t < M->nwindow)
+		{
+			M->base = t;
+		}
+	}
+
+	n = mark5_stream_vdif_mux_fill(M);
+	if(n <= 0)
+	{
+		return -1;
+	}
+
+	ms->datawindow = M->batch[M->cur];
+	ms->datawindowsize = (long long)n*M->outputframebytes;
+
+	return 0;
+}
+
+static int mark5_stream_vdif_mux_next(struct mark5_stream *ms)
+{
+	struct mark5_stream_vdif_mux *M;
+
+	M = (struct mark5_stream_vdif_mux *)(ms->inputdata);
+
+	ms->frame += ms->framebytes;
+
+	if(ms->frame + ms->framebytes > ms->datawindow + ms->datawindowsize)
+	{
+		int n;
+
+		if(ms->datawindowsize < (long long)(M->nwindow)*M->outputframebytes)
+		{
+			ms->readposition = -1;
+
+			return -1;
+		}
+
+		/* the batch just decoded is reused for the one after the next */
+		mark5_stream_vdif_mux_clear(M, M->cur);
+		M->cur = 1 - M->cur;
+		M->base += M->nwindow;
+
+		n = mark5_stream_vdif_mux_fill(M);
+		if(n <= 0)
+		{
+			ms->readposition = -1;
+
+			return -1;
+		}
+		ms->datawindow = M->batch[M->cur];
+		ms->datawindowsize = (long long)n*M->outputframebytes;
+		ms->frame = ms->datawindow;
+	}
+
+	/* successfully got new frame, so increment it */
+	++ms->framenum;
+	ms->readposition = 0;
+
+	return ms->framebytes;
+}
+
+static int mark5_stream_vdif_mux_final(struct mark5_stream *ms)
+{
+	struct mark5_stream_vdif_mux *M;
+	int b;
+
+	M = (struct mark5_stream_vdif_mux *)(ms->inputdata);
+
+	if(M->nlate > 0 || M->nstray > 0 || M->nduplicate > 0 || M->nresync > 0 || M->nrestart > 0)
+	{
+		fprintf(m5stderr, "Warning: %s: %lld packets too late, %lld far ahead, %lld duplicate; %lld resyncs, %lld steps back in time\n",
+			ms->streamname, M->nlate, M->nstray, M->nduplicate, M->nresync, M->nrestart);
+	}
+	for(b = 0; b < 2; ++b)
+	{
+		if(M->batch[b])
+		{
+			free(M->batch[b]);
+		}
+		if(M->present[b])
+		{
+			free(M->present[b]);
+		}
+	}
+	if(M->inbuf)
+	{
+		free(M->inbuf);
+	}
+	if(M->in > 0)
+	{
+		close(M->in);
+	}
+
+	free(M);
+
+	return 0;
+}
+
+/* undoes the constructor */
+static void mark5_stream_vdif_mux_abandon(struct mark5_stream_vdif_mux *M)
+{
+	if(M->in > 0)
+	{
+		close(M->in);
+	}
+	free(M->inbuf);
+	free(M);
+}
+
+struct mark5_stream_generic *new_mark5_stream_vdif_mux(const char *filename, long long offset, int framespersecond, int nthread, const int *threadids)
+{
+	struct mark5_stream_generic *V;
+	struct mark5_stream_vdif_mux *M;
+	const unsigned char *packet;
+	size_t frameoffset;
+	int framesize = 0;
+	int i, t;
+
+	if(framespersecond <= 0 || nthread < 0 || nthread > MAX_VDIF_MUX_THREADS)
+	{
+		fprintf(m5stderr, "new_mark5_stream_vdif_mux: need frames per second > 0 and at most %d threads\n", MAX_VDIF_MUX_THREADS);
+
+		return 0;
+	}
+
+	M = (struct mark5_stream_vdif_mux *)calloc(1, sizeof(struct mark5_stream_vdif_mux));
+	snprintf(M->filename, MARK5_STREAM_ID_LENGTH, "%s", filename);
+	M->framespersecond = framespersecond;
+	M->inbufsize = MARK5_STREAM_VDIF_MUX_READ;
+	M->inbuf = (unsigned char *)malloc(M->inbufsize);
+
+	if(strcmp(filename, "-") == 0)
+	{
+		M->in = 0; /* stdin */
+	}
+	else
+	{
+		M->in = open(filename, O_RDONLY);
+		if(M->in < 0)
+		{
+			fprintf(m5stderr, "File cannot be opened : <%s>\n", filename);
+			perror(0);
+			M->in = -1;
+			mark5_stream_vdif_mux_abandon(M);
+
+			return 0;
+		}
+	}
+
+	/* skip to offset and read the start of the data to learn the packets */
+	while(offset > 0)
+	{
+		ssize_t r = read(M->in, M->inbuf, offset < M->inbufsize ? offset : M->inbufsize);
+
+		if(r <= 0)
+		{
+			break;
+		}
+		offset -= r;
+	}
+	M->inlength = M->inpos = 0;
+	while(M->inlength < M->inbufsize)
+	{
+		ssize_t r = read(M->in, M->inbuf + M->inlength, M->inbufsize - M->inlength);
+
+		if(r <= 0)
+		{
+			M->eof = 1;
+			break;
+		}
+		M->inlength += r;
+	}
+
+	if(M->inlength < 64 || find_vdif_frame(M->inbuf, M->inlength, &frameoffset, &framesize) < 0)
+	{
+		fprintf(m5stderr, "new_mark5_stream_vdif_mux: no VDIF frames found in <%s>\n", filename);
+		mark5_stream_vdif_mux_abandon(M);
+
+		return 0;
+	}
+	if(2*framesize > M->inbufsize)
+	{
+		M->inbufsize = 2*framesize;
+		M->inbuf = (unsigned char *)realloc(M->inbuf, M->inbufsize);
+	}
+	M->inpos = frameoffset;
+	packet = M->inbuf + M->inpos;
+	M->inputframebytes = framesize;
+	M->inputheaderbytes = (packet[3] & 0x40) ? 16 : 32;
+	M->chansperthread = get_vdif_chans_per_thread(packet);
+	M->nbit = get_vdif_quantization_bits(packet);
+	M->iscomplex = get_vdif_complex(packet);
+
+	memset(M->slot, -1, sizeof(M->slot));
+	if(nthread > 0 && threadids)
+	{
+		for(i = 0; i < nthread; ++i)
+		{
+			if(threadids[i] < 0 || threadids[i] > 1023 || M->slot[threadids[i]] >= 0)
+			{
+				fprintf(m5stderr, "new_mark5_stream_vdif_mux: bad or repeated thread id %d\n", threadids[i]);
+				mark5_stream_vdif_mux_abandon(M);
+
+				return 0;
+			}
+			M->threadid[i] = threadids[i];
+			M->slot[threadids[i]] = i;
+		}
+		M->nthread = nthread;
+	}
+	else
+	{
+		/* all threads seen in the first read, in increasing order */
+		long long pos;
+		char seen[1024];
+
+		memset(seen, 0, sizeof(seen));
+		for(pos = M->inpos; pos + framesize <= M->inlength; pos += framesize)
+		{
+			const unsigned int *header = (const unsigned int *)(M->inbuf + pos);
+
+			if(((header[2] & 0x00FFFFFF) << 3) != (unsigned int)framesize)
+			{
+				break;
+			}
+			seen[(header[3] >> 16) & 0x03FF] = 1;
+		}
+		for(t = 0; t < 1024; ++t)
+		{
+			if(seen[t])
+			{
+				if(M->nthread >= MAX_VDIF_MUX_THREADS)
+				{
+					fprintf(m5stderr, "new_mark5_stream_vdif_mux: more than %d threads in <%s>\n", MAX_VDIF_MUX_THREADS, filename);
+					mark5_stream_vdif_mux_abandon(M);
+
+					return 0;
+				}
+				M->threadid[M->nthread] = t;
+				M->slot[t] = M->nthread;
+				++M->nthread;
+			}
+		}
+	}
+
+	for(M->nslot = 1; M->nslot < M->nthread; M->nslot *= 2)
+	{
+	}
+	M->outputframebytes = MARK5_STREAM_VDIF_MUX_HEADER + M->nslot*(framesize - M->inputheaderbytes);
+	M->nwindow = MARK5_STREAM_VDIF_MUX_BATCH/M->outputframebytes;
+	if(M->nwindow < 4)
+	{
+		M->nwindow = 4;
+	}
+
+	V = (struct mark5_stream_generic *)calloc(1, sizeof(struct mark5_stream_generic));
+	V->init_stream = mark5_stream_vdif_mux_init;
+	V->next = mark5_stream_vdif_mux_next;
+	V->final_stream = mark5_stream_vdif_mux_final;
+	V->inputdata = M;
+	V->inputdatasize = sizeof(struct mark5_stream_vdif_mux);
+
+	return V;
+}
+
+struct mark5_format_generic *new_mark5_format_vdif_mux(const struct mark5_stream_generic *s, int decimation)
+{
+	const struct mark5_stream_vdif_mux *M;
+
+	if(!s || s->init_stream != mark5_stream_vdif_mux_init)
+	{
+		fprintf(m5stderr, "new_mark5_format_vdif_mux: " "Wrong stream type!\n");
+
+		return 0;
+	}
+
+	M = (const struct mark5_stream_vdif_mux *)(s->inputdata);
+
+	return new_mark5_format_generalized_vdif(M->framespersecond, 1,
+		M->nslot*M->chansperthread, M->nbit, decimation,
+		M->outputframebytes - MARK5_STREAM_VDIF_MUX_HEADER, MARK5_STREAM_VDIF_MUX_HEADER, M->iscomplex);
+}
@@ -0,0 +1,1760 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "config.h"
+#include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_unpack_simd.h"
+
+/* The vector kernels below work on blocks of one or more 128 bit (SSE4.1),
+ * 256 bit (AVX2) or 512 bit (AVX-512) registers loaded straight from the
+ * payload.  Every output vector is assembled by picking, for each lane, the
+ * 32-bit word of the block holding that sample (a register permute), shifting
+ * the sample down and masking it.  The resulting state number then indexes
+ * the level table with a second permute, so the values produced are exactly
+ * those of the lookup tables used by the scalar decoders.  Where the sign
+ * and magnitude bits of a sample lie apart (track formats) the magnitude is
+ * picked the same way.  Where the data are NRZM modulated, the sign bits of
+ * the units to be negated are inverted in the loaded registers first, one
+ * mask per register built from the modulation bits, after which the data
+ * are decoded as if plain.
+ *
+ * The per-lane tables are computed once, when the format is made, by
+ * mark5_simd_layout_init() or mark5_simd_layout_probe(), for the instruction
+ * set selected at that time.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC_PREREQ(4, 9)) && !defined(WORDS_BIGENDIAN)
+#define MARK5_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+static int requestedlevel = MK5_SIMD_AUTO;
+
+enum Mark5SimdLevel mark5_simd_detect(void)
+{
+	static int detected = MK5_SIMD_AUTO;
+
+	if(detected == MK5_SIMD_AUTO)
+	{
+		int level = MK5_SIMD_SCALAR;
+
+#ifdef MARK5_SIMD_X86
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+		{
+			level = MK5_SIMD_AVX512BW;
+		}
+		else if(__builtin_cpu_supports("avx2"))
+		{
+			level = MK5_SIMD_AVX2;
+		}
+		else if(__builtin_cpu_supports("sse4.1"))
+		{
+			level = MK5_SIMD_SSE41;
+		}
+#elif defined(__aarch64__)
+		/* always present; no kernels yet, so this selects the lookup tables */
+		level = MK5_SIMD_NEON;
+#endif
+		detected = level;
+	}
+
+	return detected;
+}
+
+enum Mark5SimdLevel mark5_simd_level(void)
+{
+	enum Mark5SimdLevel best;
+
+	best = mark5_simd_detect();
+
+	if(requestedlevel == MK5_SIMD_AUTO)
+	{
+		return best;
+	}
+	if(requestedlevel == MK5_SIMD_NEON || best == MK5_SIMD_NEON)
+	{
+		/* the x86 levels are ordered; NEON is a family of its own */
+		return requestedlevel == best ? best : MK5_SIMD_SCALAR;
+	}
+
+	return requestedlevel < best ? requestedlevel : best;
+}
+
+int mark5_simd_set_level(int level)
+{
+	if(level < MK5_SIMD_AUTO || level > MK5_SIMD_NEON)
+	{
+		return -1;
+	}
+	requestedlevel = level;
+
+	return 0;
+}
+
+int mark5_simd_level_from_name(const char *name)
+{
+	if(strcasecmp(name, "auto") == 0 || name[0] == 0)
+	{
+		return MK5_SIMD_AUTO;
+	}
+	if(strcasecmp(name, "scalar") == 0 || strcasecmp(name, "none") == 0)
+	{
+		return MK5_SIMD_SCALAR;
+	}
+	if(strcasecmp(name, "sse4.1") == 0 || strcasecmp(name, "sse41") == 0)
+	{
+		return MK5_SIMD_SSE41;
+	}
+	if(strcasecmp(name, "avx2") == 0)
+	{
+		return MK5_SIMD_AVX2;
+	}
+	if(strcasecmp(name, "avx512") == 0 || strcasecmp(name, "avx512bw") == 0)
+	{
+		return MK5_SIMD_AVX512BW;
+	}
+	if(strcasecmp(name, "neon") == 0)
+	{
+		return MK5_SIMD_NEON;
+	}
+
+	return -2;
+}
+
+
+void mark5_simd_unpack_scalar(const struct mark5_simd_layout *L, const unsigned char *src, int nsamp, float **data, int o, const unsigned char *mod, int modunit, const int *chans, int nc)
+{
+	const unsigned int mask = (1 << L->nbit) - 1;
+	const unsigned char *u;
+	unsigned int state;
+	int t, c, j, k, p;
+	float x;
+
+	for(t = 0; t < nsamp; ++t)
+	{
+		u = src + (t / L->unitsamples)*L->unitbytes;
+		for(j = 0; j < nc; ++j)
+		{
+			c = chans ? chans[j] : j;
+			k = c*L->unitsamples + t % L->unitsamples;
+			p = L->signpos[k];
+			if(L->split)
+			{
+				state = ((u[p >> 3] >> (p & 7)) & 1) | (((u[L->magpos[k] >> 3] >> (L->magpos[k] & 7)) & 1) << 1);
+			}
+			else
+			{
+				state = (u[p >> 3] >> (p & 7)) & mask;
+			}
+			x = L->levels[state];
+			if(mod && mark5_simd_modulation(mod, modunit + t / L->unitsamples))
+			{
+				x = -x;
+			}
+			data[c][o+t] = x;
+		}
+	}
+}
+
+void mark5_simd_count_scalar(const struct mark5_simd_layout *L, const unsigned char *src, int nslot, unsigned int *highstates)
+{
+	int t, c, p;
+
+	for(t = 0; t < nslot; ++t)
+	{
+		p = t*L->slotbits;
+		for(c = 0; c < L->nchan; ++c)
+		{
+			highstates[c] += L->high[(src[p >> 3] >> (p & 7)) & 3];
+			p += 2;
+		}
+	}
+}
+
+#ifdef MARK5_SIMD_X86
+
+/* the modulation bits of the 64 units from unit m on */
+static inline uint64_t modulation_bits(const unsigned char *mod, int m)
+{
+	uint64_t lo, hi;
+
+	memcpy(&lo, mod + (m >> 3), 8);
+	if(m & 7)
+	{
+		memcpy(&hi, mod + (m >> 3) + 8, 8);
+		lo = (lo >> (m & 7)) | (hi << (64 - (m & 7)));
+	}
+
+	return lo;
+}
+
+/* SSE4.1: 4 lanes, up to 4 registers (64 bytes) per block.  Lacking a
+ * cross-lane permute, words are gathered from each register with a byte
+ * shuffle and the results or-ed together.  Lacking a variable shift, each
+ * sample is moved to the top of its lane by a multiply.  Only contiguous 1
+ * and 2 bit data are handled: 4 bit levels would need 4 table shuffles per
+ * vector, which is slower than the lookup tables.
+ */
+
+static inline __attribute__((always_inline, target("sse4.1"))) void unpack_sse41(const struct mark5_simd_layout *L, const unsigned char *src, int nblock, float **data, int o, const int32_t *vsel, int nv, const int nreg)
+{
+	const __m128i down = _mm_cvtsi32_si128(32 - L->nbit);
+	const __m128i spread = _mm_set_epi8(12, 12, 12, 12, 8, 8, 8, 8, 4, 4, 4, 4, 0, 0, 0, 0);
+	const __m128i bytes = _mm_set1_epi32(0x03020100);
+	const __m128i lev = _mm_castps_si128(_mm_loadu_ps(L->levels));
+	__m128i r0, r1, r2, r3;
+	int b, k, v;
+
+	r1 = r2 = r3 = _mm_setzero_si128();
+
+	for(b = 0; b < nblock; ++b)
+	{
+		r0 = _mm_loadu_si128((const __m128i *)src);
+		if(nreg > 1)
+		{
+			r1 = _mm_loadu_si128((const __m128i *)(src + 16));
+		}
+		if(nreg > 2)
+		{
+			r2 = _mm_loadu_si128((const __m128i *)(src + 32));
+			r3 = _mm_loadu_si128((const __m128i *)(src + 48));
+		}
+
+		for(k = 0; k < nv; ++k)
+		{
+			const __m128i *shuf;
+			__m128i w, code, index;
+
+			v = vsel ? vsel[k] : k;
+			shuf = (const __m128i *)(L->shuffle + 64*v);
+			w = _mm_shuffle_epi8(r0, _mm_loadu_si128(shuf));
+			if(nreg > 1)
+			{
+				w = _mm_or_si128(w, _mm_shuffle_epi8(r1, _mm_loadu_si128(shuf + 1)));
+			}
+			if(nreg > 2)
+			{
+				w = _mm_or_si128(w, _mm_shuffle_epi8(r2, _mm_loadu_si128(shuf + 2)));
+				w = _mm_or_si128(w, _mm_shuffle_epi8(r3, _mm_loadu_si128(shuf + 3)));
+			}
+			code = _mm_srl_epi32(_mm_mullo_epi32(w, _mm_loadu_si128((const __m128i *)(L->scale + 4*v))), down);
+
+			/* byte k of each lane becomes 4*code+k, indexing the bytes of the level table */
+			index = _mm_add_epi8(_mm_shuffle_epi8(_mm_slli_epi32(code, 2), spread), bytes);
+			_mm_storeu_ps(data[L->chan[v]] + o + L->offset[v], _mm_castsi128_ps(_mm_shuffle_epi8(lev, index)));
+		}
+
+		src += L->blockbytes;
+		o += L->blockslots;
+	}
+}
+
+/* only chosen for layouts that are not modulated, see layout_build() */
+static __attribute__((target("sse4.1"))) void unpack_sse41_1reg(const struct mark5_simd_layout *L, const unsigned char *src, int nblock, float **data, int o, const unsigned char *mod __attribute__((unused)), int modunit __attribute__((unused)), const int32_t *vsel, int nv)
+{
+	unpack_sse41(L, src, nblock, data, o, vsel, nv, 1);
+}
+
+static __attribute__((target("sse4.1"))) void unpack_sse41_2reg(const struct mark5_simd_layout *L, const unsigned char *src, int nblock, float **data, int o, const unsigned char *mod __attribute__((unused)), int modunit __attribute__((unused)), const int32_t *vsel, int nv)
+{
+	unpack_sse41(L, src, nblock, data, o, vsel, nv, 2);
+}
+
+static __attribute__((target("sse4.1"))) void unpack_sse41_4reg(const struct mark5_simd_layout *L, const unsigned char *src, int nblock, float **data, int o, const unsigned char *mod __attribute__((unused)), int modunit __attribute__((unused)), const int32_t *vsel, int nv)
+{
+	unpack_sse41(L, src, nblock, data, o, vsel, nv, 4);
+}
+
+/* 2 bit high state counting: a sample is high if its two bits are alike
+ * (or unlike, for some level orderings), which for a whole 64-bit word is
+ * one xor; each channel's samples are then picked by a mask and counted.
+ */
+
+static __attribute__((target("popcnt"))) void count_popcnt(const struct mark5_simd_layout *L, const unsigned char *src, int nunit, unsigned int *highstates)
+{
+	const uint64_t invert = L->countxor ? 0 : ~(uint64_t)0;
+	uint64_t w[2];
+	int u, k, c;
+
+	for(u = 0; u < nunit; ++u)
+	{
+		for(k = 0; k < L->countwords; ++k)
+		{
+			memcpy(w + k, src + 8*k, 8);
+			w[k] = (w[k] ^ (w[k] >> 1)) ^ invert;
+		}
+		for(c = 0; c < L->nchan; ++c)
+		{
+			highstates[c] += __builtin_popcountll(w[L->countword[c]] & L->countmask[c]);
+		}
+		src += 8*L->countwords;
+	}
+}
+
+/* AVX2: 8 lanes, up to 4 registers (128 bytes) per block */
+
+static inline __attribute__((always_inline, target("avx2"))) __m256i gather_avx2(__m256i word, __m256i r0, __m256i r1, __m256i r2, __m256i r3, const int nreg)
+{
+	__m256i w;
+
+	w = _mm256_permutevar8x32_epi32(r0, word);
+	if(nreg > 1)
+	{
+		w = _mm256_blendv_epi8(w, _mm256_permutevar8x32_epi32(r1, word), _mm256_cmpgt_epi32(word, _mm256_set1_epi32(7)));
+	}
+	if(nreg > 2)
+	{
+		w = _mm256_blendv_epi8(w, _mm256_permutevar8x32_epi32(r2, word), _mm256_cmpgt_epi32(word, _mm256_set1_epi32(15)));
+		w = _mm256_blendv_epi8(w, _mm256_permutevar8x32_epi32(r3, word), _mm256_cmpgt_epi32(word, _mm256_set1_epi32(23)));
+	}
+
+	return w;
+}
+
+static inline __attribute__((always_inline, target("avx2"))) __m256i demodulate_avx2(__m256i r, uint64_t bits, __m256i flip, __m256i modbyte, __m256i modmask)
+{
+	__m256i m;
+
+	/* the byte shuffle stays within 128 bit lanes, so the bits are in both */
+	m = _mm256_shuffle_epi8(_mm256_set1_epi32((uint32_t)bits), modbyte);
+	m = _mm256_cmpeq_epi8(_mm256_and_si256(m, modmask), modmask);
+
+	return _mm256_xor_si256(r, _mm256_and_si256(m, flip));
+}
+
+static inline __attribute__((always_inline, target("avx2"))) void unpack_avx2(const struct mark5_simd_layout *L, const unsigned char *src, int nblock, float **data, int o, const unsigned char *mod, int modunit, const int32_t *vsel, int nv, const int nreg, const int is4bit, const int split, const int modulated)
+{
+	const __m256i mask = _mm256_set1_epi32(split ? 1 : (1 << L->nbit) - 1);
+	const __m256 lev0 = _mm256_loadu_ps(L->levels);
+	const __m256 lev1 = _mm256_loadu_ps(L->levels + 8);
+	const __m256i flip = _mm256_loadu_si256((const __m256i *)L->flip);
+	const __m256i modbyte = _mm256_loadu_si256((const __m256i *)L->modbyte);
+	const __m256i modmask = _mm256_loadu_si256((const __m256i *)L->modmask);
+	const int regunits = 32/L->unitbytes;
+	__m256i r0, r1, r2, r3;
+	int b, k, v;
+
+	r1 = r2 = r3 = _mm256_setzero_si256();
+
+	for(b = 0; b < nblock; ++b)
+	{
+		r0 = _mm256_loadu_si256((const __m256i *)src);
+		if(nreg > 1)
+		{
+			r1 = _mm256_loadu_si256((const __m256i *)(src + 32));
+		}
+		if(nreg > 2)
+		{
+			r2 = _mm256_loadu_si256((const __m256i *)(src + 64));
+			r3 = _mm256_loadu_si256((const __m256i *)(src + 96));
+		}
+		if(modulated)
+		{
+			r0 = demodulate_avx2(r0, modulation_bits(mod, modunit), flip, modbyte, modmask);
+			if(nreg > 1)
+			{
+				r1 = demodulate_avx2(r1, modulation_bits(mod, modunit + regunits), flip, modbyte, modmask);
+			}
+			if(nreg > 2)
+			{
+				r2 = demodulate_avx2(r2, modulation_bits(mod, modunit + 2*regunits), flip, modbyte, modmask);
+				r3 = demodulate_avx2(r3, modulation_bits(mod, modunit + 3*regunits), flip, modbyte, modmask);
+			}
+		}
+
+		for(k = 0; k < nv; ++k)
+		{
+			__m256i w, code;
+			__m256 val;
+
+			v = vsel ? vsel[k] : k;
+			w = gather_avx2(_mm256_loadu_si256((const __m256i *)(L->word + 8*v)), r0, r1, r2, r3, nreg);
+			code = _mm256_and_si256(_mm256_srlv_epi32(w, _mm256_loadu_si256((const __m256i *)(L->shift + 8*v))), mask);
+			if(split)
+			{
+				w = gather_avx2(_mm256_loadu_si256((const __m256i *)(L->word2 + 8*v)), r0, r1, r2, r3, nreg);
+				w = _mm256_and_si256(_mm256_srlv_epi32(w, _mm256_loadu_si256((const __m256i *)(L->shift2 + 8*v))), mask);
+				code = _mm256_or_si256(code, _mm256_slli_epi32(w, 1));
+			}
+			val = _mm256_permutevar8x32_ps(lev0, code);
+			if(is4bit)
+			{
+				/* states 8 to 15 come from the upper half of the table */
+				val = _mm256_blendv_ps(val, _mm256_permutevar8x32_ps(lev1, code), _mm256_castsi256_ps(_mm256_slli_epi32(code, 28)));
+			}
+			_mm256_storeu_ps(data[L->chan[v]] + o + L->offset[v], val);
+		}
+
+		src += L->blockbytes;
+		o += L->blockslots;
+		modunit += L->blockunits;
+	}
+}
+
+#define AVX2_KERNEL(name, nreg, is4bit, split, modulated) \
+static __attribute__((target("avx2"))) void name(const struct mark5_simd_layout *L, const unsigned char *src, int nblock, float **data, int o, const unsigned char *mod, int modunit, const int32_t *vsel, int nv) \
+{ \
+	unpack_avx2(L, src, nblock, data, o, mod, modunit, vsel, nv, nreg, is4bit, split, modulated); \
+}
+
+AVX2_KERNEL(unpack_avx2_1reg, 1, 0, 0, 0)
+AVX2_KERNEL(unpack_avx2_2reg, 2, 0, 0, 0)
+AVX2_KERNEL(unpack_avx2_4reg, 4, 0, 0, 0)
+AVX2_KERNEL(unpack_avx2_1reg_4bit, 1, 1, 0, 0)
+AVX2_KERNEL(unpack_avx2_2reg_4bit, 2, 1, 0, 0)
+AVX2_KERNEL(unpack_avx2_4reg_4bit, 4, 1, 0, 0)
+AVX2_KERNEL(unpack_avx2_1reg_split, 1, 0, 1, 0)
+AVX2_KERNEL(unpack_avx2_2reg_split, 2, 0, 1, 0)
+AVX2_KERNEL(unpack_avx2_4reg_split, 4, 0, 1, 0)
+AVX2_KERNEL(unpack_avx2_1reg_mod, 1, 0, 0, 1)
+AVX2_KERNEL(unpack_avx2_2reg_mod, 2, 0, 0, 1)
+AVX2_KERNEL(unpack_avx2_4reg_mod, 4, 0, 0, 1)
+AVX2_KERNEL(unpack_avx2_1reg_split_mod, 1, 0, 1, 1)
+AVX2_KERNEL(unpack_avx2_2reg_split_mod, 2, 0, 1, 1)
+AVX2_KERNEL(unpack_avx2_4reg_split_mod, 4, 0, 1, 1)
+
+/* indexed by [nreg 1, 2, 4][plain, split, modulated, split and modulated, 4 bit] */
+static const simdUnpackFunc avx2kernels[3][5] =
+{
+	{ unpack_avx2_1reg, unpack_avx2_1reg_split, unpack_avx2_1reg_mod, unpack_avx2_1reg_split_mod, unpack_avx2_1reg_4bit },
+	{ unpack_avx2_2reg, unpack_avx2_2reg_split, unpack_avx2_2reg_mod, unpack_avx2_2reg_split_mod, unpack_avx2_2reg_4bit },
+	{ unpack_avx2_4reg, unpack_avx2_4reg_split, unpack_avx2_4reg_mod, unpack_avx2_4reg_split_mod, unpack_avx2_4reg_4bit }
+};
+
+/* AVX-512: 16 lanes, up to 4 registers (256 bytes) per block.  The 16 entry
+ * permute covers the full 4-bit level table in one instruction.
+ */
+
+static inline __attribute__((always_inline, target("avx512f,avx512bw"))) __m512i gather_avx512(__m512i word, __m512i r0, __m512i r1, __m512i r2, __m512i r3, const int nreg)
+{
+	__m512i w;
+
+	if(nreg == 1)
+	{
+		w = _mm512_permutexvar_epi32(word, r0);
+	}
+	else
+	{
+		w = _mm512_permutex2var_epi32(r0, word, r1);
+	}
+	if(nreg > 2)
+	{
+		w = _mm512_mask_blend_epi32(_mm512_cmpge_epi32_mask(word, _mm512_set1_epi32(32)), w, _mm512_permutex2var_epi32(r2, word, r3));
+	}
+
+	return w;
+}
+
+/* the modulation bits become a write mask directly, one bit per element of the unit size */
+static inline __attribute__((always_inline, target("avx512f,avx512bw"))) __m512i demodulate_avx512(__m512i r, uint64_t bits, __m512i flip, const int unitbytes)
+{
+	__m512i m;
+
+	switch(unitbytes)
+	{
+	case 1:
+		m = _mm512_maskz_mov_epi8((__mmask64)bits, flip);
+		break;
+	case 2:
+		m = _mm512_maskz_mov_epi16((__mmask32)bits, flip);
+		break;
+	case 4:
+		m = _mm512_maskz_mov_epi32((__mmask16)bits, flip);
+		break;
+	case 8:
+		m = _mm512_maskz_mov_epi64((__mmask8)bits, flip);
+		break;
+	default:
+		/* 16 bytes: each bit covers two 64-bit elements */
+		m = _mm512_maskz_mov_epi64((__mmask8)((bits & 1)*3 | (bits & 2)*6 | (bits & 4)*12 | (bits & 8)*24), flip);
+		break;
+	}
+
+	return _mm512_xor_si512(r, m);
+}
+
+static inline __attribute__((always_inline, target("avx512f,avx512bw"))) void unpack_avx512(const struct mark5_simd_layout *L, const unsigned char *src, int nblock, float **data, int o, const unsigned char *mod, int modunit, const int32_t *vsel, int nv, const int nreg, const int split, const int modulated)
+{
+	const __m512i mask = _mm512_set1_epi32(split ? 1 : (1 << L->nbit) - 1);
+	const __m512 lev = _mm512_loadu_ps(L->levels);
+	const __m512i flip = _mm512_loadu_si512((const void *)L->flip);
+	const int unitbytes = L->unitbytes;
+	const int regunits = 64/unitbytes;
+	__m512i r0, r1, r2, r3;
+	int b, k, v;
+
+	r1 = r2 = r3 = _mm512_setzero_si512();
+
+	for(b = 0; b < nblock; ++b)
+	{
+		r0 = _mm512_loadu_si512((const void *)src);
+		if(nreg > 1)
+		{
+			r1 = _mm512_loadu_si512((const void *)(src + 64));
+		}
+		if(nreg > 2)
+		{
+			r2 = _mm512_loadu_si512((const void *)(src + 128));
+			r3 = _mm512_loadu_si512((const void *)(src + 192));
+		}
+		if(modulated)
+		{
+			r0 = demodulate_avx512(r0, modulation_bits(mod, modunit), flip, unitbytes);
+			if(nreg > 1)
+			{
+				r1 = demodulate_avx512(r1, modulation_bits(mod, modunit + regunits), flip, unitbytes);
+			}
+			if(nreg > 2)
+			{
+				r2 = demodulate_avx512(r2, modulation_bits(mod, modunit + 2*regunits), flip, unitbytes);
+				r3 = demodulate_avx512(r3, modulation_bits(mod, modunit + 3*regunits), flip, unitbytes);
+			}
+		}
+
+		for(k = 0; k < nv; ++k)
+		{
+			__m512i w, code;
+			__m512 val;
+
+			v = vsel ? vsel[k] : k;
+			w = gather_avx512(_mm512_loadu_si512((const void *)(L->word + 16*v)), r0, r1, r2, r3, nreg);
+			code = _mm512_and_si512(_mm512_srlv_epi32(w, _mm512_loadu_si512((const void *)(L->shift + 16*v))), mask);
+			if(split)
+			{
+				w = gather_avx512(_mm512_loadu_si512((const void *)(L->word2 + 16*v)), r0, r1, r2, r3, nreg);
+				w = _mm512_and_si512(_mm512_srlv_epi32(w, _mm512_loadu_si512((const void *)(L->shift2 + 16*v))), mask);
+				code = _mm512_or_si512(code, _mm512_slli_epi32(w, 1));
+			}
+			val = _mm512_permutexvar_ps(code, lev);
+			_mm512_storeu_ps(data[L->chan[v]] + o + L->offset[v], val);
+		}
+
+		src += L->blockbytes;
+		o += L->blockslots;
+		modunit += L->blockunits;
+	}
+}
+
+#define AVX512_KERNEL(name, nreg, split, modulated) \
+static __attribute__((target("avx512f,avx512bw"))) void name(const struct mark5_simd_layout *L, const unsigned char *src, int nblock, float **data, int o, const unsigned char *mod, int modunit, const int32_t *vsel, int nv) \
+{ \
+	unpack_avx512(L, src, nblock, data, o, mod, modunit, vsel, nv, nreg, split, modulated); \
+}
+
+AVX512_KERNEL(unpack_avx512_1reg, 1, 0, 0)
+AVX512_KERNEL(unpack_avx512_2reg, 2, 0, 0)
+AVX512_KERNEL(unpack_avx512_4reg, 4, 0, 0)
+AVX512_KERNEL(unpack_avx512_1reg_split, 1, 1, 0)
+AVX512_KERNEL(unpack_avx512_2reg_split, 2, 1, 0)
+AVX512_KERNEL(unpack_avx512_4reg_split, 4, 1, 0)
+AVX512_KERNEL(unpack_avx512_1reg_mod, 1, 0, 1)
+AVX512_KERNEL(unpack_avx512_2reg_mod, 2, 0, 1)
+AVX512_KERNEL(unpack_avx512_4reg_mod, 4, 0, 1)
+AVX512_KERNEL(unpack_avx512_1reg_split_mod, 1, 1, 1)
+AVX512_KERNEL(unpack_avx512_2reg_split_mod, 2, 1, 1)
+AVX512_KERNEL(unpack_avx512_4reg_split_mod, 4, 1, 1)
+
+/* indexed by [nreg 1, 2, 4][plain, split, modulated, split and modulated] */
+static const simdUnpackFunc avx512kernels[3][4] =
+{
+	{ unpack_avx512_1reg, unpack_avx512_1reg_split, unpack_avx512_1reg_mod, unpack_avx512_1reg_split_mod },
+	{ unpack_avx512_2reg, unpack_avx512_2reg_split, unpack_avx512_2reg_mod, unpack_avx512_2reg_split_mod },
+	{ unpack_avx512_4reg, unpack_avx512_4reg_split, unpack_avx512_4reg_mod, unpack_avx512_4reg_split_mod }
+};
+
+#endif /* MARK5_SIMD_X86 */
+
+static int ispowerof2(int x)
+{
+	return x > 0 && (x & (x-1)) == 0;
+}
+
+static void count_init(struct mark5_simd_layout *L, enum Mark5SimdLevel level)
+{
+	int c, t, p;
+
+	if(L->nbit != 2 || L->slotbits == 0 || L->slotbits > 128 || level < MK5_SIMD_SSE41 || level == MK5_SIMD_NEON)
+	{
+		return;
+	}
+#ifdef MARK5_SIMD_X86
+	if(!__builtin_cpu_supports("popcnt"))
+	{
+		return;
+	}
+	if(L->high[0] && L->high[3] && !L->high[1] && !L->high[2])
+	{
+		L->countxor = 0;
+	}
+	else if(!L->high[0] && !L->high[3] && L->high[1] && L->high[2])
+	{
+		L->countxor = 1;
+	}
+	else
+	{
+		return;
+	}
+
+	L->countwords = L->slotbits > 64 ? L->slotbits/64 : 1;
+	L->countslots = 64*L->countwords/L->slotbits;
+	for(c = 0; c < L->nchan; ++c)
+	{
+		p = 2*c;
+		L->countword[c] = p / 64;
+		L->countmask[c] = 0;
+		for(t = 0; t < L->countslots; ++t)
+		{
+			L->countmask[c] |= (uint64_t)1 << ((t*L->slotbits + p) % 64);
+		}
+	}
+	L->counter = count_popcnt;
+#endif
+}
+
+static void set_levels(struct mark5_simd_layout *L, int nbit, int nchan, const float *levels)
+{
+	int k;
+
+	L->nbit = nbit;
+	L->nchan = nchan;
+	for(k = 0; k < (1 << nbit); ++k)
+	{
+		L->levels[k] = levels[k];
+		L->high[k] = (levels[k] > 1.1 || levels[k] < -1.1);
+	}
+}
+
+/* choose the kernel and fill the per-lane tables from signpos[] and magpos[] */
+static int layout_build(struct mark5_simd_layout *L, enum Mark5SimdLevel level)
+{
+	int v, j, k, t, u, p, w, vectorsperchan, variant, r;
+
+	L->kernel = 0;
+
+	/* enough registers that a block holds whole units and a whole vector of each channel */
+	L->nreg = L->unitbytes/(4*L->unitsamples);
+	if(L->nreg < 1)
+	{
+		L->nreg = 1;
+	}
+	r = L->nreg == 1 ? 0 : (L->nreg == 2 ? 1 : (L->nreg == 4 ? 2 : -1));
+	if(r < 0)
+	{
+		return -1;
+	}
+
+	if(L->modulate)
+	{
+		/* negation must be the inversion of the same bits of every state */
+		for(w = 1; w < (1 << L->nbit); ++w)
+		{
+			for(k = 0; k < (1 << L->nbit) && L->levels[k ^ w] == -L->levels[k]; ++k)
+			{
+			}
+			if(k == (1 << L->nbit))
+			{
+				break;
+			}
+		}
+		if(w == (1 << L->nbit))
+		{
+			return -1;
+		}
+		memset(L->flip, 0, sizeof(L->flip));
+		for(k = 0; k < L->nchan*L->unitsamples; ++k)
+		{
+			for(j = 0; j < L->nbit; ++j)
+			{
+				if(!(w & (1 << j)))
+				{
+					continue;
+				}
+				t = (j == 0) ? L->signpos[k] : (L->split ? L->magpos[k] : L->signpos[k] + j);
+				for(p = t/8; p < (int)sizeof(L->flip); p += L->unitbytes)
+				{
+					L->flip[p] |= 1 << (t % 8);
+				}
+			}
+		}
+		for(p = 0; p < (int)sizeof(L->modbyte); ++p)
+		{
+			u = p / L->unitbytes;
+			L->modbyte[p] = u / 8;
+			L->modmask[p] = 1 << (u % 8);
+		}
+	}
+
+#ifdef MARK5_SIMD_X86
+	variant = L->split + 2*(L->modulate != 0);
+	switch(level)
+	{
+	case MK5_SIMD_AVX512BW:
+		L->lanes = 16;
+		L->kernel = avx512kernels[r][variant];
+		break;
+	case MK5_SIMD_AVX2:
+		L->lanes = 8;
+		L->kernel = avx2kernels[r][L->nbit == 4 ? 4 : variant];
+		break;
+	case MK5_SIMD_SSE41:
+		L->lanes = 4;
+		if(L->nbit < 4 && variant == 0)
+		{
+			L->kernel = r == 0 ? unpack_sse41_1reg : (r == 1 ? unpack_sse41_2reg : unpack_sse41_4reg);
+		}
+		break;
+	default:
+		break;
+	}
+#endif
+
+	if(!L->kernel)
+	{
+		return -1;
+	}
+
+	L->blockbytes = 4*L->lanes*L->nreg;
+	L->blockunits = L->blockbytes/L->unitbytes;
+	L->blockslots = L->blockunits*L->unitsamples;
+	vectorsperchan = L->blockslots/L->lanes;
+	L->nvector = L->nchan*vectorsperchan;
+	if(L->blockunits*L->unitbytes != L->blockbytes || vectorsperchan*L->lanes != L->blockslots || L->nvector > MARK5_SIMD_MAXVECTORS)
+	{
+		L->kernel = 0;
+
+		return -1;
+	}
+
+	memset(L->shuffle, 0x80, sizeof(L->shuffle));
+	for(v = 0; v < L->nvector; ++v)
+	{
+		L->chan[v] = v / vectorsperchan;
+		L->offset[v] = (v % vectorsperchan)*L->lanes;
+		for(j = 0; j < L->lanes; ++j)
+		{
+			t = L->offset[v] + j;
+			u = t / L->unitsamples;
+			k = L->chan[v]*L->unitsamples + t % L->unitsamples;
+			p = 8*L->unitbytes*u + L->signpos[k];
+			w = p / 32;
+			L->word[v*L->lanes + j] = w;
+			L->shift[v*L->lanes + j] = p % 32;
+			if(L->split)
+			{
+				p = 8*L->unitbytes*u + L->magpos[k];
+				L->word2[v*L->lanes + j] = p / 32;
+				L->shift2[v*L->lanes + j] = p % 32;
+			}
+			if(L->lanes == 4)
+			{
+				L->scale[4*v + j] = 1U << (32 - L->nbit - p % 32);
+				for(k = 0; k < 4; ++k)
+				{
+					L->shuffle[64*v + 16*(w/4) + 4*j + k] = 4*(w%4) + k;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+int mark5_simd_layout_init(struct mark5_simd_layout *L, int nbit, int nchan, int slotbits, int decimation, int iscomplex, const float *levels)
+{
+	enum Mark5SimdLevel level;
+	int c, s, j, nval, step, unitbits;
+
+	memset(L, 0, sizeof(struct mark5_simd_layout));
+
+	if(nbit != 1 && nbit != 2 && nbit != 4)
+	{
+		return -1;
+	}
+	nval = iscomplex ? 2 : 1;
+	if(nchan < 1 || decimation < 1 || !ispowerof2(slotbits) || nval*nchan*nbit > slotbits)
+	{
+		return -1;
+	}
+
+	/* a unit is the smallest whole number of bytes holding whole decimated samples */
+	step = slotbits*decimation;
+	for(unitbits = step; unitbits % 8 != 0; unitbits += step);
+	if(unitbits > 65536 || nval*nchan*(unitbits/step) > MARK5_SIMD_MAXMAP)
+	{
+		return -1;
+	}
+
+	set_levels(L, nbit, nchan, levels);
+	L->slotbits = slotbits;
+	L->unitbytes = unitbits/8;
+	L->unitsamples = nval*(unitbits/step);
+	for(c = 0; c < nchan; ++c)
+	{
+		for(s = 0; s < unitbits/step; ++s)
+		{
+			for(j = 0; j < nval; ++j)
+			{
+				L->signpos[c*L->unitsamples + nval*s + j] = s*step + (nval*c + j)*nbit;
+			}
+		}
+	}
+
+	L->mapped = 1;
+
+	level = mark5_simd_level();
+
+	if(decimation == 1 && !iscomplex)
+	{
+		count_init(L, level);
+	}
+
+	return layout_build(L, level);
+}
+
+/* A throw-away stream, all valid, for running a decoder on a test buffer */
+static struct mark5_stream *probe_stream(unsigned char *payload)
+{
+	struct mark5_stream *ms;
+
+	ms = (struct mark5_stream *)calloc(1, sizeof(struct mark5_stream));
+	ms->payload = payload;
+	ms->databytes = 1<<29;
+	ms->log2blankzonesize = 30;
+	ms->blankzonestartvalid[0] = 0;
+	ms->blankzoneendvalid[0] = 1<<30;
+
+	return ms;
+}
+
+#define PROBE_UNITS	256
+
+int mark5_simd_layout_probe(struct mark5_simd_layout *L, decodeFunc decode, int nbit, int nchan, int unitbytes, int unitsamples, const float *levels, const unsigned char *modulate)
+{
+	enum Mark5SimdLevel level;
+	struct mark5_stream *ms;
+	unsigned char *buf;
+	float *out[MARK5_SIMD_MAXVECTORS], *ref[MARK5_SIMD_MAXVECTORS];
+	unsigned char found[MARK5_SIMD_MAXMAP];
+	float sign0, x;
+	unsigned int seed;
+	int b, c, s, k, n, state, status = -1;
+
+	memset(L, 0, sizeof(struct mark5_simd_layout));
+
+	/* the kernels need cross-lane permutes and per-lane shifts; without
+	 * them the bit positions are still learned, for the statistics
+	 */
+	level = mark5_simd_level();
+	if(level < MK5_SIMD_AVX2 || level == MK5_SIMD_NEON)
+	{
+		level = MK5_SIMD_SCALAR;
+	}
+	if((nbit != 1 && nbit != 2) || nchan < 1 || nchan > MARK5_SIMD_MAXVECTORS || nchan*unitsamples > MARK5_SIMD_MAXMAP ||
+	   !ispowerof2(unitbytes) || unitbytes > 16 || !ispowerof2(unitsamples) || nchan*unitsamples*nbit > 8*unitbytes)
+	{
+		return -1;
+	}
+
+	set_levels(L, nbit, nchan, levels);
+	L->unitbytes = unitbytes;
+	L->unitsamples = unitsamples;
+	L->modulate = modulate;
+
+	/* 16 bytes of headroom for decoders that look before the payload */
+	buf = (unsigned char *)calloc(PROBE_UNITS*unitbytes + 32, 1);
+	ms = probe_stream(buf + 16);
+	n = PROBE_UNITS*unitsamples;
+	for(c = 0; c < nchan; ++c)
+	{
+		out[c] = (float *)malloc(n*sizeof(float));
+		ref[c] = (float *)malloc(n*sizeof(float));
+	}
+	memset(found, 0, sizeof(found));
+
+	/* set one bit at a time and see which sample changes, and to which state */
+	sign0 = (modulate && mark5_simd_modulation(modulate, 0)) ? -1.0 : 1.0;
+	for(b = 0; b < 8*unitbytes; ++b)
+	{
+		memset(buf + 16, 0, unitbytes);
+		buf[16 + b/8] = 1 << (b%8);
+		ms->readposition = 0;
+		decode(ms, unitsamples, out);
+		for(c = 0; c < nchan; ++c)
+		{
+			for(s = 0; s < unitsamples; ++s)
+			{
+				k = c*unitsamples + s;
+				x = out[c][s];
+				if(x == sign0*levels[0])
+				{
+					continue;
+				}
+				for(state = 1; state < (1 << nbit); ++state)
+				{
+					if(x == sign0*levels[state])
+					{
+						break;
+					}
+				}
+				if(state == 1 && !(found[k] & 1))
+				{
+					L->signpos[k] = b;
+					found[k] |= 1;
+				}
+				else if(state == 2 && !(found[k] & 2))
+				{
+					L->magpos[k] = b;
+					found[k] |= 2;
+				}
+				else
+				{
+					goto done;
+				}
+			}
+		}
+	}
+
+	for(k = 0; k < nchan*unitsamples; ++k)
+	{
+		if(found[k] != (1 << nbit) - 1)
+		{
+			goto done;
+		}
+		if(nbit == 2 && (L->magpos[k] != L->signpos[k] + 1 || L->signpos[k] % 2 != 0))
+		{
+			L->split = 1;
+		}
+	}
+
+	layout_build(L, level);
+
+	/* the vector (or, lacking a kernel, map based) decoding must agree exactly with the lookup tables */
+	seed = 12345;
+	for(k = 0; k < PROBE_UNITS*unitbytes; ++k)
+	{
+		seed = seed*1103515245 + 12345;
+		buf[16 + k] = seed >> 16;
+	}
+	ms->readposition = 0;
+	decode(ms, n, ref);
+	mark5_simd_unpack(L, buf + 16, n, out, 0, modulate, 0);
+	L->mapped = 1;
+	for(c = 0; c < nchan; ++c)
+	{
+		if(memcmp(out[c], ref[c], n*sizeof(float)) != 0)
+		{
+			L->mapped = 0;
+		}
+	}
+	if(L->mapped && L->kernel)
+	{
+		status = 0;
+	}
+
+done:
+	if(status != 0)
+	{
+		L->kernel = 0;
+	}
+	for(c = 0; c < nchan; ++c)
+	{
+		free(out[c]);
+		free(ref[c]);
+	}
+	free(ms);
+	free(buf);
+
+	return status;
+}
+
+/* a channel selection: the channels, and the output vectors that belong to them */
+struct selection
+{
+	const int *chans;	/* 0 for all channels */
+	int nc;
+	const int32_t *vsel;	/* 0 for all vectors */
+	int nv;
+};
+
+static void unpack_selection(const struct mark5_simd_layout *L, const unsigned char *src, int nsamp, float **data, int o, const unsigned char *mod, int modunit, const struct selection *S)
+{
+	int nblock = 0;
+
+	if(L->kernel)
+	{
+		nblock = nsamp/L->blockslots;
+		if(nblock > 0 && S->nv > 0)
+		{
+			L->kernel(L, src, nblock, data, o, mod, modunit, S->vsel, S->nv);
+		}
+	}
+	if(nsamp > nblock*L->blockslots)
+	{
+		mark5_simd_unpack_scalar(L, src + nblock*L->blockbytes, nsamp - nblock*L->blockslots, data, o + nblock*L->blockslots, mod, modunit + nblock*L->blockunits, S->chans, S->nc);
+	}
+}
+
+int mark5_simd_unpack(const struct mark5_simd_layout *L, const unsigned char *src, int nsamp, float **data, int o, const unsigned char *mod, int modunit)
+{
+	struct selection S = { 0, L->nchan, 0, L->nvector };
+
+	unpack_selection(L, src, nsamp, data, o, mod, modunit, &S);
+
+	return nsamp;
+}
+
+int mark5_simd_count(const struct mark5_simd_layout *L, const unsigned char *src, int nslot, unsigned int *highstates)
+{
+	int nunit = 0;
+
+	if(L->counter)
+	{
+		nunit = nslot/L->countslots;
+		if(nunit > 0)
+		{
+			L->counter(L, src, nunit, highstates);
+		}
+	}
+	if(nslot > nunit*L->countslots)
+	{
+		mark5_simd_count_scalar(L, src + nunit*L->countwords*8, nslot - nunit*L->countslots, highstates);
+	}
+
+	return nslot;
+}
+
+#ifdef MARK5_SIMD_X86
+
+/* Conversion to integers; the default rounding mode is to nearest, as for lrintf().
+ * Values are clamped to the int16 range first, as beyond the int32 range the
+ * conversion gives INT_MIN whatever the sign.
+ */
+
+static __attribute__((target("avx512f,avx512bw"))) int float_to_int_avx512(const float *x, int n, float scale, int8_t *out8, int16_t *out16)
+{
+	const __m512 s = _mm512_set1_ps(scale);
+	const __m512 lo = _mm512_set1_ps(-32768.0f);
+	const __m512 hi = _mm512_set1_ps(32767.0f);
+	__m512i v;
+	int i;
+
+	for(i = 0; i + 16 <= n; i += 16)
+	{
+		v = _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_loadu_ps(x + i), s), lo), hi));
+		if(out8)
+		{
+			_mm_storeu_si128((__m128i *)(out8 + i), _mm512_cvtsepi32_epi8(v));
+		}
+		else
+		{
+			_mm256_storeu_si256((__m256i *)(out16 + i), _mm512_cvtsepi32_epi16(v));
+		}
+	}
+
+	return i;
+}
+
+static __attribute__((target("avx2"))) int float_to_int_avx2(const float *x, int n, float scale, int8_t *out8, int16_t *out16)
+{
+	const __m256 s = _mm256_set1_ps(scale);
+	const __m256 min = _mm256_set1_ps(-32768.0f);
+	const __m256 max = _mm256_set1_ps(32767.0f);
+	__m128i lo, hi;
+	__m256i v;
+	int i;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		v = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), s), min), max));
+		lo = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		if(out8)
+		{
+			hi = _mm_packs_epi16(lo, lo);
+			_mm_storel_epi64((__m128i *)(out8 + i), hi);
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i *)(out16 + i), lo);
+		}
+	}
+
+	return i;
+}
+
+static __attribute__((target("sse4.1"))) int float_to_int_sse41(const float *x, int n, float scale, int8_t *out8, int16_t *out16)
+{
+	const __m128 s = _mm_set1_ps(scale);
+	const __m128 min = _mm_set1_ps(-32768.0f);
+	const __m128 max = _mm_set1_ps(32767.0f);
+	__m128i lo, hi;
+	int i;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		lo = _mm_packs_epi32(_mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(x + i), s), min), max)),
+			_mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(x + i + 4), s), min), max)));
+		if(out8)
+		{
+			hi = _mm_packs_epi16(lo, lo);
+			_mm_storel_epi64((__m128i *)(out8 + i), hi);
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i *)(out16 + i), lo);
+		}
+	}
+
+	return i;
+}
+
+#endif /* MARK5_SIMD_X86 */
+
+static void float_to_int(const float *x, int n, float scale, int8_t *out8, int16_t *out16)
+{
+	float y;
+	long v;
+	int i = 0;
+
+#ifdef MARK5_SIMD_X86
+	switch(mark5_simd_level())
+	{
+	case MK5_SIMD_AVX512BW:
+		i = float_to_int_avx512(x, n, scale, out8, out16);
+		break;
+	case MK5_SIMD_AVX2:
+		i = float_to_int_avx2(x, n, scale, out8, out16);
+		break;
+	case MK5_SIMD_SSE41:
+		i = float_to_int_sse41(x, n, scale, out8, out16);
+		break;
+	default:
+		break;
+	}
+#endif
+
+	for(; i < n; ++i)
+	{
+		y = x[i]*scale;
+		v = lrintf(y > 32767.0f ? 32767.0f : (y < -32768.0f ? -32768.0f : y));
+		if(out8)
+		{
+			out8[i] = v > 127 ? 127 : (v < -128 ? -128 : v);
+		}
+		else
+		{
+			out16[i] = v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+		}
+	}
+}
+
+void mark5_simd_float_to_int8(const float *x, int n, float scale, int8_t *out)
+{
+	float_to_int(x, n, scale, out, 0);
+}
+
+void mark5_simd_float_to_int16(const float *x, int n, float scale, int16_t *out)
+{
+	float_to_int(x, n, scale, 0, out);
+}
+
+/* Find the extent of the run of equally valid data starting at byte i of
+ * the current payload, from the valid ranges published by the blanker.  As
+ * in the lookup table decoders, a unit is valid if its first byte is.
+ * Returns 1 if valid, 0 if to be blanked.
+ */
+static int nextrun(const struct mark5_stream *ms, int flagbyte, int i, int *end)
+{
+	const struct mark5_byte_range *v = ms->validrange;
+	int lo, hi, m;
+
+	if(flagbyte != 0 && (ms->payload[flagbyte] & 0x80))
+	{
+		*end = ms->databytes;
+
+		return 0;
+	}
+
+	/* the first range ending after i */
+	lo = 0;
+	hi = ms->nvalidrange;
+	while(lo < hi)
+	{
+		m = (lo + hi)/2;
+		if(v[m].end <= i)
+		{
+			lo = m + 1;
+		}
+		else
+		{
+			hi = m;
+		}
+	}
+
+	if(lo < ms->nvalidrange && v[lo].start <= i)
+	{
+		*end = v[lo].end < ms->databytes ? v[lo].end : ms->databytes;
+
+		return 1;
+	}
+	*end = (lo < ms->nvalidrange && v[lo].start < ms->databytes) ? v[lo].start : ms->databytes;
+
+	return 0;
+}
+
+static inline int chanmissing(const struct mark5_stream *ms, int c)
+{
+	return c < MARK5_MAXMASKCHAN && ((ms->chanmissing >> c) & 1);
+}
+
+/* Unpacks a valid run of a frame that lacks some channels (ms->chanmissing):
+ * those are zeroed and counted, and only the others handed to the unpacker.
+ * Complex data come as pairs of values, counted as one sample.
+ */
+static void unpack_present(struct mark5_stream *ms, const struct mark5_simd_layout *L, const unsigned char *src, int nsamp, float **data, int o, int modunit, const struct selection *S)
+{
+	int chans[MARK5_SIMD_MAXMAP];
+	int32_t vsel[MARK5_SIMD_MAXVECTORS];
+	struct selection P = { chans, 0, vsel, 0 };
+	int j, c, v;
+
+	for(j = 0; j < S->nc; ++j)
+	{
+		c = S->chans ? S->chans[j] : j;
+		if(chanmissing(ms, c))
+		{
+			memset(data[c] + o, 0, nsamp*sizeof(float));
+			ms->chaninvalid[c] += ms->iscomplex ? nsamp/2 : nsamp;
+		}
+		else
+		{
+			chans[P.nc++] = c;
+		}
+	}
+	for(j = 0; j < S->nv; ++j)
+	{
+		v = S->vsel ? S->vsel[j] : j;
+		if(!chanmissing(ms, L->chan[v]))
+		{
+			vsel[P.nv++] = v;
+		}
+	}
+
+	unpack_selection(L, src, nsamp, data, o, L->modulate, modunit, &P);
+}
+
+/* Runs of valid data are handed in one piece to the vector unpacker;
+ * blanked data are written as zeros.  Only the selected channels of data
+ * are touched.
+ */
+static int decode_selection(struct mark5_stream *ms, const struct mark5_simd_layout *L, int flagbyte, int nsamp, float **data, const struct selection *S)
+{
+	int o, i, c, j, n, end, valid;
+	int nblank = 0;
+
+	i = ms->readposition;
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		if(i >= ms->databytes)
+		{
+			if(mark5_stream_next_frame(ms) < 0)
+			{
+				return -1;
+			}
+			i = 0;
+		}
+
+		valid = nextrun(ms, flagbyte, i, &end);
+
+		/* number of samples in the units starting before end */
+		n = ((end - i + L->unitbytes - 1)/L->unitbytes)*L->unitsamples;
+		if(n > nsamp - o)
+		{
+			n = nsamp - o;
+		}
+
+		if(valid && ms->chanmissing)
+		{
+			unpack_present(ms, L, ms->payload + i, n, data, o, i/L->unitbytes, S);
+		}
+		else if(valid)
+		{
+			unpack_selection(L, ms->payload + i, n, data, o, L->modulate, i/L->unitbytes, S);
+		}
+		else
+		{
+			for(j = 0; j < S->nc; ++j)
+			{
+				c = S->chans ? S->chans[j] : j;
+				memset(data[c] + o, 0, n*sizeof(float));
+			}
+			nblank += n;
+		}
+
+		i += (n/L->unitsamples)*L->unitbytes;
+		if(i >= ms->databytes)
+		{
+			if(mark5_stream_next_frame(ms) < 0)
+			{
+				return -1;
+			}
+			i = 0;
+		}
+	}
+
+	ms->readposition = i;
+
+	return nsamp - nblank;
+}
+
+int mark5_simd_decode_stream(struct mark5_stream *ms, const struct mark5_simd_layout *L, int flagbyte, int nsamp, float **data)
+{
+	struct selection S = { 0, L->nchan, 0, L->nvector };
+
+	return decode_selection(ms, L, flagbyte, nsamp, data, &S);
+}
+
+/* The selected vectors are found once per call; as there are at most 64 of
+ * them this costs nothing next to the decoding.  Channels are distinct, as
+ * checked by mark5_stream_decode_channels().
+ */
+int mark5_simd_decode_channels_stream(struct mark5_stream *ms, const struct mark5_simd_layout *L, int flagbyte, int nsamp, const int *chanlist, int nsel, float **data)
+{
+	float *chandata[MARK5_SIMD_MAXVECTORS];
+	int32_t vsel[MARK5_SIMD_MAXVECTORS];
+	struct selection S;
+	int k, v;
+
+	if(nsel > L->nchan || L->nchan > MARK5_SIMD_MAXVECTORS)
+	{
+		return -1;
+	}
+
+	memset(chandata, 0, sizeof(chandata));
+	for(k = 0; k < nsel; ++k)
+	{
+		chandata[chanlist[k]] = data[k];
+	}
+
+	S.chans = chanlist;
+	S.nc = nsel;
+	S.vsel = vsel;
+	S.nv = 0;
+	for(v = 0; v < L->nvector; ++v)
+	{
+		if(chandata[L->chan[v]])
+		{
+			vsel[S.nv++] = v;
+		}
+	}
+
+	return decode_selection(ms, L, flagbyte, nsamp, chandata, &S);
+}
+
+/* Counts a valid run of a frame that lacks some channels: those count as invalid rather than as data */
+static void count_present(struct mark5_stream *ms, const struct mark5_simd_layout *L, const unsigned char *src, int nsamp, unsigned int *highstates)
+{
+	unsigned int h[MARK5_SIMD_MAXMAP];
+	int c;
+
+	memset(h, 0, L->nchan*sizeof(unsigned int));
+	mark5_simd_count(L, src, nsamp, h);
+	for(c = 0; c < L->nchan; ++c)
+	{
+		if(chanmissing(ms, c))
+		{
+			ms->chaninvalid[c] += ms->iscomplex ? nsamp/2 : nsamp;
+		}
+		else
+		{
+			highstates[c] += h[c];
+		}
+	}
+}
+
+int mark5_simd_count_stream(struct mark5_stream *ms, const struct mark5_simd_layout *L, int flagbyte, int nsamp, unsigned int *highstates)
+{
+	int o, i, n, end, valid;
+	int nblank = 0;
+
+	i = ms->readposition;
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		if(i >= ms->databytes)
+		{
+			if(mark5_stream_next_frame(ms) < 0)
+			{
+				return -1;
+			}
+			i = 0;
+		}
+
+		valid = nextrun(ms, flagbyte, i, &end);
+
+		n = ((end - i + L->unitbytes - 1)/L->unitbytes)*L->unitsamples;
+		if(n > nsamp - o)
+		{
+			n = nsamp - o;
+		}
+
+		if(valid && ms->chanmissing)
+		{
+			count_present(ms, L, ms->payload + i, n, highstates);
+		}
+		else if(valid)
+		{
+			mark5_simd_count(L, ms->payload + i, n, highstates);
+		}
+		else
+		{
+			nblank += n;
+		}
+
+		i += (n/L->unitsamples)*L->unitbytes;
+		if(i >= ms->databytes)
+		{
+			if(mark5_stream_next_frame(ms) < 0)
+			{
+				return -1;
+			}
+			i = 0;
+		}
+	}
+
+	ms->readposition = i;
+
+	return nsamp - nblank;
+}
+
+/* Statistics.  When every sample lies within one byte, counting how often
+ * each byte value occurs at each position within the unit tells how often
+ * every channel was in every state: one increment per byte of data, however
+ * many channels there are.  The counts are turned into per channel state
+ * counts once per call.  Positions are counted over at least 8 bytes, so
+ * that 8 bytes can be counted at once and repeated values (e.g., of a 1
+ * byte unit) do not wait on each other.
+ */
+
+#define STATS_MINPERIOD	8
+
+int mark5_simd_stats_supported(const struct mark5_simd_layout *L)
+{
+	float x;
+	int k, s, j;
+
+	if(!L->mapped || L->unitbytes > MARK5_SIMD_STATSBYTES)
+	{
+		return 0;
+	}
+	for(k = 0; k < L->nchan*L->unitsamples; ++k)
+	{
+		if(L->split ? L->magpos[k]/8 != L->signpos[k]/8 : L->signpos[k]/8 != (L->signpos[k] + L->nbit - 1)/8)
+		{
+			return 0;
+		}
+	}
+	if(L->modulate)
+	{
+		/* modulated states must decode to one of the plain levels */
+		for(s = 0; s < (1 << L->nbit); ++s)
+		{
+			x = -L->levels[s];
+			for(j = 0; j < (1 << L->nbit) && L->levels[j] != x; ++j)
+			{
+			}
+			if(j == (1 << L->nbit))
+			{
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+static void stats_count_bytes(const struct mark5_simd_layout *L, const unsigned char *src, int nunit, const unsigned char *mod, int modunit, int period, uint32_t *H)
+{
+	uint32_t *h;
+	int k, p, u, nbyte;
+
+	if(mod)
+	{
+		for(u = 0; u < nunit; ++u)
+		{
+			h = mark5_simd_modulation(mod, modunit + u) ? H + 256*period : H;
+			for(p = 0; p < L->unitbytes; ++p)
+			{
+				++h[256*p + src[p]];
+			}
+			src += L->unitbytes;
+		}
+
+		return;
+	}
+
+	/* period is a multiple of 8 */
+	nbyte = nunit*L->unitbytes;
+	for(k = 0; k + 8 <= nbyte; k += 8)
+	{
+		h = H + 256*(k % period);
+		++h[src[k]];
+		++h[256 + src[k+1]];
+		++h[512 + src[k+2]];
+		++h[768 + src[k+3]];
+		++h[1024 + src[k+4]];
+		++h[1280 + src[k+5]];
+		++h[1536 + src[k+6]];
+		++h[1792 + src[k+7]];
+	}
+	for(; k < nbyte; ++k)
+	{
+		++H[256*(k % period) + src[k]];
+	}
+}
+
+/* state of sample k of a unit, from the byte holding it */
+static inline int stats_state(const struct mark5_simd_layout *L, int k, unsigned int byte)
+{
+	if(L->split)
+	{
+		return ((byte >> (L->signpos[k] & 7)) & 1) | (((byte >> (L->magpos[k] & 7)) & 1) << 1);
+	}
+	else
+	{
+		return (byte >> (L->signpos[k] & 7)) & ((1 << L->nbit) - 1);
+	}
+}
+
+/* the first nsamp samples of the unit at src, for a run not ending on a unit
+ * boundary or of a frame lacking some channels; channels in missing are left out
+ */
+static void stats_count_partial(const struct mark5_simd_layout *L, const unsigned char *src, int nsamp, const unsigned char *mod, int modunit, uint64_t missing, long long *counts)
+{
+	int c, s, k, t;
+
+	t = mod ? mark5_simd_modulation(mod, modunit) : 0;
+	for(c = 0; c < L->nchan; ++c)
+	{
+		if(c < MARK5_MAXMASKCHAN && ((missing >> c) & 1))
+		{
+			continue;
+		}
+		for(s = 0; s < nsamp; ++s)
+		{
+			k = c*L->unitsamples + s;
+			++counts[((t*L->nchan) + c)*16 + stats_state(L, k, src[L->signpos[k] >> 3])];
+		}
+	}
+}
+
+static void stats_fold(const struct mark5_simd_layout *L, uint32_t *H, int period, long long *counts, long long nvalid, struct mark5_stream_stats *stats)
+{
+	const int nstate = 1 << L->nbit;
+	const uint32_t *h;
+	int inbyte[MARK5_SIMD_STATSBYTES][8];	/* samples held by each byte of a unit */
+	int ninbyte[MARK5_SIMD_STATSBYTES];
+	long long n;
+	float x;
+	int t, p, v, k, j, s, c, rank;
+
+	memset(ninbyte, 0, sizeof(ninbyte));
+	for(k = 0; k < L->nchan*L->unitsamples; ++k)
+	{
+		p = L->signpos[k] >> 3;
+		inbyte[p][ninbyte[p]++] = k;
+	}
+
+	for(t = 0; t < (L->modulate ? 2 : 1); ++t)
+	{
+		/* positions holding the same byte of a unit are added first */
+		for(p = L->unitbytes; p < period; ++p)
+		{
+			for(v = 0; v < 256; ++v)
+			{
+				H[256*(t*period + p % L->unitbytes) + v] += H[256*(t*period + p) + v];
+			}
+		}
+		for(p = 0; p < L->unitbytes; ++p)
+		{
+			h = H + 256*(t*period + p);
+			for(v = 0; v < 256; ++v)
+			{
+				if(h[v] == 0)
+				{
+					continue;
+				}
+				for(j = 0; j < ninbyte[p]; ++j)
+				{
+					k = inbyte[p][j];
+					c = k / L->unitsamples;
+					counts[(t*L->nchan + c)*16 + stats_state(L, k, v)] += h[v];
+				}
+			}
+		}
+	}
+
+	/* histograms are by decoded value, lowest first, as in the generic code */
+	for(c = 0; c < L->nchan; ++c)
+	{
+		for(t = 0; t < 2; ++t)
+		{
+			for(s = 0; s < nstate; ++s)
+			{
+				n = counts[(t*L->nchan + c)*16 + s];
+				if(n == 0)
+				{
+					continue;
+				}
+				x = t ? -L->levels[s] : L->levels[s];
+				for(rank = 0, v = 0; v < nstate; ++v)
+				{
+					if(L->levels[v] < x)
+					{
+						++rank;
+					}
+				}
+				stats->histogram[c*stats->nstate + rank] += n;
+				stats->sum[c] += n*(double)x;
+				stats->sumsq[c] += n*(double)x*x;
+			}
+		}
+		stats->nvalid[c] += nvalid;
+	}
+}
+
+int mark5_simd_stats_stream(struct mark5_stream *ms, const struct mark5_simd_layout *L, int flagbyte, int nsamp, struct mark5_stream_stats *stats)
+{
+	uint32_t *H;
+	long long *counts;
+	long long nmissing[MARK5_MAXMASKCHAN];
+	int o, i, n, u, c, end, valid, period;
+	int nblank = 0;
+
+	/* a whole number of units, and of the 8 bytes counted at a time */
+	for(period = L->unitbytes; period % STATS_MINPERIOD != 0; period += L->unitbytes);
+
+	H = (uint32_t *)calloc(2*period*256, sizeof(uint32_t));
+	counts = (long long *)calloc(2*L->nchan*16, sizeof(long long));
+	memset(nmissing, 0, sizeof(nmissing));
+
+	i = ms->readposition;
+
+	for(o = 0; o < nsamp; o += n)
+	{
+		if(i >= ms->databytes)
+		{
+			if(mark5_stream_next_frame(ms) < 0)
+			{
+				nblank = -1;
+
+				break;
+			}
+			i = 0;
+		}
+
+		valid = nextrun(ms, flagbyte, i, &end);
+
+		n = ((end - i + L->unitbytes - 1)/L->unitbytes)*L->unitsamples;
+		if(n > nsamp - o)
+		{
+			n = nsamp - o;
+		}
+
+		if(valid && ms->chanmissing)
+		{
+			/* bytes may hold present and missing channels alike, so sample by sample */
+			for(u = 0; u < n/L->unitsamples; ++u)
+			{
+				stats_count_partial(L, ms->payload + i + u*L->unitbytes, L->unitsamples, L->modulate, i/L->unitbytes + u, ms->chanmissing, counts);
+			}
+			if(n % L->unitsamples)
+			{
+				stats_count_partial(L, ms->payload + i + u*L->unitbytes, n % L->unitsamples, L->modulate, i/L->unitbytes + u, ms->chanmissing, counts);
+			}
+			for(c = 0; c < L->nchan && c < MARK5_MAXMASKCHAN; ++c)
+			{
+				if(chanmissing(ms, c))
+				{
+					nmissing[c] += n;
+					ms->chaninvalid[c] += n;
+				}
+			}
+		}
+		else if(valid)
+		{
+			stats_count_bytes(L, ms->payload + i, n/L->unitsamples, L->modulate, i/L->unitbytes, period, H);
+			if(n % L->unitsamples)
+			{
+				stats_count_partial(L, ms->payload + i + (n/L->unitsamples)*L->unitbytes, n % L->unitsamples, L->modulate, i/L->unitbytes + n/L->unitsamples, 0, counts);
+			}
+		}
+		else
+		{
+			nblank += n;
+		}
+
+		i += (n/L->unitsamples)*L->unitbytes;
+		if(i >= ms->databytes)
+		{
+			if(mark5_stream_next_frame(ms) < 0)
+			{
+				nblank = -1;
+
+				break;
+			}
+			i = 0;
+		}
+	}
+
+	if(nblank >= 0)
+	{
+		ms->readposition = i;
+		stats_fold(L, H, period, counts, nsamp - nblank, stats);
+		for(c = 0; c < L->nchan && c < MARK5_MAXMASKCHAN; ++c)
+		{
+			stats->nvalid[c] -= nmissing[c];
+		}
+	}
+
+	free(H);
+	free(counts);
+
+	return nblank < 0 ? -1 : nsamp - nblank;
+}
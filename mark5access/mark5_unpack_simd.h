@@ -0,0 +1,179 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#ifndef __MARK5_UNPACK_SIMD_H__
+#define __MARK5_UNPACK_SIMD_H__
+
+/* Private to the library: vectorized unpacking of payloads made of equal
+ * units, each holding a fixed number of samples of every channel.  For most
+ * formats (e.g., VDIF, Mark5B) a unit is one time slot, a contiguous
+ * little-endian group of bits holding all of the channels in order, nbit
+ * bits each.  For the track based formats (VLBA, Mark4) a unit is one word
+ * across all tracks, and the position of each bit is learned from the
+ * format's own lookup table decoder (see mark5_simd_layout_probe()).
+ *
+ * Which kernels are used is decided at run time from the instruction sets
+ * the cpu supports, possibly limited by the user (see M5A_OPT_SIMDLEVEL
+ * and the MARK5ACCESS_SIMD environment variable).
+ */
+
+#include <stdint.h>
+#include "mark5access/mark5_stream.h"
+
+#define MARK5_SIMD_MAXLANES	16
+#define MARK5_SIMD_MAXVECTORS	64
+#define MARK5_SIMD_MAXMAP	128	/* channels times samples per unit */
+#define MARK5_SIMD_STATSBYTES	16	/* largest unit for mark5_simd_stats_stream() */
+
+struct mark5_simd_layout;
+
+/* vsel lists the nv output vectors to produce, or is 0 to produce vectors 0 to nv-1 */
+typedef void (*simdUnpackFunc)(const struct mark5_simd_layout *L, const unsigned char *src, int nblock, float **data, int o, const unsigned char *mod, int modunit, const int32_t *vsel, int nv);
+typedef void (*simdCountFunc)(const struct mark5_simd_layout *L, const unsigned char *src, int nunit, unsigned int *highstates);
+
+struct mark5_simd_layout
+{
+	int nbit;		/* bits per sample: 1, 2 or 4 */
+	int nchan;		/* number of channels actually decoded */
+	int slotbits;		/* bits per time slot, incl. unused channels; 0 for track layouts */
+	int unitbytes;		/* bytes per unit */
+	int unitsamples;	/* samples per channel per unit */
+	int split;		/* 1 if the two bits of a 2 bit sample are not adjacent */
+	const unsigned char *modulate;	/* if set, unit m is negated where bit m is 1 (VLBA NRZM); see mark5_simd_modulation() */
+	uint16_t signpos[MARK5_SIMD_MAXMAP];	/* bit within unit of sample s of channel c, at [c*unitsamples + s] */
+	uint16_t magpos[MARK5_SIMD_MAXMAP];	/* split layouts: bit holding the magnitude */
+	int mapped;		/* 1 if signpos[] and magpos[] are known good, even without a kernel */
+	int lanes;		/* 32-bit lanes per vector */
+	int nreg;		/* vector registers per block */
+	int blockbytes;		/* bytes consumed per kernel block */
+	int blockunits;		/* units per block */
+	int blockslots;		/* samples per channel produced per block */
+	int nvector;		/* output vectors per block, over all channels */
+	float levels[16];	/* decoded value for each of the 1<<nbit states */
+	int32_t chan[MARK5_SIMD_MAXVECTORS];	/* output channel of each vector */
+	int32_t offset[MARK5_SIMD_MAXVECTORS];	/* output sample of each vector within a block */
+	int32_t word[MARK5_SIMD_MAXVECTORS*MARK5_SIMD_MAXLANES];	/* 32-bit word within block for each lane */
+	int32_t shift[MARK5_SIMD_MAXVECTORS*MARK5_SIMD_MAXLANES];	/* bit shift within that word */
+	int32_t word2[MARK5_SIMD_MAXVECTORS*MARK5_SIMD_MAXLANES];	/* split layouts: same for the magnitude bit */
+	int32_t shift2[MARK5_SIMD_MAXVECTORS*MARK5_SIMD_MAXLANES];
+	uint8_t flip[64];	/* modulated layouts: bits inverted to negate every sample of a register of units */
+	uint8_t modbyte[32];	/* modulated layouts: byte of the modulation bits of a register for each of its bytes */
+	uint8_t modmask[32];	/* and the bit within that byte */
+	uint32_t scale[MARK5_SIMD_MAXVECTORS*4];		/* SSE4.1: multiplier bringing the sample to the top bits */
+	uint8_t shuffle[MARK5_SIMD_MAXVECTORS*4*16];	/* SSE4.1: byte gather from each of up to 4 registers */
+	simdUnpackFunc kernel;
+
+	/* high/low state counting; 2 bit contiguous data only */
+	unsigned char high[16];	/* 1 for high states */
+	int countwords;		/* 64-bit words per count unit */
+	int countslots;		/* time slots per count unit */
+	int countxor;		/* 1 if high states have unlike bits, 0 if like */
+	int countword[64];	/* word within unit holding each channel */
+	uint64_t countmask[64];	/* bits within that word, one per time slot */
+	simdCountFunc counter;
+};
+
+/* Modulation is kept as a bitset, bit m (lsb first) for unit m, so that a
+ * whole VLBA frame's worth (2.5 kB) stays in L1 cache.  The vector kernels
+ * read it 64 bits at a time, so it must be padded by 16 bytes.
+ */
+static inline int mark5_simd_modulation(const unsigned char *modulate, int m)
+{
+	return (modulate[m >> 3] >> (m & 7)) & 1;
+}
+
+/* best level supported by this cpu */
+enum Mark5SimdLevel mark5_simd_detect(void);
+
+/* level in use: the detected one unless a lower one was requested */
+enum Mark5SimdLevel mark5_simd_level(void);
+
+/* request a level; MK5_SIMD_AUTO selects the best available.  Returns 0 on success */
+int mark5_simd_set_level(int level);
+
+/* parse names as used in MARK5ACCESS_SIMD; returns -2 if not understood */
+int mark5_simd_level_from_name(const char *name);
+
+/* returns 0 if a vector kernel is available for this layout at the current level, -1 otherwise.
+ * Only every decimation-th time slot is decoded.  For complex data each
+ * channel holds a real and an imaginary value, in that order; these are
+ * decoded as two successive samples, so data[c] may point to float complex
+ * and nsamp counts values rather than complex samples.  L->counter is set
+ * independently if high states can be counted with popcount (real data,
+ * decimation 1).
+ */
+int mark5_simd_layout_init(struct mark5_simd_layout *L, int nbit, int nchan, int slotbits, int decimation, int iscomplex, const float *levels);
+
+/* As above, for a layout of units of unitbytes bytes, each with unitsamples
+ * samples of nchan channels, at bit positions found by decoding test patterns
+ * with decode, a decimation 1 lookup table decoder reading whole units.
+ * levels are those of the states without modulation.  The result is checked
+ * against decode on random data before being accepted.
+ */
+int mark5_simd_layout_probe(struct mark5_simd_layout *L, decodeFunc decode, int nbit, int nchan, int unitbytes, int unitsamples, const float *levels, const unsigned char *modulate);
+
+/* decode nsamp samples per channel (whole units) with plain C; used for the partial blocks at ends of runs.
+ * mod is the modulation bitset, or 0, and modunit the index in it of the first unit.  Only the nc channels listed in chans are
+ * decoded, or channels 0 to nc-1 if chans is 0.
+ */
+void mark5_simd_unpack_scalar(const struct mark5_simd_layout *L, const unsigned char *src, int nsamp, float **data, int o, const unsigned char *mod, int modunit, const int *chans, int nc);
+
+/* decode nsamp samples per channel starting at src into data[c][o...].  Returns nsamp */
+int mark5_simd_unpack(const struct mark5_simd_layout *L, const unsigned char *src, int nsamp, float **data, int o, const unsigned char *mod, int modunit);
+
+/* add the number of high states in nslot time slots to highstates[c] */
+void mark5_simd_count_scalar(const struct mark5_simd_layout *L, const unsigned char *src, int nslot, unsigned int *highstates);
+int mark5_simd_count(const struct mark5_simd_layout *L, const unsigned char *src, int nslot, unsigned int *highstates);
+
+/* out[i] = x[i]*scale, rounded to nearest and saturated; used by the integer decoders */
+void mark5_simd_float_to_int8(const float *x, int n, float scale, int8_t *out);
+void mark5_simd_float_to_int16(const float *x, int n, float scale, int16_t *out);
+
+/* decodeFunc and countFunc bodies.  The payload is split into runs of units
+ * of equal validity according to the blank zones, possibly continuing over
+ * many zones; each valid run is unpacked in one piece without further checks.
+ * If flagbyte is nonzero, the msb of payload[flagbyte] set marks the whole
+ * frame as invalid (Mark5B).
+ */
+int mark5_simd_decode_stream(struct mark5_stream *ms, const struct mark5_simd_layout *L, int flagbyte, int nsamp, float **data);
+
+/* decodeChannelsFunc body: as above for the nsel distinct channels in chanlist only, channel chanlist[k]
+ * going to data[k].  Vectors of other channels are skipped entirely.
+ */
+int mark5_simd_decode_channels_stream(struct mark5_stream *ms, const struct mark5_simd_layout *L, int flagbyte, int nsamp, const int *chanlist, int nsel, float **data);
+int mark5_simd_count_stream(struct mark5_stream *ms, const struct mark5_simd_layout *L, int flagbyte, int nsamp, unsigned int *highstates);
+
+/* statisticsFunc body, from counts of byte values; no samples are decoded.
+ * Usable if mark5_simd_stats_supported(), which needs the bit positions
+ * (L->mapped) but no kernel, and every sample to lie within one byte.
+ */
+int mark5_simd_stats_supported(const struct mark5_simd_layout *L);
+int mark5_simd_stats_stream(struct mark5_stream *ms, const struct mark5_simd_layout *L, int flagbyte, int nsamp, struct mark5_stream_stats *stats);
+
+#endif
@@ -0,0 +1,281 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "config.h"
+#include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_uring.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+
+/* The submission and completion rings are shared with the kernel: the
+ * producer of each ring moves its tail, the consumer its head, with release
+ * stores and acquire loads so entries are complete before they are seen.
+ */
+struct mark5_uring
+{
+	int fd;
+	unsigned int depth;	/* entries in the submission ring */
+	unsigned int queued;	/* queued since the last submit */
+
+	void *sqmap, *cqmap;
+	size_t sqmapsize, cqmapsize;
+	struct io_uring_sqe *sqes;
+	size_t sqessize;
+
+	unsigned int *sqhead, *sqtail, *sqmask, *sqarray;
+	unsigned int *cqhead, *cqtail, *cqmask;
+	struct io_uring_cqe *cqes;
+};
+
+struct mark5_uring *mark5_uring_new(int depth)
+{
+	struct mark5_uring *U;
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+
+	U = (struct mark5_uring *)calloc(1, sizeof(struct mark5_uring));
+	U->fd = syscall(__NR_io_uring_setup, depth, &p);
+	if(U->fd < 0)
+	{
+		free(U);
+
+		return 0;
+	}
+	U->depth = p.sq_entries;
+
+	U->sqmapsize = p.sq_off.array + p.sq_entries*sizeof(unsigned int);
+	U->cqmapsize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(U->cqmapsize > U->sqmapsize)
+		{
+			U->sqmapsize = U->cqmapsize;
+		}
+		U->cqmapsize = U->sqmapsize;
+	}
+	U->sqmap = mmap(0, U->sqmapsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, U->fd, IORING_OFF_SQ_RING);
+	if(U->sqmap == MAP_FAILED)
+	{
+		close(U->fd);
+		free(U);
+
+		return 0;
+	}
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		U->cqmap = U->sqmap;
+	}
+	else
+	{
+		U->cqmap = mmap(0, U->cqmapsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, U->fd, IORING_OFF_CQ_RING);
+		if(U->cqmap == MAP_FAILED)
+		{
+			munmap(U->sqmap, U->sqmapsize);
+			close(U->fd);
+			free(U);
+
+			return 0;
+		}
+	}
+	U->sqessize = p.sq_entries*sizeof(struct io_uring_sqe);
+	U->sqes = (struct io_uring_sqe *)mmap(0, U->sqessize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, U->fd, IORING_OFF_SQES);
+	if(U->sqes == MAP_FAILED)
+	{
+		if(U->cqmap != U->sqmap)
+		{
+			munmap(U->cqmap, U->cqmapsize);
+		}
+		munmap(U->sqmap, U->sqmapsize);
+		close(U->fd);
+		free(U);
+
+		return 0;
+	}
+
+	U->sqhead = (unsigned int *)((char *)U->sqmap + p.sq_off.head);
+	U->sqtail = (unsigned int *)((char *)U->sqmap + p.sq_off.tail);
+	U->sqmask = (unsigned int *)((char *)U->sqmap + p.sq_off.ring_mask);
+	U->sqarray = (unsigned int *)((char *)U->sqmap + p.sq_off.array);
+	U->cqhead = (unsigned int *)((char *)U->cqmap + p.cq_off.head);
+	U->cqtail = (unsigned int *)((char *)U->cqmap + p.cq_off.tail);
+	U->cqmask = (unsigned int *)((char *)U->cqmap + p.cq_off.ring_mask);
+	U->cqes = (struct io_uring_cqe *)((char *)U->cqmap + p.cq_off.cqes);
+
+	return U;
+}
+
+void mark5_uring_delete(struct mark5_uring *U)
+{
+	if(!U)
+	{
+		return;
+	}
+	munmap(U->sqes, U->sqessize);
+	if(U->cqmap != U->sqmap)
+	{
+		munmap(U->cqmap, U->cqmapsize);
+	}
+	munmap(U->sqmap, U->sqmapsize);
+	close(U->fd);
+	free(U);
+}
+
+int mark5_uring_register_buffers(struct mark5_uring *U, unsigned char **bufs, int n, size_t length)
+{
+	struct iovec *iov;
+	int i, r;
+
+	iov = (struct iovec *)malloc(n*sizeof(struct iovec));
+	for(i = 0; i < n; ++i)
+	{
+		iov[i].iov_base = bufs[i];
+		iov[i].iov_len = length;
+	}
+	/* fails, e.g., if the buffers exceed RLIMIT_MEMLOCK; plain reads are then used */
+	r = syscall(__NR_io_uring_register, U->fd, IORING_REGISTER_BUFFERS, iov, n);
+	free(iov);
+
+	return r < 0 ? -1 : 0;
+}
+
+int mark5_uring_queue_read(struct mark5_uring *U, int fd, unsigned char *buf, int bufindex, int length, long long pos, unsigned long long tag)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int tail, index;
+
+	tail = *U->sqtail;
+	if(tail - __atomic_load_n(U->sqhead, __ATOMIC_ACQUIRE) >= U->depth)
+	{
+		return -1;
+	}
+	index = tail & *U->sqmask;
+	sqe = &U->sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = bufindex >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = length;
+	sqe->off = pos;
+	sqe->buf_index = bufindex >= 0 ? bufindex : 0;
+	sqe->user_data = tag;
+	U->sqarray[index] = index;
+	__atomic_store_n(U->sqtail, tail + 1, __ATOMIC_RELEASE);
+	++U->queued;
+
+	return 0;
+}
+
+int mark5_uring_submit(struct mark5_uring *U)
+{
+	int r;
+
+	while(U->queued > 0)
+	{
+		r = syscall(__NR_io_uring_enter, U->fd, U->queued, 0, 0, 0, 0);
+		if(r < 0)
+		{
+			if(errno == EINTR || errno == EAGAIN)
+			{
+				continue;
+			}
+
+			return -1;
+		}
+		U->queued -= r;
+	}
+
+	return 0;
+}
+
+int mark5_uring_wait(struct mark5_uring *U, unsigned long long *tag, int *res)
+{
+	struct io_uring_cqe *cqe;
+	unsigned int head;
+
+	head = *U->cqhead;
+	while(head == __atomic_load_n(U->cqtail, __ATOMIC_ACQUIRE))
+	{
+		if(syscall(__NR_io_uring_enter, U->fd, 0, 1, IORING_ENTER_GETEVENTS, 0, 0) < 0 && errno != EINTR)
+		{
+			return -1;
+		}
+	}
+	cqe = &U->cqes[head & *U->cqmask];
+	*tag = cqe->user_data;
+	*res = cqe->res;
+	__atomic_store_n(U->cqhead, head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+#else
+
+struct mark5_uring *mark5_uring_new(int depth)
+{
+	return 0;
+}
+
+void mark5_uring_delete(struct mark5_uring *U)
+{
+}
+
+int mark5_uring_register_buffers(struct mark5_uring *U, unsigned char **bufs, int n, size_t length)
+{
+	return -1;
+}
+
+int mark5_uring_queue_read(struct mark5_uring *U, int fd, unsigned char *buf, int bufindex, int length, long long pos, unsigned long long tag)
+{
+	return -1;
+}
+
+int mark5_uring_submit(struct mark5_uring *U)
+{
+	return -1;
+}
+
+int mark5_uring_wait(struct mark5_uring *U, unsigned long long *tag, int *res)
+{
+	return -1;
+}
+
+#endif
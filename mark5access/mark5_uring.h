@@ -0,0 +1,66 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the mark5access developers                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#ifndef __MARK5_URING_H__
+#define __MARK5_URING_H__
+
+/* Private to the library: a minimal io_uring (Linux 5.1 and later) queue of
+ * reads, used by the file stream to keep several large reads in flight.
+ * The kernel interface is used directly, without liburing.  Where io_uring
+ * is not available, mark5_uring_new() returns 0 and the caller reads
+ * synchronously instead.
+ */
+
+#include <sys/types.h>
+
+struct mark5_uring;
+
+/* returns 0 if io_uring cannot be used, e.g., old kernel or denied by policy */
+struct mark5_uring *mark5_uring_new(int depth);
+
+void mark5_uring_delete(struct mark5_uring *U);
+
+/* registers n buffers of length bytes each for fixed buffer reads; returns 0 on success */
+int mark5_uring_register_buffers(struct mark5_uring *U, unsigned char **bufs, int n, size_t length);
+
+/* queues a read of length bytes at file position pos into buf, the bufindex-th
+ * registered buffer or any memory if bufindex < 0.  tag identifies the read on
+ * completion.  Returns 0 on success, -1 if the queue is full.
+ */
+int mark5_uring_queue_read(struct mark5_uring *U, int fd, unsigned char *buf, int bufindex, int length, long long pos, unsigned long long tag);
+
+/* hands the queued reads to the kernel; returns the number submitted or -1 */
+int mark5_uring_submit(struct mark5_uring *U);
+
+/* waits for a read to complete; res is as returned by pread(), or -errno.
+ * Returns 0 on success, -1 on error.
+ */
+int mark5_uring_wait(struct mark5_uring *U, unsigned long long *tag, int *res);
+
+#endif
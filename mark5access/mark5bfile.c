@@ -35,6 +35,7 @@
 #include <sys/stat.h>
 #include <time.h>
 #include "mark5bfile.h"
+#include "mark5access/mark5_stream.h"
 
 #define MARK5B_FRAME_SIZE	10016
 #define MARK5B_HEADER_SIZE	16
@@ -49,6 +50,9 @@
 
 #define MJD_UNIX0		40587.0
 
+#define MARK5B_SUMMARY_CACHE_KEY	"mark5b"
+#define MARK5B_SUMMARY_CACHE_FORMAT	"%lld %d %d %d %d %d %d %d %d %d %d"
+
 void resetmark5bfilesummary(struct mark5b_file_summary *sum)
 {
 	memset(sum, 0, sizeof(struct mark5b_file_summary));
@@ -132,9 +136,22 @@ int summarizemark5bfile(struct mark5b_file_summary *sum, const char *fileName)
 	int lastOffset;
 	FILE *in;
 	int seconds0, seconds1;
+	char cached[256];
 
 	/* Initialize things */
 
+	resetmark5bfilesummary(sum);
+	strncpy(sum->fileName, fileName, MARK5B_SUMMARY_FILE_LENGTH-1);
+
+	/* A summary made earlier of this same file, if caching is on */
+
+	if(mark5_cache_get(fileName, MARK5B_SUMMARY_CACHE_KEY, cached, sizeof(cached)) == 0 &&
+		sscanf(cached, MARK5B_SUMMARY_CACHE_FORMAT, &sum->fileSize, &sum->nBit, &sum->nChannel, &sum->framesPerSecond,
+			&sum->startDay, &sum->startSecond, &sum->startFrame, &sum->endDay, &sum->endSecond, &sum->endFrame,
+			&sum->firstFrameOffset) == 11)
+	{
+		return 0;
+	}
 	resetmark5bfilesummary(sum);
 	strncpy(sum->fileName, fileName, MARK5B_SUMMARY_FILE_LENGTH-1);
 	sum->startSecond = 1<<30;
@@ -248,6 +265,11 @@ int summarizemark5bfile(struct mark5b_file_summary *sum, const char *fileName)
 	free(buffer);
 	fclose(in);
 
+	snprintf(cached, sizeof(cached), MARK5B_SUMMARY_CACHE_FORMAT, sum->fileSize, sum->nBit, sum->nChannel, sum->framesPerSecond,
+		sum->startDay, sum->startSecond, sum->startFrame, sum->endDay, sum->endSecond, sum->endFrame,
+		sum->firstFrameOffset);
+	mark5_cache_put(fileName, MARK5B_SUMMARY_CACHE_KEY, cached);
+
 	return 0;
 }
 
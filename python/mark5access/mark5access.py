@@ -168,10 +168,13 @@ mark5_stream_count_high_states.restype = c_int
 mark5_stream_count_high_states.argtypes = [POINTER(mark5_stream), c_int, POINTER(c_uint)]
 new_mark5_stream_memory = _libraries['libmark5access.so'].new_mark5_stream_memory
 new_mark5_stream_memory.restype = POINTER(mark5_stream_generic)
-new_mark5_stream_memory.argtypes = [c_void_p, c_uint]
+new_mark5_stream_memory.argtypes = [c_void_p, c_longlong]
 new_mark5_stream_file = _libraries['libmark5access.so'].new_mark5_stream_file
 new_mark5_stream_file.restype = POINTER(mark5_stream_generic)
 new_mark5_stream_file.argtypes = [STRING, c_longlong]
+mark5_stream_file_set_buffersize = _libraries['libmark5access.so'].mark5_stream_file_set_buffersize
+mark5_stream_file_set_buffersize.restype = c_int
+mark5_stream_file_set_buffersize.argtypes = [POINTER(mark5_stream_generic), c_longlong]
 mark5_stream_file_add_infile = _libraries['libmark5access.so'].mark5_stream_file_add_infile
 mark5_stream_file_add_infile.restype = c_int
 mark5_stream_file_add_infile.argtypes = [POINTER(mark5_stream), STRING]
@@ -230,6 +233,7 @@ mark5_format._fields_ = [
     ('framesperperiod', c_int),
     ('alignmentseconds', c_int),
     ('decimation', c_int),
+    ('score', c_int),
 ]
 mark5_stream_list_formats = _libraries['libmark5access.so'].mark5_stream_list_formats
 mark5_stream_list_formats.restype = STRING
@@ -280,6 +284,7 @@ __all__ = ['mark5_stream_next_frame', 'new_mark5_format_mark4',
            'new_mark5_format_from_stream', 'decodeFunc',
            'MK5_BLANKER_VDIF', 'print_mark5_format',
            'mark5_stream_seek', 'mark5_stream_file_add_infile',
+           'mark5_stream_file_set_buffersize',
            'new_mark5_stream_absorb', 'new_mark5_stream_file',
            'mark5_stream_print', 'MK5_FORMAT_VDIFL',
            'mark5_stream_list_formats', 'delete_mark5_stream_generic',